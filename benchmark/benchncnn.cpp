@@ -12,12 +12,16 @@
 // CONDITIONS OF ANY KIND, either express or implied. See the License for the
 // specific language governing permissions and limitations under the License.
 
+#include <algorithm>
 #include <float.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
-#include <algorithm>
 #include <windows.h> // Sleep()
 #else
 #include <unistd.h> // sleep()
@@ -32,6 +36,7 @@
 #include "datareader.h"
 #include "net.h"
 #include "gpu.h"
+#include "layer/batchnorm.h"
 
 class DataReaderFromEmpty : public ncnn::DataReader
 {
@@ -47,10 +52,56 @@ public:
     }
 };
 
+// reproducible small weights for the sequence benchmark
+// zero weights would make every relu output trivially skippable
+class DataReaderFromRandom : public ncnn::DataReader
+{
+public:
+    DataReaderFromRandom()
+        : seed(7767517)
+    {
+    }
+    virtual int scan(const char* format, void* p) const
+    {
+        return 0;
+    }
+    virtual size_t read(void* buf, size_t size) const
+    {
+        if (size == sizeof(unsigned int))
+        {
+            // weight type tag, 0 = raw float32
+            memset(buf, 0, size);
+            return size;
+        }
+
+        float* p = (float*)buf;
+        for (size_t i = 0; i < size / sizeof(float); i++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            p[i] = ((seed >> 8) / 16777216.f - 0.5f) * 0.2f;
+        }
+        return size;
+    }
+
+private:
+    mutable unsigned int seed;
+};
+
 static int g_warmup_loop_count = 8;
 static int g_loop_count = 4;
 static bool g_enable_cooling_down = true;
 
+// 0 = constant input, 1 = synthetic sequences, 2 = frames from g_sequence_dir
+static int g_sequence_mode = 0;
+static const char* g_sequence_dir = 0;
+static const int g_sequence_length = 64;
+
+#ifdef __EMSCRIPTEN__
+#define MODEL_DIR "/working/"
+#else
+#define MODEL_DIR ""
+#endif
+
 static ncnn::UnlockedPoolAllocator g_blob_pool_allocator;
 static ncnn::PoolAllocator g_workspace_pool_allocator;
 
@@ -60,8 +111,233 @@ static ncnn::VkAllocator* g_blob_vkallocator = 0;
 static ncnn::VkAllocator* g_staging_vkallocator = 0;
 #endif // NCNN_VULKAN
 
+static void sleep_for_cooling_down()
+{
+    if (g_enable_cooling_down)
+    {
+        // sleep 10 seconds for cooling down SOC  :(
+#ifdef _WIN32
+        Sleep(10 * 1000);
+#elif defined(__unix__) || defined(__APPLE__)
+        sleep(10);
+#elif _POSIX_TIMERS
+        struct timespec ts;
+        ts.tv_sec = 10;
+        ts.tv_nsec = 0;
+        nanosleep(&ts, &ts);
+#else
+        // TODO How to handle it ?
+#endif
+    }
+}
+
+// smooth scene with edges, value in [-1, 1], pixel (x, y) of scene id
+static float scene_value(int scene, int x, int y, int q)
+{
+    const float fx = x * (0.031f + scene * 0.007f);
+    const float fy = y * (0.023f + q * 0.005f);
+    float v = 0.6f * sinf(fx + scene) * cosf(fy - q);
+    if (((x + scene * 13) / 24 + (y + q * 7) / 24) % 2)
+        v += 0.4f;
+    return v - 0.2f;
+}
+
+static void make_synthetic_sequence(const char* type, int w, int h, int c, std::vector<ncnn::Mat>& frames)
+{
+    unsigned int seed = 20210101;
+
+    frames.resize(g_sequence_length);
+    for (int t = 0; t < g_sequence_length; t++)
+    {
+        ncnn::Mat& m = frames[t];
+        m.create(w, h, c);
+
+        // slow pan moves one pixel per frame, scene cut every 16 frames
+        const int pan = strcmp(type, "pan") == 0 ? t : 0;
+        const int scene = strcmp(type, "cut") == 0 ? t / 16 : 0;
+        const float noise = strcmp(type, "noise") == 0 ? 0.02f : 0.f;
+
+        for (int q = 0; q < c; q++)
+        {
+            float* ptr = m.channel(q);
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    float v = scene_value(scene, x + pan, y, q);
+                    if (noise != 0.f)
+                    {
+                        seed = seed * 1664525 + 1013904223;
+                        v += ((seed >> 8) / 16777216.f - 0.5f) * 2.f * noise;
+                    }
+                    ptr[x] = v;
+                }
+                ptr += w;
+            }
+        }
+    }
+}
+
+// read binary ppm/pgm, return 0 if success
+static int read_pnm(const char* path, std::vector<unsigned char>& pixels, int& w, int& h, int& c)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return -1;
+
+    char magic[3] = {0};
+    int maxval = 0;
+    int nscan = fscanf(fp, "%2s %d %d %d", magic, &w, &h, &maxval);
+    if (nscan != 4 || maxval != 255 || (strcmp(magic, "P6") != 0 && strcmp(magic, "P5") != 0))
+    {
+        fclose(fp);
+        return -1;
+    }
+    fgetc(fp);
+
+    c = magic[1] == '6' ? 3 : 1;
+    pixels.resize((size_t)w * h * c);
+    size_t nread = fread(pixels.data(), 1, pixels.size(), fp);
+    fclose(fp);
+
+    return nread == pixels.size() ? 0 : -1;
+}
+
+// frames named 000000.ppm 000001.ppm ... in g_sequence_dir, resized to w x h
+static void load_sequence_dir(int w, int h, int c, std::vector<ncnn::Mat>& frames)
+{
+    frames.clear();
+    for (int t = 0; t < g_sequence_length; t++)
+    {
+        char path[256];
+        sprintf(path, "%s/%06d.ppm", g_sequence_dir, t);
+
+        std::vector<unsigned char> pixels;
+        int pw, ph, pc;
+        if (read_pnm(path, pixels, pw, ph, pc) != 0)
+            break;
+
+        int type = pc == 3 ? (c == 3 ? ncnn::Mat::PIXEL_RGB : ncnn::Mat::PIXEL_RGB2GRAY) : (c == 3 ? ncnn::Mat::PIXEL_GRAY2RGB : ncnn::Mat::PIXEL_GRAY);
+        ncnn::Mat m = ncnn::Mat::from_pixels_resize(pixels.data(), type, pw, ph, w, h);
+
+        const float mean_vals[3] = {127.5f, 127.5f, 127.5f};
+        const float norm_vals[3] = {1 / 127.5f, 1 / 127.5f, 1 / 127.5f};
+        m.substract_mean_normalize(mean_vals, norm_vals);
+
+        frames.push_back(m);
+    }
+}
+
+static double percentile(std::vector<double> times, double p)
+{
+    std::sort(times.begin(), times.end());
+    size_t index = (size_t)(p * (times.size() - 1) + 0.5);
+    return times[index];
+}
+
+void benchmark_sequence(const char* comment, const ncnn::Mat& _in, const ncnn::Option& _opt)
+{
+    // sparse paths are float only
+    if (strstr(comment, "_int8"))
+        return;
+
+    std::vector<std::string> sequence_names;
+    std::vector<std::vector<ncnn::Mat> > sequences;
+    if (g_sequence_mode == 1)
+    {
+        const char* types[4] = {"static", "pan", "noise", "cut"};
+        for (int i = 0; i < 4; i++)
+        {
+            sequence_names.push_back(types[i]);
+            sequences.push_back(std::vector<ncnn::Mat>());
+            make_synthetic_sequence(types[i], _in.w, _in.h, _in.c, sequences.back());
+        }
+    }
+    else
+    {
+        sequence_names.push_back("dir");
+        sequences.push_back(std::vector<ncnn::Mat>());
+        load_sequence_dir(_in.w, _in.h, _in.c, sequences.back());
+        if (sequences.back().empty())
+        {
+            fprintf(stderr, "no frames found in %s\n", g_sequence_dir);
+            return;
+        }
+    }
+
+    sleep_for_cooling_down();
+
+    const char* mode_names[3] = {"raw", "temporal", "spatial"};
+    for (size_t si = 0; si < sequences.size(); si++)
+    {
+        const std::vector<ncnn::Mat>& frames = sequences[si];
+
+        for (int mode = 0; mode < 3; mode++)
+        {
+            g_blob_pool_allocator.clear();
+            g_workspace_pool_allocator.clear();
+
+            // fresh net per run, temporal state starts from the first frame
+            ncnn::Net net;
+
+            net.opt = _opt;
+            net.opt.use_vulkan_compute = false;
+            net.opt.use_temporal_sparsity = mode == 1;
+            net.opt.use_spatial_sparsity = mode == 2;
+
+            char parampath[256];
+            sprintf(parampath, MODEL_DIR "%s.param", comment);
+            if (net.load_param(parampath) != 0)
+                return;
+
+            DataReaderFromRandom dr;
+            net.load_model(dr);
+
+            // random running variance could be negative, make batchnorm identity
+            for (size_t i = 0; i < net.layers().size(); i++)
+            {
+                if (net.layers()[i]->type == "BatchNorm")
+                {
+                    ncnn::BatchNorm* bn = (ncnn::BatchNorm*)net.layers()[i];
+                    bn->a_data.fill(0.f);
+                    bn->b_data.fill(1.f);
+                }
+            }
+
+            const std::vector<const char*>& input_names = net.input_names();
+            const std::vector<const char*>& output_names = net.output_names();
+
+            std::vector<double> times(frames.size());
+            for (size_t t = 0; t < frames.size(); t++)
+            {
+                double start = ncnn::get_current_time();
+
+                {
+                    ncnn::Mat out;
+                    ncnn::Extractor ex = net.create_extractor();
+                    ex.input(input_names[0], frames[t]);
+                    ex.extract(output_names[0], out);
+                }
+
+                double end = ncnn::get_current_time();
+
+                times[t] = end - start;
+            }
+
+            fprintf(stderr, "%20s  %-6s  %-8s  p50 = %7.2f  p90 = %7.2f  p99 = %7.2f  max = %7.2f\n", comment, sequence_names[si].c_str(), mode_names[mode],
+                    percentile(times, 0.5), percentile(times, 0.9), percentile(times, 0.99), percentile(times, 1.0));
+        }
+    }
+}
+
 void benchmark(const char* comment, const ncnn::Mat& _in, const ncnn::Option& opt)
 {
+    if (g_sequence_mode != 0)
+    {
+        benchmark_sequence(comment, _in, opt);
+        return;
+    }
+
     ncnn::Mat in = _in;
     in.fill(0.01f);
 
@@ -87,12 +363,6 @@ void benchmark(const char* comment, const ncnn::Mat& _in, const ncnn::Option& op
     }
 #endif // NCNN_VULKAN
 
-#ifdef __EMSCRIPTEN__
-#define MODEL_DIR "/working/"
-#else
-#define MODEL_DIR ""
-#endif
-
     char parampath[256];
     sprintf(parampath, MODEL_DIR "%s.param", comment);
     net.load_param(parampath);
@@ -103,22 +373,7 @@ void benchmark(const char* comment, const ncnn::Mat& _in, const ncnn::Option& op
     const std::vector<const char*>& input_names = net.input_names();
     const std::vector<const char*>& output_names = net.output_names();
 
-    if (g_enable_cooling_down)
-    {
-        // sleep 10 seconds for cooling down SOC  :(
-#ifdef _WIN32
-        Sleep(10 * 1000);
-#elif defined(__unix__) || defined(__APPLE__)
-        sleep(10);
-#elif _POSIX_TIMERS
-        struct timespec ts;
-        ts.tv_sec = 10;
-        ts.tv_nsec = 0;
-        nanosleep(&ts, &ts);
-#else
-        // TODO How to handle it ?
-#endif
-    }
+    sleep_for_cooling_down();
 
     ncnn::Mat out;
 
@@ -186,6 +441,19 @@ int main(int argc, char** argv)
     {
         cooling_down = atoi(argv[5]);
     }
+    if (argc >= 7)
+    {
+        // 0 = constant input, 1 = synthetic sequences, otherwise a frame directory
+        if (strcmp(argv[6], "0") == 0 || strcmp(argv[6], "1") == 0)
+        {
+            g_sequence_mode = atoi(argv[6]);
+        }
+        else
+        {
+            g_sequence_mode = 2;
+            g_sequence_dir = argv[6];
+        }
+    }
 
 #ifdef __EMSCRIPTEN__
     EM_ASM(
@@ -248,6 +516,10 @@ int main(int argc, char** argv)
     fprintf(stderr, "powersave = %d\n", ncnn::get_cpu_powersave());
     fprintf(stderr, "gpu_device = %d\n", gpu_device);
     fprintf(stderr, "cooling_down = %d\n", (int)g_enable_cooling_down);
+    if (g_sequence_mode == 2)
+        fprintf(stderr, "sequence = %s\n", g_sequence_dir);
+    else
+        fprintf(stderr, "sequence = %d\n", g_sequence_mode);
 
     // run
     benchmark("squeezenet", ncnn::Mat(227, 227, 3), opt);
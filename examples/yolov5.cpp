@@ -14,6 +14,7 @@
 
 #include "layer.h"
 #include "net.h"
+#include "nms.h"
 
 #if defined(USE_NCNN_SIMPLEOCV)
 #include "simpleocv.h"
@@ -88,88 +89,34 @@ struct Object
     float prob;
 };
 
-static inline float intersection_area(const Object& a, const Object& b)
+// sort by score from highest to lowest and apply nms
+static void nms_sorted_bboxes(const std::vector<Object>& proposals, std::vector<int>& picked, float nms_threshold)
 {
-    cv::Rect_<float> inter = a.rect & b.rect;
-    return inter.area();
-}
-
-static void qsort_descent_inplace(std::vector<Object>& faceobjects, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].prob;
-
-    while (i <= j)
-    {
-        while (faceobjects[i].prob > p)
-            i++;
-
-        while (faceobjects[j].prob < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
-
-            i++;
-            j--;
-        }
-    }
-
-    #pragma omp parallel sections
-    {
-        #pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
-        }
-        #pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
-        }
-    }
-}
+    picked.clear();
 
-static void qsort_descent_inplace(std::vector<Object>& faceobjects)
-{
-    if (faceobjects.empty())
+    if (proposals.empty())
         return;
 
-    qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
-}
-
-static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
+    std::vector<int> order;
+    ncnn::sort_descent_topk(&proposals.data()->prob, proposals.size(), sizeof(Object) / sizeof(float), 0, order);
 
-    const int n = faceobjects.size();
+    const int n = order.size();
 
-    std::vector<float> areas(n);
+    std::vector<float> bboxes(n * 4);
     for (int i = 0; i < n; i++)
     {
-        areas[i] = faceobjects[i].rect.area();
+        const cv::Rect_<float>& r = proposals[order[i]].rect;
+        bboxes[i * 4] = r.x;
+        bboxes[i * 4 + 1] = r.y;
+        bboxes[i * 4 + 2] = r.x + r.width;
+        bboxes[i * 4 + 3] = r.y + r.height;
     }
 
-    for (int i = 0; i < n; i++)
-    {
-        const Object& a = faceobjects[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const Object& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
+    ncnn::nms_sorted_bboxes(bboxes.data(), n, 4, 0, 0, nms_threshold, picked);
 
-        if (keep)
-            picked.push_back(i);
+    for (size_t i = 0; i < picked.size(); i++)
+    {
+        picked[i] = order[picked[i]];
     }
 }
 
@@ -395,8 +342,6 @@ static int detect_yolov5(const cv::Mat& bgr, std::vector<Object>& objects)
     }
 
     // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
-
     // apply nms with nms_threshold
     std::vector<int> picked;
     nms_sorted_bboxes(proposals, picked, nms_threshold);
@@ -291,6 +291,337 @@ void UnlockedPoolAllocator::fastFree(void* ptr)
     ncnn::fastFree(ptr);
 }
 
+class ArenaBlock
+{
+public:
+    size_t size;
+    size_t offset;
+    int alloc_time;
+    int free_time;
+
+    // blocks sharing address range, planned to be released before this one
+    std::vector<int> conflicts;
+};
+
+struct arena_block_size_greater
+{
+    const std::vector<ArenaBlock>* blocks;
+
+    bool operator()(int a, int b) const
+    {
+        return (*blocks)[a].size > (*blocks)[b].size;
+    }
+};
+
+class ArenaAllocatorPrivate
+{
+public:
+    void plan();
+
+    Mutex lock;
+
+    std::vector<ArenaBlock> blocks;
+    bool planned;
+    // the frame left the plan, record the next one
+    bool replan;
+    // the rest of this frame goes to the heap
+    bool bypass;
+    // this frame records the allocation sequence
+    bool recording;
+
+    unsigned char* arena;
+    size_t arena_size;
+    // arena blocks not released yet
+    int arena_live;
+    // bytes of this frame served from the heap
+    size_t heap_bytes;
+
+    int clock;
+    int seq;
+    std::vector<char> live;
+
+    // recording frame, heap pointer to block index
+    std::vector<std::pair<void*, int> > recorded_ptrs;
+};
+
+// each arena block starts with its index, the payload follows aligned
+#define NCNN_ARENA_HEADER NCNN_MALLOC_ALIGN
+
+void ArenaAllocatorPrivate::plan()
+{
+    const int block_count = (int)blocks.size();
+
+    std::vector<int> order(block_count);
+    for (int i = 0; i < block_count; i++)
+    {
+        order[i] = i;
+    }
+
+    // largest first, each block takes the lowest gap among the blocks alive with it
+    arena_block_size_greater comp;
+    comp.blocks = &blocks;
+    std::partial_sort(order.begin(), order.end(), order.end(), comp);
+
+    arena_size = 0;
+    std::vector<int> placed;
+    for (int i = 0; i < block_count; i++)
+    {
+        ArenaBlock& b = blocks[order[i]];
+
+        std::vector<std::pair<size_t, size_t> > taken;
+        for (size_t j = 0; j < placed.size(); j++)
+        {
+            const ArenaBlock& p = blocks[placed[j]];
+            if (p.alloc_time < b.free_time && b.alloc_time < p.free_time)
+                taken.push_back(std::make_pair(p.offset, p.offset + p.size));
+        }
+
+        // sort the taken ranges by offset
+        for (size_t j = 1; j < taken.size(); j++)
+        {
+            for (size_t k = j; k > 0 && taken[k].first < taken[k - 1].first; k--)
+            {
+                std::swap(taken[k], taken[k - 1]);
+            }
+        }
+
+        size_t offset = 0;
+        for (size_t j = 0; j < taken.size(); j++)
+        {
+            if (taken[j].first >= offset + b.size)
+                break;
+
+            offset = std::max(offset, taken[j].second);
+        }
+
+        b.offset = offset;
+        arena_size = std::max(arena_size, offset + b.size);
+        placed.push_back(order[i]);
+    }
+
+    for (int i = 0; i < block_count; i++)
+    {
+        ArenaBlock& b = blocks[i];
+        b.conflicts.clear();
+        for (int j = 0; j < i; j++)
+        {
+            const ArenaBlock& p = blocks[j];
+            if (p.offset < b.offset + b.size && b.offset < p.offset + p.size)
+                b.conflicts.push_back(j);
+        }
+    }
+
+    arena = (unsigned char*)ncnn::fastMalloc(arena_size);
+    live.assign(block_count, 0);
+    planned = true;
+}
+
+ArenaAllocator::ArenaAllocator()
+    : Allocator(), d(new ArenaAllocatorPrivate)
+{
+    d->planned = false;
+    d->replan = false;
+    d->bypass = false;
+    d->recording = false;
+    d->arena = 0;
+    d->arena_size = 0;
+    d->arena_live = 0;
+    d->heap_bytes = 0;
+    d->clock = 0;
+    d->seq = 0;
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+    clear();
+
+    delete d;
+}
+
+ArenaAllocator::ArenaAllocator(const ArenaAllocator&)
+    : d(0)
+{
+}
+
+ArenaAllocator& ArenaAllocator::operator=(const ArenaAllocator&)
+{
+    return *this;
+}
+
+void ArenaAllocator::begin_frame()
+{
+    d->lock.lock();
+
+    if (d->recording)
+    {
+        // blocks still held at the end of the recorded frame live through it
+        for (size_t i = 0; i < d->blocks.size(); i++)
+        {
+            if (d->blocks[i].free_time < 0)
+                d->blocks[i].free_time = d->clock;
+        }
+        d->recorded_ptrs.clear();
+        d->recording = false;
+
+        d->plan();
+    }
+
+    d->seq = 0;
+    d->clock = 0;
+    d->bypass = false;
+    d->heap_bytes = 0;
+
+    if (d->arena_live > 0)
+    {
+        // the previous frame still holds arena blocks, keep away from them
+        d->bypass = true;
+    }
+    else if (!d->planned || d->replan)
+    {
+        if (d->arena)
+        {
+            ncnn::fastFree(d->arena);
+            d->arena = 0;
+        }
+        d->arena_size = 0;
+        d->blocks.clear();
+        d->planned = false;
+        d->replan = false;
+        d->recording = true;
+    }
+    else
+    {
+        d->live.assign(d->blocks.size(), 0);
+    }
+
+    d->lock.unlock();
+}
+
+size_t ArenaAllocator::arena_size() const
+{
+    return d->planned ? d->arena_size : 0;
+}
+
+size_t ArenaAllocator::heap_bytes() const
+{
+    return d->heap_bytes;
+}
+
+void ArenaAllocator::clear()
+{
+    d->lock.lock();
+
+    if (d->arena_live > 0)
+    {
+        NCNN_LOGE("FATAL ERROR! arena allocator cleared with %d blocks in use", d->arena_live);
+    }
+
+    if (d->arena)
+    {
+        ncnn::fastFree(d->arena);
+        d->arena = 0;
+    }
+    d->arena_size = 0;
+    d->blocks.clear();
+    d->planned = false;
+    d->replan = false;
+    d->recording = false;
+    d->recorded_ptrs.clear();
+
+    d->lock.unlock();
+}
+
+void* ArenaAllocator::fastMalloc(size_t size)
+{
+    d->lock.lock();
+
+    const size_t block_size = alignSize(size + NCNN_ARENA_HEADER + NCNN_MALLOC_OVERREAD, NCNN_MALLOC_ALIGN);
+
+    if (d->recording)
+    {
+        void* ptr = ncnn::fastMalloc(size);
+
+        ArenaBlock b;
+        b.size = block_size;
+        b.offset = 0;
+        b.alloc_time = d->clock++;
+        b.free_time = -1;
+        d->blocks.push_back(b);
+        d->recorded_ptrs.push_back(std::make_pair(ptr, (int)d->blocks.size() - 1));
+        d->heap_bytes += size;
+
+        d->lock.unlock();
+        return ptr;
+    }
+
+    if (d->planned && !d->bypass)
+    {
+        const int i = d->seq++;
+
+        bool fit = i < (int)d->blocks.size() && d->blocks[i].size == block_size;
+        for (size_t j = 0; fit && j < d->blocks[i].conflicts.size(); j++)
+        {
+            // a block planned to be gone by now is still alive
+            if (d->live[d->blocks[i].conflicts[j]])
+                fit = false;
+        }
+
+        if (fit)
+        {
+            unsigned char* block = d->arena + d->blocks[i].offset;
+            *(int*)block = i;
+            d->live[i] = 1;
+            d->arena_live++;
+
+            d->lock.unlock();
+            return block + NCNN_ARENA_HEADER;
+        }
+
+        // different shapes or a different order, plan again on the next frame
+        d->bypass = true;
+        d->replan = true;
+    }
+
+    d->heap_bytes += size;
+
+    d->lock.unlock();
+
+    return ncnn::fastMalloc(size);
+}
+
+void ArenaAllocator::fastFree(void* ptr)
+{
+    d->lock.lock();
+
+    unsigned char* p = (unsigned char*)ptr;
+    if (d->arena && p >= d->arena && p < d->arena + d->arena_size)
+    {
+        const int i = *(int*)(p - NCNN_ARENA_HEADER);
+        d->live[i] = 0;
+        d->arena_live--;
+
+        d->lock.unlock();
+        return;
+    }
+
+    if (d->recording)
+    {
+        for (size_t j = 0; j < d->recorded_ptrs.size(); j++)
+        {
+            if (d->recorded_ptrs[j].first == ptr)
+            {
+                d->blocks[d->recorded_ptrs[j].second].free_time = d->clock++;
+                d->recorded_ptrs.erase(d->recorded_ptrs.begin() + j);
+                break;
+            }
+        }
+    }
+
+    d->lock.unlock();
+
+    ncnn::fastFree(ptr);
+}
+
 #if NCNN_VULKAN
 VkAllocator::VkAllocator(const VulkanDevice* _vkdev)
     : vkdev(_vkdev)
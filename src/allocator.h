@@ -210,6 +210,43 @@ private:
     UnlockedPoolAllocatorPrivate* const d;
 };
 
+// static arena for inference with fixed input shapes
+// the first frame runs on the heap and records every allocation with its lifetime
+// the offsets are then planned once so that blocks alive at the same time never overlap,
+// later frames replay the plan inside one buffer without any allocator call
+// a frame diverging from the plan falls back to the heap and the next frame plans again
+// blocks retained across frames suspend the arena until they are released
+class ArenaAllocatorPrivate;
+class NCNN_EXPORT ArenaAllocator : public Allocator
+{
+public:
+    ArenaAllocator();
+    ~ArenaAllocator();
+
+    // start a frame, the allocation sequence restarts from the beginning of the plan
+    void begin_frame();
+
+    // planned peak bytes, 0 before the plan exists
+    size_t arena_size() const;
+
+    // bytes of the current frame served from the heap
+    // nonzero while a frame is recorded or once it leaves the plan
+    size_t heap_bytes() const;
+
+    // drop the plan and the arena buffer, every block must be released
+    void clear();
+
+    virtual void* fastMalloc(size_t size);
+    virtual void fastFree(void* ptr);
+
+private:
+    ArenaAllocator(const ArenaAllocator&);
+    ArenaAllocator& operator=(const ArenaAllocator&);
+
+private:
+    ArenaAllocatorPrivate* const d;
+};
+
 #if NCNN_VULKAN
 
 class VulkanDevice;
@@ -14,8 +14,16 @@
 
 #include "datareader.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#if NCNN_STDIO && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace ncnn {
 
 DataReader::DataReader()
@@ -85,6 +93,128 @@ size_t DataReaderFromStdio::read(void* buf, size_t size) const
 {
     return fread(buf, 1, size, d->fp);
 }
+
+class DataReaderFromMmapPrivate
+{
+public:
+    DataReaderFromMmapPrivate()
+        : data(0), size(0), offset(0)
+    {
+    }
+    const unsigned char* data;
+    size_t size;
+    mutable size_t offset;
+};
+
+DataReaderFromMmap::DataReaderFromMmap(const char* path)
+    : DataReader(), d(new DataReaderFromMmapPrivate)
+{
+#if !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        NCNN_LOGE("open %s failed", path);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        NCNN_LOGE("stat %s failed", path);
+        close(fd);
+        return;
+    }
+
+    void* ptr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        NCNN_LOGE("mmap %s failed", path);
+        return;
+    }
+
+    d->data = (const unsigned char*)ptr;
+    d->size = (size_t)st.st_size;
+#else
+    // no mmap here, keep the whole file in memory and reference it likewise
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        NCNN_LOGE("fopen %s failed", path);
+        return;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (len > 0)
+    {
+        unsigned char* buf = (unsigned char*)malloc((size_t)len);
+        if (buf && fread(buf, 1, (size_t)len, fp) == (size_t)len)
+        {
+            d->data = buf;
+            d->size = (size_t)len;
+        }
+        else
+        {
+            NCNN_LOGE("fread %s failed", path);
+            free(buf);
+        }
+    }
+
+    fclose(fp);
+#endif
+}
+
+DataReaderFromMmap::~DataReaderFromMmap()
+{
+    if (d->data)
+    {
+#if !defined(_WIN32)
+        munmap((void*)d->data, d->size);
+#else
+        free((void*)d->data);
+#endif
+    }
+
+    delete d;
+}
+
+DataReaderFromMmap::DataReaderFromMmap(const DataReaderFromMmap&)
+    : d(0)
+{
+}
+
+DataReaderFromMmap& DataReaderFromMmap::operator=(const DataReaderFromMmap&)
+{
+    return *this;
+}
+
+size_t DataReaderFromMmap::size() const
+{
+    return d->size;
+}
+
+size_t DataReaderFromMmap::read(void* buf, size_t size) const
+{
+    size = std::min(size, d->size - d->offset);
+    memcpy(buf, d->data + d->offset, size);
+    d->offset += size;
+    return size;
+}
+
+size_t DataReaderFromMmap::reference(size_t size, const void** buf) const
+{
+    // the weights stay 4-byte aligned within the page aligned mapping
+    if (size > d->size - d->offset || (d->offset & 3) != 0)
+        return 0;
+
+    *buf = d->data + d->offset;
+    d->offset += size;
+    return size;
+}
 #endif // NCNN_STDIO
 
 class DataReaderFromMemoryPrivate
@@ -70,6 +70,30 @@ private:
 private:
     DataReaderFromStdioPrivate* const d;
 };
+
+// map the model file read-only and reference the weight data in place
+// the pages are shared with the page cache and among forked processes
+// the mapping must be retained while the referenced weights are in use
+class DataReaderFromMmapPrivate;
+class NCNN_EXPORT DataReaderFromMmap : public DataReader
+{
+public:
+    explicit DataReaderFromMmap(const char* path);
+    virtual ~DataReaderFromMmap();
+
+    // mapped bytes, 0 if the file could not be mapped
+    size_t size() const;
+
+    virtual size_t read(void* buf, size_t size) const;
+    virtual size_t reference(size_t size, const void** buf) const;
+
+private:
+    DataReaderFromMmap(const DataReaderFromMmap&);
+    DataReaderFromMmap& operator=(const DataReaderFromMmap&);
+
+private:
+    DataReaderFromMmapPrivate* const d;
+};
 #endif // NCNN_STDIO
 
 class DataReaderFromMemoryPrivate;
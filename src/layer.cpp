@@ -37,6 +37,25 @@
 
 namespace ncnn {
 
+LayerStats::LayerStats()
+{
+    reset();
+}
+
+void LayerStats::reset()
+{
+    forward_count = 0;
+    forward_time = 0.0;
+    skipped_outputs = 0.0;
+    reused_outputs = 0.0;
+    clean_outputs = 0.0;
+    computed_outputs = 0.0;
+    macs_avoided = 0.0;
+    bound_time = 0.0;
+    dot_time = 0.0;
+    state_bytes = 0;
+}
+
 Layer::Layer()
 {
     one_blob_only = false;
@@ -52,6 +71,8 @@ Layer::Layer()
 
     support_reserved_00 = false;
 
+    support_dirty_region = false;
+
     typeindex = -1;
 
 #if NCNN_VULKAN
@@ -85,6 +106,20 @@ int Layer::destroy_pipeline(const Option& /*opt*/)
     return 0;
 }
 
+void Layer::reset_state()
+{
+}
+
+int Layer::save_pipeline(std::vector<Mat>& /*mats*/) const
+{
+    return -1;
+}
+
+int Layer::load_pipeline(const std::vector<Mat>& /*mats*/, const Option& /*opt*/)
+{
+    return -1;
+}
+
 int Layer::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     if (!support_inplace)
@@ -30,8 +30,43 @@
 #include <vulkan/vulkan.h>
 #endif // NCNN_VULKAN
 
+// tile edge in pixels of the dirty region masks
+#define NCNN_DIRTY_TILE_SIZE 8
+
 namespace ncnn {
 
+// runtime counters of a layer, accumulated until reset
+class NCNN_EXPORT LayerStats
+{
+public:
+    LayerStats();
+
+    // zero all counters
+    void reset();
+
+public:
+    // forward calls and their wall time in ms
+    int forward_count;
+    double forward_time;
+
+    // outputs skipped by the sparse bounds, reused within the error budget,
+    // kept from the previous frame in clean regions, and computed
+    double skipped_outputs;
+    double reused_outputs;
+    double clean_outputs;
+    double computed_outputs;
+
+    // multiply-accumulates saved by the skipped, reused and clean outputs
+    double macs_avoided;
+
+    // wall time in ms spent on skip bounds and on dot products
+    double bound_time;
+    double dot_time;
+
+    // bytes of state carried to the next frame
+    size_t state_bytes;
+};
+
 class NCNN_EXPORT Layer
 {
 public:
@@ -56,6 +91,18 @@ public:
     // return 0 if success
     virtual int destroy_pipeline(const Option& opt);
 
+    // drop the state carried between forward calls
+    // the next forward starts a new stream
+    virtual void reset_state();
+
+    // export the weight data derived by create_pipeline for the weight cache
+    // return 0 if success, -1 if the pipeline cannot be restored from mats
+    virtual int save_pipeline(std::vector<Mat>& mats) const;
+
+    // setup from the mats exported by save_pipeline instead of create_pipeline
+    // return 0 if success, otherwise create_pipeline runs
+    virtual int load_pipeline(const std::vector<Mat>& mats, const Option& opt);
+
 public:
     // one input and one output blob
     bool one_blob_only;
@@ -86,7 +133,9 @@ public:
 
     bool support_reserved_00;
 
-    bool support_reserved_0;
+    // compute only the dirty tiles given in top_dirty_mask
+    // clean tiles are carried over from the previous frame
+    bool support_dirty_region;
     bool support_reserved_1;
     bool support_reserved_2;
     bool support_reserved_3;
@@ -164,6 +213,12 @@ public:
     // shape hint
     std::vector<Mat> bottom_shapes;
     std::vector<Mat> top_shapes;
+    // tiles of the top blob changed since the previous frame
+    // one byte per NCNN_DIRTY_TILE_SIZE x NCNN_DIRTY_TILE_SIZE tile, nonzero for dirty
+    // assigned by net right before forward, empty means the whole top blob is dirty
+    Mat top_dirty_mask;
+    // runtime counters, timings are collected with opt.use_layer_stats
+    LayerStats stats;
 };
 
 // layer factory function
@@ -113,21 +113,35 @@ int Convolution1D_arm::destroy_pipeline(const Option& /*opt*/)
 
 int Convolution1D_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (is_stream_skipped(bottom_blob))
+    {
+        // the stride jumps over the whole chunk, no window starts in it
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     int elembits = bottom_blob.elembits();
 
 #if __ARM_FEATURE_FP16_VECTOR_ARITHMETIC
     if (opt.use_fp16_storage && elembits == 16)
     {
-        if (opt.use_fp16_arithmetic)
-            return forward_fp16sa(bottom_blob, top_blob, opt);
-        else
-            return forward_fp16s(bottom_blob, top_blob, opt);
+        int ret = opt.use_fp16_arithmetic ? forward_fp16sa(bottom_blob, top_blob, opt) : forward_fp16s(bottom_blob, top_blob, opt);
+        if (ret != 0)
+            return ret;
+
+        return update_stream_context(bottom_blob, opt);
     }
 #endif
 
 #if NCNN_BF16
     if (opt.use_bf16_storage && elembits == 16)
-        return forward_bf16s(bottom_blob, top_blob, opt);
+    {
+        int ret = forward_bf16s(bottom_blob, top_blob, opt);
+        if (ret != 0)
+            return ret;
+
+        return update_stream_context(bottom_blob, opt);
+    }
 #endif
 
     int w = bottom_blob.w;
@@ -154,9 +168,16 @@ int Convolution1D_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Opti
 #endif
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, the whole chunk becomes streaming context
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -355,7 +376,7 @@ int Convolution1D_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Opti
         }
     }
 
-    return 0;
+    return update_stream_context(bottom_blob, opt);
 }
 
 int Convolution1D_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
@@ -529,9 +550,16 @@ int Convolution1D_arm::forward_fp16s(const Mat& bottom_blob, Mat& top_blob, cons
     int out_elempack = (opt.use_packing_layout && num_output % 4 == 0) ? 4 : 1;
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, forward keeps the whole chunk as streaming context
+        top_blob.release();
+        return 0;
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -743,9 +771,16 @@ int Convolution1D_arm::forward_fp16sa(const Mat& bottom_blob, Mat& top_blob, con
     }
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, forward keeps the whole chunk as streaming context
+        top_blob.release();
+        return 0;
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -1266,9 +1301,16 @@ int Convolution1D_arm::forward_bf16s(const Mat& bottom_blob, Mat& top_blob, cons
 #endif
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, forward keeps the whole chunk as streaming context
+        top_blob.release();
+        return 0;
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -39,6 +39,14 @@ GRU_arm::GRU_arm()
 
 int GRU_arm::create_pipeline(const Option& opt)
 {
+    if (streaming && direction == 0)
+    {
+        // the stateful streaming runs the reference implementation in fp32
+        support_fp16_storage = false;
+        support_bf16_storage = false;
+        return 0;
+    }
+
 #if __ARM_FEATURE_FP16_VECTOR_ARITHMETIC
     if (opt.use_fp16_storage)
     {
@@ -619,6 +627,9 @@ static int gru(const Mat& bottom_blob, Mat& top_blob, int reverse, const Mat& we
 
 int GRU_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return GRU::forward(bottom_blob, top_blob, opt);
+
     int elembits = bottom_blob.elembits();
 
 #if __ARM_FEATURE_FP16_VECTOR_ARITHMETIC
@@ -695,6 +706,9 @@ int GRU_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 
 int GRU_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return GRU::forward(bottom_blobs, top_blobs, opt);
+
     const Mat& bottom_blob = bottom_blobs[0];
     int elembits = bottom_blob.elembits();
 
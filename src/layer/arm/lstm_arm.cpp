@@ -39,6 +39,14 @@ LSTM_arm::LSTM_arm()
 
 int LSTM_arm::create_pipeline(const Option& opt)
 {
+    if (streaming && direction == 0)
+    {
+        // the stateful streaming runs the reference implementation in fp32
+        support_fp16_storage = false;
+        support_bf16_storage = false;
+        return 0;
+    }
+
 #if __ARM_FEATURE_FP16_VECTOR_ARITHMETIC
     if (opt.use_fp16_storage)
     {
@@ -341,6 +349,9 @@ static int lstm(const Mat& bottom_blob, Mat& top_blob, int reverse, const Mat& w
 
 int LSTM_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return LSTM::forward(bottom_blob, top_blob, opt);
+
     int elembits = bottom_blob.elembits();
 
 #if __ARM_FEATURE_FP16_VECTOR_ARITHMETIC
@@ -423,6 +434,9 @@ int LSTM_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 
 int LSTM_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return LSTM::forward(bottom_blobs, top_blobs, opt);
+
     const Mat& bottom_blob = bottom_blobs[0];
     int elembits = bottom_blob.elembits();
 
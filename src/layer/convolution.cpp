@@ -16,10 +16,18 @@
 
 #include "layer_type.h"
 
+#include "benchmark.h"
+#include "cpu.h"
 #include "fused_activation.h"
 
+#include <float.h>
+
 #define E 6
 #define E_pow_num 64 // 2^6
+#define SPATIAL_BOUND_MIN_SPARSITY 0.1f // dense frames below this skip the neighbour bounds
+#define SPARSE_TILE_BYTES 524288         // packed input patches of a tile stay in l2
+#define SPARSE_TILE_MIN 16
+#define SPARSE_TILE_MAX 64
 
 namespace ncnn {
 
@@ -27,6 +35,7 @@ Convolution::Convolution()
 {
     one_blob_only = true;
     support_inplace = false;
+    support_dirty_region = true;
 }
 
 int Convolution::load_param(const ParamDict& pd)
@@ -51,17 +60,24 @@ int Convolution::load_param(const ParamDict& pd)
 
     dynamic_weight = pd.get(19, 0);
 
-    record1 = Mat();
-    record2 = Mat();
-    record3 = Mat();
-    record4 = Mat();
-    all_select_norms = Mat();
-    top_E_indices = Mat();
-    top_E_w_vals = Mat();
+    reuse_error_abs = pd.get(20, 0.f);
+    reuse_error_rel = pd.get(21, 0.f);
+
+    temporal_kernel = pd.get(22, 0);
+    spatial_kernel = pd.get(23, 0);
+    sparse_mode = pd.get(24, -1);
+    refresh_interval = pd.get(25, 0);
+    pool_kernel = pd.get(26, 0);
+    pool_stride = pd.get(27, pool_kernel);
+    pool_pad = pd.get(28, 0);
+
+    reset_state();
+
+    reuse_count = 0;
+    reuse_error_sum = 0;
+    reuse_error_max = 0.f;
 
     exact_compute = true;
-    call_count = 0;
-    last_time_sparsity = -1;
 
     if (dynamic_weight)
     {
@@ -143,10 +159,212 @@ int Convolution::create_pipeline(const Option& opt)
     return 0;
 }
 
+// the input patch of output (i, j) packed contiguous, in the weight order
+static void pack_patch(const Mat& in_x, int i, int j, int stride_w, int stride_h, const int* space_ofs, int maxk, float* col)
+{
+    for (int q = 0; q < in_x.c; q++)
+    {
+        const float* sptr = in_x.channel(q).row(i * stride_h) + j * stride_w;
+
+        for (int w_i = 0; w_i < maxk; w_i++)
+        {
+            *col++ = sptr[space_ofs[w_i]];
+        }
+    }
+}
+
+static float dot_product(const float* a, const float* b, int size)
+{
+    float sum0 = 0.f;
+    float sum1 = 0.f;
+    float sum2 = 0.f;
+    float sum3 = 0.f;
+
+    int t = 0;
+    for (; t + 3 < size; t += 4)
+    {
+        sum0 += a[t] * b[t];
+        sum1 += a[t + 1] * b[t + 1];
+        sum2 += a[t + 2] * b[t + 2];
+        sum3 += a[t + 3] * b[t + 3];
+    }
+    for (; t < size; t++)
+    {
+        sum0 += a[t] * b[t];
+    }
+
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+// four output channels sharing one load of the packed patch
+static void dot_product_4(const float* col, const float* kptr, int size, float* sums)
+{
+    const float* k0 = kptr;
+    const float* k1 = kptr + size;
+    const float* k2 = kptr + size * 2;
+    const float* k3 = kptr + size * 3;
+
+    float sum0 = 0.f;
+    float sum1 = 0.f;
+    float sum2 = 0.f;
+    float sum3 = 0.f;
+
+    for (int t = 0; t < size; t++)
+    {
+        const float v = col[t];
+        sum0 += v * k0[t];
+        sum1 += v * k1[t];
+        sum2 += v * k2[t];
+        sum3 += v * k3[t];
+    }
+
+    sums[0] = sum0;
+    sums[1] = sum1;
+    sums[2] = sum2;
+    sums[3] = sum3;
+}
+
+// output positions per tile, the packed patches of a tile stay in l2
+// wide layers still keep SPARSE_TILE_MIN positions so each weight block is reused across them
+static int sparse_tile_size(int patch_size)
+{
+    return std::min(SPARSE_TILE_MAX, std::max(SPARSE_TILE_MIN, SPARSE_TILE_BYTES / (patch_size * (int)sizeof(float))));
+}
+
+// || x_{ij} - y_{i2j2} || over the receptive field
+static float patch_distance(const Mat& x, int i, int j, const Mat& y, int i2, int j2, int stride_w, int stride_h, const int* space_ofs, int maxk)
+{
+    float sum = 0.f;
+    for (int q = 0; q < x.c; q++)
+    {
+        const float* sptr = x.channel(q).row(i * stride_h) + j * stride_w;
+        const float* sptr2 = y.channel(q).row(i2 * stride_h) + j2 * stride_w;
+
+        for (int w_i = 0; w_i < maxk; w_i++)
+        {
+            float d = sptr[space_ofs[w_i]] - sptr2[space_ofs[w_i]];
+            sum += d * d;
+        }
+    }
+
+    return sqrt(sum);
+}
+
+// dot products of the channels in need with the patch of output p, in the tile starting at p0
+// the patch is packed on first need and reused by the following channel blocks of the tile
+static void masked_dot_product(const Mat& in_x, int p, int p0, int outw, int stride_w, int stride_h, const int* space_ofs, int maxk,
+                               float* patch_tile, unsigned char* packed, const float* kptr, const int* need, int need_count, float* sums)
+{
+    const int patch_size = in_x.c * maxk;
+
+    float* col = patch_tile + (p - p0) * patch_size;
+    if (!packed[p - p0])
+    {
+        pack_patch(in_x, p / outw, p % outw, stride_w, stride_h, space_ofs, maxk, col);
+        packed[p - p0] = 1;
+    }
+
+    if (need_count == 4)
+    {
+        dot_product_4(col, kptr, patch_size, sums);
+        return;
+    }
+
+    for (int n = 0; n < need_count; n++)
+    {
+        sums[need[n]] = dot_product(col, kptr + patch_size * need[n], patch_size);
+    }
+}
+
+// exact compute of the dirty outputs, tiled like the sparse paths
+// pre_y receives the output before bias and activation when given
+static int tiled_convolution(const Mat& in_x, Mat& out_y, const Mat& weight_data, const Mat& bias_data, const int* space_ofs, int maxk,
+                             int stride_w, int stride_h, int activation_type, const Mat& activation_params, const Mat& dirty_mask, Mat* pre_y,
+                             const Option& opt, double& computed_count, double& negative_count)
+{
+    const int inch = in_x.c;
+
+    const int outw = out_y.w;
+    const int outh = out_y.h;
+    const int outch = out_y.c;
+
+    const int bias_term = bias_data.empty() ? 0 : 1;
+
+    const int size = outw * outh;
+    const int patch_size = inch * maxk;
+    const int tile_size = sparse_tile_size(patch_size);
+    const int tile_count = (size + tile_size - 1) / tile_size;
+
+    Mat patches(patch_size * tile_size, 1, opt.num_threads, 4u, opt.workspace_allocator);
+    if (patches.empty())
+        return -100;
+
+    std::vector<double> tile_computed(tile_count, 0.0);
+    std::vector<double> tile_negative(tile_count, 0.0);
+
+    const unsigned char* dirty_ptr = dirty_mask;
+    static const int need_all[4] = {0, 1, 2, 3};
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int t = 0; t < tile_count; t++)
+    {
+        const int p0 = t * tile_size;
+        const int p1 = std::min(p0 + tile_size, size);
+
+        float* patch_tile = patches.channel(get_omp_thread_num());
+        unsigned char packed[SPARSE_TILE_MAX] = {0};
+
+        double computed = 0.0;
+        double negative = 0.0;
+
+        for (int k0 = 0; k0 < outch; k0 += 4)
+        {
+            const int kn = std::min(4, outch - k0);
+
+            const float* kptr = (const float*)weight_data + patch_size * k0;
+
+            for (int p = p0; p < p1; p++)
+            {
+                // clean tile, out_y already holds this frame
+                if (dirty_ptr && !dirty_ptr[(p / outw / NCNN_DIRTY_TILE_SIZE) * dirty_mask.w + p % outw / NCNN_DIRTY_TILE_SIZE])
+                    continue;
+
+                float sums[4];
+                masked_dot_product(in_x, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need_all, kn, sums);
+
+                for (int kk = 0; kk < kn; kk++)
+                {
+                    const float y_kij = sums[kk] + (bias_term ? bias_data[k0 + kk] : 0.f);
+                    if (pre_y)
+                        ((float*)pre_y->channel(k0 + kk))[p] = sums[kk];
+                    if (y_kij < 0.f)
+                        negative += 1;
+
+                    ((float*)out_y.channel(k0 + kk))[p] = activation_ss(y_kij, activation_type, activation_params);
+                }
+
+                computed += kn;
+            }
+        }
+
+        tile_computed[t] = computed;
+        tile_negative[t] = negative;
+    }
+
+    for (int t = 0; t < tile_count; t++)
+    {
+        computed_count += tile_computed[t];
+        negative_count += tile_negative[t];
+    }
+
+    return 0;
+}
 
 static int mlsys_convolution(const Mat& in_x, Mat& out_y, const Mat& weight_data, const Mat& bias_data,
                        int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
-                       int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2)
+                       int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2,
+                       const Mat& dirty_mask, Mat& drift, float reuse_error_abs, float reuse_error_rel,
+                       double& reuse_count, double& reuse_error_sum, float& reuse_error_max, LayerStats& stats)
 {
     //    fprintf(stderr, "卷卷卷@@raw conv, activation type is %d\n", activation_type);
     const int w = in_x.w;
@@ -200,221 +418,282 @@ static int mlsys_convolution(const Mat& in_x, Mat& out_y, const Mat& weight_data
         }
 
         /**
-         * exact compute
+         * exact compute, out_y holds the dense pre-activation output
          */
         last_x.clone_from(in_x);
-        //        last_x.create(out_y.w, out_y.h, kernel_w*kernel_h, in_x.c);
-//        fprintf(stderr, "%d ", outch);
-        last_y.clone_from(out_y);
-        for (int i = 0; i < outh; i++)
+        last_y.create(outw, outh, outch);
+        if (last_y.empty())
+            return -100;
+        if (opt.use_approximate_reuse && (reuse_error_abs > 0.f || reuse_error_rel > 0.f))
         {
-            for (int j = 0; j < outw; j++)
-            {
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = out_y.channel(k);
-                    outptr += i * outw;
-
-                    float* outptr_last_y = last_y.channel(k);
-                    outptr_last_y += i * outw;
-
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
-
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
-
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = in_x.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+            drift.create(outw, outh, outch);
+            if (drift.empty())
+                return -100;
+            drift.fill(0.f);
+        }
+        else
+        {
+            drift.release();
+        }
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
+        #pragma omp parallel for num_threads(opt.num_threads)
+        for (int k = 0; k < outch; k++)
+        {
+            const float bias = bias_term ? bias_data[k] : 0.f;
 
-                        }
+            float* outptr = out_y.channel(k);
+            float* outptr_last_y = last_y.channel(k);
 
-                        kptr += maxk;
-                    }
-                    if (bias_term)
-                        outptr_last_y[j] = y_kij - bias_data[k];
-                    else
-                        outptr_last_y[j] = y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    //                    if (outptr_last_y[j] <= opt.lower)
-                    //                        less_0_count += 1;
-                }
+            for (int i = 0; i < outw * outh; i++)
+            {
+                outptr_last_y[i] = outptr[i] - bias;
+                outptr[i] = activation_ss(outptr[i], activation_type, activation_params);
             }
         }
         //        fprintf(stderr, "less 0 count = %d\n",less_0_count);
     }else{
-        float reduced_count=0;
-        float total_count = 0;
-        float max_reduce_count;
+        const unsigned char* dirty_ptr = dirty_mask;
+
+        // approximate reuse keeps the bound accumulated since the last exact compute,
+        // last_y - drift is the exact value of that compute
+        const bool approximate = opt.use_approximate_reuse && (reuse_error_abs > 0.f || reuse_error_rel > 0.f);
+        if (approximate && (drift.w != outw || drift.h != outh || drift.c != outch))
+        {
+            // no anchor known yet, force an exact compute first
+            drift.create(outw, outh, outch);
+            if (drift.empty())
+                return -100;
+            drift.fill(FLT_MAX);
+        }
+
+        double bound_start = opt.use_layer_stats ? get_current_time() : 0.0;
+
+        /**
+         * compute dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||, -1 for the clean tiles
+         */
+        Mat dx_norms(outw, outh);
+        if (dx_norms.empty())
+            return -100;
+
+        #pragma omp parallel for num_threads(opt.num_threads)
         for (int i = 0; i < outh; i++)
         {
+            float* dxptr = dx_norms.row(i);
+
             for (int j = 0; j < outw; j++)
             {
-                /**
-                 * compute dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||
-                 */
-                float dx2_sum = 0.0;
-                for (int q = 0; q < inch; q++)
+                // clean tile, out_y and last_y already hold this frame
+                if (dirty_ptr && !dirty_ptr[(i / NCNN_DIRTY_TILE_SIZE) * dirty_mask.w + j / NCNN_DIRTY_TILE_SIZE])
                 {
-                    const Mat& m = in_x.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+                    dxptr[j] = -1.f;
+                    continue;
+                }
 
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
+                float dx2_sum = 0.f;
+                for (int q = 0; q < inch; q++)
+                {
+                    const float* sptr = in_x.channel(q).row(i * stride_h) + j * stride_w;
+                    const float* sptr_last_x = last_x.channel(q).row(i * stride_h) + j * stride_w;
 
                     for (int w_i = 0; w_i < maxk; w_i++)
                     {
-                        float val = sptr[space_ofs[w_i]];
-                        float val_last_x = sptr_last_x[space_ofs[w_i]];
-                        dx2_sum += (val - val_last_x) * (val - val_last_x);
+                        float d = sptr[space_ofs[w_i]] - sptr_last_x[space_ofs[w_i]];
+                        dx2_sum += d * d;
                     }
                 }
 
-                float dx_norm = sqrt(dx2_sum);  // 1.2%的开销
-                                               //                float dx_norm = 0.0;              // 15773
+                dxptr[j] = sqrt(dx2_sum);
+            }
+        }
+
+        double dot_start = opt.use_layer_stats ? get_current_time() : 0.0;
+
+        /**
+         * the output positions are walked in tiles, the output channels in blocks of 4
+         * the patches of a tile are packed once on first exact compute and shared by all channels
+         * the weights of a channel block stay hot for the whole tile
+         */
+        const int size = outw * outh;
+        const int patch_size = inch * maxk;
+        const int tile_size = sparse_tile_size(patch_size);
+        const int tile_count = (size + tile_size - 1) / tile_size;
+
+        Mat patches(patch_size * tile_size, 1, opt.num_threads, 4u, opt.workspace_allocator);
+        if (patches.empty())
+            return -100;
+
+        std::vector<double> tile_computed(tile_count, 0.0);
+        std::vector<double> tile_skipped(tile_count, 0.0);
+        std::vector<double> tile_reused(tile_count, 0.0);
+        std::vector<double> tile_error_sum(tile_count, 0.0);
+        std::vector<float> tile_error_max(tile_count, 0.f);
+
+        const float* dxptr = dx_norms;
+        const float* w_norm2_ptr = w_norm2;
+
+        #pragma omp parallel for num_threads(opt.num_threads)
+        for (int t = 0; t < tile_count; t++)
+        {
+            const int p0 = t * tile_size;
+            const int p1 = std::min(p0 + tile_size, size);
+
+            float* patch_tile = patches.channel(get_omp_thread_num());
+            unsigned char packed[SPARSE_TILE_MAX] = {0};
+
+            double computed = 0.0;
+            double skipped = 0.0;
+            double reused = 0.0;
+            double error_sum = 0.0;
+            float error_max = 0.f;
+
+            for (int k0 = 0; k0 < outch; k0 += 4)
+            {
+                const int kn = std::min(4, outch - k0);
 
-                for (int k = 0; k < outch; k++)
+                float* outptrs[4];
+                float* out_bar_ptrs[4];
+                float* drift_ptrs[4];
+                float biases[4];
+                for (int kk = 0; kk < kn; kk++)
                 {
-                    //                    fprintf(stderr, "debug 2\n");
-                    float* outptr = out_y.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
+                    outptrs[kk] = out_y.channel(k0 + kk);
+                    out_bar_ptrs[kk] = last_y.channel(k0 + kk);
+                    drift_ptrs[kk] = approximate ? (float*)drift.channel(k0 + kk) : 0;
+                    biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
+                }
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+                const float* kptr = (const float*)weight_data + patch_size * k0;
 
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+                for (int p = p0; p < p1; p++)
+                {
+                    const float dx_norm = dxptr[p];
+                    if (dx_norm < 0.f)
+                        continue;
 
                     /**
-                     * get w_norm = || w_k ||
                      * if (\bar{y[ijk]} + dx_norm * w_norm <= - bias_data[k]) // reduce computation
                      * {
                      *      update \bar{y[ijk]} = \bar{y[ijk]} + dx_norm * w_norm
                      * }
                      * else // exact compute
                      */
-                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-                    float norm_norm = w_norm2_ptr[k] * dx_norm;
-                    float* out_bar_ptr = last_y.channel(k);
-
-                    out_bar_ptr += i * outw;
-
-                    total_count+= 1;
-//                    total_count += 2*inch*maxk;
-                    if (out_bar_ptr[j] + norm_norm <= -y_kij){
-                        outptr[j] = 0;
-                        reduced_count += 1;
-//                        max_reduce_count += 1;
-                        out_bar_ptr[j] += norm_norm;
-                    }else{
-                        out_bar_ptr[j] = -y_kij;
-                        for (int q = 0; q < inch; q++)
+                    int need[4];
+                    int need_count = 0;
+                    for (int kk = 0; kk < kn; kk++)
+                    {
+                        const float norm_norm = w_norm2_ptr[k0 + kk] * dx_norm;
+                        float* out_bar_ptr = out_bar_ptrs[kk];
+
+                        if (out_bar_ptr[p] + norm_norm <= -biases[kk])
                         {
-                            const Mat& m = in_x.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
+                            outptrs[kk][p] = 0;
+                            out_bar_ptr[p] += norm_norm;
+                            if (approximate)
+                                drift_ptrs[kk][p] += norm_norm;
+                            skipped += 1;
+                            continue;
+                        }
 
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
+                        if (approximate)
+                        {
+                            float* drift_ptr = drift_ptrs[kk];
+                            const float y_anchor = out_bar_ptr[p] - drift_ptr[p] + biases[kk];
+                            const float error_bound = drift_ptr[p] + norm_norm;
+                            if (y_anchor > 0.f && error_bound <= reuse_error_abs + reuse_error_rel * y_anchor)
                             {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
+                                // positive output drifted within budget, reuse the last exact value
+                                outptrs[kk][p] = activation_ss(y_anchor, activation_type, activation_params);
+                                out_bar_ptr[p] += norm_norm;
+                                drift_ptr[p] = error_bound;
+                                reused += 1;
+                                error_sum += error_bound;
+                                error_max = std::max(error_max, error_bound);
+                                continue;
                             }
-
-                            kptr += maxk;
+                            drift_ptr[p] = 0.f;
                         }
 
-                        out_bar_ptr[j] += y_kij;
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-
-//                        if (y_kij <= 0)
-//                            max_reduce_count += 1;
+                        need[need_count++] = kk;
                     }
-                }
-            }
-        }
-//        fprintf(stderr, "%.4f/%.4f=%.4f\n", reduced_count, total_count, reduced_count/total_count);
-//        fprintf(stderr, "%.4f/%.4f=%.4f <-\n", reduced_count, total_count, max_reduce_count/total_count);
-//        fprintf(stderr, "%.1f <-\n", total_count);
 
-//        fprintf(stderr, "%.2f\t",  reduced_count/total_count);
-//        fprintf(stderr, "%.2f <-\n",  max_reduce_count/total_count);
+                    if (need_count == 0)
+                        continue;
 
-        last_x.clone_from(in_x); //没有这行是15899，加了是16058
-    }
+                    float sums[4];
+                    masked_dot_product(in_x, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
 
+                    for (int n = 0; n < need_count; n++)
+                    {
+                        const int kk = need[n];
+                        out_bar_ptrs[kk][p] = sums[kk];
+                        outptrs[kk][p] = activation_ss(sums[kk] + biases[kk], activation_type, activation_params);
+                    }
 
-    return 0;
-}
+                    computed += need_count;
+                }
+            }
 
-inline void find_top_E(const float* w_arr, float* w_topE_indices_arr, float* w_topE_val_arr, int w_arr_len, float* all_select_norms, float w_full_2){
-    /**
-     * find top absolute largest E element in arr, indices stored to indices_arr
-     * w_arr: len = w_arr_len
-     * indices_arr: len = E
-     * all_select_norms: len = 2^E
-     * w_full_norm: 当前w_k的full元素的norm的      平方
-     */
-//    fprintf(stderr, "111\t");
-    std::vector<std::pair<float, int> > w_ordered;
+            tile_computed[t] = computed;
+            tile_skipped[t] = skipped;
+            tile_reused[t] = reused;
+            tile_error_sum[t] = error_sum;
+            tile_error_max[t] = error_max;
+        }
 
-    w_ordered.reserve(w_arr_len);
-    for(int i=0; i<w_arr_len; i++){
-        w_ordered.push_back(std::make_pair(abs(w_arr[i]), i));
-    }
+        if (opt.use_layer_stats)
+        {
+            stats.bound_time += dot_start - bound_start;
+            stats.dot_time += get_current_time() - dot_start;
+        }
 
-    std::sort(w_ordered.begin(), w_ordered.end());
+        double computed_count = 0.0;
+        double skipped_count = 0.0;
+        double reused_count = 0.0;
+        for (int t = 0; t < tile_count; t++)
+        {
+            computed_count += tile_computed[t];
+            skipped_count += tile_skipped[t];
+            reused_count += tile_reused[t];
+            reuse_error_sum += tile_error_sum[t];
+            reuse_error_max = std::max(reuse_error_max, tile_error_max[t]);
+        }
+        reuse_count += reused_count;
 
-    for(int i=0; i<E; i++){
-//    for(int i=w_arr_len-1; i>w_arr_len-1-E; i--){
-        w_topE_val_arr[i] = w_ordered[w_arr_len-1-i].first;
-        w_topE_indices_arr[i] = w_ordered[w_arr_len-1-i].second;
-//        w_topE_val_arr[i] = w_ordered[i].first;
-//        w_topE_indices_arr[i] = w_ordered[i].second;
+        double clean_count = 0.0;
+        for (int p = 0; p < size; p++)
+        {
+            if (dxptr[p] < 0.f)
+                clean_count += outch;
+        }
 
-//        fprintf(stderr, "%f, %d \t",  w_topE_val_arr[i],  int(w_topE_indices_arr[i]));
+        stats.skipped_outputs += skipped_count;
+        stats.reused_outputs += reused_count;
+        stats.clean_outputs += clean_count;
+        stats.computed_outputs += computed_count;
+        stats.macs_avoided += (skipped_count + reused_count + clean_count) * inch * maxk;
 
-        //0.070557, 6 	0.077123, 23 	0.098039, 5 	0.100434, 3 	0.114497, 24 	0.148363, 12
+        last_x.clone_from(in_x);
     }
-//    fprintf(stderr, "\n");
-//    fprintf(stderr, "222\t");
-
-    for(int i=0; i<E_pow_num; i++){
-        float tobe_sub = 0.0;
-        for (int norm_index=E-1; norm_index>=0; norm_index--){
-            if ((i>>norm_index) & 1){   // 当前位=1
-                tobe_sub += w_topE_val_arr[E-1-norm_index] * w_topE_val_arr[E-1-norm_index];
-            }
-        }
 
-        all_select_norms[i] = sqrt(w_full_2 - tobe_sub);
-    }
-    for (int i=0; i<E; i++){
-        w_topE_val_arr[i] =  w_arr[int(w_topE_indices_arr[i])];
-    }
+    return 0;
+}
 
-//    fprintf(stderr, "333\n");
-    w_ordered.clear();
-    /**
-     * 把相对应位置的, select_norm，转化坐标，存到all_select_norm中
-     */
+static void count_skipped_outputs(LayerStats& stats, double skipped_count, double total_count, int inch, int maxk)
+{
+    stats.skipped_outputs += skipped_count;
+    stats.computed_outputs += total_count - skipped_count;
+    stats.macs_avoided += skipped_count * inch * maxk;
 }
 
-static int mlsys_convolution_lower_top_E(const Mat& in_x, Mat& out_y, const Mat& weight_data, const Mat& bias_data,
-                             int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
-                             int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2
-                                         ,Mat& all_select_norms, Mat& top_E_indices, Mat& top_E_w_vals, Mat& x_vector_diff)
+// temporal skipping for a relu convolution feeding a max pooling
+// within each pooling window the outputs are visited by descending upper bound,
+// an output whose bound is not above the window max so far cannot be the max
+// the skipped outputs get their relu bound, never above the max of any window they belong to
+static int mlsys_convolution_maxpool(const Mat& in_x, Mat& out_y, const Mat& weight_data, const Mat& bias_data,
+                                     int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
+                                     int pool_kernel, int pool_stride, int pool_pad, const Option& opt,
+                                     Mat& last_x, Mat& last_y, const Mat& w_norm2, LayerStats& stats)
 {
-    //    fprintf(stderr, "卷卷卷@@raw conv, activation type is %d\n", activation_type);
     const int w = in_x.w;
     const int inch = in_x.c;
 
@@ -444,248 +723,232 @@ static int mlsys_convolution_lower_top_E(const Mat& in_x, Mat& out_y, const Mat&
             p2 += gap;
         }
     }
-    float* all_select_norms_ptr = nullptr;
-    float* top_E_indices_ptr = nullptr;
-    float* top_E_w_vals_ptr = nullptr;
-    float* x_vector_diff_ptr = nullptr;
 
-    if (last_x.total() <= 0){
-        w_norm2.create(outch);
-        all_select_norms.create(outch*E_pow_num);
-        top_E_indices.create(outch* E);
-        top_E_w_vals.create(outch* E);
-        x_vector_diff.create(inch*maxk);
+    // window origin, the same for both axes as the pooling is square
+    int pool_pad_x = pool_pad;
+    int pool_pad_y = pool_pad;
+    if (pool_pad == -233 || pool_pad == -234)
+    {
+        const int wpad = std::max(pool_kernel + (outw - 1) / pool_stride * pool_stride - outw, 0);
+        const int hpad = std::max(pool_kernel + (outh - 1) / pool_stride * pool_stride - outh, 0);
+        pool_pad_x = pool_pad == -233 ? wpad / 2 : wpad - wpad / 2;
+        pool_pad_y = pool_pad == -233 ? hpad / 2 : hpad - hpad / 2;
+    }
 
-        all_select_norms_ptr = (float*)all_select_norms.data;
-        top_E_indices_ptr = (float*)top_E_indices.data;
-        top_E_w_vals_ptr = (float*)top_E_w_vals.data;
-//        x_vector_diff_ptr = (float*)x_vector_diff.data;
+    double bound_start = opt.use_layer_stats ? get_current_time() : 0.0;
 
-        /**
-         * calculate w_norm2
-         */
+    // dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||, shared by all output channels
+    Mat dx_norms(outw, outh);
+    if (dx_norms.empty())
+        return -100;
 
-        float* w_norm2_data = (float*) w_norm2.data;
-        for (int k=0; k<outch; k++){
-//            fprintf(stderr, "%d\n", k);
-            const float* kptr = (const float*)weight_data.data + maxk * inch * k;
-            w_norm2_data[k] = 0.0;
-            for (int q = 0; q < inch; q++){
-                for (int w_i = 0; w_i < maxk; w_i++){
-                    w_norm2_data[k] += kptr[w_i] * kptr[w_i];
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i = 0; i < outh; i++)
+    {
+        float* dxptr = dx_norms.row(i);
+
+        for (int j = 0; j < outw; j++)
+        {
+            float dx2_sum = 0.f;
+            for (int q = 0; q < inch; q++)
+            {
+                const float* sptr = in_x.channel(q).row(i * stride_h) + j * stride_w;
+                const float* sptr_last_x = last_x.channel(q).row(i * stride_h) + j * stride_w;
+
+                for (int w_i = 0; w_i < maxk; w_i++)
+                {
+                    float d = sptr[space_ofs[w_i]] - sptr_last_x[space_ofs[w_i]];
+                    dx2_sum += d * d;
                 }
-                kptr += maxk;
             }
 
-            kptr = (const float*)weight_data.data + maxk * inch * k;
-            find_top_E(kptr,
-                       top_E_indices_ptr + E*k,
-                       top_E_w_vals_ptr + E*k,
-                       maxk * inch,
-                       all_select_norms_ptr+k*E_pow_num,
-                       w_norm2_data[k]); // 传进去的是平方
-            w_norm2_data[k] = sqrt(w_norm2_data[k]);
+            dxptr[j] = sqrt(dx2_sum);
         }
-        /**
-         * exact compute
-         */
-        last_x.clone_from(in_x);
-        //        last_x.create(out_y.w, out_y.h, kernel_w*kernel_h, in_x.c);
-        last_y.clone_from(out_y);
-        for (int i = 0; i < outh; i++)
+    }
+
+    double dot_start = opt.use_layer_stats ? get_current_time() : 0.0;
+
+    // the windows intersecting the output, a superset of the pooling windows is still exact
+    const int window_x0 = -((pool_pad_x + pool_stride - 1) / pool_stride);
+    const int window_y0 = -((pool_pad_y + pool_stride - 1) / pool_stride);
+    const int window_x1 = (outw - 1 + pool_pad_x) / pool_stride;
+    const int window_y1 = (outh - 1 + pool_pad_y) / pool_stride;
+
+    double skipped_count = 0;
+
+    #pragma omp parallel for num_threads(opt.num_threads) reduction(+ : skipped_count)
+    for (int k = 0; k < outch; k++)
+    {
+        const float bias = bias_term ? bias_data[k] : 0.f;
+        const float w_norm = w_norm2[k];
+        const float* kptr0 = (const float*)weight_data + maxk * inch * k;
+
+        float* outptr = out_y.channel(k);
+        float* lastptr = last_y.channel(k);
+
+        std::vector<unsigned char> computed(outw * outh, 0);
+        std::vector<std::pair<float, int> > members;
+        members.reserve(pool_kernel * pool_kernel);
+
+        for (int wy = window_y0; wy <= window_y1; wy++)
         {
-            for (int j = 0; j < outw; j++)
+            for (int wx = window_x0; wx <= window_x1; wx++)
             {
-                for (int k = 0; k < outch; k++)
+                const int y0 = std::max(wy * pool_stride - pool_pad_y, 0);
+                const int x0 = std::max(wx * pool_stride - pool_pad_x, 0);
+                const int y1 = std::min(wy * pool_stride - pool_pad_y + pool_kernel, outh);
+                const int x1 = std::min(wx * pool_stride - pool_pad_x + pool_kernel, outw);
+
+                // the max of the members known exactly, relu output is never below zero
+                float window_max = 0.f;
+                members.clear();
+                for (int i = y0; i < y1; i++)
                 {
-                    float* outptr = out_y.channel(k);
-                    outptr += i * outw;
+                    for (int j = x0; j < x1; j++)
+                    {
+                        const int index = i * outw + j;
+                        if (computed[index])
+                        {
+                            window_max = std::max(window_max, outptr[index]);
+                            continue;
+                        }
+
+                        const float ub = lastptr[index] + bias + dx_norms.row(i)[j] * w_norm;
+                        members.push_back(std::make_pair(ub, index));
+                    }
+                }
 
-                    float* outptr_last_y = last_y.channel(k);
-                    outptr_last_y += i * outw;
+                std::sort(members.begin(), members.end());
 
-                    float y_kij = 0.f;
+                for (int m = (int)members.size() - 1; m >= 0; m--)
+                {
+                    if (members[m].first <= window_max)
+                        break;
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+                    const int index = members[m].second;
+                    const int i = index / outw;
+                    const int j = index % outw;
 
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+                    float y_kij = bias;
 
+                    const float* kptr = kptr0;
                     for (int q = 0; q < inch; q++)
                     {
-                        const Mat m = in_x.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+                        const float* sptr = in_x.channel(q).row(i * stride_h) + j * stride_w;
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
+                        for (int w_i = 0; w_i < maxk; w_i++)
                         {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
-
+                            y_kij += sptr[space_ofs[w_i]] * kptr[w_i];
                         }
 
                         kptr += maxk;
                     }
-                    if (bias_term)
-                        outptr_last_y[j] = y_kij - bias_data[k];
-                    else
-                        outptr_last_y[j] = y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    //                    if (outptr_last_y[j] <= opt.lower)
-                    //                        less_0_count += 1;
+
+                    computed[index] = 1;
+                    lastptr[index] = y_kij - bias;
+                    outptr[index] = std::max(y_kij, 0.f);
+                    window_max = std::max(window_max, outptr[index]);
                 }
             }
         }
-        //        fprintf(stderr, "less 0 count = %d\n",less_0_count);
-    }else{;
-        all_select_norms_ptr = (float*)all_select_norms.data;
-        top_E_indices_ptr = (float*)top_E_indices.data;
-        top_E_w_vals_ptr = (float*)top_E_w_vals.data;
-        x_vector_diff_ptr = (float*)x_vector_diff.data;
-        //        float reduced_count=0;
-        //        float total_count = 0;
+
+        // the outputs skipped by every window they belong to
         for (int i = 0; i < outh; i++)
         {
             for (int j = 0; j < outw; j++)
             {
-                /**
-                 * compute dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||
-                 */
-                float dx2_sum = 0.0;
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat& m = in_x.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++)
-                    {
-                        int q_i = q*maxk + w_i;
-                        float val = sptr[space_ofs[w_i]];
-                        float val_last_x = sptr_last_x[space_ofs[w_i]];
-                        x_vector_diff_ptr[q_i] = val - val_last_x;
-                        dx2_sum += x_vector_diff_ptr[q_i] * x_vector_diff_ptr[q_i];
-                    }
-                }
-
-                float dx_norm = sqrt(dx2_sum);  // 1.2%的开销
-                                               //                float dx_norm = 0.0;              // 15773
+                const int index = i * outw + j;
+                if (computed[index])
+                    continue;
 
-                all_select_norms_ptr = (float*)all_select_norms.data;
-                top_E_indices_ptr = (float*)top_E_indices.data;
-                top_E_w_vals_ptr = (float*)top_E_w_vals.data;
-                for (int k = 0; k < outch; k++)
-                {
-                    //                    fprintf(stderr, "debug 2\n");
-                    float* outptr = out_y.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
-
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
-
-                    /**
-                     * get w_norm = || w_k ||
-                     * if (\bar{y[ijk]} + dx_norm * w_norm <= - bias_data[k]) // reduce computation
-                     * {
-                     *      update \bar{y[ijk]} = \bar{y[ijk]} + dx_norm * w_norm
-                     * }
-                     * else // exact compute
-                     */
-//                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-//                    float norm_norm = w_norm2_ptr[k] * dx_norm;
+                lastptr[index] += dx_norms.row(i)[j] * w_norm;
+                outptr[index] = std::max(lastptr[index] + bias, 0.f);
+                skipped_count += 1;
+            }
+        }
+    }
 
-                    // 比较符号，并且取出相对应的w_norm
-                    float diff_sign_sub = 0.0;
-                    unsigned int select_norm_index = 0;
-                    float temp_ii;
-                    for (int ii=0; ii< E; ii++){
-                        temp_ii = x_vector_diff_ptr[(int)(top_E_indices_ptr[ii])] * top_E_w_vals[ii];
-                        select_norm_index = select_norm_index<<1;
-                        if (temp_ii > 0){
-                            select_norm_index |= 1;
-                        }else if(temp_ii < 0){
-//                            diff_sign_sub += temp_ii;
-                        }
-                    }
+    if (opt.use_layer_stats)
+    {
+        stats.bound_time += dot_start - bound_start;
+        stats.dot_time += get_current_time() - dot_start;
+    }
 
-                    float* out_bar_ptr = last_y.channel(k);
-                    out_bar_ptr += i * outw;
+    count_skipped_outputs(stats, skipped_count, (double)outw * outh * outch, inch, maxk);
 
+    last_x.clone_from(in_x);
 
-//                    out_bar_ptr[j] += dx_norm * all_select_norms_ptr[select_norm_index] + diff_sign_sub;
-                    out_bar_ptr[j] += dx_norm * all_select_norms_ptr[select_norm_index];
+    return 0;
+}
 
-//                    if (dx_norm * all_select_norms_ptr[select_norm_index] + diff_sign_sub > norm_norm)
-//                        fprintf(stderr, "完了完了%.1f ", (dx_norm * all_select_norms_ptr[select_norm_index] + diff_sign_sub)/norm_norm);
+inline void find_top_E(const float* w_arr, float* w_topE_indices_arr, float* w_topE_val_arr, int w_arr_len, float* all_select_norms, float w_full_2){
+    /**
+     * find top absolute largest E element in arr, indices stored to indices_arr
+     * w_arr: len = w_arr_len
+     * indices_arr: len = E
+     * all_select_norms: len = 2^E
+     * w_full_norm: 当前w_k的full元素的norm的      平方
+     */
+//    fprintf(stderr, "111\t");
+    std::vector<std::pair<float, int> > w_ordered;
 
-                    //                    total_count += 1;
-                    if (out_bar_ptr[j] + y_kij <= 0){
-                        outptr[j] = 0;
-                        //                        reduced_count += 1;
-                        //                        max_reduce_count += 1;
-                    }else{
-                        out_bar_ptr[j] = -y_kij;
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat& m = in_x.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
+    w_ordered.reserve(w_arr_len);
+    for(int i=0; i<w_arr_len; i++){
+        w_ordered.push_back(std::make_pair((float)fabs(w_arr[i]), i));
+    }
+    // kernels shorter than E pad with zero weights, which never select
+    while ((int)w_ordered.size() < E)
+        w_ordered.insert(w_ordered.begin(), std::make_pair(0.f, 0));
+    w_arr_len = (int)w_ordered.size();
 
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                            {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
-                            }
+    std::sort(w_ordered.begin(), w_ordered.end());
 
-                            kptr += maxk;
-                        }
+    for(int i=0; i<E; i++){
+//    for(int i=w_arr_len-1; i>w_arr_len-1-E; i--){
+        w_topE_val_arr[i] = w_ordered[w_arr_len-1-i].first;
+        w_topE_indices_arr[i] = w_ordered[w_arr_len-1-i].second;
+//        w_topE_val_arr[i] = w_ordered[i].first;
+//        w_topE_indices_arr[i] = w_ordered[i].second;
 
-                        out_bar_ptr[j] += y_kij;
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
+//        fprintf(stderr, "%f, %d \t",  w_topE_val_arr[i],  int(w_topE_indices_arr[i]));
 
-                        //                        if (y_kij <= 0)
-                        //                            max_reduce_count += 1;
-                    }
+        //0.070557, 6 	0.077123, 23 	0.098039, 5 	0.100434, 3 	0.114497, 24 	0.148363, 12
+    }
+//    fprintf(stderr, "\n");
+//    fprintf(stderr, "222\t");
 
-                    all_select_norms_ptr += E_pow_num;
-                    top_E_indices_ptr += E;
-                    top_E_w_vals_ptr += E;
-                }
+    for(int i=0; i<E_pow_num; i++){
+        float tobe_sub = 0.0;
+        for (int norm_index=E-1; norm_index>=0; norm_index--){
+            if ((i>>norm_index) & 1){   // 当前位=1
+                tobe_sub += w_topE_val_arr[E-1-norm_index] * w_topE_val_arr[E-1-norm_index];
             }
         }
-        //        fprintf(stderr, "%.4f/%.4f=%.4f\n", reduced_count, total_count, reduced_count/total_count);
-        //        fprintf(stderr, "%.4f/%.4f=%.4f <-\n", max_reduce_count, total_count, max_reduce_count/total_count);
-
-        //        fprintf(stderr, "%.2f\n",  reduced_count/total_count);
-        //        fprintf(stderr, "%.2f <-\n",  max_reduce_count/total_count);
-//                fprintf(stderr, "\n");
 
-        last_x.clone_from(in_x); //没有这行是15899，加了是16058
+        all_select_norms[i] = sqrt(std::max(w_full_2 - tobe_sub, 0.f));
+    }
+    for (int i=0; i<E; i++){
+        w_topE_val_arr[i] = w_topE_val_arr[i] == 0.f ? 0.f : w_arr[int(w_topE_indices_arr[i])];
     }
 
-
-    return 0;
+//    fprintf(stderr, "333\n");
+    w_ordered.clear();
+    /**
+     * 把相对应位置的, select_norm，转化坐标，存到all_select_norm中
+     */
 }
 
-
-// 上面，左面，(t-1)全比较
-static int temporal_spatial_convolution1(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data,
-                                        int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
-                                        int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2,
-                                        Mat& last_y_col, Mat& last_y_row)
+static int mlsys_convolution_lower_top_E(const Mat& in_x, Mat& out_y, const Mat& weight_data, const Mat& bias_data,
+                             int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
+                             int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2
+                                         ,Mat& all_select_norms, Mat& top_E_indices, Mat& top_E_w_vals, LayerStats& stats)
 {
-    const int w = bottom_blob.w;
-    const int inch = bottom_blob.c;
+    const int w = in_x.w;
+    const int inch = in_x.c;
 
-    const int outw = top_blob.w;
-    const int outh = top_blob.h;
-    const int outch = top_blob.c;
+    const int outw = out_y.w;
+    const int outh = out_y.h;
+    const int outch = out_y.c;
 
     const int bias_term = bias_data.empty() ? 0 : 1;
 
@@ -710,27 +973,20 @@ static int temporal_spatial_convolution1(const Mat& bottom_blob, Mat& top_blob,
         }
     }
 
-    float reduce = 0;
-    float total = 0;
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
-
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
-
     if (last_x.total() <= 0){
-//        fprintf(stderr, "enter\n");
         w_norm2.create(outch);
-        last_y_col.create(outch);
-        last_y_row.create(outch, outw);         // outw是h
+        all_select_norms.create(outch*E_pow_num);
+        top_E_indices.create(outch* E);
+        top_E_w_vals.create(outch* E);
+
+        float* all_select_norms_ptr = (float*)all_select_norms.data;
+        float* top_E_indices_ptr = (float*)top_E_indices.data;
+        float* top_E_w_vals_ptr = (float*)top_E_w_vals.data;
+
         /**
          * calculate w_norm2
          */
+
         float* w_norm2_data = (float*) w_norm2.data;
         for (int k=0; k<outch; k++){
             const float* kptr = (const float*)weight_data.data + maxk * inch * k;
@@ -741,294 +997,187 @@ static int temporal_spatial_convolution1(const Mat& bottom_blob, Mat& top_blob,
                 }
                 kptr += maxk;
             }
+
+            kptr = (const float*)weight_data.data + maxk * inch * k;
+            find_top_E(kptr,
+                       top_E_indices_ptr + E*k,
+                       top_E_w_vals_ptr + E*k,
+                       maxk * inch,
+                       all_select_norms_ptr+k*E_pow_num,
+                       w_norm2_data[k]); // 传进去的是平方
             w_norm2_data[k] = sqrt(w_norm2_data[k]);
         }
 
         /**
-         * exact compute
+         * exact compute, last_y holds the output before bias
          */
-        last_x.clone_from(bottom_blob);
-        last_y.clone_from(top_blob);
-        for (int i = 0; i < outh; i++)
-        {
-            for (int j = 0; j < outw; j++)
-            {
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
+        last_x.clone_from(in_x);
+        last_y.create(outw, outh, outch);
+        if (last_y.empty())
+            return -100;
 
-                    float* outptr_last_y = last_y.channel(k);
-                    outptr_last_y += i * outw;
+        double computed_count = 0.0;
+        double negative_count = 0.0;
+        int ret = tiled_convolution(in_x, out_y, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params,
+                                    Mat(), &last_y, opt, computed_count, negative_count);
+        if (ret != 0)
+            return ret;
 
-                    float y_kij = 0.f;
+        stats.computed_outputs += computed_count;
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+        return 0;
+    }
 
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+    const float* all_select_norms_ptr = all_select_norms;
+    const float* top_E_indices_ptr = top_E_indices;
+    const float* top_E_w_vals_ptr = top_E_w_vals;
 
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+    /**
+     * the output positions are walked in tiles, the output channels in blocks of 4
+     * dx = x_{ij}^{t} - x_{ij}^{t-1} of a tile is packed next to its input patches,
+     * the select-norm bounds and the exact computes of all channels read them from there
+     */
+    const int size = outw * outh;
+    const int patch_size = inch * maxk;
+    const int tile_size = sparse_tile_size(patch_size);
+    const int tile_count = (size + tile_size - 1) / tile_size;
+
+    Mat patches(patch_size * tile_size, 1, opt.num_threads, 4u, opt.workspace_allocator);
+    Mat diffs(patch_size * tile_size, 1, opt.num_threads, 4u, opt.workspace_allocator);
+    if (patches.empty() || diffs.empty())
+        return -100;
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
+    std::vector<double> tile_skipped(tile_count, 0.0);
 
-                        }
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int t = 0; t < tile_count; t++)
+    {
+        const int p0 = t * tile_size;
+        const int p1 = std::min(p0 + tile_size, size);
 
-                        kptr += maxk;
-                    }
-                    if (bias_term)
-                        outptr_last_y[j] = y_kij - bias_data[k];
-                    else
-                        outptr_last_y[j] = y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    //                    if (outptr_last_y[j] <= opt.lower)
-                    //                        less_0_count += 1;
-                }
-            }
-        }
-        //        fprintf(stderr, "less 0 count = %d\n",less_0_count);
-    }else{
-        //        fprintf(stderr, "啊啊啊啊啊\n");
-        float reduced_count = 0.0;
-        float total_count = 0.0;
-        float max_reduce_count = 0.0;
-        float our_count = 0.0;
-        float mlsys_count = 0.0;
-        for (int i = 0; i < outh; i++)
+        float* patch_tile = patches.channel(get_omp_thread_num());
+        float* diff_tile = diffs.channel(get_omp_thread_num());
+        unsigned char packed[SPARSE_TILE_MAX];
+        float dx_norms[SPARSE_TILE_MAX];
+
+        /**
+         * compute dx and dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||
+         */
+        for (int p = p0; p < p1; p++)
         {
-            last_y_row_ptr = (float*)last_y_row.data;
-            for (int j = 0; j < outw; j++)
+            float* col = patch_tile + (p - p0) * patch_size;
+            float* diff = diff_tile + (p - p0) * patch_size;
+            pack_patch(in_x, p / outw, p % outw, stride_w, stride_h, space_ofs, maxk, col);
+            pack_patch(last_x, p / outw, p % outw, stride_w, stride_h, space_ofs, maxk, diff);
+            packed[p - p0] = 1;
+
+            float dx2_sum = 0.f;
+            for (int q_i = 0; q_i < patch_size; q_i++)
             {
-//                delta_x_col = 0.0;
-//                delta_x_row = 0.0;
-//                if (j!=0){
-//                /** 上一列的基准
-//                 * calculate ||x(i, j) - x(i, j-1)||
-//                 */
-//                    for (int q = 0; q < inch; q++)
-//                    {
-//                        const Mat m = bottom_blob.channel(q);
-//                        const float* sptr = m.row(i * stride_h) + j * stride_w;
-//
-//                        const float* prev_sptr = sptr - stride_w;
-//
-//                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-//                        {
-//                            float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-//                            delta_x_col += delta * delta;
-//                        }
-//                    }
-//                    delta_x_col = sqrt(delta_x_col);
-//                }
-//
-//                if (i!=0){
-//                /** 上一行的基准
-//                 * calculate ||x(i, j) - x(i-1, j)||
-//                 */
-//                    for (int q = 0; q < inch; q++)
-//                    {
-//                        const Mat m = bottom_blob.channel(q);
-//                        const float* sptr = m.row(i * stride_h) + j * stride_w;
-//
-//                        const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
-//
-//                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-//                        {
-//                            float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-//                            delta_x_row += delta * delta;
-//                        }
-//                    }
-//                    delta_x_row = sqrt(delta_x_row);
-//                }
-//
-//
-//                /**
-//                 * compute dx_norm = || x_{ij}^{t} - x_{ij}^{t-1} ||
-//                 */
-//
-//                float dx2_sum = 0.0;
-//                for (int q = 0; q < inch; q++)
-//                {
-//                    const Mat& m = bottom_blob.channel(q);
-//                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-//
-//                    const Mat& m_last_x = last_x.channel(q);
-//                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
-//
-//                    for (int w_i = 0; w_i < maxk; w_i++)
-//                    {
-//                        float val = sptr[space_ofs[w_i]];
-//                        float val_last_x = sptr_last_x[space_ofs[w_i]];
-//                        dx2_sum += (val - val_last_x) * (val - val_last_x);
-//                    }
-//                }
-//                float dx_norm = sqrt(dx2_sum);
-
-                delta_x_col = 0.0;
-                delta_x_row = 0.0;
-                float dx2_sum = 0.0;
-                const float* prev_i_sptr = nullptr;
-                const float* prev_j_sptr = nullptr;
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-//                    auto stride_delta_x = (unsigned char*)m.data + (size_t)m.w * i * stride_h * m.elemsize + j * stride_w;
-//                    const float* sptr = (const float*)(stride_delta_x);
+                diff[q_i] = col[q_i] - diff[q_i];
+                dx2_sum += diff[q_i] * diff[q_i];
+            }
 
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
+            dx_norms[p - p0] = sqrt(dx2_sum);
+        }
 
-                    if (i!=0){
-                        prev_i_sptr = m.row((i-1) * stride_h) + j * stride_w;
-//                        prev_i_sptr = (const float*)(stride_delta_x - (size_t)m.w * stride_h * m.elemsize);
-                    }
+        double skipped = 0.0;
 
-                    if (j!=0){
-                        prev_j_sptr = sptr - stride_w;
-                    }
+        for (int k0 = 0; k0 < outch; k0 += 4)
+        {
+            const int kn = std::min(4, outch - k0);
 
-                    for (int w_i = 0; w_i < maxk; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = sptr_last_x[w_i_offset] - base;
-                        dx2_sum += temporal_diff * temporal_diff;
-
-                        if (i!=0){
-                            float spatial_i_diff = prev_i_sptr[w_i_offset] - base;
-                            delta_x_row += spatial_i_diff * spatial_i_diff;
-                        }
+            float* outptrs[4];
+            float* out_bar_ptrs[4];
+            float biases[4];
+            for (int kk = 0; kk < kn; kk++)
+            {
+                outptrs[kk] = out_y.channel(k0 + kk);
+                out_bar_ptrs[kk] = last_y.channel(k0 + kk);
+                biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
+            }
 
-                        if (j!=0){
-                            float spatial_j_diff = prev_j_sptr[w_i_offset] - base;
-                            delta_x_col += spatial_j_diff * spatial_j_diff;
-                        }
-                    }
-                }
-                if (i!=0){
-                    delta_x_row = sqrt(delta_x_row);
-                }
+            const float* kptr = (const float*)weight_data + patch_size * k0;
 
-                if (j!=0){
-                    delta_x_col = sqrt(delta_x_col);
-                }
-                float dx_norm = sqrt(dx2_sum);
+            for (int p = p0; p < p1; p++)
+            {
+                const float* diff = diff_tile + (p - p0) * patch_size;
+                const float dx_norm = dx_norms[p - p0];
 
-                for (int k = 0; k < outch; k++)
+                int need[4];
+                int need_count = 0;
+                for (int kk = 0; kk < kn; kk++)
                 {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
-
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+                    const int k = k0 + kk;
+                    const float* select_norms = all_select_norms_ptr + k * E_pow_num;
+                    const float* indices = top_E_indices_ptr + k * E;
+                    const float* w_vals = top_E_w_vals_ptr + k * E;
 
-
-                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-                    float* out_bar_ptr = last_y.channel(k);
-                    out_bar_ptr += i * outw;
-
-                    /**
-                     * 注意our_bar_ptr是j，而last_y_col_ptr是k
-                     */
-                    float norm_norm = out_bar_ptr[j] + w_norm2_ptr[k] * dx_norm;
-                    min_norm_norm = norm_norm;
-
-                    if (j!=0){
-                        norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2_ptr[k];
-                        min_norm_norm = std::min(min_norm_norm, norm_norm_col);
-                    }
-
-                    if (i!=0){
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_ptr[k];
-                        min_norm_norm = std::min(min_norm_norm, norm_norm_row);
+                    // the top E terms decreasing y are added exactly and their weights
+                    // are dropped from the norm, the rest is bounded by dx_norm * norm
+                    float diff_sign_sub = 0.0;
+                    unsigned int select_norm_index = 0;
+                    for (int ii = 0; ii < E; ii++)
+                    {
+                        const float temp_ii = diff[(int)indices[ii]] * w_vals[ii];
+                        select_norm_index = select_norm_index << 1;
+                        if (temp_ii < 0)
+                        {
+                            select_norm_index |= 1;
+                            diff_sign_sub += temp_ii;
+                        }
                     }
 
-//                    total_count+=1;
-                    if (min_norm_norm + y_kij <= 0){
-//                        if (i!=0 && norm_norm_row==min_norm_norm)
-//                            our_count += 1;
-//                        else if (j!=0 && norm_norm_col==min_norm_norm)
-//                            our_count += 1;
-//                        else
-//                            mlsys_count += 1;
-                        last_y_col_ptr[k] = min_norm_norm;
-                        last_y_row_ptr[k] = min_norm_norm;
-                        out_bar_ptr[j] = min_norm_norm;
-                        outptr[j] = 0;
-//                        reduced_count += 1;
-//                        max_reduce_count += 1;
-                    }else{
-//                        out_bar_ptr[j] = -y_kij;
-//                        last_y_col_ptr[k] = -y_kij;
-//                        last_y_row_ptr[k] = -y_kij;
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat& m = bottom_blob.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
+                    float* out_bar_ptr = out_bar_ptrs[kk];
+                    out_bar_ptr[p] += dx_norm * select_norms[select_norm_index] + diff_sign_sub;
 
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                            {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
-                            }
+                    if (out_bar_ptr[p] + biases[kk] <= 0)
+                    {
+                        outptrs[kk][p] = 0;
+                        skipped += 1;
+                        continue;
+                    }
 
-                            kptr += maxk;
-                        }
+                    need[need_count++] = kk;
+                }
 
-                        if (bias_term){
-                            out_bar_ptr[j] = y_kij - bias_data[k];
-                            last_y_col_ptr[k] = y_kij - bias_data[k];;
-                            last_y_row_ptr[k] = y_kij - bias_data[k];;
-                        }else{
-                            out_bar_ptr[j] = y_kij;
-                            last_y_col_ptr[k] = y_kij;
-                            last_y_row_ptr[k] = y_kij;
-                        }
+                if (need_count == 0)
+                    continue;
 
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
+                float sums[4];
+                masked_dot_product(in_x, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
 
-//                        if (y_kij <= 0)
-//                            max_reduce_count += 1;
-                    }
+                for (int n = 0; n < need_count; n++)
+                {
+                    const int kk = need[n];
+                    out_bar_ptrs[kk][p] = sums[kk];
+                    outptrs[kk][p] = activation_ss(sums[kk] + biases[kk], activation_type, activation_params);
                 }
-                last_y_row_ptr += outch;
             }
         }
-        //        fprintf(stderr, "%.4f/%.4f=%.4f\n", reduced_count, total_count, reduced_count/total_count);
-        //        fprintf(stderr, "%.4f/%.4f=%.4f <-\n", max_reduce_count, total_count, max_reduce_count/total_count);
 
-//                fprintf(stderr, "%.2f\n",  reduced_count/total_count);
-        //        fprintf(stderr, "%.2f <-\n",  max_reduce_count/total_count);
-
-//        fprintf(stderr, "进入原有的:%.2f \t 进入我们的:%.2f\n",  mlsys_count/reduced_count, our_count/reduced_count);
+        tile_skipped[t] = skipped;
+    }
 
-        last_x.clone_from(bottom_blob); //没有这行是15899，加了是16058
+    double skipped_count = 0.0;
+    for (int t = 0; t < tile_count; t++)
+    {
+        skipped_count += tile_skipped[t];
     }
 
+    last_x.clone_from(in_x);
+
+    count_skipped_outputs(stats, skipped_count, (double)size * outch, inch, maxk);
 
     return 0;
 }
 
-
-
+// 上面，左面，(t-1)全比较
 // 如果\delta x过大，就采用我们的方法
 static int change_temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data,
                                          int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
                                          int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2,
-                                         Mat& last_y_col, Mat& last_y_row, float& last_x_sparsity)
+                                         Mat& last_y_col, Mat& last_y_row, float& last_x_sparsity, LayerStats& stats)
 {
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
@@ -1060,20 +1209,8 @@ static int change_temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_
         }
     }
 
-    float reduce = 0;
-    float total = 0;
-
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
-
     if (w_norm2.total() <= 0)
     {
-        //        fprintf(stderr, "enter\n");
         w_norm2.create(outch);
         last_y_col.create(outch);
         last_y_row.create(outch, outw); // outw是h
@@ -1097,167 +1234,149 @@ static int change_temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_
         }
     }
 
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
-    if (false){
+    const int size = outw * outh;
+    const int patch_size = inch * maxk;
+
+    double reduce = 0;
+    const double total = (double)size * outch;
+
+    // the neighbour bounds only pay off on sparse outputs
+    // compute dense frames exactly, the sparsity is measured either way
+    if (last_x_sparsity < SPATIAL_BOUND_MIN_SPARSITY){
         /**
          * exact compute
-        */
-        for (int i = 0; i < outh; i++)
-        {
-            for (int j = 0; j < outw; j++)
-            {
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
+         */
+        double computed_count = 0.0;
+        int ret = tiled_convolution(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params,
+                                    Mat(), 0, opt, computed_count, reduce);
+        if (ret != 0)
+            return ret;
 
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
+        stats.computed_outputs += computed_count;
 
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
-                    total += 1;
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+        last_x_sparsity = (float)(reduce / total);
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
-                        }
+        return 0;
+    }
 
-                        kptr += maxk;
-                    }
-                    if (y_kij < 0)
-                        reduce += 1;
+    /**
+     * delta_x_col = ||x(i, j) - x(i, j-1)||, delta_x_row = ||x(i, j) - x(i-1, j)||
+     */
+    Mat deltas(outw, outh, 2);
+    if (deltas.empty())
+        return -100;
 
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                }
-            }
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i = 0; i < outh; i++)
+    {
+        float* delta_x_cols = deltas.channel(0).row(i);
+        float* delta_x_rows = deltas.channel(1).row(i);
+
+        for (int j = 0; j < outw; j++)
+        {
+            delta_x_cols[j] = j != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i, j - 1, stride_w, stride_h, space_ofs, maxk) : 0.f;
+            delta_x_rows[j] = i != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i - 1, j, stride_w, stride_h, space_ofs, maxk) : 0.f;
         }
     }
-    else{
 
-        for (int i = 0; i < outh; i++)
-        {
-            last_y_row_ptr = (float*)last_y_row.data;
-            for (int j = 0; j < outw; j++)
-            {
-                delta_x_col = 0.0;
-                delta_x_row = 0.0;
-                if (j!=0){
-            /** 上一列的基准
-             * calculate ||x(i, j) - x(i, j-1)||
-             */
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+    /**
+     * the neighbour state of a channel follows the scan order, the tiles are walked in order
+     * and the channel blocks of a tile reuse its packed input patches
+     */
+    const int tile_size = sparse_tile_size(patch_size);
 
-                        const float* prev_sptr = sptr - stride_w;
+    Mat patches(patch_size * tile_size, 4u, opt.workspace_allocator);
+    if (patches.empty())
+        return -100;
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                            delta_x_col += delta * delta;
-                        }
-                    }
-                    delta_x_col = sqrt(delta_x_col);
-                }
+    float* patch_tile = patches;
+    float* last_y_col_ptr = last_y_col;
+    const float* w_norm2_ptr = w_norm2;
+    const float* delta_x_cols = deltas.channel(0);
+    const float* delta_x_rows = deltas.channel(1);
 
-                if (i!=0){
-            /** 上一行的基准
-             * calculate ||x(i, j) - x(i-1, j)||
-             */
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+    double skipped_count = 0.0;
 
-                        const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
+    for (int p0 = 0; p0 < size; p0 += tile_size)
+    {
+        const int p1 = std::min(p0 + tile_size, size);
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                            delta_x_row += delta * delta;
-                        }
-                    }
-                    delta_x_row = sqrt(delta_x_row);
-                }
+        unsigned char packed[SPARSE_TILE_MAX] = {0};
 
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
+        for (int k0 = 0; k0 < outch; k0 += 4)
+        {
+            const int kn = std::min(4, outch - k0);
 
-                    float y_kij = 0.f;
+            float* outptrs[4];
+            float biases[4];
+            for (int kk = 0; kk < kn; kk++)
+            {
+                outptrs[kk] = top_blob.channel(k0 + kk);
+                biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
+            }
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+            const float* kptr = (const float*)weight_data + patch_size * k0;
 
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+            for (int p = p0; p < p1; p++)
+            {
+                const int i = p / outw;
+                const int j = p % outw;
 
-                    total += 1;
+                float* last_y_row_ptr = last_y_row.row(j);
 
-                    if (j!=0){
-                        norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2[k];
-                        min_norm_norm = norm_norm_col;
-                    }
+                int need[4];
+                int need_count = 0;
+                for (int kk = 0; kk < kn; kk++)
+                {
+                    const int k = k0 + kk;
 
-                    if (i!=0){
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2[k];
-                        if(j!=0)
-                            min_norm_norm = std::min(norm_norm_row, min_norm_norm);
-                        else
-                            min_norm_norm = norm_norm_row;
-                    }
+                    float min_norm_norm = 0.f;
+                    if (j != 0)
+                        min_norm_norm = last_y_col_ptr[k] + delta_x_cols[p] * w_norm2_ptr[k];
 
+                    if (i != 0)
+                    {
+                        const float norm_norm_row = last_y_row_ptr[k] + delta_x_rows[p] * w_norm2_ptr[k];
+                        min_norm_norm = j != 0 ? std::min(norm_norm_row, min_norm_norm) : norm_norm_row;
+                    }
 
-                    if ((i!=0||j!=0) && min_norm_norm + y_kij <= 0){
+                    if ((i != 0 || j != 0) && min_norm_norm + biases[kk] <= 0)
+                    {
                         last_y_col_ptr[k] = min_norm_norm;
                         last_y_row_ptr[k] = min_norm_norm;
-                        outptr[j] = 0;
-
-
-                    }else{
-                        last_y_col_ptr[k] = -y_kij;
-                        last_y_row_ptr[k] = -y_kij;
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat m = bottom_blob.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
+                        outptrs[kk][p] = 0;
+                        skipped_count += 1;
+                        reduce += 1;
+                        continue;
+                    }
 
-                            for (int w_i = 0; w_i < maxk; w_i++)
-                            {
-                                float val = sptr[space_ofs[w_i]];
-                                float wt = kptr[w_i];
-                                y_kij += val * wt;
+                    need[need_count++] = kk;
+                }
 
-                            }
-                            kptr += maxk;
-                        }
+                if (need_count == 0)
+                    continue;
 
+                float sums[4];
+                masked_dot_product(bottom_blob, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
 
-                        if (y_kij < 0)
-                            reduce += 1;
+                for (int n = 0; n < need_count; n++)
+                {
+                    const int kk = need[n];
+                    const float y_kij = sums[kk] + biases[kk];
+                    if (y_kij < 0)
+                        reduce += 1;
 
-                        last_y_col_ptr[k] += y_kij;
-                        last_y_row_ptr[k] += y_kij;
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    }
+                    last_y_col_ptr[k0 + kk] = sums[kk];
+                    last_y_row_ptr[k0 + kk] = sums[kk];
+                    outptrs[kk][p] = activation_ss(y_kij, activation_type, activation_params);
                 }
-                last_y_row_ptr += outch;
             }
         }
     }
 
-    last_x_sparsity = reduce / total;
+    last_x_sparsity = (float)(reduce / total);
+
+    count_skipped_outputs(stats, skipped_count, total, inch, maxk);
 
     return 0;
 }
@@ -1267,7 +1386,7 @@ static int change_temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_
 static int temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data,
                                         int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
                                         int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2,
-                                        Mat& last_y_col, Mat& last_y_row)
+                                        Mat& last_y_col, Mat& last_y_row, LayerStats& stats)
 {
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
@@ -1299,18 +1418,7 @@ static int temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_blob, c
         }
     }
 
-    float reduce = 0;
-    float total = 0;
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
-
     if (last_x.total() <= 0){
-        //        fprintf(stderr, "enter\n");
         w_norm2.create(outch);
         last_y_col.create(outch);
         last_y_row.create(outch, outw);         // outw是h
@@ -1331,200 +1439,148 @@ static int temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_blob, c
         }
 
         /**
-         * exact compute
+         * exact compute, last_y holds the output before bias
          */
         last_x.clone_from(bottom_blob);
-        last_y.clone_from(top_blob);
-        for (int i = 0; i < outh; i++)
-        {
-            for (int j = 0; j < outw; j++)
-            {
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-
-                    float* outptr_last_y = last_y.channel(k);
-                    outptr_last_y += i * outw;
-
-                    float y_kij = 0.f;
+        last_y.create(outw, outh, outch);
+        if (last_y.empty())
+            return -100;
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+        double computed_count = 0.0;
+        double negative_count = 0.0;
+        int ret = tiled_convolution(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params,
+                                    Mat(), &last_y, opt, computed_count, negative_count);
+        if (ret != 0)
+            return ret;
 
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+        stats.computed_outputs += computed_count;
 
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+        return 0;
+    }
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
+    /**
+     * dx_norm = ||x^{t}(i, j) - x^{t-1}(i, j)||, delta_x_col = ||x(i, j) - x(i, j-1)||, delta_x_row = ||x(i, j) - x(i-1, j)||
+     */
+    Mat deltas(outw, outh, 3);
+    if (deltas.empty())
+        return -100;
 
-                        }
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i = 0; i < outh; i++)
+    {
+        float* dx_norms = deltas.channel(0).row(i);
+        float* delta_x_cols = deltas.channel(1).row(i);
+        float* delta_x_rows = deltas.channel(2).row(i);
 
-                        kptr += maxk;
-                    }
-                    if (bias_term)
-                        outptr_last_y[j] = y_kij - bias_data[k];
-                    else
-                        outptr_last_y[j] = y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                }
-            }
-        }
-        //        fprintf(stderr, "less 0 count = %d\n",less_0_count);
-    }else{
-        float* last_y_row_ptr = nullptr;
-        float* last_y_col_ptr = (float*) last_y_col.data;
-
-        float reduced_count = 0.0;
-        float total_count = 0.0;
-//        float max_reduce_count = 0.0;
-//        float our_count = 0.0;
-//        float mlsys_count = 0.0;
-        float dx2_sum = 0.0;
-        const float* prev_i_sptr = nullptr;
-        const float* prev_j_sptr = nullptr;
-        for (int i = 0; i < outh; i++)
+        for (int j = 0; j < outw; j++)
         {
-            last_y_row_ptr = (float*)last_y_row.data;
-            for (int j = 0; j < outw; j++)
-            {
-                delta_x_col = 0.0;
-                delta_x_row = 0.0;
-                dx2_sum = 0.0;
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+            dx_norms[j] = patch_distance(bottom_blob, i, j, last_x, i, j, stride_w, stride_h, space_ofs, maxk);
+            delta_x_cols[j] = j != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i, j - 1, stride_w, stride_h, space_ofs, maxk) : 0.f;
+            delta_x_rows[j] = i != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i - 1, j, stride_w, stride_h, space_ofs, maxk) : 0.f;
+        }
+    }
 
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
+    /**
+     * the neighbour state of a channel follows the scan order, the tiles are walked in order
+     * and the channel blocks of a tile reuse its packed input patches
+     */
+    const int size = outw * outh;
+    const int patch_size = inch * maxk;
+    const int tile_size = sparse_tile_size(patch_size);
 
-                    if (i!=0){
-                        prev_i_sptr = m.row((i-1) * stride_h) + j * stride_w;
-                    }
+    Mat patches(patch_size * tile_size, 4u, opt.workspace_allocator);
+    if (patches.empty())
+        return -100;
 
-                    if (j!=0){
-                        prev_j_sptr = sptr - stride_w;
-                    }
+    float* patch_tile = patches;
+    float* last_y_col_ptr = last_y_col;
+    const float* w_norm2_ptr = w_norm2;
+    const float* dx_norms = deltas.channel(0);
+    const float* delta_x_cols = deltas.channel(1);
+    const float* delta_x_rows = deltas.channel(2);
 
-                    for (int w_i = 0; w_i < maxk; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = sptr_last_x[w_i_offset] - base;
-                        dx2_sum += temporal_diff * temporal_diff;
-
-                        if (i!=0){
-                            float spatial_i_diff = prev_i_sptr[w_i_offset] - base;
-                            delta_x_row += spatial_i_diff * spatial_i_diff;
-                        }
+    double skipped_count = 0.0;
 
-                        if (j!=0){
-                            float spatial_j_diff = prev_j_sptr[w_i_offset] - base;
-                            delta_x_col += spatial_j_diff * spatial_j_diff;
-                        }
-                    }
-                }
-                if (i!=0){
-                    delta_x_row = sqrt(delta_x_row);
-                }
+    for (int p0 = 0; p0 < size; p0 += tile_size)
+    {
+        const int p1 = std::min(p0 + tile_size, size);
 
-                if (j!=0){
-                    delta_x_col = sqrt(delta_x_col);
-                }
-                float dx_norm = sqrt(dx2_sum);
+        unsigned char packed[SPARSE_TILE_MAX] = {0};
 
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
+        for (int k0 = 0; k0 < outch; k0 += 4)
+        {
+            const int kn = std::min(4, outch - k0);
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+            float* outptrs[4];
+            float* out_bar_ptrs[4];
+            float biases[4];
+            for (int kk = 0; kk < kn; kk++)
+            {
+                outptrs[kk] = top_blob.channel(k0 + kk);
+                out_bar_ptrs[kk] = last_y.channel(k0 + kk);
+                biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
+            }
 
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+            const float* kptr = (const float*)weight_data + patch_size * k0;
 
+            for (int p = p0; p < p1; p++)
+            {
+                const int i = p / outw;
+                const int j = p % outw;
 
-                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-                    float* out_bar_ptr = last_y.channel(k);
-                    out_bar_ptr += i * outw;
+                float* last_y_row_ptr = last_y_row.row(j);
+
+                int need[4];
+                int need_count = 0;
+                for (int kk = 0; kk < kn; kk++)
+                {
+                    const int k = k0 + kk;
 
                     /**
                      * 注意our_bar_ptr是j，而last_y_col_ptr是k
                      */
-                    float norm_norm = out_bar_ptr[j] + w_norm2_ptr[k] * dx_norm;
-                    min_norm_norm = norm_norm;
+                    float min_norm_norm = out_bar_ptrs[kk][p] + w_norm2_ptr[k] * dx_norms[p];
 
-                    if (j!=0){
-                        norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2_ptr[k];
-                        min_norm_norm = std::min(min_norm_norm, norm_norm_col);
-                    }
+                    if (j != 0)
+                        min_norm_norm = std::min(min_norm_norm, last_y_col_ptr[k] + delta_x_cols[p] * w_norm2_ptr[k]);
 
-                    if (i!=0){
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_ptr[k];
-                        min_norm_norm = std::min(min_norm_norm, norm_norm_row);
-                    }
+                    if (i != 0)
+                        min_norm_norm = std::min(min_norm_norm, last_y_row_ptr[k] + delta_x_rows[p] * w_norm2_ptr[k]);
 
-                    total_count += 1;
-                    if (min_norm_norm + y_kij <= 0){
+                    if (min_norm_norm + biases[kk] <= 0)
+                    {
                         last_y_col_ptr[k] = min_norm_norm;
                         last_y_row_ptr[k] = min_norm_norm;
-                        out_bar_ptr[j] = min_norm_norm;
-                        outptr[j] = 0;
-
-                        reduced_count += 1;
-                    }else{
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat& m = bottom_blob.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
+                        out_bar_ptrs[kk][p] = min_norm_norm;
+                        outptrs[kk][p] = 0;
+                        skipped_count += 1;
+                        continue;
+                    }
 
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                            {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
-                            }
+                    need[need_count++] = kk;
+                }
 
-                            kptr += maxk;
-                        }
+                if (need_count == 0)
+                    continue;
 
-                        if (bias_term){
-                            out_bar_ptr[j] = y_kij - bias_data[k];
-                            last_y_col_ptr[k] = y_kij - bias_data[k];;
-                            last_y_row_ptr[k] = y_kij - bias_data[k];
-                        }else{
-                            out_bar_ptr[j] = y_kij;
-                            last_y_col_ptr[k] = y_kij;
-                            last_y_row_ptr[k] = y_kij;
-                        }
+                float sums[4];
+                masked_dot_product(bottom_blob, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
 
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    }
+                for (int n = 0; n < need_count; n++)
+                {
+                    const int kk = need[n];
+                    out_bar_ptrs[kk][p] = sums[kk];
+                    last_y_col_ptr[k0 + kk] = sums[kk];
+                    last_y_row_ptr[k0 + kk] = sums[kk];
+                    outptrs[kk][p] = activation_ss(sums[kk] + biases[kk], activation_type, activation_params);
                 }
-                last_y_row_ptr += outch;
             }
         }
-        //        fprintf(stderr, "%.4f/%.4f=%.4f\n", reduced_count, total_count, reduced_count/total_count);
-        //        fprintf(stderr, "%.4f/%.4f=%.4f <-\n", max_reduce_count, total_count, max_reduce_count/total_count);
-
-//        fprintf(stderr, "%.2f\t",  reduced_count/total_count);
-        //        fprintf(stderr, "%.2f <-\n",  max_reduce_count/total_count);
-
-        //        fprintf(stderr, "进入原有的:%.2f \t 进入我们的:%.2f\n",  mlsys_count/reduced_count, our_count/reduced_count);
-
-        last_x.clone_from(bottom_blob); //没有这行是15899，加了是16058
     }
 
+    last_x.clone_from(bottom_blob);
+
+    count_skipped_outputs(stats, skipped_count, (double)size * outch, inch, maxk);
 
     return 0;
 }
@@ -1533,7 +1589,7 @@ static int temporal_spatial_convolution(const Mat& bottom_blob, Mat& top_blob, c
 static int temporal_spatial_convolution_lower_bound(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data,
                                         int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h,
                                         int activation_type, const Mat& activation_params, const Option& opt, Mat& last_x, Mat& last_y, Mat& w_norm2,
-                                        Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower)
+                                        Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower, LayerStats& stats)
 {
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
@@ -1565,21 +1621,7 @@ static int temporal_spatial_convolution_lower_bound(const Mat& bottom_blob, Mat&
         }
     }
 
-    float reduce = 0;
-    float total = 0;
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    //    float norm_norm_row;    // i的norm norm
-    //    float delta_x_row;
-
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
-
     if (last_x.total() <= 0){
-        //        fprintf(stderr, "enter\n");
         w_norm2.create(outch);
         w_norm2_lower.create(outch);
         last_y_col.create(outch);
@@ -1598,354 +1640,155 @@ static int temporal_spatial_convolution_lower_bound(const Mat& bottom_blob, Mat&
                 }
                 kptr += maxk;
             }
-            w_norm2_data_lower_ptr[k] = sqrt(w_norm2_data_ptr[k] -
-                                             ((const float*)weight_data.data + maxk * inch * k)[0]
-                                             * ((const float*)weight_data.data + maxk * inch * k)[0]);
+            const float w0 = ((const float*)weight_data.data + maxk * inch * k)[0];
+            w_norm2_data_lower_ptr[k] = sqrt(std::max(w_norm2_data_ptr[k] - w0 * w0, 0.f));
             w_norm2_data_ptr[k] = sqrt(w_norm2_data_ptr[k]);
         }
 
         /**
-         * exact compute
+         * exact compute, last_y holds the output before bias
          */
         last_x.clone_from(bottom_blob);
-        last_y.clone_from(top_blob);
-        for (int i = 0; i < outh; i++)
-        {
-            for (int j = 0; j < outw; j++)
-            {
-                for (int k = 0; k < outch; k++)
-                {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-
-                    float* outptr_last_y = last_y.channel(k);
-                    outptr_last_y += i * outw;
-
-                    float y_kij = 0.f;
+        last_y.create(outw, outh, outch);
+        if (last_y.empty())
+            return -100;
 
-                    if (bias_term)
-                        y_kij = bias_data[k];
+        double computed_count = 0.0;
+        double negative_count = 0.0;
+        int ret = tiled_convolution(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params,
+                                    Mat(), &last_y, opt, computed_count, negative_count);
+        if (ret != 0)
+            return ret;
 
-                    // 某层有64个卷积核，kptr即为64个卷积核之一
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+        stats.computed_outputs += computed_count;
 
-//                    total += 1;
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+        return 0;
+    }
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
+    /**
+     * dx_norm = ||x^{t}(i, j) - x^{t-1}(i, j)||, delta_x_col = ||x(i, j) - x(i, j-1)||
+     * and the temporal change of the first input element, added exactly when it decreases y
+     */
+    Mat deltas(outw, outh, 3);
+    if (deltas.empty())
+        return -100;
 
-                        }
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i = 0; i < outh; i++)
+    {
+        float* dx_norms = deltas.channel(0).row(i);
+        float* delta_x_cols = deltas.channel(1).row(i);
+        float* record_xij_0s = deltas.channel(2).row(i);
 
-                        kptr += maxk;
-                    }
-                    if (bias_term)
-                        outptr_last_y[j] = y_kij - bias_data[k];
-                    else
-                        outptr_last_y[j] = y_kij;
-//                    if (y_kij <= 0)
-//                        reduce += 1;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                }
-            }
-        }
-//        fprintf(stderr, "%.0f %.0f\n", reduce, total);
-    }else{
-        float dx2_sum = 0.0;
-        //        const float* prev_i_sptr = nullptr;
-        const float* prev_j_sptr = nullptr;
-        for (int i = 0; i < outh; i++)
+        for (int j = 0; j < outw; j++)
         {
-            //            last_y_row_ptr = (float*)last_y_row.data;
-            for (int j = 0; j < 1; j++)
-            {
-                float record_xij_0 = 0;
-                bool first = true;
-                delta_x_col = 0.0;
-                //                delta_x_row = 0.0;
-                dx2_sum = 0.0;
-                for (int q = 0; q < 1; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
-
-
-                    for (int w_i = 0; w_i < 1; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
-
-                        record_xij_0 = temporal_diff;
-
-                        dx2_sum += temporal_diff * temporal_diff;
-
-                        //                        if (i!=0){
-                        //                            float spatial_i_diff = prev_i_sptr[w_i_offset] - base;
-                        //                            delta_x_row += spatial_i_diff * spatial_i_diff;
-                        //                        }
+            dx_norms[j] = patch_distance(bottom_blob, i, j, last_x, i, j, stride_w, stride_h, space_ofs, maxk);
+            delta_x_cols[j] = j != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i, j - 1, stride_w, stride_h, space_ofs, maxk) : 0.f;
+            record_xij_0s[j] = bottom_blob.channel(0).row(i * stride_h)[j * stride_w] - last_x.channel(0).row(i * stride_h)[j * stride_w];
+        }
+    }
 
-                    }
+    /**
+     * the neighbour state of a channel follows the scan order, the tiles are walked in order
+     * and the channel blocks of a tile reuse its packed input patches
+     */
+    const int size = outw * outh;
+    const int patch_size = inch * maxk;
+    const int tile_size = sparse_tile_size(patch_size);
 
-                    for (int w_i = 1; w_i < maxk; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
-                        dx2_sum += temporal_diff * temporal_diff;
+    Mat patches(patch_size * tile_size, 4u, opt.workspace_allocator);
+    if (patches.empty())
+        return -100;
 
+    float* patch_tile = patches;
+    float* last_y_col_ptr = last_y_col;
+    const float* w_norm2_ptr = w_norm2;
+    const float* w_norm2_lower_ptr = w_norm2_lower;
+    const float* dx_norms = deltas.channel(0);
+    const float* delta_x_cols = deltas.channel(1);
+    const float* record_xij_0s = deltas.channel(2);
 
-                    }
-                }
-                for (int q = 1; q < inch; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+    double skipped_count = 0.0;
 
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
+    for (int p0 = 0; p0 < size; p0 += tile_size)
+    {
+        const int p1 = std::min(p0 + tile_size, size);
 
+        unsigned char packed[SPARSE_TILE_MAX] = {0};
 
-                    for (int w_i = 0; w_i < maxk; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
+        for (int k0 = 0; k0 < outch; k0 += 4)
+        {
+            const int kn = std::min(4, outch - k0);
 
-                        dx2_sum += temporal_diff * temporal_diff;
+            float* outptrs[4];
+            float* out_bar_ptrs[4];
+            float biases[4];
+            for (int kk = 0; kk < kn; kk++)
+            {
+                outptrs[kk] = top_blob.channel(k0 + kk);
+                out_bar_ptrs[kk] = last_y.channel(k0 + kk);
+                biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
+            }
 
-                    }
-                }
+            const float* kptr = (const float*)weight_data + patch_size * k0;
 
-                float dx_norm = sqrt(dx2_sum);
+            for (int p = p0; p < p1; p++)
+            {
+                const int j = p % outw;
 
-                for (int k = 0; k < outch; k++)
+                int need[4];
+                int need_count = 0;
+                for (int kk = 0; kk < kn; kk++)
                 {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
-
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
+                    const int k = k0 + kk;
 
-
-                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-                    float* out_bar_ptr = last_y.channel(k);
-                    out_bar_ptr += i * outw;
+                    const float temp = record_xij_0s[p] * kptr[patch_size * kk];
 
                     /**
                      * 注意our_bar_ptr是j，而last_y_col_ptr是k
                      */
-                    float norm_norm;
-                    if (record_xij_0 * kptr[0] <= 0)
-                        norm_norm = out_bar_ptr[j] + w_norm2_lower[k] * dx_norm + record_xij_0 * kptr[0];
+                    float min_norm_norm;
+                    if (temp <= 0)
+                        min_norm_norm = out_bar_ptrs[kk][p] + w_norm2_lower_ptr[k] * dx_norms[p] + temp;
                     else
-                        norm_norm = out_bar_ptr[j] + w_norm2_ptr[k] * dx_norm;
-
-                    min_norm_norm = norm_norm;
-
-                    if (min_norm_norm + y_kij <= 0){
-                        last_y_col_ptr[k] = min_norm_norm;
-                        out_bar_ptr[j] = min_norm_norm;
-                        outptr[j] = 0;
-                    }else{
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat& m = bottom_blob.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                            {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
-                            }
-
-                            kptr += maxk;
-                        }
-
-                        if (bias_term){
-                            out_bar_ptr[j] = y_kij - bias_data[k];
-                            last_y_col_ptr[k] = y_kij - bias_data[k];;
-                            //                            last_y_row_ptr[k] = y_kij - bias_data[k];;
-                        }else{
-                            out_bar_ptr[j] = y_kij;
-                            last_y_col_ptr[k] = y_kij;
-                            //                            last_y_row_ptr[k] = y_kij;
-                        }
-
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    }
-                }
-                //                last_y_row_ptr += outch;
-            }
-            for (int j = 1; j < outw; j++)
-            {
-                float record_xij_0 = 0;
-                bool first = true;
-                delta_x_col = 0.0;
-                //                delta_x_row = 0.0;
-                dx2_sum = 0.0;
-                for (int q = 0; q < 1; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
+                        min_norm_norm = out_bar_ptrs[kk][p] + w_norm2_ptr[k] * dx_norms[p];
 
-                    //                    if (i!=0){
-                    //                        prev_i_sptr = m.row((i-1) * stride_h) + j * stride_w;
-                    //                    }
+                    if (j != 0)
+                        min_norm_norm = std::min(min_norm_norm, last_y_col_ptr[k] + delta_x_cols[p] * w_norm2_ptr[k]);
 
-                    prev_j_sptr = sptr - stride_w;
-
-
-                    for (int w_i = 0; w_i < 1; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
-
-                        record_xij_0 = temporal_diff;
-
-                        dx2_sum += temporal_diff * temporal_diff;
-
-
-                        float spatial_j_diff = prev_j_sptr[w_i_offset] - base;
-                        delta_x_col += spatial_j_diff * spatial_j_diff;
-
-                    }
-
-                    for (int w_i = 1; w_i < maxk; w_i++)
+                    if (min_norm_norm + biases[kk] <= 0)
                     {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
-                        dx2_sum += temporal_diff * temporal_diff;
-
-                        float spatial_j_diff = prev_j_sptr[w_i_offset] - base;
-                        delta_x_col += spatial_j_diff * spatial_j_diff;
+                        last_y_col_ptr[k] = min_norm_norm;
+                        out_bar_ptrs[kk][p] = min_norm_norm;
+                        outptrs[kk][p] = 0;
+                        skipped_count += 1;
+                        continue;
                     }
-                }
-                for (int q = 1; q < inch; q++)
-                {
-                    const Mat& m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const Mat& m_last_x = last_x.channel(q);
-                    const float* sptr_last_x = m_last_x.row(i * stride_h) + j * stride_w;
-
-                    prev_j_sptr = sptr - stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++)
-                    {
-                        auto w_i_offset = space_ofs[w_i];
-                        float base = sptr[w_i_offset];
-                        float temporal_diff = base - sptr_last_x[w_i_offset];
-
-                        dx2_sum += temporal_diff * temporal_diff;
 
-                        float spatial_j_diff = prev_j_sptr[w_i_offset] - base;
-                        delta_x_col += spatial_j_diff * spatial_j_diff;
-
-                    }
+                    need[need_count++] = kk;
                 }
 
+                if (need_count == 0)
+                    continue;
 
-                delta_x_col = sqrt(delta_x_col);
-
-                float dx_norm = sqrt(dx2_sum);
+                float sums[4];
+                masked_dot_product(bottom_blob, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
 
-                for (int k = 0; k < outch; k++)
+                for (int n = 0; n < need_count; n++)
                 {
-                    float* outptr = top_blob.channel(k);
-                    outptr += i * outw;
-                    float y_kij = 0.f;
-
-                    if (bias_term)
-                        y_kij = bias_data[k];
-
-                    const float* kptr = (const float*)weight_data + maxk * inch * k;
-
-
-                    const float* w_norm2_ptr = (const float*)w_norm2.data;
-                    float* out_bar_ptr = last_y.channel(k);
-                    out_bar_ptr += i * outw;
-
-                    /**
-                     * 注意our_bar_ptr是j，而last_y_col_ptr是k
-                     */
-                    float norm_norm;
-                    if (kptr[0] <=0 || record_xij_0 * kptr[0] > 0)
-                        norm_norm = out_bar_ptr[j] + w_norm2_lower[k] * dx_norm;
-                    else
-                        norm_norm = out_bar_ptr[j] + w_norm2_ptr[k] * dx_norm;
-
-                    min_norm_norm = norm_norm;
-
-                    norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2_ptr[k];
-                    min_norm_norm = std::min(min_norm_norm, norm_norm_col);
-
-
-                    if (min_norm_norm + y_kij <= 0){
-                        last_y_col_ptr[k] = min_norm_norm;
-                        //                        last_y_row_ptr[k] = min_norm_norm;
-                        out_bar_ptr[j] = min_norm_norm;
-                        outptr[j] = 0;
-                    }else{
-                        for (int q = 0; q < inch; q++)
-                        {
-                            const Mat& m = bottom_blob.channel(q);
-                            const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                            for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                            {
-                                float val = sptr[space_ofs[w_i]]; // 20.72
-                                float wt = kptr[w_i];
-                                y_kij += val * wt; // 41.45
-                            }
-
-                            kptr += maxk;
-                        }
-
-                        if (bias_term){
-                            out_bar_ptr[j] = y_kij - bias_data[k];
-                            last_y_col_ptr[k] = y_kij - bias_data[k];;
-                            //                            last_y_row_ptr[k] = y_kij - bias_data[k];;
-                        }else{
-                            out_bar_ptr[j] = y_kij;
-                            last_y_col_ptr[k] = y_kij;
-                            //                            last_y_row_ptr[k] = y_kij;
-                        }
-
-                        outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                    }
+                    const int kk = need[n];
+                    out_bar_ptrs[kk][p] = sums[kk];
+                    last_y_col_ptr[k0 + kk] = sums[kk];
+                    outptrs[kk][p] = activation_ss(sums[kk] + biases[kk], activation_type, activation_params);
                 }
-                //                last_y_row_ptr += outch;
             }
         }
-        //        fprintf(stderr, "%.4f/%.4f=%.4f\n", reduced_count, total_count, reduced_count/total_count);
-        //        fprintf(stderr, "%.4f/%.4f=%.4f <-\n", max_reduce_count, total_count, max_reduce_count/total_count);
+    }
 
-        //                fprintf(stderr, "%.2f\n",  reduced_count/total_count);
-        //        fprintf(stderr, "%.2f <-\n",  max_reduce_count/total_count);
+    last_x.clone_from(bottom_blob);
 
-        //        fprintf(stderr, "进入原有的:%.2f \t 进入我们的:%.2f\n",  mlsys_count/reduced_count, our_count/reduced_count);
+    count_skipped_outputs(stats, skipped_count, (double)size * outch, inch, maxk);
 
-        last_x.clone_from(bottom_blob); //没有这行是15899，加了是16058
-    }
     return 0;
 }
 
@@ -1977,12 +1820,14 @@ float find_max(const float* arr, int size){
     return max_2;
 }
 
-// 比较左边和上面
-static int spatial_convolution_lower_bound_first_one(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h,
-                               int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
-                               Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower)
+// the left and upper neighbours are the spatial reference, which serialises the scan
+// split the output rows into independent strips, each strip restarts its reference
+// on its first row and keeps its own neighbour state, so the strips run in parallel
+// w_norm2_lower drops the first weight, whose term is added exactly when it decreases y
+static int spatial_convolution_strips(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, const int* space_ofs, int maxk,
+                                      int stride_w, int stride_h, int activation_type, const Mat& activation_params, const Option& opt,
+                                      const Mat& w_norm2, const Mat& w_norm2_lower, Mat& last_y_col, Mat& last_y_row, LayerStats& stats)
 {
-    const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
 
     const int outw = top_blob.w;
@@ -1991,227 +1836,181 @@ static int spatial_convolution_lower_bound_first_one(const Mat& bottom_blob, Mat
 
     const int bias_term = bias_data.empty() ? 0 : 1;
 
-    const int maxk = kernel_w * kernel_h;
-
-    // kernel offsets
-    std::vector<int> _space_ofs(maxk);
-    int* space_ofs = &_space_ofs[0];
-    {
-        int p1 = 0;
-        int p2 = 0;
-        int gap = w * dilation_h - kernel_w * dilation_w;
-        for (int i = 0; i < kernel_h; i++)
-        {
-            for (int j = 0; j < kernel_w; j++)
-            {
-                space_ofs[p1] = p2;
-                p1++;
-                p2 += dilation_w;
-            }
-            p2 += gap;
-        }
-    }
-
-    //    Mat w_norm2 = Mat();
-    //    Mat last_y_col = Mat();
-    if (w_norm2.total() <= 0){
-        w_norm2.create(outch);
-        w_norm2_lower.create(outch);
-        last_y_col.create(outch);
-        last_y_row.create(outch, outw);         // outw是h
-        float* w_norm2_data_lower_ptr = (float*) w_norm2_lower.data;    // 去掉第0个元素
-        /**
-         * calculate w_norm2
-         */
-        float* w_norm2_data = (float*) w_norm2.data;
-        for (int k=0; k<outch; k++){
-            const float* kptr = (const float*)weight_data.data + maxk * inch * k;
-            w_norm2_data_lower_ptr[k] = kptr[0] * kptr[0];
-            w_norm2_data[k] = 0.0;
-            for (int q = 0; q < inch; q++){
-                for (int w_i = 0; w_i < maxk; w_i++){
-                    w_norm2_data[k] += kptr[w_i] * kptr[w_i];
-                }
-                kptr += maxk;
-            }
-
-//            float abs_max_2 = find_max((const float*)weight_data.data + maxk * inch * k, maxk*inch);
-
-            w_norm2_data_lower_ptr[k] = sqrt(w_norm2_data[k] -
-                                             w_norm2_data_lower_ptr[k]);
-//            w_norm2_data_lower_ptr[k] = sqrt(w_norm2_data[k] - abs_max_2);
-            w_norm2_data[k] = sqrt(w_norm2_data[k]);
-//            fprintf(stderr, "%f\n", w_norm2_data_lower_ptr[k]/ w_norm2_data[k]);
-        }
-//        fprintf(stderr, "\n");
-    }
-
-
-    float reduce = 0;
-    float total = 0;
+    const int nstrips = std::max(1, std::min(opt.num_threads, outh));
+    last_y_col.create(outch, nstrips);
+    last_y_row.create(outch, outw, nstrips);
+    if (last_y_col.empty() || last_y_row.empty())
+        return -100;
 
-    float min_norm_norm;
+    // the tiles of a strip are walked in order, the channel blocks of a tile reuse its packed input patches
+    const int patch_size = inch * maxk;
+    const int tile_size = sparse_tile_size(patch_size);
 
-    float norm_norm_col;
-    float delta_x_col;
+    Mat patches(patch_size * tile_size, 1, nstrips, 4u, opt.workspace_allocator);
+    if (patches.empty())
+        return -100;
 
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
+    const float* w_norm2_ptr = w_norm2;
+    const float* w_norm2_lower_ptr = w_norm2_lower;
 
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
+    // per strip counters, summed after the parallel region
+    std::vector<double> strip_skipped(nstrips, 0.0);
+    std::vector<double> strip_bound_time(nstrips, 0.0);
+    std::vector<double> strip_dot_time(nstrips, 0.0);
 
-    //    #pragma omp parallel for num_threads(opt.num_threads)
-    for (int i = 0; i < outh; i++)
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int s = 0; s < nstrips; s++)
     {
-        last_y_row_ptr = (float*)last_y_row.data;
-        for (int j = 0; j < outw; j++)
+        const int strip_y0 = outh * s / nstrips;
+        const int strip_y1 = outh * (s + 1) / nstrips;
+
+        float* patch_tile = patches.channel(s);
+        float* last_y_col_ptr = last_y_col.row(s);
+        Mat last_y_row_strip = last_y_row.channel(s);
+
+        for (int p0 = strip_y0 * outw; p0 < strip_y1 * outw; p0 += tile_size)
         {
-            float record_delta_xij_0 = 0; //    record i delta
-            delta_x_col = 0.0;
-            delta_x_row = 0.0;
-            if (j!=0){
-                /** 上一列的基准
-             * calculate ||x(i, j) - x(i, j-1)||
-             */
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+            const int p1 = std::min(p0 + tile_size, strip_y1 * outw);
 
-                    const float* prev_sptr = sptr - stride_w;
+            double bound_start = opt.use_layer_stats ? get_current_time() : 0.0;
 
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_col += delta * delta;
-                    }
-                }
-                delta_x_col = sqrt(delta_x_col);
-            }
+            // the bound phase computes all deltas of the tile before the dot product phase
+            float delta_x_cols[SPARSE_TILE_MAX];
+            float delta_x_rows[SPARSE_TILE_MAX];
+            float record_delta_xij_0s[SPARSE_TILE_MAX];
+            for (int p = p0; p < p1; p++)
+            {
+                const int i = p / outw;
+                const int j = p % outw;
+
+                /** 上一列的基准
+                 * calculate ||x(i, j) - x(i, j-1)||
+                 */
+                delta_x_cols[p - p0] = j != 0 ? patch_distance(bottom_blob, i, j, bottom_blob, i, j - 1, stride_w, stride_h, space_ofs, maxk) : 0.f;
 
-            if (i!=0){
                 /** 上一行的基准
-             * calculate ||x(i, j) - x(i-1, j)||
-             */
-                for (int q = 0; q < 1; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+                 * calculate ||x(i, j) - x(i-1, j)||
+                 */
+                delta_x_rows[p - p0] = i != strip_y0 ? patch_distance(bottom_blob, i, j, bottom_blob, i - 1, j, stride_w, stride_h, space_ofs, maxk) : 0.f;
+                record_delta_xij_0s[p - p0] = i != strip_y0 ? bottom_blob.channel(0).row(i * stride_h)[j * stride_w] - bottom_blob.channel(0).row((i - 1) * stride_h)[j * stride_w] : 0.f;
+            }
 
-                    const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
-                    for (int w_i = 0; w_i < 1; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        record_delta_xij_0 = delta;
-                        delta_x_row += delta * delta;
-                    }
+            double dot_start = opt.use_layer_stats ? get_current_time() : 0.0;
 
-                    for (int w_i = 1; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_row += delta * delta;
-                    }
-                }
-                for (int q = 1; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+            unsigned char packed[SPARSE_TILE_MAX] = {0};
 
-                    const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
+            for (int k0 = 0; k0 < outch; k0 += 4)
+            {
+                const int kn = std::min(4, outch - k0);
 
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_row += delta * delta;
-                    }
+                float* outptrs[4];
+                float biases[4];
+                for (int kk = 0; kk < kn; kk++)
+                {
+                    outptrs[kk] = top_blob.channel(k0 + kk);
+                    biases[kk] = bias_term ? bias_data[k0 + kk] : 0.f;
                 }
-                delta_x_row = sqrt(delta_x_row);
-            }
 
-            for (int k = 0; k < outch; k++)
-            {
-                float* outptr = top_blob.channel(k);
-                outptr += i * outw;
+                const float* kptr = (const float*)weight_data + patch_size * k0;
 
-                float y_kij = 0.f;
+                for (int p = p0; p < p1; p++)
+                {
+                    const int i = p / outw;
+                    const int j = p % outw;
 
-                if (bias_term)
-                    y_kij = bias_data[k];
+                    float* last_y_row_ptr = last_y_row_strip.row(j);
 
-                const float* kptr = (const float*)weight_data + maxk * inch * k;
+                    const float delta_x_col = delta_x_cols[p - p0];
+                    const float delta_x_row = delta_x_rows[p - p0];
 
-                total += 1;
+                    int need[4];
+                    int need_count = 0;
+                    for (int kk = 0; kk < kn; kk++)
+                    {
+                        const int k = k0 + kk;
 
-                if (j!=0){
-                    norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2[k];
-                    min_norm_norm = norm_norm_col;
-                }
+                        // the strip reference is computed exactly
+                        if (i == strip_y0 && j == 0)
+                        {
+                            need[need_count++] = kk;
+                            continue;
+                        }
 
-                if (i!=0){
-                    float temp = record_delta_xij_0 * kptr[0];
-                    if (temp <= 0)
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_lower[k] + temp;
-                    else
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2[k];
+                        float min_norm_norm = 0.f;
+                        if (j != 0)
+                            min_norm_norm = last_y_col_ptr[k] + delta_x_col * w_norm2_ptr[k];
 
-                    if(j!=0)
-                        min_norm_norm = std::min(norm_norm_row, min_norm_norm);
-                    else
-                        min_norm_norm = norm_norm_row;
-                }
+                        if (i != strip_y0)
+                        {
+                            const float temp = record_delta_xij_0s[p - p0] * kptr[patch_size * kk];
 
-                if ((i!=0||j!=0) && min_norm_norm + y_kij <= 0){
-                    last_y_col_ptr[k] = min_norm_norm;
-                    last_y_row_ptr[k] = min_norm_norm;
-                    outptr[j] = 0;
-                    reduce += 1;
-                }else{
-                    last_y_col_ptr[k] = -y_kij;
-                    last_y_row_ptr[k] = -y_kij;
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
+                            float norm_norm_row;
+                            if (w_norm2_lower_ptr && temp <= 0)
+                                norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_lower_ptr[k] + temp;
+                            else
+                                norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_ptr[k];
 
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
+                            min_norm_norm = j != 0 ? std::min(norm_norm_row, min_norm_norm) : norm_norm_row;
+                        }
 
+                        if (min_norm_norm + biases[kk] <= 0)
+                        {
+                            last_y_col_ptr[k] = min_norm_norm;
+                            last_y_row_ptr[k] = min_norm_norm;
+                            outptrs[kk][p] = 0;
+                            strip_skipped[s] += 1;
+                            continue;
                         }
-                        kptr += maxk;
+
+                        need[need_count++] = kk;
                     }
 
-                    last_y_col_ptr[k] += y_kij;
-                    last_y_row_ptr[k] += y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
+                    if (need_count == 0)
+                        continue;
+
+                    float sums[4];
+                    masked_dot_product(bottom_blob, p, p0, outw, stride_w, stride_h, space_ofs, maxk, patch_tile, packed, kptr, need, need_count, sums);
+
+                    for (int n = 0; n < need_count; n++)
+                    {
+                        const int kk = need[n];
+                        last_y_col_ptr[k0 + kk] = sums[kk];
+                        last_y_row_ptr[k0 + kk] = sums[kk];
+                        outptrs[kk][p] = activation_ss(sums[kk] + biases[kk], activation_type, activation_params);
+                    }
                 }
             }
-            last_y_row_ptr += outch;
-            //            last_y_row_ptr = (float*)((unsigned char*)last_y_row_ptr + (size_t)w * last_y_row.elemsize);
+
+            if (opt.use_layer_stats)
+            {
+                strip_bound_time[s] += dot_start - bound_start;
+                strip_dot_time[s] += get_current_time() - dot_start;
+            }
         }
     }
-    //    fprintf(stderr, "%f/%f=%.2f\n", reduce, total, reduce/total);
+
+    double skipped_count = 0.0;
+    for (int s = 0; s < nstrips; s++)
+    {
+        skipped_count += strip_skipped[s];
+        stats.bound_time += strip_bound_time[s];
+        stats.dot_time += strip_dot_time[s];
+    }
+    count_skipped_outputs(stats, skipped_count, (double)outw * outh * outch, inch, maxk);
+
     return 0;
 }
 
 // 比较左边和上面
-static int spatial_convolution_lower_bound_first_E(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h,
-                                                     int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
-                                                     Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower,
-                                                   Mat& all_select_norms, Mat& top_E_indices, Mat& top_E_w_vals)
+static int spatial_convolution_lower_bound_first_one(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h,
+                               int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
+                               Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower, LayerStats& stats)
 {
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
 
-    const int outw = top_blob.w;
-    const int outh = top_blob.h;
     const int outch = top_blob.c;
 
-    const int bias_term = bias_data.empty() ? 0 : 1;
-
     const int maxk = kernel_w * kernel_h;
 
     // kernel offsets
@@ -2233,13 +2032,9 @@ static int spatial_convolution_lower_bound_first_E(const Mat& bottom_blob, Mat&
         }
     }
 
-    //    Mat w_norm2 = Mat();
-    //    Mat last_y_col = Mat();
     if (w_norm2.total() <= 0){
         w_norm2.create(outch);
         w_norm2_lower.create(outch);
-        last_y_col.create(outch);
-        last_y_row.create(outch, outw);         // outw是h
         float* w_norm2_data_lower_ptr = (float*) w_norm2_lower.data;    // 去掉第0个元素
         /**
          * calculate w_norm2
@@ -2256,166 +2051,25 @@ static int spatial_convolution_lower_bound_first_E(const Mat& bottom_blob, Mat&
                 kptr += maxk;
             }
 
-            //            float abs_max_2 = find_max((const float*)weight_data.data + maxk * inch * k, maxk*inch);
-
-            w_norm2_data_lower_ptr[k] = sqrt(w_norm2_data[k] -
-                                             w_norm2_data_lower_ptr[k]);
-            //            w_norm2_data_lower_ptr[k] = sqrt(w_norm2_data[k] - abs_max_2);
+            w_norm2_data_lower_ptr[k] = sqrt(std::max(w_norm2_data[k] - w_norm2_data_lower_ptr[k], 0.f));
             w_norm2_data[k] = sqrt(w_norm2_data[k]);
-            //            fprintf(stderr, "%f\n", w_norm2_data_lower_ptr[k]/ w_norm2_data[k]);
         }
-        //        fprintf(stderr, "\n");
     }
 
+    return spatial_convolution_strips(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params, opt,
+                                      w_norm2, w_norm2_lower, last_y_col, last_y_row, stats);
+}
 
-    float reduce = 0;
-    float total = 0;
-
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
-
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
-
-    //    #pragma omp parallel for num_threads(opt.num_threads)
-    for (int i = 0; i < outh; i++)
-    {
-        last_y_row_ptr = (float*)last_y_row.data;
-        for (int j = 0; j < outw; j++)
-        {
-            float record_delta_xij_0 = 0; //    record i delta
-            delta_x_col = 0.0;
-            delta_x_row = 0.0;
-            if (j!=0){
-                /** 上一列的基准
-             * calculate ||x(i, j) - x(i, j-1)||
-             */
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const float* prev_sptr = sptr - stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_col += delta * delta;
-                    }
-                }
-                delta_x_col = sqrt(delta_x_col);
-            }
-
-            if (i!=0){
-                /** 上一行的基准
-             * calculate ||x(i, j) - x(i-1, j)||
-             */
-                for (int q = 0; q < 1; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
-                    for (int w_i = 0; w_i < 1; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        record_delta_xij_0 = delta;
-                        delta_x_row += delta * delta;
-                    }
-
-                    for (int w_i = 1; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_row += delta * delta;
-                    }
-                }
-                for (int q = 1; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_row += delta * delta;
-                    }
-                }
-                delta_x_row = sqrt(delta_x_row);
-            }
-
-            for (int k = 0; k < outch; k++)
-            {
-                float* outptr = top_blob.channel(k);
-                outptr += i * outw;
-
-                float y_kij = 0.f;
-
-                if (bias_term)
-                    y_kij = bias_data[k];
-
-                const float* kptr = (const float*)weight_data + maxk * inch * k;
-
-                total += 1;
-
-                if (j!=0){
-                    norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2[k];
-                    min_norm_norm = norm_norm_col;
-                }
-
-                if (i!=0){
-                    float temp = record_delta_xij_0 * kptr[0];
-                    if (temp <= 0)
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2_lower[k] + temp;
-                    else
-                        norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2[k];
-
-                    if(j!=0)
-                        min_norm_norm = std::min(norm_norm_row, min_norm_norm);
-                    else
-                        min_norm_norm = norm_norm_row;
-                }
-
-                if ((i!=0||j!=0) && min_norm_norm + y_kij <= 0){
-                    last_y_col_ptr[k] = min_norm_norm;
-                    last_y_row_ptr[k] = min_norm_norm;
-                    outptr[j] = 0;
-                    reduce += 1;
-                }else{
-                    last_y_col_ptr[k] = -y_kij;
-                    last_y_row_ptr[k] = -y_kij;
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
-
-                        }
-                        kptr += maxk;
-                    }
-
-                    last_y_col_ptr[k] += y_kij;
-                    last_y_row_ptr[k] += y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                }
-            }
-            last_y_row_ptr += outch;
-            //            last_y_row_ptr = (float*)((unsigned char*)last_y_row_ptr + (size_t)w * last_y_row.elemsize);
-        }
-    }
-    //    fprintf(stderr, "%f/%f=%.2f\n", reduce, total, reduce/total);
-    return 0;
+// 比较左边和上面
+// the top E selection is not used by the neighbour bound yet, the scan is the first_one scan
+static int spatial_convolution_lower_bound_first_E(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h,
+                                                     int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
+                                                     Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, Mat& w_norm2_lower,
+                                                   Mat& /*all_select_norms*/, Mat& /*top_E_indices*/, Mat& /*top_E_w_vals*/, LayerStats& stats)
+{
+    return spatial_convolution_lower_bound_first_one(bottom_blob, top_blob, weight_data, bias_data, kernel_w, kernel_h,
+                                                     stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                     w_norm2, last_y_col, last_y_row, w_norm2_lower, stats);
 }
 
 
@@ -2423,18 +2077,14 @@ static int spatial_convolution_lower_bound_first_E(const Mat& bottom_blob, Mat&
 // 比较左边和上面
 static int spatial_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h,
                                int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
-                               Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, float& last_sparsity, float& call_time)
+                               Mat& w_norm2, Mat& last_y_col, Mat& last_y_row, float& last_sparsity, float& call_time, LayerStats& stats)
 {
     call_time += 1;
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
 
-    const int outw = top_blob.w;
-    const int outh = top_blob.h;
     const int outch = top_blob.c;
 
-    const int bias_term = bias_data.empty() ? 0 : 1;
-
     const int maxk = kernel_w * kernel_h;
 
     // kernel offsets
@@ -2456,12 +2106,8 @@ static int spatial_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat&
         }
     }
 
-//    Mat w_norm2 = Mat();
-//    Mat last_y_col = Mat();
     if (w_norm2.total() <= 0){
         w_norm2.create(outch);
-        last_y_col.create(outch);
-        last_y_row.create(outch, outw);         // outw是h
         /**
          * calculate w_norm2
          */
@@ -2479,139 +2125,14 @@ static int spatial_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat&
         }
     }
 
-
-    float reduce = 0;
-    float total = 0;
-
-    float min_norm_norm;
-
-    float norm_norm_col;
-    float delta_x_col;
-
-    float norm_norm_row;    // i的norm norm
-    float delta_x_row;
-
-    float* last_y_row_ptr = nullptr;
-    float* last_y_col_ptr = (float*) last_y_col.data;
-
-        //    #pragma omp parallel for num_threads(opt.num_threads)
-    for (int i = 0; i < outh; i++)
-    {
-        last_y_row_ptr = (float*)last_y_row.data;
-        for (int j = 0; j < outw; j++)
-        {
-            delta_x_col = 0.0;
-            delta_x_row = 0.0;
-            if (j!=0){
-            /** 上一列的基准
-             * calculate ||x(i, j) - x(i, j-1)||
-             */
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const float* prev_sptr = sptr - stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_col += delta * delta;
-                    }
-                }
-                delta_x_col = sqrt(delta_x_col);
-            }
-
-            if (i!=0){
-            /** 上一行的基准
-             * calculate ||x(i, j) - x(i-1, j)||
-             */
-            for (int q = 0; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                    const float* prev_sptr = m.row((i-1) * stride_h) + j * stride_w;
-
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float delta = sptr[space_ofs[w_i]] - prev_sptr[space_ofs[w_i]];
-                        delta_x_row += delta * delta;
-                    }
-                }
-                delta_x_row = sqrt(delta_x_row);
-            }
-
-            for (int k = 0; k < outch; k++)
-            {
-                float* outptr = top_blob.channel(k);
-                outptr += i * outw;
-
-                float y_kij = 0.f;
-
-                if (bias_term)
-                    y_kij = bias_data[k];
-
-                const float* kptr = (const float*)weight_data + maxk * inch * k;
-
-                total += 1;
-
-                if (j!=0){
-                    norm_norm_col = last_y_col_ptr[k] + delta_x_col * w_norm2[k];
-                    min_norm_norm = norm_norm_col;
-                }
-
-                if (i!=0){
-                    norm_norm_row = last_y_row_ptr[k] + delta_x_row * w_norm2[k];
-                    if(j!=0)
-                        min_norm_norm = std::min(norm_norm_row, min_norm_norm);
-                    else
-                        min_norm_norm = norm_norm_row;
-                }
-
-                if ((i!=0||j!=0) && min_norm_norm + y_kij <= 0){
-                    last_y_col_ptr[k] = min_norm_norm;
-                    last_y_row_ptr[k] = min_norm_norm;
-                    outptr[j] = 0;
-//                    reduce += 2 * inch * maxk;
-                }else{
-                    last_y_col_ptr[k] = -y_kij;
-                    last_y_row_ptr[k] = -y_kij;
-                    for (int q = 0; q < inch; q++)
-                    {
-                        const Mat m = bottom_blob.channel(q);
-                        const float* sptr = m.row(i * stride_h) + j * stride_w;
-
-                        for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                        {
-                            float val = sptr[space_ofs[w_i]]; // 20.72
-                            float wt = kptr[w_i];
-                            y_kij += val * wt; // 41.45
-
-                        }
-                        kptr += maxk;
-                    }
-
-                    last_y_col_ptr[k] += y_kij;
-                    last_y_row_ptr[k] += y_kij;
-                    outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-                }
-            }
-            last_y_row_ptr += outch;
-//            last_y_row_ptr = (float*)((unsigned char*)last_y_row_ptr + (size_t)w * last_y_row.elemsize);
-        }
-    }
-//    if (last_sparsity < 0)
-//        last_sparsity = reduce;
-//    else
-//        last_sparsity = ((call_time - 1) * last_sparsity + reduce)/call_time;
-//    fprintf(stderr, "%.0f ", reduce);
-    return 0;
+    return spatial_convolution_strips(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params, opt,
+                                      w_norm2, Mat(), last_y_col, last_y_row, stats);
 }
 
 
 // 保留原来的convolution
-static int raw_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt)
+static int raw_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& weight_data, const Mat& bias_data, int kernel_w, int kernel_h, int stride_w, int stride_h, int dilation_w, int dilation_h, int activation_type, const Mat& activation_params, const Option& opt,
+                           const Mat& dirty_mask, LayerStats& stats)
 {
     const int w = bottom_blob.w;
     const int inch = bottom_blob.c;
@@ -2620,8 +2141,6 @@ static int raw_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& wei
     const int outh = top_blob.h;
     const int outch = top_blob.c;
 
-    const int bias_term = bias_data.empty() ? 0 : 1;
-
     const int maxk = kernel_w * kernel_h;
 
     // kernel offsets
@@ -2643,54 +2162,57 @@ static int raw_convolution(const Mat& bottom_blob, Mat& top_blob, const Mat& wei
         }
     }
 
-    //    #pragma omp parallel for num_threads(opt.num_threads)
-    double sparsity = 0.0;
-    double total = 0.0;
-    double flops = 0.0;
-    for (int i = 0; i < outh; i++)
-    {
-        for (int j = 0; j < outw; j++)
-        {
-            for (int k = 0; k < outch; k++)
-            {
-                float* outptr = top_blob.channel(k);
-                outptr += i * outw;
+    double dot_start = opt.use_layer_stats ? get_current_time() : 0.0;
 
-                float y_kij = 0.f;
+    double computed_count = 0.0;
+    double negative_count = 0.0;
+    int ret = tiled_convolution(bottom_blob, top_blob, weight_data, bias_data, space_ofs, maxk, stride_w, stride_h, activation_type, activation_params,
+                                dirty_mask, 0, opt, computed_count, negative_count);
+    if (ret != 0)
+        return ret;
 
-                if (bias_term)
-                    y_kij = bias_data[k];
+    // the clean tiles keep the previous frame
+    const double clean_count = (double)outw * outh * outch - computed_count;
 
-                const float* kptr = (const float*)weight_data + maxk * inch * k;
+    if (opt.use_layer_stats)
+        stats.dot_time += get_current_time() - dot_start;
+    stats.computed_outputs += computed_count;
+    stats.clean_outputs += clean_count;
+    stats.macs_avoided += clean_count * inch * maxk;
 
-                flops += inch*maxk;
-                for (int q = 0; q < inch; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    const float* sptr = m.row(i * stride_h) + j * stride_w;
+    return 0;
+}
 
-                    for (int w_i = 0; w_i < maxk; w_i++) // 29.23
-                    {
-                        float val = sptr[space_ofs[w_i]]; // 20.72
-                        float wt = kptr[w_i];
-                        y_kij += val * wt; // 41.45
-                    }
+void Convolution::reset_state()
+{
+    record1.release();
+    record2.release();
+    record3.release();
+    record4.release();
+    record5.release();
+    all_select_norms.release();
+    top_E_indices.release();
+    top_E_w_vals.release();
+    reuse_drift.release();
 
-                    kptr += maxk;
-                }
+    call_count = 0;
+    last_time_sparsity = -1;
+    refresh_count = 0;
 
-                if (y_kij <= 0){
-                    sparsity += 1;
-                }
-                total += 1;
+    state_w = 0;
+    state_h = 0;
+    state_c = 0;
+}
 
-                outptr[j] = activation_ss(y_kij, activation_type, activation_params);
-            }
-        }
-    }
-//    fprintf(stderr, "%f %f\n", flops, sparsity/total);
+int Convolution::forward_dense(const Mat& bottom_blob_bordered, Mat& top_blob, const Option& opt)
+{
+    return raw_convolution(bottom_blob_bordered, top_blob, weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, 0, Mat(), opt,
+                           Mat(), stats);
+}
 
-    return 0;
+static size_t mat_bytes(const Mat& m)
+{
+    return m.total() * m.elemsize;
 }
 
 int Convolution::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
@@ -2769,58 +2291,114 @@ int Convolution::forward(const Mat& bottom_blob, Mat& top_blob, const Option& op
     if (top_blob.empty())
         return -100;
 
+    // the temporal and spatial state is only valid for the input shape it was built on
+    // not every kernel keeps the input itself, so the shape is kept aside
+    if (state_w != w || state_h != h || state_c != bottom_blob_bordered.c)
+    {
+        reset_state();
+        state_w = w;
+        state_h = h;
+        state_c = bottom_blob_bordered.c;
+    }
+
     int ret;
-    if (opt.use_reserved_0){
-//    if (false){
-//        ret = our_convolution(bottom_blob_bordered, top_blob,
-//                              weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                              last_x, theta_thres, w_unit, w_norm, exact_compute);
-
-        ret = mlsys_convolution(bottom_blob_bordered, top_blob,
-                                weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-                            record1, record2, record3);
-
-//        ret = mlsys_convolution_lower_top_E(bottom_blob_bordered, top_blob,
-//                                weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                            record1, record2, record3, all_select_norms, top_E_indices, top_E_w_vals, record4);
-
-//    ret = change_temporal_spatial_convolution(bottom_blob_bordered, top_blob,
-//                                    weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                    record1, record2, record3, record4, record5, last_time_sparsity);
-
-//        ret = spatial_convolution(bottom_blob_bordered, top_blob,
-//                                  weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                          record1, record2, record3, last_time_sparsity, call_count);
-
-//        ret = spatial_convolution_lower_bound_first_one(bottom_blob_bordered, top_blob,
-//                                                weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                                record1, record2, record3, record4);
-
-//        ret = spatial_convolution_lower_bound_first_E(bottom_blob_bordered, top_blob,
-//                                                      weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                                      record1, record2, record3, record4, all_select_norms, top_E_indices, top_E_w_vals);
-
-//        ret = temporal_spatial_convolution(bottom_blob_bordered, top_blob,
-//                                  weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                  record1, record2, record3, record4, all_select_norms);
-
-//        ret = temporal_spatial_convolution_lower_bound(bottom_blob_bordered, top_blob,
-//                                  weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                  record1, record2, record3, record4, all_select_norms, top_E_indices);
-    }
-//    else if(opt.use_reserved_4){
-//        ret = temporal_spatial_convolution(bottom_blob_bordered, top_blob,
-//                                           weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
-//                                           record1, record2, record3, record4, all_select_norms);
-//    }
-    else{
+    if (opt.use_reserved_0)
+    {
+        // the bounds loosen over skipped frames, refresh_interval rebuilds them periodically
+        if (refresh_interval > 0 && refresh_count >= refresh_interval)
+        {
+            reset_state();
+            state_w = w;
+            state_h = h;
+            state_c = bottom_blob_bordered.c;
+        }
+        refresh_count++;
+
+        switch (temporal_kernel)
+        {
+        case 1:
+            ret = mlsys_convolution_lower_top_E(bottom_blob_bordered, top_blob,
+                                                weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                record1, record2, record3, all_select_norms, top_E_indices, top_E_w_vals, stats);
+            break;
+        case 2:
+            ret = temporal_spatial_convolution(bottom_blob_bordered, top_blob,
+                                               weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                               record1, record2, record3, record4, record5, stats);
+            break;
+        case 3:
+            ret = temporal_spatial_convolution_lower_bound(bottom_blob_bordered, top_blob,
+                                                           weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                           record1, record2, record3, record4, record5, all_select_norms, stats);
+            break;
+        case 4:
+            ret = change_temporal_spatial_convolution(bottom_blob_bordered, top_blob,
+                                                      weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                      record1, record2, record3, record4, record5, last_time_sparsity, stats);
+            break;
+        default:
+            if (record1.empty())
+            {
+                // first and refresh frames run the dense pipeline, the state is seeded from it
+                ret = forward_dense(bottom_blob_bordered, top_blob, opt);
+                if (ret != 0)
+                    return ret;
+            }
+            if (pool_kernel > 0 && activation_type == 1 && !record1.empty() && top_dirty_mask.empty() && !opt.use_dirty_region
+                    && !(opt.use_approximate_reuse && (reuse_error_abs > 0.f || reuse_error_rel > 0.f)))
+            {
+                ret = mlsys_convolution_maxpool(bottom_blob_bordered, top_blob,
+                                                weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h,
+                                                pool_kernel, pool_stride, pool_pad, opt,
+                                                record1, record2, record3, stats);
+                break;
+            }
+            ret = mlsys_convolution(bottom_blob_bordered, top_blob,
+                                    weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                    record1, record2, record3, top_dirty_mask,
+                                    reuse_drift, reuse_error_abs, reuse_error_rel, reuse_count, reuse_error_sum, reuse_error_max, stats);
+            break;
+        }
+    }
+    else if (activation_type == 1 && (sparse_mode == 2 || (sparse_mode < 0 && opt.use_spatial_sparsity)))
+    {
+        switch (spatial_kernel)
+        {
+        case 1:
+            ret = spatial_convolution_lower_bound_first_one(bottom_blob_bordered, top_blob,
+                                                            weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                            record1, record2, record3, record4, stats);
+            break;
+        case 2:
+            ret = spatial_convolution_lower_bound_first_E(bottom_blob_bordered, top_blob,
+                                                          weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                                          record1, record2, record3, record4, all_select_norms, top_E_indices, top_E_w_vals, stats);
+            break;
+        default:
+            ret = spatial_convolution(bottom_blob_bordered, top_blob,
+                                      weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                                      record1, record2, record3, last_time_sparsity, call_count, stats);
+            break;
+        }
+    }
+    else
+    {
         ret = raw_convolution(bottom_blob_bordered, top_blob,
-                              weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt);
-//        fprintf(stderr, "raw conv\n");
+                              weight_data, bias_data, kernel_w, kernel_h, stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt,
+                              top_dirty_mask, stats);
     }
     if (ret != 0)
         return ret;
 
+    // temporal and spatial state carried to the next frame
+    size_t state_bytes = mat_bytes(record1) + mat_bytes(record2) + mat_bytes(record3) + mat_bytes(record4) + mat_bytes(record5)
+                         + mat_bytes(all_select_norms) + mat_bytes(top_E_indices) + mat_bytes(top_E_w_vals) + mat_bytes(reuse_drift);
+    for (size_t i = 0; i < last_x_our.size(); i++)
+    {
+        state_bytes += mat_bytes(last_x_our[i]);
+    }
+    stats.state_bytes = state_bytes;
+
     return 0;
 }
 
@@ -2868,7 +2446,7 @@ int Convolution::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>&
         return -100;
 
     int ret = raw_convolution(bottom_blob_bordered, top_blob, weight_data_flattened, bias_data_flattened, _kernel_w, _kernel_h,
-                              stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt);
+                              stride_w, stride_h, dilation_w, dilation_h, activation_type, activation_params, opt, Mat(), stats);
     if (ret != 0)
         return ret;
 
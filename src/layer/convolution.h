@@ -34,10 +34,18 @@ public:
 
     virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt);
 
+    // drop the temporal and spatial state, the next frame is computed exactly
+    virtual void reset_state();
+
 protected:
     void make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const;
     void make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, int kernel_w, int kernel_h, const Option& opt) const;
 
+    // dense pre-activation output of the bordered fp32 input, unpacked
+    // the temporal state is seeded from it on the first and refresh frames
+    // arch layers override it with their optimized kernels
+    virtual int forward_dense(const Mat& bottom_blob_bordered, Mat& top_blob, const Option& opt);
+
 #if NCNN_INT8
     int forward_int8(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
 #endif
@@ -68,6 +76,33 @@ public:
 
     int dynamic_weight;
 
+    // approximate reuse budget, 0 = lossless only
+    // a positive output is reused while the bound accumulated since its last
+    // exact compute stays within reuse_error_abs + reuse_error_rel * y
+    float reuse_error_abs;
+    float reuse_error_rel;
+
+    // bound used to skip the relu outputs
+    // temporal 0=previous frame 1=previous frame with top E weights 2=previous frame and neighbours
+    //          3=previous frame and neighbours with first weight 4=neighbours on sparse frames
+    // spatial  0=neighbours 1,2=neighbours with first weight
+    int temporal_kernel;
+    int spatial_kernel;
+
+    // -1=follow the options 0=dense 1=temporal 2=spatial
+    int sparse_mode;
+
+    // rebuild the temporal state every refresh_interval frames, 0=never
+    int refresh_interval;
+
+    // the max pooling window consuming the relu output, 0=none
+    // pool_pad -233=SAME_UPPER -234=SAME_LOWER
+    // the temporal kernel skips the outputs bounded below their window max,
+    // those hold the bound instead of the exact value
+    int pool_kernel;
+    int pool_stride;
+    int pool_pad;
+
     // model
     Mat weight_data;
     Mat bias_data;
@@ -77,6 +112,7 @@ public:
     Mat record2;
     Mat record3;
     Mat record4;
+    Mat record5;
     Mat all_select_norms;
     Mat top_E_indices;
     Mat top_E_w_vals;
@@ -91,6 +127,20 @@ public:
 
     std::vector<Mat> last_x_our;
 
+    // frames since the temporal state was built
+    int refresh_count;
+
+    // bordered input shape the temporal and spatial state was built on
+    int state_w;
+    int state_h;
+    int state_c;
+
+    // approximate reuse state and error accounting
+    Mat reuse_drift;
+    double reuse_count;
+    double reuse_error_sum; // sum of the error bounds of the reused outputs
+    float reuse_error_max;
+
 #if NCNN_INT8
     Mat weight_data_int8_scales;
     Mat bottom_blob_int8_scales;
@@ -16,6 +16,8 @@
 
 #include "fused_activation.h"
 
+#include <string.h>
+
 namespace ncnn {
 
 Convolution1D::Convolution1D()
@@ -39,12 +41,15 @@ int Convolution1D::load_param(const ParamDict& pd)
     activation_params = pd.get(10, Mat());
 
     dynamic_weight = pd.get(19, 0);
+    streaming = pd.get(20, 0);
 
     if (dynamic_weight)
     {
         one_blob_only = false;
     }
 
+    reset_state();
+
     return 0;
 }
 
@@ -125,6 +130,13 @@ static int convolution1d(const Mat& bottom_blob, Mat& top_blob, const Mat& weigh
 
 int Convolution1D::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (is_stream_skipped(bottom_blob))
+    {
+        // the stride jumps over the whole chunk, no window starts in it
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     Mat bottom_blob_bordered;
     make_padding(bottom_blob, bottom_blob_bordered, opt);
     if (bottom_blob_bordered.empty())
@@ -135,7 +147,14 @@ int Convolution1D::forward(const Mat& bottom_blob, Mat& top_blob, const Option&
 
     const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
+
+    if (outw == 0)
+    {
+        // no window completes, the whole chunk becomes streaming context
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
 
     top_blob.create(outw, num_output, elemsize, opt.blob_allocator);
     if (top_blob.empty())
@@ -145,7 +164,7 @@ int Convolution1D::forward(const Mat& bottom_blob, Mat& top_blob, const Option&
     if (ret != 0)
         return ret;
 
-    return 0;
+    return update_stream_context(bottom_blob, opt);
 }
 
 int Convolution1D::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
@@ -181,7 +200,13 @@ int Convolution1D::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat
 
     const int kernel_extent_w = dilation_w * (_kernel_w - 1) + 1;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
+
+    if (outw == 0)
+    {
+        top_blob.release();
+        return 0;
+    }
 
     top_blob.create(outw, _num_output, elemsize, opt.blob_allocator);
     if (top_blob.empty())
@@ -194,6 +219,145 @@ int Convolution1D::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat
     return 0;
 }
 
+void Convolution1D::reset_state()
+{
+    stream_context.release();
+    stream_skip = 0;
+    stream_started = false;
+}
+
+bool Convolution1D::is_stream_start(const Mat& bottom_blob) const
+{
+    const Mat& context = stream_context;
+
+    if (!stream_started)
+        return true;
+
+    return !context.empty() && (context.h != bottom_blob.h || context.elemsize != bottom_blob.elemsize || context.elempack != bottom_blob.elempack);
+}
+
+bool Convolution1D::is_stream_skipped(const Mat& bottom_blob) const
+{
+    if (!streaming || dynamic_weight || is_stream_start(bottom_blob))
+        return false;
+
+    return stream_skip >= bottom_blob.w;
+}
+
+void Convolution1D::make_streaming_input(const Mat& bottom_blob, Mat& bottom_blob_bordered, int kernel_extent_w, const Option& opt) const
+{
+    const Mat& context = stream_context;
+
+    Option opt_b = opt;
+    opt_b.blob_allocator = opt.workspace_allocator;
+
+    if (is_stream_start(bottom_blob))
+    {
+        // a new stream is causal, the left context is padding
+        copy_make_border(bottom_blob, bottom_blob_bordered, 0, 0, kernel_extent_w - 1, 0, BORDER_CONSTANT, pad_value, opt_b);
+    }
+    else if (stream_skip > 0)
+    {
+        // the next window starts inside this chunk, the context is empty
+        copy_cut_border(bottom_blob, bottom_blob_bordered, 0, 0, stream_skip, 0, opt_b);
+    }
+    else if (context.empty())
+    {
+        bottom_blob_bordered = bottom_blob;
+    }
+    else
+    {
+        // the unconsumed columns of the previous chunk followed by this chunk
+        bottom_blob_bordered.create(context.w + bottom_blob.w, bottom_blob.h, bottom_blob.elemsize, bottom_blob.elempack, opt_b.blob_allocator);
+        if (bottom_blob_bordered.empty())
+            return;
+
+        const size_t context_size = context.w * context.elemsize;
+        const size_t size = bottom_blob.w * bottom_blob.elemsize;
+        for (int i = 0; i < bottom_blob.h; i++)
+        {
+            unsigned char* outptr = (unsigned char*)bottom_blob_bordered.data + (context_size + size) * i;
+            memcpy(outptr, (const unsigned char*)context.data + context_size * i, context_size);
+            memcpy(outptr + context_size, (const unsigned char*)bottom_blob.data + size * i, size);
+        }
+    }
+}
+
+int Convolution1D::update_stream_context(const Mat& bottom_blob, const Option& opt)
+{
+    if (!streaming || dynamic_weight)
+        return 0;
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+
+    // the columns make_streaming_input put in front of the chunk, then the chunk
+    // past the columns the stride jumped over
+    Mat context = stream_context;
+    const Mat& chunk = bottom_blob;
+    int skip = 0;
+    if (is_stream_start(bottom_blob))
+    {
+        // only the padding columns, the chunk itself is never bordered again
+        context.release();
+        if (kernel_extent_w > 1)
+        {
+            context.create(kernel_extent_w - 1, chunk.h, chunk.elemsize, chunk.elempack, opt.workspace_allocator);
+            if (context.empty())
+                return -100;
+
+            // fill every packed lane
+            Mat lanes(context.w * context.h * context.elempack, context.data, context.elemsize / context.elempack);
+            if (chunk.elembits() == 16)
+                lanes.fill(support_fp16_storage && opt.use_fp16_storage ? float32_to_float16(pad_value) : float32_to_bfloat16(pad_value));
+            else
+                lanes.fill(pad_value);
+        }
+    }
+    else
+    {
+        skip = std::min(stream_skip, chunk.w);
+    }
+
+    const int context_w = context.empty() ? 0 : context.w;
+    const int w = context_w + chunk.w - skip;
+
+    // keep the columns from the first window of the next chunk on
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
+    const int consumed = outw * stride_w;
+
+    stream_started = true;
+    stream_skip = stream_skip - skip + std::max(consumed - w, 0);
+
+    if (consumed >= w)
+    {
+        stream_context.release();
+        return 0;
+    }
+
+    const size_t elemsize = chunk.elemsize;
+
+    Mat next_context;
+    next_context.create(w - consumed, chunk.h, elemsize, chunk.elempack);
+    if (next_context.empty())
+        return -100;
+
+    const int context_start = std::min(consumed, context_w);
+    const int chunk_start = std::max(consumed - context_w, 0) + skip;
+    const size_t context_size = (context_w - context_start) * elemsize;
+    const size_t chunk_size = (chunk.w - chunk_start) * elemsize;
+    for (int i = 0; i < chunk.h; i++)
+    {
+        unsigned char* outptr = (unsigned char*)next_context.data + (context_size + chunk_size) * i;
+        if (context_size)
+            memcpy(outptr, (const unsigned char*)context.data + (context_w * i + context_start) * elemsize, context_size);
+        memcpy(outptr + context_size, (const unsigned char*)chunk.data + (chunk.w * i + chunk_start) * elemsize, chunk_size);
+    }
+
+    stream_context = next_context;
+
+    return 0;
+}
+
 void Convolution1D::make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const
 {
     make_padding(bottom_blob, bottom_blob_bordered, kernel_w, opt);
@@ -205,6 +369,12 @@ void Convolution1D::make_padding(const Mat& bottom_blob, Mat& bottom_blob_border
 
     const int kernel_extent_w = dilation_w * (_kernel_w - 1) + 1;
 
+    if (streaming && !dynamic_weight)
+    {
+        make_streaming_input(bottom_blob, bottom_blob_bordered, kernel_extent_w, opt);
+        return;
+    }
+
     bottom_blob_bordered = bottom_blob;
     if (pad_left > 0 || pad_right > 0)
     {
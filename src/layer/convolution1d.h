@@ -34,9 +34,23 @@ public:
 
     virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt);
 
+    // drop the left context, the next chunk starts a new stream
+    virtual void reset_state();
+
 protected:
     void make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const;
     void make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, int kernel_w, const Option& opt) const;
+    void make_streaming_input(const Mat& bottom_blob, Mat& bottom_blob_bordered, int kernel_extent_w, const Option& opt) const;
+
+    // whether the chunk starts a new stream, with padding as left context
+    bool is_stream_start(const Mat& bottom_blob) const;
+
+    // whether a stride longer than the kernel extent jumps over the whole chunk
+    bool is_stream_skipped(const Mat& bottom_blob) const;
+
+    // keep the columns of the chunk that no output has consumed yet
+    // called at the end of forward, after make_padding has read the old context
+    int update_stream_context(const Mat& bottom_blob, const Option& opt);
 
 public:
     // param
@@ -57,9 +71,19 @@ public:
 
     int dynamic_weight;
 
+    // causal streaming, each forward takes the next chunk of the sequence
+    // and emits the outputs whose window ends in that chunk
+    int streaming;
+
     // model
     Mat weight_data;
     Mat bias_data;
+
+    // streaming state, the input columns not yet consumed by any output
+    // and the columns the stride still has to jump before the next window
+    Mat stream_context;
+    int stream_skip;
+    bool stream_started;
 };
 
 } // namespace ncnn
@@ -16,6 +16,8 @@
 
 #include "fused_activation.h"
 
+#include <string.h>
+
 namespace ncnn {
 
 Convolution3D::Convolution3D()
@@ -47,6 +49,9 @@ int Convolution3D::load_param(const ParamDict& pd)
     weight_data_size = pd.get(6, 0);
     activation_type = pd.get(9, 0);
     activation_params = pd.get(10, Mat());
+    sliding_window = pd.get(20, 0);
+
+    reset_state();
 
     return 0;
 }
@@ -69,6 +74,9 @@ int Convolution3D::load_model(const ModelBin& mb)
 
 int Convolution3D::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (sliding_window)
+        return forward_sliding_window(bottom_blob, top_blob, opt);
+
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int d = bottom_blob.d;
@@ -169,6 +177,291 @@ int Convolution3D::forward(const Mat& bottom_blob, Mat& top_blob, const Option&
     return 0;
 }
 
+void Convolution3D::reset_state()
+{
+    last_bottom_blob.release();
+    slice_sums.clear();
+    slice_taps.clear();
+}
+
+static bool same_slice(const Mat& a, int za, const Mat& b, int zb)
+{
+    const size_t size = (size_t)a.w * a.h * a.elemsize;
+    for (int q = 0; q < a.c; q++)
+    {
+        if (memcmp((const float*)a.channel(q).depth(za), (const float*)b.channel(q).depth(zb), size) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// how many slices the window advanced since the previous input, -1 for no shared slice
+static int find_window_shift(const Mat& bottom_blob, const Mat& last_bottom_blob)
+{
+    if (last_bottom_blob.empty())
+        return -1;
+
+    if (last_bottom_blob.dims != bottom_blob.dims || last_bottom_blob.w != bottom_blob.w || last_bottom_blob.h != bottom_blob.h
+            || last_bottom_blob.d != bottom_blob.d || last_bottom_blob.c != bottom_blob.c || last_bottom_blob.elemsize != bottom_blob.elemsize)
+        return -1;
+
+    const int d = bottom_blob.d;
+    for (int shift = 0; shift < d; shift++)
+    {
+        bool shared = true;
+        for (int z = 0; z + shift < d; z++)
+        {
+            if (!same_slice(bottom_blob, z, last_bottom_blob, z + shift))
+            {
+                shared = false;
+                break;
+            }
+        }
+
+        if (shared)
+            return shift;
+    }
+
+    return -1;
+}
+
+int Convolution3D::forward_sliding_window(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
+{
+    const int d0 = bottom_blob.d;
+    const int channels = bottom_blob.c;
+    size_t elemsize = bottom_blob.elemsize;
+
+    const int kernel_extend_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extend_h = dilation_h * (kernel_h - 1) + 1;
+    const int kernel_extend_d = dilation_d * (kernel_d - 1) + 1;
+
+    Mat bottom_blob_bordered;
+    Option opt_pad = opt;
+    opt_pad.use_packing_layout = false;
+    make_padding(bottom_blob, bottom_blob_bordered, opt_pad);
+    if (bottom_blob_bordered.empty())
+        return -100;
+
+    const int w = bottom_blob_bordered.w;
+    const int h = bottom_blob_bordered.h;
+    const int d = bottom_blob_bordered.d;
+
+    const int outw = (w - kernel_extend_w) / stride_w + 1;
+    const int outh = (h - kernel_extend_h) / stride_h + 1;
+    const int outd = (d - kernel_extend_d) / stride_d + 1;
+
+    // padded slices in front of the first input slice
+    int front = 0;
+    if (d > d0)
+    {
+        if (pad_front > 0)
+            front = pad_front;
+        else if (pad_front == -233 || pad_front == -234)
+            front = (d - d0) / 2;
+    }
+
+    const int maxk2 = kernel_w * kernel_h;
+    const int maxk = maxk2 * kernel_d;
+
+    // kernel offsets within one slice
+    std::vector<int> _space_ofs(maxk2);
+    int* space_ofs = &_space_ofs[0];
+    {
+        int p1 = 0;
+        int p2 = 0;
+        int gap = w * dilation_h - kernel_w * dilation_w;
+        for (int i = 0; i < kernel_h; i++)
+        {
+            for (int j = 0; j < kernel_w; j++)
+            {
+                space_ofs[p1] = p2;
+                p1++;
+                p2 += dilation_w;
+            }
+            p2 += gap;
+        }
+    }
+
+    // slices shared with the previous window keep their partial sums
+    int shift = find_window_shift(bottom_blob, last_bottom_blob);
+    if ((int)slice_sums.size() != d0 || (!slice_sums.empty() && (slice_sums[0].w != outw || slice_sums[0].h != outh)))
+        shift = -1;
+
+    std::vector<Mat> sums(d0);
+    std::vector<unsigned char> taps_ready(d0 * kernel_d, 0);
+    double reused_taps = 0;
+    for (int t = 0; t < d0; t++)
+    {
+        const int bt = t + front;
+
+        Mat& m = sums[t];
+        unsigned char* ready = &taps_ready[t * kernel_d];
+        if (shift >= 0 && t + shift < d0)
+        {
+            m = slice_sums[t + shift];
+            memcpy(ready, &slice_taps[(t + shift) * kernel_d], kernel_d);
+        }
+        else
+        {
+            // kept across calls, not from the workspace allocator
+            m.create(outw, outh, kernel_d * num_output, elemsize);
+            if (m.empty())
+                return -100;
+        }
+
+        // the kernel depth taps reaching this slice from some output depth
+        // a slice moving along the window may need taps it did not need before
+        std::vector<int> taps;
+        for (int kz = 0; kz < kernel_d; kz++)
+        {
+            const int zz = bt - kz * dilation_d;
+            if (zz < 0 || zz % stride_d != 0 || zz / stride_d >= outd)
+                continue;
+
+            if (ready[kz])
+                reused_taps += 1;
+            else
+                taps.push_back(kz);
+
+            ready[kz] = 1;
+        }
+
+        const int ntaps = (int)taps.size();
+        if (ntaps == 0)
+            continue;
+
+        #pragma omp parallel for num_threads(opt.num_threads)
+        for (int p = 0; p < num_output; p++)
+        {
+            for (int k = 0; k < ntaps; k++)
+            {
+                const int kz = taps[k];
+
+                float* outptr = m.channel(p * kernel_d + kz);
+
+                for (int i = 0; i < outh; i++)
+                {
+                    for (int j = 0; j < outw; j++)
+                    {
+                        float sum = 0.f;
+
+                        const float* kptr = (const float*)weight_data + maxk * channels * p + maxk2 * kz;
+
+                        for (int q = 0; q < channels; q++)
+                        {
+                            const Mat m2 = bottom_blob_bordered.channel(q);
+                            const float* sptr = m2.depth(bt).row(i * stride_h) + j * stride_w;
+
+                            for (int l = 0; l < maxk2; l++)
+                            {
+                                sum += sptr[space_ofs[l]] * kptr[l];
+                            }
+
+                            kptr += maxk;
+                        }
+
+                        outptr[j] = sum;
+                    }
+
+                    outptr += outw;
+                }
+            }
+        }
+    }
+
+    // a padded slice is pad_value everywhere
+    std::vector<float> pad_sums(num_output * kernel_d, 0.f);
+    if (pad_value != 0.f)
+    {
+        for (int p = 0; p < num_output; p++)
+        {
+            for (int kz = 0; kz < kernel_d; kz++)
+            {
+                const float* kptr = (const float*)weight_data + maxk * channels * p + maxk2 * kz;
+
+                float wsum = 0.f;
+                for (int q = 0; q < channels; q++)
+                {
+                    for (int l = 0; l < maxk2; l++)
+                    {
+                        wsum += kptr[l];
+                    }
+
+                    kptr += maxk;
+                }
+
+                pad_sums[p * kernel_d + kz] = wsum * pad_value;
+            }
+        }
+    }
+
+    top_blob.create(outw, outh, outd, num_output, elemsize, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    const int size = outw * outh;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int p = 0; p < num_output; p++)
+    {
+        float* outptr = top_blob.channel(p);
+
+        std::vector<const float*> sptrs;
+        sptrs.reserve(kernel_d);
+
+        for (int z = 0; z < outd; z++)
+        {
+            float bias = bias_term ? bias_data[p] : 0.f;
+
+            sptrs.clear();
+            for (int kz = 0; kz < kernel_d; kz++)
+            {
+                const int t = z * stride_d + kz * dilation_d - front;
+                if (t < 0 || t >= d0)
+                    bias += pad_sums[p * kernel_d + kz];
+                else
+                    sptrs.push_back(sums[t].channel(p * kernel_d + kz));
+            }
+
+            const int n = (int)sptrs.size();
+            for (int i = 0; i < size; i++)
+            {
+                float sum = bias;
+                for (int k = 0; k < n; k++)
+                {
+                    sum += sptrs[k][i];
+                }
+
+                outptr[i] = activation_ss(sum, activation_type, activation_params);
+            }
+
+            outptr += size;
+        }
+    }
+
+    // keep a copy, the caller may recycle the input blob
+    last_bottom_blob = bottom_blob.clone();
+    if (last_bottom_blob.empty())
+        return -100;
+
+    slice_sums.swap(sums);
+    slice_taps.swap(taps_ready);
+
+    const double tap_macs = (double)size * num_output * channels * maxk2;
+    stats.computed_outputs += (double)size * outd * num_output;
+    stats.macs_avoided += reused_taps * tap_macs;
+
+    size_t state_bytes = last_bottom_blob.total() * last_bottom_blob.elemsize;
+    for (int t = 0; t < d0; t++)
+    {
+        state_bytes += slice_sums[t].total() * slice_sums[t].elemsize;
+    }
+    stats.state_bytes = state_bytes;
+
+    return 0;
+}
+
 void Convolution3D::make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const
 {
     int w = bottom_blob.w;
@@ -30,9 +30,14 @@ public:
 
     virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt);
 
+    // drop the cached slice partial sums, the next window is computed in full
+    virtual void reset_state();
+
 protected:
     void make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const;
 
+    int forward_sliding_window(const Mat& bottom_blob, Mat& top_blob, const Option& opt);
+
 public:
     // param
     int num_output;
@@ -59,8 +64,20 @@ public:
     int activation_type;
     Mat activation_params;
 
+    // the input is a window of frames advancing along depth between calls
+    // the partial sums of the slices shared with the previous window are reused
+    int sliding_window;
+
     Mat weight_data;
     Mat bias_data;
+
+    // sliding window state
+    // the previous input and the partial sums of each input slice
+    // slice_sums[t] holds kernel_d planes per output channel
+    // only the depth taps flagged in slice_taps[t * kernel_d + kz] are filled
+    Mat last_bottom_blob;
+    std::vector<Mat> slice_sums;
+    std::vector<unsigned char> slice_taps;
 };
 
 } // namespace ncnn
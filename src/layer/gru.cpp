@@ -29,6 +29,11 @@ int GRU::load_param(const ParamDict& pd)
     num_output = pd.get(0, 0);
     weight_data_size = pd.get(1, 0);
     direction = pd.get(2, 0);
+    streaming = pd.get(20, 0);
+    delta_threshold = pd.get(21, 0.f);
+
+    reset_state();
+
     return 0;
 }
 
@@ -162,6 +167,15 @@ static int gru(const Mat& bottom_blob, Mat& top_blob, int reverse, const Mat& we
 
 int GRU::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (streaming && direction == 0)
+    {
+        std::vector<Mat> bottom_blobs(1, bottom_blob);
+        std::vector<Mat> top_blobs(1);
+        int ret = forward(bottom_blobs, top_blobs, opt);
+        top_blob = top_blobs[0];
+        return ret;
+    }
+
     int T = bottom_blob.h;
 
     int num_directions = direction == 2 ? 2 : 1;
@@ -227,7 +241,29 @@ int GRU::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blo
 
     Mat hidden;
     Allocator* hidden_allocator = top_blobs.size() == 2 ? opt.blob_allocator : opt.workspace_allocator;
-    if (bottom_blobs.size() == 2)
+    const bool stream = streaming && direction == 0 && bottom_blobs.size() == 1;
+    if (stream)
+    {
+        if (delta_threshold > 0.f)
+        {
+            int ret = forward_delta(bottom_blob, top_blobs[0], opt);
+            if (ret != 0)
+                return ret;
+
+            if (top_blobs.size() == 2)
+            {
+                top_blobs[1] = stream_hidden.clone(opt.blob_allocator);
+            }
+
+            return 0;
+        }
+
+        // continue from the state left by the previous call
+        int ret = get_stream_state(hidden);
+        if (ret != 0)
+            return ret;
+    }
+    else if (bottom_blobs.size() == 2)
     {
         hidden = bottom_blobs[1].clone(hidden_allocator);
     }
@@ -286,9 +322,172 @@ int GRU::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blo
 
     if (top_blobs.size() == 2)
     {
-        top_blobs[1] = hidden;
+        top_blobs[1] = stream ? hidden.clone(opt.blob_allocator) : hidden;
+    }
+
+    return 0;
+}
+
+void GRU::reset_state()
+{
+    stream_hidden.release();
+    delta_x.release();
+    delta_h.release();
+    delta_gates.release();
+}
+
+int GRU::get_stream_state(Mat& hidden)
+{
+    if (stream_hidden.empty())
+    {
+        // a new sequence, kept across calls, not from the workspace allocator
+        stream_hidden.create(num_output, 1);
+        if (stream_hidden.empty())
+            return -100;
+        stream_hidden.fill(0.f);
+    }
+
+    hidden = stream_hidden;
+
+    return 0;
+}
+
+int GRU::forward_delta(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
+{
+    const int size = bottom_blob.w;
+    const int T = bottom_blob.h;
+
+    Mat hidden;
+    int ret = get_stream_state(hidden);
+    if (ret != 0)
+        return ret;
+
+    const Mat weight_xc = weight_xc_data.channel(0);
+    const Mat bias_c = bias_c_data.channel(0);
+    const Mat weight_hc = weight_hc_data.channel(0);
+
+    if (delta_x.w != size || delta_gates.empty())
+    {
+        // nothing propagated yet, the pre-activations are the bias
+        // rows R U WN BN match the bias rows
+        delta_x.create(size);
+        delta_h.create(num_output);
+        delta_gates.create(num_output, 4);
+        if (delta_x.empty() || delta_h.empty() || delta_gates.empty())
+            return -100;
+
+        delta_x.fill(0.f);
+        delta_h.fill(0.f);
+        memcpy(delta_gates, bias_c, num_output * 4 * sizeof(float));
     }
 
+    top_blob.create(num_output, T, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    std::vector<int> x_index;
+    std::vector<float> x_delta;
+    std::vector<int> h_index;
+    std::vector<float> h_delta;
+    x_index.reserve(size);
+    x_delta.reserve(size);
+    h_index.reserve(num_output);
+    h_delta.reserve(num_output);
+
+    double skipped_count = 0;
+    for (int t = 0; t < T; t++)
+    {
+        // the changes beyond the threshold since they were last propagated
+        const float* x = bottom_blob.row(t);
+        float* x_last = delta_x;
+        x_index.clear();
+        x_delta.clear();
+        for (int i = 0; i < size; i++)
+        {
+            const float d = x[i] - x_last[i];
+            if (fabs(d) > delta_threshold)
+            {
+                x_index.push_back(i);
+                x_delta.push_back(d);
+                x_last[i] = x[i];
+            }
+        }
+
+        float* h_last = delta_h;
+        h_index.clear();
+        h_delta.clear();
+        for (int i = 0; i < num_output; i++)
+        {
+            const float d = hidden[i] - h_last[i];
+            if (fabs(d) > delta_threshold)
+            {
+                h_index.push_back(i);
+                h_delta.push_back(d);
+                h_last[i] = hidden[i];
+            }
+        }
+
+        const int x_count = (int)x_index.size();
+        const int h_count = (int)h_index.size();
+        skipped_count += size - x_count + num_output - h_count;
+
+        // R U += W_xc * dx_t + W_hc * dh_t
+        // WN += W_xn * dx_t
+        // BN += W_hn * dh_t
+        #pragma omp parallel for num_threads(opt.num_threads)
+        for (int q = 0; q < num_output; q++)
+        {
+            for (int g = 0; g < 3; g++)
+            {
+                const float* weight_xc_g = weight_xc.row(num_output * g + q);
+                const float* weight_hc_g = weight_hc.row(num_output * g + q);
+
+                float xsum = 0.f;
+                for (int k = 0; k < x_count; k++)
+                {
+                    xsum += weight_xc_g[x_index[k]] * x_delta[k];
+                }
+
+                float hsum = 0.f;
+                for (int k = 0; k < h_count; k++)
+                {
+                    hsum += weight_hc_g[h_index[k]] * h_delta[k];
+                }
+
+                if (g < 2)
+                {
+                    delta_gates.row(g)[q] += xsum + hsum;
+                }
+                else
+                {
+                    delta_gates.row(2)[q] += xsum;
+                    delta_gates.row(3)[q] += hsum;
+                }
+            }
+        }
+
+        // h_t := (1 - update) .* new + update .* h_{t-1}
+        float* output_data = top_blob.row(t);
+        for (int q = 0; q < num_output; q++)
+        {
+            float R = delta_gates.row(0)[q];
+            float U = delta_gates.row(1)[q];
+
+            R = 1.f / (1.f + exp(-R));
+            U = 1.f / (1.f + exp(-U));
+
+            float N = tanh(delta_gates.row(2)[q] + R * delta_gates.row(3)[q]);
+
+            float H = (1 - U) * N + U * hidden[q];
+
+            hidden[q] = H;
+            output_data[q] = H;
+        }
+    }
+
+    stats.macs_avoided += skipped_count * 3 * num_output;
+    stats.state_bytes = (stream_hidden.total() + delta_x.total() + delta_h.total() + delta_gates.total()) * sizeof(float);
+
     return 0;
 }
 
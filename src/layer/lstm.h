@@ -32,14 +32,40 @@ public:
 
     virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt);
 
+    // drop the hidden and cell state, the next call starts a new sequence
+    virtual void reset_state();
+
+protected:
+    // the hidden and cell state left by the previous call
+    int get_stream_state(Mat& hidden, Mat& cell);
+
+    int forward_delta(const Mat& bottom_blob, Mat& top_blob, const Option& opt);
+
 public:
     int num_output;
     int weight_data_size;
     int direction; // 0=forward 1=reverse 2=bidirectional
 
+    // keep the hidden and cell state across forward calls, forward direction only
+    int streaming;
+
+    // streaming as a delta network, input and hidden changes
+    // within the threshold are not propagated, 0 = off
+    float delta_threshold;
+
     Mat weight_hc_data;
     Mat weight_xc_data;
     Mat bias_c_data;
+
+    // streaming state
+    Mat stream_hidden;
+    Mat stream_cell;
+
+    // delta network state
+    // the last propagated input and hidden, the gate pre-activations they give
+    Mat delta_x;
+    Mat delta_h;
+    Mat delta_gates;
 };
 
 } // namespace ncnn
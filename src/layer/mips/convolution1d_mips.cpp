@@ -88,6 +88,13 @@ int Convolution1D_mips::destroy_pipeline(const Option& /*opt*/)
 
 int Convolution1D_mips::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (is_stream_skipped(bottom_blob))
+    {
+        // the stride jumps over the whole chunk, no window starts in it
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     size_t elemsize = bottom_blob.elemsize;
@@ -112,9 +119,16 @@ int Convolution1D_mips::forward(const Mat& bottom_blob, Mat& top_blob, const Opt
 #endif
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, the whole chunk becomes streaming context
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -306,7 +320,7 @@ int Convolution1D_mips::forward(const Mat& bottom_blob, Mat& top_blob, const Opt
         }
     }
 
-    return 0;
+    return update_stream_context(bottom_blob, opt);
 }
 
 int Convolution1D_mips::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
@@ -24,6 +24,7 @@ Pooling::Pooling()
 {
     one_blob_only = true;
     support_inplace = false;
+    support_dirty_region = true;
 }
 
 int Pooling::load_param(const ParamDict& pd)
@@ -204,6 +205,10 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 
     const int maxk = kernel_w * kernel_h;
 
+    // clean tiles already hold this frame when computing dirty region only
+    const unsigned char* dirty_ptr = top_dirty_mask;
+    const int dirty_w = top_dirty_mask.w;
+
     // kernel offsets
     std::vector<int> _space_ofs(maxk);
     int* space_ofs = &_space_ofs[0];
@@ -235,6 +240,9 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
             {
                 for (int j = 0; j < outw; j++)
                 {
+                    if (dirty_ptr && !dirty_ptr[(i / NCNN_DIRTY_TILE_SIZE) * dirty_w + j / NCNN_DIRTY_TILE_SIZE])
+                        continue;
+
                     const float* sptr = m.row(i * stride_h) + j * stride_w;
 
                     float max = sptr[0];
@@ -277,6 +285,9 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 
                     for (int j = 0; j < outw; j++)
                     {
+                        if (dirty_ptr && !dirty_ptr[(i / NCNN_DIRTY_TILE_SIZE) * dirty_w + j / NCNN_DIRTY_TILE_SIZE])
+                            continue;
+
                         int sx0 = j * stride_w;
 
                         float sum = 0;
@@ -327,6 +338,9 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
                 {
                     for (int j = 0; j < outw; j++)
                     {
+                        if (dirty_ptr && !dirty_ptr[(i / NCNN_DIRTY_TILE_SIZE) * dirty_w + j / NCNN_DIRTY_TILE_SIZE])
+                            continue;
+
                         const float* sptr = m.row(i * stride_h) + j * stride_w;
 
                         float sum = 0;
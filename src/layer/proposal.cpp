@@ -14,6 +14,8 @@
 
 #include "proposal.h"
 
+#include "nms.h"
+
 #include <math.h>
 
 namespace ncnn {
@@ -97,101 +99,6 @@ struct Rect
     float y2;
 };
 
-static inline float intersection_area(const Rect& a, const Rect& b)
-{
-    if (a.x1 > b.x2 || a.x2 < b.x1 || a.y1 > b.y2 || a.y2 < b.y1)
-    {
-        // no intersection
-        return 0.f;
-    }
-
-    float inter_width = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
-    float inter_height = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
-
-    return inter_width * inter_height;
-}
-
-template<typename T>
-static void qsort_descent_inplace(std::vector<T>& datas, std::vector<float>& scores, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = scores[(left + right) / 2];
-
-    while (i <= j)
-    {
-        while (scores[i] > p)
-            i++;
-
-        while (scores[j] < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(datas[i], datas[j]);
-            std::swap(scores[i], scores[j]);
-
-            i++;
-            j--;
-        }
-    }
-
-    if (left < j)
-        qsort_descent_inplace(datas, scores, left, j);
-
-    if (i < right)
-        qsort_descent_inplace(datas, scores, i, right);
-}
-
-template<typename T>
-static void qsort_descent_inplace(std::vector<T>& datas, std::vector<float>& scores)
-{
-    if (datas.empty() || scores.empty())
-        return;
-
-    qsort_descent_inplace(datas, scores, 0, static_cast<int>(scores.size() - 1));
-}
-
-static void nms_sorted_bboxes(const std::vector<Rect>& bboxes, std::vector<size_t>& picked, float nms_threshold)
-{
-    picked.clear();
-
-    const size_t n = bboxes.size();
-
-    std::vector<float> areas(n);
-    for (size_t i = 0; i < n; i++)
-    {
-        const Rect& r = bboxes[i];
-
-        float width = r.x2 - r.x1;
-        float height = r.y2 - r.y1;
-
-        areas[i] = width * height;
-    }
-
-    for (size_t i = 0; i < n; i++)
-    {
-        const Rect& a = bboxes[i];
-
-        int keep = 1;
-        for (size_t j = 0; j < picked.size(); j++)
-        {
-            const Rect& b = bboxes[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            //             float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
-
-        if (keep)
-            picked.push_back(i);
-    }
-}
-
 int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
 {
     const Mat& score_blob = bottom_blobs[0];
@@ -315,21 +222,22 @@ int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     }
 
     // sort all (proposal, score) pairs by score from highest to lowest
-    qsort_descent_inplace(proposal_boxes, scores);
-
     // take top pre_nms_topN
-    if (pre_nms_topN > 0 && pre_nms_topN < (int)proposal_boxes.size())
+    std::vector<int> order;
+    sort_descent_topk(scores.data(), (int)scores.size(), 1, pre_nms_topN, order);
+
+    std::vector<Rect> sorted_boxes(order.size());
+    for (size_t i = 0; i < order.size(); i++)
     {
-        proposal_boxes.resize(pre_nms_topN);
-        scores.resize(pre_nms_topN);
+        sorted_boxes[i] = proposal_boxes[order[i]];
     }
 
     // apply nms with nms_thresh
-    std::vector<size_t> picked;
-    nms_sorted_bboxes(proposal_boxes, picked, nms_thresh);
-
     // take after_nms_topN
-    int picked_count = std::min((int)picked.size(), after_nms_topN);
+    std::vector<int> picked;
+    nms_sorted_bboxes((const float*)sorted_boxes.data(), (int)sorted_boxes.size(), sizeof(Rect) / sizeof(float), 0, 0, nms_thresh, picked, after_nms_topN);
+
+    int picked_count = (int)picked.size();
 
     // return the top proposals
     Mat& roi_blob = top_blobs[0];
@@ -341,10 +249,10 @@ int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     {
         float* outptr = roi_blob.channel(i);
 
-        outptr[0] = proposal_boxes[picked[i]].x1;
-        outptr[1] = proposal_boxes[picked[i]].y1;
-        outptr[2] = proposal_boxes[picked[i]].x2;
-        outptr[3] = proposal_boxes[picked[i]].y2;
+        outptr[0] = sorted_boxes[picked[i]].x1;
+        outptr[1] = sorted_boxes[picked[i]].y1;
+        outptr[2] = sorted_boxes[picked[i]].x2;
+        outptr[3] = sorted_boxes[picked[i]].y2;
     }
 
     if (top_blobs.size() > 1)
@@ -357,7 +265,7 @@ int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
         for (int i = 0; i < picked_count; i++)
         {
             float* outptr = roi_score_blob.channel(i);
-            outptr[0] = scores[picked[i]];
+            outptr[0] = scores[order[picked[i]]];
         }
     }
 
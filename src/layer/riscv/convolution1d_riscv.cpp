@@ -109,15 +109,23 @@ int Convolution1D_riscv::destroy_pipeline(const Option& /*opt*/)
 
 int Convolution1D_riscv::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (is_stream_skipped(bottom_blob))
+    {
+        // the stride jumps over the whole chunk, no window starts in it
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     int elembits = bottom_blob.elembits();
 
 #if __riscv_vector && __riscv_zfh
     if (opt.use_fp16_storage && elembits == 16)
     {
-        if (opt.use_fp16_arithmetic)
-            return forward_fp16sa(bottom_blob, top_blob, opt);
-        else
-            return forward_fp16s(bottom_blob, top_blob, opt);
+        int ret = opt.use_fp16_arithmetic ? forward_fp16sa(bottom_blob, top_blob, opt) : forward_fp16s(bottom_blob, top_blob, opt);
+        if (ret != 0)
+            return ret;
+
+        return update_stream_context(bottom_blob, opt);
     }
 #endif
 
@@ -150,9 +158,16 @@ int Convolution1D_riscv::forward(const Mat& bottom_blob, Mat& top_blob, const Op
 #endif
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, the whole chunk becomes streaming context
+        top_blob.release();
+        return update_stream_context(bottom_blob, opt);
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -337,7 +352,7 @@ int Convolution1D_riscv::forward(const Mat& bottom_blob, Mat& top_blob, const Op
         }
     }
 
-    return 0;
+    return update_stream_context(bottom_blob, opt);
 }
 
 int Convolution1D_riscv::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
@@ -500,9 +515,16 @@ int Convolution1D_riscv::forward_fp16s(const Mat& bottom_blob, Mat& top_blob, co
     int out_elempack = (opt.use_packing_layout && num_output % packn == 0) ? packn : 1;
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, forward keeps the whole chunk as streaming context
+        top_blob.release();
+        return 0;
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -721,9 +743,16 @@ int Convolution1D_riscv::forward_fp16sa(const Mat& bottom_blob, Mat& top_blob, c
     int out_elempack = (opt.use_packing_layout && num_output % packn == 0) ? packn : 1;
     size_t out_elemsize = elemsize / elempack * out_elempack;
 
-    const int outw = (w - kernel_extent_w) / stride_w + 1;
+    const int outw = w >= kernel_extent_w ? (w - kernel_extent_w) / stride_w + 1 : 0;
     const int outh = num_output / out_elempack;
 
+    if (outw == 0)
+    {
+        // no window completes, forward keeps the whole chunk as streaming context
+        top_blob.release();
+        return 0;
+    }
+
     top_blob.create(outw, outh, out_elemsize, out_elempack, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
@@ -217,6 +217,14 @@ GRU_riscv::GRU_riscv()
 
 int GRU_riscv::create_pipeline(const Option& opt)
 {
+    if (streaming && direction == 0)
+    {
+        // the stateful streaming runs the reference implementation in fp32
+        support_fp16_storage = false;
+        support_bf16_storage = false;
+        return 0;
+    }
+
 #if __riscv_vector && __riscv_zfh
     if (opt.use_fp16_storage && opt.use_fp16_arithmetic)
         return create_pipeline_fp16sa(opt);
@@ -227,6 +235,9 @@ int GRU_riscv::create_pipeline(const Option& opt)
 
 int GRU_riscv::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return GRU::forward(bottom_blob, top_blob, opt);
+
     int elembits = bottom_blob.elembits();
 #if __riscv_vector
 
@@ -301,6 +312,9 @@ int GRU_riscv::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 
 int GRU_riscv::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
 {
+    if (streaming && direction == 0)
+        return GRU::forward(bottom_blobs, top_blobs, opt);
+
     const Mat& bottom_blob = bottom_blobs[0];
     int elembits = bottom_blob.elembits();
 
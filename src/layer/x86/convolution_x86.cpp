@@ -107,6 +107,7 @@ Convolution_x86::Convolution_x86()
 
     activation = 0;
     convolution_dilation1 = 0;
+    convolution_dense = 0;
 }
 
 static void convolution_transform_kernel_packed_sse(const Mat& weight_data, Mat& weight_data_packed, int num_input, int num_output, int kernel_w, int kernel_h, int elempack, int out_elempack)
@@ -145,6 +146,40 @@ static void convolution_transform_kernel_packed_sse(const Mat& weight_data, Mat&
     }
 }
 
+bool Convolution_x86::use_convolution_dense(const Option& opt) const
+{
+    return activation_type == 1 && temporal_kernel == 0 && (sparse_mode == 1 || (sparse_mode < 0 && opt.use_temporal_sparsity && !opt.use_spatial_sparsity));
+}
+
+Layer* Convolution_x86::create_convolution_dense() const
+{
+    Layer* op = ncnn::create_layer(ncnn::LayerType::Convolution);
+
+    // set param, the input comes bordered
+    ncnn::ParamDict pd;
+    pd.set(0, num_output); // num_output
+    pd.set(1, kernel_w);
+    pd.set(11, kernel_h);
+    pd.set(2, dilation_w);
+    pd.set(12, dilation_h);
+    pd.set(3, stride_w);
+    pd.set(13, stride_h);
+    pd.set(5, bias_term);
+    pd.set(6, weight_data_size);
+    pd.set(24, 0); // dense
+
+    op->load_param(pd);
+
+    // set weights
+    ncnn::Mat weights[2];
+    weights[0] = weight_data;
+    weights[1] = bias_data;
+
+    op->load_model(ModelBinFromMatArray(weights));
+
+    return op;
+}
+
 int Convolution_x86::create_pipeline(const Option& opt)
 {
     if (dynamic_weight)
@@ -159,6 +194,17 @@ int Convolution_x86::create_pipeline(const Option& opt)
     }
 #endif
 
+    // the temporal relu layers keep a dense pipeline without activation
+    // the first and refresh frames run it instead of the reference convolution
+    // and a plain forward runs it followed by relu, so no other transform is kept
+    if (use_convolution_dense(opt))
+    {
+        convolution_dense = create_convolution_dense();
+        convolution_dense->create_pipeline(opt);
+
+        return 0;
+    }
+
     int kernel_size = kernel_w * kernel_h;
     int num_input = weight_data_size / kernel_size / num_output;
 
@@ -503,6 +549,127 @@ int Convolution_x86::destroy_pipeline(const Option& opt)
         convolution_dilation1 = 0;
     }
 
+    if (convolution_dense)
+    {
+        convolution_dense->destroy_pipeline(opt);
+        delete convolution_dense;
+        convolution_dense = 0;
+    }
+
+    return 0;
+}
+
+int Convolution_x86::save_pipeline(std::vector<Mat>& mats) const
+{
+    // the dilation pipeline is not exported
+    if (dynamic_weight || convolution_dilation1)
+        return -1;
+
+    Mat signature(10, (size_t)4u);
+    int* p = signature;
+    p[0] = num_output;
+    p[1] = kernel_w;
+    p[2] = kernel_h;
+    p[3] = dilation_w;
+    p[4] = dilation_h;
+    p[5] = stride_w;
+    p[6] = stride_h;
+    p[7] = weight_data_size;
+    p[8] = 0;
+    p[9] = convolution_dense ? 1 : 0;
+
+    mats.push_back(signature);
+    mats.push_back(weight_sgemm_data);
+    mats.push_back(weight_data_3x3_winograd23);
+    mats.push_back(weight_3x3_winograd42_data);
+    mats.push_back(weight_3x3_winograd64_data);
+    mats.push_back(weight_data_packed);
+
+#if NCNN_INT8
+    mats.push_back(weight_data_int8);
+    mats.push_back(weight_data_3x3_winograd23_int8);
+
+    // the weight quantized at runtime
+    if (weight_data.elemsize == (size_t)1u)
+    {
+        mats.push_back(weight_data);
+        mats.push_back(weight_data_int8_scales);
+    }
+#endif // NCNN_INT8
+
+    // the mats of the nested dense pipeline follow
+    p[8] = (int)mats.size();
+
+    if (convolution_dense)
+    {
+        std::vector<Mat> dense_mats;
+        if (convolution_dense->save_pipeline(dense_mats) != 0)
+            return -1;
+
+        mats.insert(mats.end(), dense_mats.begin(), dense_mats.end());
+    }
+
+    return 0;
+}
+
+int Convolution_x86::load_pipeline(const std::vector<Mat>& mats, const Option& opt)
+{
+#if NCNN_INT8
+    const size_t mat_count = 8;
+#else
+    const size_t mat_count = 6;
+#endif
+
+    if (dynamic_weight || mats.size() < mat_count || mats[0].w != 10 || mats[0].elemsize != 4u)
+        return -1;
+
+    const int* p = mats[0];
+    if (p[0] != num_output || p[1] != kernel_w || p[2] != kernel_h || p[3] != dilation_w || p[4] != dilation_h || p[5] != stride_w || p[6] != stride_h || p[7] != weight_data_size)
+        return -1;
+
+    const size_t own_count = (size_t)p[8];
+    if (own_count < mat_count || own_count > mats.size())
+        return -1;
+
+#if NCNN_INT8
+    const bool int8_weight = opt.use_int8_inference && (weight_data.elemsize == (size_t)1u || own_count == mat_count + 2);
+#else
+    const bool int8_weight = false;
+#endif
+    const bool dense = !int8_weight && use_convolution_dense(opt);
+    if (dense != (p[9] == 1))
+        return -1;
+
+    activation = create_activation_layer(activation_type, activation_params, opt);
+
+    weight_sgemm_data = mats[1];
+    weight_data_3x3_winograd23 = mats[2];
+    weight_3x3_winograd42_data = mats[3];
+    weight_3x3_winograd64_data = mats[4];
+    weight_data_packed = mats[5];
+
+#if NCNN_INT8
+    weight_data_int8 = mats[6];
+    weight_data_3x3_winograd23_int8 = mats[7];
+
+    if (own_count == mat_count + 2)
+    {
+        weight_data = mats[8];
+        weight_data_int8_scales = mats[9];
+    }
+#endif // NCNN_INT8
+
+    if (dense)
+    {
+        convolution_dense = create_convolution_dense();
+
+        std::vector<Mat> dense_mats(mats.begin() + own_count, mats.end());
+        if (convolution_dense->load_pipeline(dense_mats, opt) != 0)
+        {
+            convolution_dense->create_pipeline(opt);
+        }
+    }
+
     return 0;
 }
 
@@ -523,6 +690,42 @@ int Convolution_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option
         return Convolution::forward(bottom_blob, top_blob, opt);
     }
 
+    // the sparse relu paths keep their state in the reference layout
+    if (activation_type == 1 && (opt.use_reserved_0 || sparse_mode == 2 || (sparse_mode < 0 && opt.use_spatial_sparsity)))
+    {
+        if (bottom_blob.elempack == 1)
+            return Convolution::forward(bottom_blob, top_blob, opt);
+
+        Option opt_unpack = opt;
+        opt_unpack.blob_allocator = opt.workspace_allocator;
+
+        Mat bottom_blob_unpacked;
+        convert_packing(bottom_blob, bottom_blob_unpacked, 1, opt_unpack);
+        if (bottom_blob_unpacked.empty())
+            return -100;
+
+        return Convolution::forward(bottom_blob_unpacked, top_blob, opt);
+    }
+
+    if (convolution_dense)
+    {
+        Mat bottom_blob_bordered;
+        make_padding(bottom_blob, bottom_blob_bordered, opt);
+        if (bottom_blob_bordered.empty())
+            return -100;
+
+        int ret = convolution_dense->forward(bottom_blob_bordered, top_blob, opt);
+        if (ret != 0)
+            return ret;
+
+        if (activation)
+        {
+            activation->forward_inplace(top_blob, opt);
+        }
+
+        return 0;
+    }
+
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
@@ -1088,6 +1291,50 @@ int Convolution_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option
     return 0;
 }
 
+int Convolution_x86::forward_dense(const Mat& bottom_blob_bordered, Mat& top_blob, const Option& opt)
+{
+    if (!convolution_dense)
+        return Convolution::forward_dense(bottom_blob_bordered, top_blob, opt);
+
+    const int num_input = bottom_blob_bordered.c;
+
+    int elempack = 1;
+#if __SSE2__
+    if (opt.use_packing_layout && convolution_dense->support_packing)
+    {
+#if __AVX__
+        elempack = num_input % 8 == 0 ? 8 : num_input % 4 == 0 ? 4 : 1;
+#else
+        elempack = num_input % 4 == 0 ? 4 : 1;
+#endif
+    }
+#endif // __SSE2__
+
+    Mat bottom_blob_packed = bottom_blob_bordered;
+    if (elempack != 1)
+    {
+        Option opt_pack = opt;
+        opt_pack.blob_allocator = opt.workspace_allocator;
+
+        convert_packing(bottom_blob_bordered, bottom_blob_packed, elempack, opt_pack);
+        if (bottom_blob_packed.empty())
+            return -100;
+    }
+
+    Mat top_blob_packed;
+    int ret = convolution_dense->forward(bottom_blob_packed, top_blob_packed, opt);
+    if (ret != 0)
+        return ret;
+
+    convert_packing(top_blob_packed, top_blob, 1, opt);
+    if (top_blob.empty())
+        return -100;
+
+    stats.computed_outputs += (double)top_blob.w * top_blob.h * top_blob.c;
+
+    return 0;
+}
+
 int Convolution_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
 {
     const Mat& bottom_blob = bottom_blobs[0];
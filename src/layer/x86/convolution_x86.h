@@ -27,6 +27,9 @@ public:
     virtual int create_pipeline(const Option& opt);
     virtual int destroy_pipeline(const Option& opt);
 
+    virtual int save_pipeline(std::vector<Mat>& mats) const;
+    virtual int load_pipeline(const std::vector<Mat>& mats, const Option& opt);
+
     virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt);
 
     virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt);
@@ -38,6 +41,11 @@ protected:
 #endif
     int forwardDilation_x86(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
 
+    virtual int forward_dense(const Mat& bottom_blob_bordered, Mat& top_blob, const Option& opt);
+
+    bool use_convolution_dense(const Option& opt) const;
+    Layer* create_convolution_dense() const;
+
 public:
     Layer* activation;
 
@@ -50,6 +58,9 @@ public:
     // forwardDilation
     Layer* convolution_dilation1;
 
+    // pre-activation pipeline seeding the temporal state
+    Layer* convolution_dense;
+
     // pack4/8
     Mat weight_data_packed;
 
@@ -0,0 +1,409 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "deconvolution_x86.h"
+
+#if __SSE2__
+#include <emmintrin.h>
+#if __SSE4_1__
+#include <smmintrin.h>
+#if __AVX__
+#include <immintrin.h>
+#endif
+#endif // __SSE4_1__
+#endif // __SSE2__
+#include "x86_activation.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+#include "convolution_sgemm.h"
+
+#if __SSE2__
+#include "convolution_sgemm_pack4.h"
+#include "convolution_sgemm_pack1to4.h"
+#include "convolution_sgemm_pack4to1.h"
+
+#if __AVX__
+#include "convolution_sgemm_pack8.h"
+#include "convolution_sgemm_pack4to8.h"
+#include "convolution_sgemm_pack1to8.h"
+#include "convolution_sgemm_pack8to4.h"
+#include "convolution_sgemm_pack8to1.h"
+#endif
+#endif // __SSE2__
+
+Deconvolution_x86::Deconvolution_x86()
+{
+#if __SSE2__
+    support_packing = true;
+#endif // __SSE2__
+
+    activation = 0;
+}
+
+static int deconvolution_elempack(int channels, const Option& opt)
+{
+#if __SSE2__
+    if (opt.use_packing_layout)
+    {
+#if __AVX__
+        return channels % 8 == 0 ? 8 : channels % 4 == 0 ? 4 : 1;
+#else
+        return channels % 4 == 0 ? 4 : 1;
+#endif
+    }
+#endif // __SSE2__
+
+    (void)channels;
+    (void)opt;
+    return 1;
+}
+
+static void deconvolution_im2col_sgemm_transform_kernel(const Mat& kernel, Mat& kernel_tm, int inch, int outch, int elempack, int out_elempack)
+{
+#if __SSE2__
+#if __AVX__
+    if (elempack == 8 && out_elempack == 8)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack8_avx(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 4 && out_elempack == 8)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack4to8_avx(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 1 && out_elempack == 8)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack1to8_avx(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 8 && out_elempack == 4)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack8to4_avx(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 8 && out_elempack == 1)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack8to1_avx(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+#endif // __AVX__
+    if (elempack == 4 && out_elempack == 4)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack4_sse(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 1 && out_elempack == 4)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack1to4_sse(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+    if (elempack == 4 && out_elempack == 1)
+    {
+        convolution_im2col_sgemm_transform_kernel_pack4to1_sse(kernel, kernel_tm, inch, outch, 1, 1);
+        return;
+    }
+#endif // __SSE2__
+
+    convolution_im2col_sgemm_transform_kernel_sse(kernel, kernel_tm, inch, outch, 1, 1);
+}
+
+static void deconvolution_im2col_sgemm(const Mat& bottom_im2col, Mat& top_blob, const Mat& kernel, const Option& opt)
+{
+    const int elempack = bottom_im2col.elempack;
+    const int out_elempack = top_blob.elempack;
+
+    // the bias is added in col2im
+    Mat bias;
+
+#if __SSE2__
+#if __AVX__
+    if (elempack == 8 && out_elempack == 8)
+    {
+        im2col_sgemm_pack8_avx(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 4 && out_elempack == 8)
+    {
+        im2col_sgemm_pack4to8_avx(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 1 && out_elempack == 8)
+    {
+        im2col_sgemm_pack1to8_avx(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 8 && out_elempack == 4)
+    {
+        im2col_sgemm_pack8to4_avx(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 8 && out_elempack == 1)
+    {
+        im2col_sgemm_pack8to1_avx(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+#endif // __AVX__
+    if (elempack == 4 && out_elempack == 4)
+    {
+        im2col_sgemm_pack4_sse(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 1 && out_elempack == 4)
+    {
+        im2col_sgemm_pack1to4_sse(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+    if (elempack == 4 && out_elempack == 1)
+    {
+        im2col_sgemm_pack4to1_sse(bottom_im2col, top_blob, kernel, bias, opt);
+        return;
+    }
+#endif // __SSE2__
+
+    im2col_sgemm_sse(bottom_im2col, top_blob, kernel, bias, opt);
+}
+
+// scatter add the gemm result of input rows [i0, i0 + rows) to the output
+// col channel k * outch + p holds kernel offset k of output channel p
+static void deconvolution_col2im(const Mat& col, Mat& top_blob, int w, int i0, int rows, int kernel_w, int kernel_h, int dilation_w, int dilation_h, int stride_w, int stride_h, const Option& opt)
+{
+    const int outch = top_blob.c;
+    const int out_elempack = top_blob.elempack;
+    const int maxk = kernel_w * kernel_h;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int p = 0; p < outch; p++)
+    {
+        Mat out = top_blob.channel(p);
+
+        for (int k = 0; k < maxk; k++)
+        {
+            const int kx = k % kernel_w;
+            const int ky = k / kernel_w;
+
+            const float* sptr = col.channel(k * outch + p);
+
+            for (int i = 0; i < rows; i++)
+            {
+                float* outptr = out.row((i0 + i) * stride_h + ky * dilation_h) + kx * dilation_w * out_elempack;
+
+#if __SSE2__
+#if __AVX__
+                if (out_elempack == 8)
+                {
+                    for (int j = 0; j < w; j++)
+                    {
+                        _mm256_storeu_ps(outptr, _mm256_add_ps(_mm256_loadu_ps(outptr), _mm256_loadu_ps(sptr)));
+                        outptr += stride_w * 8;
+                        sptr += 8;
+                    }
+                    continue;
+                }
+#endif // __AVX__
+                if (out_elempack == 4)
+                {
+                    for (int j = 0; j < w; j++)
+                    {
+                        _mm_storeu_ps(outptr, _mm_add_ps(_mm_loadu_ps(outptr), _mm_loadu_ps(sptr)));
+                        outptr += stride_w * 4;
+                        sptr += 4;
+                    }
+                    continue;
+                }
+#endif // __SSE2__
+                for (int j = 0; j < w; j++)
+                {
+                    outptr[0] += sptr[0];
+                    outptr += stride_w;
+                    sptr += 1;
+                }
+            }
+        }
+    }
+}
+
+int Deconvolution_x86::create_pipeline(const Option& opt)
+{
+    activation = create_activation_layer(activation_type, activation_params, opt);
+
+    if (!opt.use_sgemm_convolution)
+        return 0;
+
+    const int maxk = kernel_w * kernel_h;
+    const int num_input = weight_data_size / maxk / num_output;
+
+    const int elempack = deconvolution_elempack(num_input, opt);
+    const int out_elempack = deconvolution_elempack(num_output, opt);
+
+    // src = kw-kh-inch-outch
+    // dst = inch-outch-kw-kh, row k * outch + p
+    // so that a packed row block holds consecutive output channels of the same kernel offset
+    Mat weight_data_r(num_input * num_output * maxk);
+    if (weight_data_r.empty())
+        return -100;
+
+    {
+        const float* kptr = weight_data;
+        float* ptr = weight_data_r;
+
+        for (int k = 0; k < maxk; k++)
+        {
+            for (int p = 0; p < num_output; p++)
+            {
+                for (int q = 0; q < num_input; q++)
+                {
+                    *ptr++ = kptr[(p * num_input + q) * maxk + k];
+                }
+            }
+        }
+    }
+
+    deconvolution_im2col_sgemm_transform_kernel(weight_data_r, weight_sgemm_data, num_input, maxk * num_output, elempack, out_elempack);
+    if (weight_sgemm_data.empty())
+        return -100;
+
+    return 0;
+}
+
+int Deconvolution_x86::destroy_pipeline(const Option& opt)
+{
+    if (activation)
+    {
+        activation->destroy_pipeline(opt);
+        delete activation;
+        activation = 0;
+    }
+
+    return 0;
+}
+
+int Deconvolution_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
+{
+    if (!weight_sgemm_data.empty())
+        return forward_sgemm(bottom_blob, top_blob, opt);
+
+    // reference scatter without packing
+    Mat bottom_blob_unpacked = bottom_blob;
+    if (bottom_blob.elempack != 1)
+    {
+        Option opt_pack1 = opt;
+        opt_pack1.blob_allocator = opt.workspace_allocator;
+
+        convert_packing(bottom_blob, bottom_blob_unpacked, 1, opt_pack1);
+        if (bottom_blob_unpacked.empty())
+            return -100;
+    }
+
+    return Deconvolution::forward(bottom_blob_unpacked, top_blob, opt);
+}
+
+int Deconvolution_x86::forward_sgemm(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    const int maxk = kernel_w * kernel_h;
+    const int num_input = weight_data_size / maxk / num_output;
+
+    const int elempack = deconvolution_elempack(num_input, opt);
+    const int out_elempack = deconvolution_elempack(num_output, opt);
+
+    Mat bottom_blob_packed = bottom_blob;
+    if (bottom_blob.elempack != elempack)
+    {
+        Option opt_pack = opt;
+        opt_pack.blob_allocator = opt.workspace_allocator;
+
+        convert_packing(bottom_blob, bottom_blob_packed, elempack, opt_pack);
+        if (bottom_blob_packed.empty())
+            return -100;
+    }
+
+    const int w = bottom_blob_packed.w;
+    const int h = bottom_blob_packed.h;
+    const int channels = bottom_blob_packed.c;
+    const size_t elemsize = bottom_blob_packed.elemsize;
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    const int outw = (w - 1) * stride_w + kernel_extent_w + output_pad_right;
+    const int outh = (h - 1) * stride_h + kernel_extent_h + output_pad_bottom;
+    const size_t out_elemsize = elemsize / elempack * out_elempack;
+
+    Mat top_blob_bordered;
+    if (pad_left > 0 || pad_right > 0 || pad_top > 0 || pad_bottom > 0 || (output_w > 0 && output_h > 0))
+    {
+        top_blob_bordered.create(outw, outh, num_output / out_elempack, out_elemsize, out_elempack, opt.workspace_allocator);
+    }
+    else
+    {
+        top_blob_bordered = top_blob;
+        top_blob_bordered.create(outw, outh, num_output / out_elempack, out_elemsize, out_elempack, opt.blob_allocator);
+    }
+    if (top_blob_bordered.empty())
+        return -100;
+
+    // fill bias
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int p = 0; p < num_output / out_elempack; p++)
+    {
+        float* outptr = top_blob_bordered.channel(p);
+        const int size = outw * outh;
+
+        for (int i = 0; i < size; i++)
+        {
+            for (int k = 0; k < out_elempack; k++)
+            {
+                outptr[k] = bias_term ? bias_data[p * out_elempack + k] : 0.f;
+            }
+            outptr += out_elempack;
+        }
+    }
+
+    // the gemm result of all kernel offsets for a band of input rows, at most about 4m
+    const size_t col_row_size = (size_t)w * maxk * num_output * sizeof(float);
+    const int nn_rows = std::max(1, std::min(h, (int)((4 * 1024 * 1024) / col_row_size)));
+
+    Mat col;
+    for (int i0 = 0; i0 < h; i0 += nn_rows)
+    {
+        const int rows = std::min(nn_rows, h - i0);
+
+        // input rows as a 1x1 im2col view
+        Mat bottom_im2col(w * rows, 1, channels, (void*)bottom_blob_packed.row(i0), elemsize, elempack);
+        bottom_im2col.cstep = bottom_blob_packed.cstep;
+
+        col.create(w * rows, 1, maxk * num_output / out_elempack, out_elemsize, out_elempack, opt.workspace_allocator);
+        if (col.empty())
+            return -100;
+
+        deconvolution_im2col_sgemm(bottom_im2col, col, weight_sgemm_data, opt);
+
+        deconvolution_col2im(col, top_blob_bordered, w, i0, rows, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, opt);
+    }
+
+    if (activation)
+    {
+        activation->forward_inplace(top_blob_bordered, opt);
+    }
+
+    cut_padding(top_blob_bordered, top_blob, opt);
+    if (top_blob.empty())
+        return -100;
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,166 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "gemm_x86.h"
+
+#if __SSE2__
+#include <emmintrin.h>
+#if __AVX__
+#include <immintrin.h>
+#endif
+#endif // __SSE2__
+
+#include "x86_gemm.h"
+
+namespace ncnn {
+
+Gemm_x86::Gemm_x86()
+{
+}
+
+int Gemm_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
+{
+    const Mat& A0 = bottom_blobs[0];
+    const Mat& B0 = bottom_blobs[1];
+
+    size_t elemsize = A0.elemsize;
+
+    Mat A;
+    if (transA == 0)
+    {
+        A = A0;
+    }
+    else
+    {
+        // transpose A to row-major
+        A.create(A0.h, A0.w, elemsize, opt.workspace_allocator);
+        if (A.empty())
+            return -100;
+
+        #pragma omp parallel for num_threads(opt.num_threads)
+        for (int i = 0; i < A.h; i++)
+        {
+            float* ptr = A.row(i);
+            for (int j = 0; j < A.w; j++)
+            {
+                ptr[j] = A0.row(j)[i];
+            }
+        }
+    }
+
+    const int M = A.h;
+    const int K = A.w; // assert A.w == B.h or B.w
+    const int N = transB == 0 ? B0.w : B0.h;
+
+    Mat B_packed;
+    int ret = gemm_x86_transform_b(B0, B0.w, transB, K, N, B_packed, opt.workspace_allocator);
+    if (ret != 0)
+        return ret;
+
+    bool has_C = bottom_blobs.size() == 3;
+
+    const float* ptrC = 0;
+    int broadcast_type_C = 0;
+    if (has_C)
+    {
+        const Mat& C = bottom_blobs[2];
+
+        ptrC = C;
+
+        if (C.dims == 1 && C.w == 1)
+        {
+            // scalar
+            broadcast_type_C = 0;
+        }
+        if (C.dims == 1 && C.w == M)
+        {
+            // M
+            // auto broadcast from h to w is the ncnn-style convention
+            broadcast_type_C = 1;
+        }
+        if (C.dims == 1 && C.w == N)
+        {
+            // N
+            broadcast_type_C = 4;
+        }
+        if (C.dims == 2 && C.w == 1 && C.h == M)
+        {
+            // Mx1
+            broadcast_type_C = 2;
+        }
+        if (C.dims == 2 && C.w == N && C.h == M)
+        {
+            // MxN
+            broadcast_type_C = 3;
+        }
+        if (C.dims == 2 && C.w == N && C.h == 1)
+        {
+            // 1xN
+            broadcast_type_C = 4;
+        }
+    }
+
+    Mat& top_blob = top_blobs[0];
+    top_blob.create(N, M, elemsize, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    // the row broadcast C folds into the gemm as bias when it is not scaled
+    const bool C_as_bias = has_C && broadcast_type_C == 4 && beta == 1.f && alpha == 1.f;
+
+    gemm_x86(A, A.w, B_packed, top_blob, N, M, N, K, C_as_bias ? ptrC : 0, opt);
+
+    if ((!has_C || C_as_bias) && alpha == 1.f)
+        return 0;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i = 0; i < M; i++)
+    {
+        float* outptr = top_blob.row(i);
+
+        for (int j = 0; j < N; j++)
+        {
+            float c = 0.f;
+            if (has_C)
+            {
+                if (broadcast_type_C == 0)
+                {
+                    c = ptrC[0];
+                }
+                if (broadcast_type_C == 1)
+                {
+                    c = ptrC[i];
+                }
+                if (broadcast_type_C == 2)
+                {
+                    c = ptrC[i];
+                }
+                if (broadcast_type_C == 3)
+                {
+                    c = ptrC[i * N + j];
+                }
+                if (broadcast_type_C == 4)
+                {
+                    c = ptrC[j];
+                }
+            }
+
+            outptr[j] = (c * beta + outptr[j]) * alpha;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -40,7 +40,6 @@ protected:
 
 public:
     Layer* flatten;
-    Layer* activation;
 
     Mat weight_data_packed;
 
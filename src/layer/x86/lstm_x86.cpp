@@ -387,6 +387,15 @@ static int lstm(const Mat& bottom_blob, Mat& top_blob, int reverse, const Mat& w
 int LSTM_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt)
 {
 #if __AVX__
+    if (streaming && direction == 0)
+    {
+        std::vector<Mat> bottom_blobs(1, bottom_blob);
+        std::vector<Mat> top_blobs(1);
+        int ret = forward(bottom_blobs, top_blobs, opt);
+        top_blob = top_blobs[0];
+        return ret;
+    }
+
     int T = bottom_blob.h;
     int num_directions = direction == 2 ? 2 : 1;
 
@@ -462,7 +471,19 @@ int LSTM_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     Mat hidden;
     Mat cell;
     Allocator* hidden_cell_allocator = top_blobs.size() == 3 ? opt.blob_allocator : opt.workspace_allocator;
-    if (bottom_blobs.size() == 3)
+    const bool stream = streaming && direction == 0 && bottom_blobs.size() == 1;
+    if (stream)
+    {
+        // the sparse delta updates gain nothing from the dense avx kernel
+        if (delta_threshold > 0.f)
+            return LSTM::forward(bottom_blobs, top_blobs, opt);
+
+        // continue from the state left by the previous call
+        int ret = get_stream_state(hidden, cell);
+        if (ret != 0)
+            return ret;
+    }
+    else if (bottom_blobs.size() == 3)
     {
         hidden = bottom_blobs[1].clone(hidden_cell_allocator);
         cell = bottom_blobs[2].clone(hidden_cell_allocator);
@@ -531,8 +552,8 @@ int LSTM_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
 
     if (top_blobs.size() == 3)
     {
-        top_blobs[1] = hidden;
-        top_blobs[2] = cell;
+        top_blobs[1] = stream ? hidden.clone(opt.blob_allocator) : hidden;
+        top_blobs[2] = stream ? cell.clone(opt.blob_allocator) : cell;
     }
 
     return 0;
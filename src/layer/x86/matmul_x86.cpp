@@ -0,0 +1,176 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "matmul_x86.h"
+
+#if __SSE2__
+#include <emmintrin.h>
+#if __AVX__
+#include <immintrin.h>
+#endif
+#endif // __SSE2__
+
+#include "x86_gemm.h"
+
+namespace ncnn {
+
+MatMul_x86::MatMul_x86()
+{
+}
+
+// the matrix of batch (q, p), batch dims are aligned to the right
+// a 3-dim operand of a 4-dim matmul has its c as d
+static const float* matmul_x86_batch_ptr(const Mat& X, int max_ABdims, int q, int p)
+{
+    if (X.dims <= 2)
+        return X;
+
+    if (X.dims == 3)
+    {
+        const int c = max_ABdims == 4 ? q : p;
+        return X.channel(X.c == 1 ? 0 : c);
+    }
+
+    return X.channel(X.c == 1 ? 0 : p).depth(X.d == 1 ? 0 : q);
+}
+
+static void matmul_x86_batch_size(const Mat& X, int max_ABdims, int& d, int& c)
+{
+    d = 1;
+    c = 1;
+
+    if (X.dims == 3 && max_ABdims == 4)
+        d = X.c;
+    if (X.dims == 3 && max_ABdims == 3)
+        c = X.c;
+    if (X.dims == 4)
+    {
+        d = X.d;
+        c = X.c;
+    }
+}
+
+int MatMul_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
+{
+    const Mat& A = bottom_blobs[0];
+    const Mat& B = bottom_blobs[1];
+    Mat& top_blob = top_blobs[0];
+
+    const int Adims = A.dims;
+    const int Bdims = B.dims;
+    const int max_ABdims = std::max(Adims, Bdims);
+    const size_t elemsize = A.elemsize;
+
+    // 1-dim A is a row, 1-dim B is a column
+    const int M = Adims == 1 ? 1 : A.h;
+    const int K = A.w;
+    const int N = Bdims == 1 ? 1 : transB == 0 ? B.w : B.h;
+    const int transB1 = Bdims == 1 ? 1 : transB;
+
+    int Ad, Ac, Bd, Bc;
+    matmul_x86_batch_size(A, max_ABdims, Ad, Ac);
+    matmul_x86_batch_size(B, max_ABdims, Bd, Bc);
+
+    const int batch_size_d = std::max(Ad, Bd);
+    const int batch_size_c = std::max(Ac, Bc);
+
+    if (Adims == 1 && Bdims == 1)
+    {
+        top_blob.create(1, elemsize, opt.blob_allocator);
+    }
+    else if (Adims == 2 && Bdims == 2)
+    {
+        top_blob.create(N, M, elemsize, opt.blob_allocator);
+    }
+    else if (Adims == 1 && Bdims == 2)
+    {
+        top_blob.create(N, elemsize, opt.blob_allocator);
+    }
+    else if (Adims == 2 && Bdims == 1)
+    {
+        top_blob.create(M, elemsize, opt.blob_allocator);
+    }
+    else if (Adims == 1 && Bdims > 2)
+    {
+        if (Bdims == 3)
+            top_blob.create(N, B.c, elemsize, opt.blob_allocator);
+        else
+            top_blob.create(N, B.d, B.c, elemsize, opt.blob_allocator);
+    }
+    else if (Adims > 2 && Bdims == 1)
+    {
+        if (Adims == 3)
+            top_blob.create(M, A.c, elemsize, opt.blob_allocator);
+        else
+            top_blob.create(M, A.d, A.c, elemsize, opt.blob_allocator);
+    }
+    else if (max_ABdims == 3)
+    {
+        top_blob.create(N, M, batch_size_c, elemsize, opt.blob_allocator);
+    }
+    else if (max_ABdims == 4)
+    {
+        top_blob.create(N, M, batch_size_d, batch_size_c, elemsize, opt.blob_allocator);
+    }
+    else
+    {
+        NCNN_LOGE("impossible matmul %d %d", Adims, Bdims);
+        return -1;
+    }
+    if (top_blob.empty())
+        return -100;
+
+    // shared B is packed once for all batches
+    const bool B_shared = Bd == 1 && Bc == 1;
+
+    Mat B_packed;
+    if (B_shared)
+    {
+        int ret = gemm_x86_transform_b(B, B.w, transB1, K, N, B_packed, opt.workspace_allocator);
+        if (ret != 0)
+            return ret;
+    }
+
+    for (int p = 0; p < batch_size_c; p++)
+    {
+        for (int q = 0; q < batch_size_d; q++)
+        {
+            if (!B_shared)
+            {
+                int ret = gemm_x86_transform_b(matmul_x86_batch_ptr(B, max_ABdims, q, p), B.w, transB1, K, N, B_packed, opt.workspace_allocator);
+                if (ret != 0)
+                    return ret;
+            }
+
+            const float* ptrA = matmul_x86_batch_ptr(A, max_ABdims, q, p);
+
+            float* outptr;
+            if (top_blob.dims <= 2)
+                outptr = top_blob.row(p);
+            else if (Adims == 1 || Bdims == 1)
+                outptr = top_blob.channel(p).row(q);
+            else if (max_ABdims == 3)
+                outptr = top_blob.channel(p);
+            else
+                outptr = top_blob.channel(p).depth(q);
+
+            // matrix-vector products write a column as a row
+            gemm_x86(ptrA, K, B_packed, outptr, N, M, N, K, 0, opt);
+        }
+    }
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,291 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "multiheadattention_x86.h"
+
+#include <float.h>
+#include <math.h>
+
+#if __SSE2__
+#include "sse_mathfun.h"
+#include <emmintrin.h>
+#if __AVX__
+#include "avx_mathfun.h"
+#include <immintrin.h>
+#endif // __AVX__
+#endif // __SSE2__
+#include "x86_gemm.h"
+#include "x86_usability.h"
+
+#include "cpu.h"
+
+namespace ncnn {
+
+MultiHeadAttention_x86::MultiHeadAttention_x86()
+{
+}
+
+static float mha_reduce_max(const float* ptr, int size)
+{
+    float max = -FLT_MAX;
+
+    int i = 0;
+#if __SSE2__
+    __m128 _max = _mm_set1_ps(-FLT_MAX);
+#if __AVX__
+    __m256 _max_avx = _mm256_set1_ps(-FLT_MAX);
+    for (; i + 7 < size; i += 8)
+    {
+        _max_avx = _mm256_max_ps(_max_avx, _mm256_loadu_ps(ptr + i));
+    }
+    _max = _mm_max_ps(_mm256_castps256_ps128(_max_avx), _mm256_extractf128_ps(_max_avx, 1));
+#endif // __AVX__
+    for (; i + 3 < size; i += 4)
+    {
+        _max = _mm_max_ps(_max, _mm_loadu_ps(ptr + i));
+    }
+    _max = _mm_max_ps(_max, _mm_movehl_ps(_max, _max));
+    _max = _mm_max_ss(_max, _mm_shuffle_ps(_max, _max, _MM_SHUFFLE(1, 1, 1, 1)));
+    max = _mm_cvtss_f32(_max);
+#endif // __SSE2__
+    for (; i < size; i++)
+    {
+        max = std::max(max, ptr[i]);
+    }
+
+    return max;
+}
+
+// ptr = exp(ptr - max), returns the sum
+static float mha_exp_sub_sum(float* ptr, int size, float max)
+{
+    float sum = 0.f;
+
+    int i = 0;
+#if __SSE2__
+#if __AVX__
+    __m256 _max_avx = _mm256_set1_ps(max);
+    __m256 _sum_avx = _mm256_setzero_ps();
+    for (; i + 7 < size; i += 8)
+    {
+        __m256 _p = exp256_ps(_mm256_sub_ps(_mm256_loadu_ps(ptr + i), _max_avx));
+        _mm256_storeu_ps(ptr + i, _p);
+        _sum_avx = _mm256_add_ps(_sum_avx, _p);
+    }
+    sum += _mm256_reduce_add_ps(_sum_avx);
+#endif // __AVX__
+    __m128 _max = _mm_set1_ps(max);
+    __m128 _sum = _mm_setzero_ps();
+    for (; i + 3 < size; i += 4)
+    {
+        __m128 _p = exp_ps(_mm_sub_ps(_mm_loadu_ps(ptr + i), _max));
+        _mm_storeu_ps(ptr + i, _p);
+        _sum = _mm_add_ps(_sum, _p);
+    }
+    sum += _mm_reduce_add_ps(_sum);
+#endif // __SSE2__
+    for (; i < size; i++)
+    {
+        ptr[i] = expf(ptr[i] - max);
+        sum += ptr[i];
+    }
+
+    return sum;
+}
+
+static void mha_scale(float* ptr, int size, float scale)
+{
+    int i = 0;
+#if __SSE2__
+#if __AVX__
+    __m256 _scale_avx = _mm256_set1_ps(scale);
+    for (; i + 7 < size; i += 8)
+    {
+        _mm256_storeu_ps(ptr + i, _mm256_mul_ps(_mm256_loadu_ps(ptr + i), _scale_avx));
+    }
+#endif // __AVX__
+    __m128 _scale = _mm_set1_ps(scale);
+    for (; i + 3 < size; i += 4)
+    {
+        _mm_storeu_ps(ptr + i, _mm_mul_ps(_mm_loadu_ps(ptr + i), _scale));
+    }
+#endif // __SSE2__
+    for (; i < size; i++)
+    {
+        ptr[i] *= scale;
+    }
+}
+
+int MultiHeadAttention_x86::create_pipeline(const Option& /*opt*/)
+{
+    const int embed_dim_per_head = embed_dim / num_head;
+    const float inv_sqrt_embed_dim_per_head = 1.f / sqrt(embed_dim_per_head);
+
+    // weight_data is outch x inch, the projection takes its transpose
+    Mat q_weight_data_scaled(weight_data_size);
+    q_bias_data_scaled.create(embed_dim);
+    if (q_weight_data_scaled.empty() || q_bias_data_scaled.empty())
+        return -100;
+
+    for (int i = 0; i < weight_data_size; i++)
+    {
+        q_weight_data_scaled[i] = q_weight_data[i] * inv_sqrt_embed_dim_per_head;
+    }
+
+    for (int i = 0; i < embed_dim; i++)
+    {
+        q_bias_data_scaled[i] = q_bias_data[i] * inv_sqrt_embed_dim_per_head;
+    }
+
+    if (gemm_x86_transform_b(q_weight_data_scaled, embed_dim, 1, embed_dim, embed_dim, q_weight_data_packed, 0) != 0)
+        return -100;
+    if (gemm_x86_transform_b(k_weight_data, embed_dim, 1, embed_dim, embed_dim, k_weight_data_packed, 0) != 0)
+        return -100;
+    if (gemm_x86_transform_b(v_weight_data, embed_dim, 1, embed_dim, embed_dim, v_weight_data_packed, 0) != 0)
+        return -100;
+    if (gemm_x86_transform_b(out_weight_data, embed_dim, 1, embed_dim, embed_dim, out_weight_data_packed, 0) != 0)
+        return -100;
+
+    return 0;
+}
+
+int MultiHeadAttention_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt)
+{
+    const Mat& q_blob = bottom_blobs[0];
+    const Mat& k_blob = bottom_blobs.size() == 1 ? q_blob : bottom_blobs[1];
+    const Mat& v_blob = bottom_blobs.size() == 1 ? q_blob : bottom_blobs[2];
+
+    const int seqlen = q_blob.h;
+    const int kv_seqlen = k_blob.h;
+    const int embed_dim_per_head = embed_dim / num_head;
+
+    Mat& top_blob = top_blobs[0];
+    top_blob.create(embed_dim, seqlen, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    Mat xq(embed_dim, seqlen, 4u, opt.workspace_allocator);
+    Mat xk(embed_dim, kv_seqlen, 4u, opt.workspace_allocator);
+    Mat xv(embed_dim, kv_seqlen, 4u, opt.workspace_allocator);
+    Mat xqkv(embed_dim, seqlen, 4u, opt.workspace_allocator);
+    if (xq.empty() || xk.empty() || xv.empty() || xqkv.empty())
+        return -100;
+
+    // the projections of all heads at once
+    // xq is scaled by inv_sqrt_embed_dim_per_head
+    gemm_x86(q_blob, q_blob.w, q_weight_data_packed, xq, embed_dim, seqlen, embed_dim, embed_dim, q_bias_data_scaled, opt);
+    gemm_x86(k_blob, k_blob.w, k_weight_data_packed, xk, embed_dim, kv_seqlen, embed_dim, embed_dim, k_bias_data, opt);
+    gemm_x86(v_blob, v_blob.w, v_weight_data_packed, xv, embed_dim, kv_seqlen, embed_dim, embed_dim, v_bias_data, opt);
+
+    // xk transposed per head in panels of keys
+    // xkt  (embed_dim_per_head * pw, kv_seqlen / pw, num_head)
+    const int nn_kv = (kv_seqlen + gemm_x86_panel_width - 1) / gemm_x86_panel_width;
+
+    Mat xkt(embed_dim_per_head * gemm_x86_panel_width, nn_kv, num_head, 4u, opt.workspace_allocator);
+    if (xkt.empty())
+        return -100;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int q = 0; q < num_head; q++)
+    {
+        Mat outm = xkt.channel(q);
+
+        for (int jj = 0; jj < nn_kv; jj++)
+        {
+            float* outptr = outm.row(jj);
+
+            for (int k = 0; k < embed_dim_per_head; k++)
+            {
+                for (int j = 0; j < gemm_x86_panel_width; j++)
+                {
+                    const int kj = jj * gemm_x86_panel_width + j;
+                    *outptr++ = kj < kv_seqlen ? xk.row(kj)[q * embed_dim_per_head + k] : 0.f;
+                }
+            }
+        }
+    }
+
+    // blocks of query rows against blocks of keys, the seqlen x seqlen scores are never stored
+    // short sequences take all keys in one block, long ones run softmax online over key blocks
+    // and rescale the partial sums whenever the row max grows
+    const int q_tile = 16;
+    const int kv_tile = kv_seqlen <= 512 ? kv_seqlen : 256;
+    const int nn_q = (seqlen + q_tile - 1) / q_tile;
+
+    Mat scratch(kv_tile * q_tile + q_tile * 2, 1, opt.num_threads, 4u, opt.workspace_allocator);
+    if (scratch.empty())
+        return -100;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int qi = 0; qi < num_head * nn_q; qi++)
+    {
+        const int q = qi / nn_q;
+        const int i = qi % nn_q * q_tile;
+        const int M = std::min(q_tile, seqlen - i);
+
+        float* scores = scratch.channel(get_omp_thread_num());
+        float* maxptr = scores + kv_tile * q_tile;
+        float* sumptr = maxptr + q_tile;
+
+        const float* qptr = xq.row(i) + q * embed_dim_per_head;
+        const Mat xktm = xkt.channel(q);
+
+        float* outptr = xqkv.row(i) + q * embed_dim_per_head;
+
+        for (int j = 0; j < kv_seqlen; j += kv_tile)
+        {
+            const int N = std::min(kv_tile, kv_seqlen - j);
+
+            // scores = xq * xk
+            gemm_x86_kernel(qptr, embed_dim, xktm.row(j / gemm_x86_panel_width), gemm_x86_panel_width, embed_dim_per_head * gemm_x86_panel_width, scores, kv_tile, M, N, embed_dim_per_head, 0, 0);
+
+            // softmax(scores) without normalization
+            for (int r = 0; r < M; r++)
+            {
+                float* ptr = scores + r * kv_tile;
+
+                const float max = j == 0 ? mha_reduce_max(ptr, N) : std::max(maxptr[r], mha_reduce_max(ptr, N));
+                const float sum = mha_exp_sub_sum(ptr, N, max);
+
+                if (j == 0)
+                {
+                    sumptr[r] = sum;
+                }
+                else
+                {
+                    const float scale = expf(maxptr[r] - max);
+                    sumptr[r] = sumptr[r] * scale + sum;
+                    mha_scale(outptr + r * embed_dim, embed_dim_per_head, scale);
+                }
+
+                maxptr[r] = max;
+            }
+
+            // xqkv += scores * xv
+            gemm_x86_kernel(scores, kv_tile, xv.row(j) + q * embed_dim_per_head, embed_dim, gemm_x86_panel_width, outptr, embed_dim, M, embed_dim_per_head, N, 0, j > 0);
+        }
+
+        for (int r = 0; r < M; r++)
+        {
+            mha_scale(outptr + r * embed_dim, embed_dim_per_head, 1.f / sumptr[r]);
+        }
+    }
+
+    // out = affine(xqkv)
+    gemm_x86(xqkv, embed_dim, out_weight_data_packed, top_blob, embed_dim, seqlen, embed_dim, embed_dim, out_bias_data, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,407 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef X86_GEMM_H
+#define X86_GEMM_H
+
+#include "mat.h"
+#include "option.h"
+#include "x86_usability.h"
+
+// sgemm shared by the layers doing matrix products
+// B is packed into panels of simd width columns, zero padded
+//   B(k, j) is at panel j / pw, row k, lane j % pw
+// constant B is packed once in create_pipeline, blob B on every forward
+
+#if __AVX__
+static const int gemm_x86_panel_width = 8;
+#elif __SSE2__
+static const int gemm_x86_panel_width = 4;
+#else
+static const int gemm_x86_panel_width = 1;
+#endif
+
+#if __SSE2__
+#if __AVX__
+static NCNN_FORCEINLINE __m256 gemm_x86_load_sum_avx(const float* c, const float* bias, int accumulate)
+{
+    return accumulate ? _mm256_loadu_ps(c) : bias ? _mm256_loadu_ps(bias) : _mm256_setzero_ps();
+}
+#endif // __AVX__
+
+static NCNN_FORCEINLINE __m128 gemm_x86_load_sum_sse(const float* c, const float* bias, int accumulate)
+{
+    return accumulate ? _mm_loadu_ps(c) : bias ? _mm_loadu_ps(bias) : _mm_setzero_ps();
+}
+#endif // __SSE2__
+
+// C(M, N) = A(M, K) * B(K, N) + bias(N), or C += A * B if accumulate
+// B(k, j) is at B + j / pw * panel_stride + k * ldb + j % pw
+// for packed B, ldb is pw and panel_stride is K * pw
+// for row major B, ldb is the row stride and panel_stride is pw
+static void gemm_x86_kernel(const float* A, int lda, const float* B, int ldb, int panel_stride, float* C, int ldc, int M, int N, int K, const float* bias, int accumulate)
+{
+    const int pw = gemm_x86_panel_width;
+
+    int i = 0;
+    for (; i + 3 < M; i += 4)
+    {
+        const float* a0 = A + i * lda;
+        const float* a1 = a0 + lda;
+        const float* a2 = a1 + lda;
+        const float* a3 = a2 + lda;
+        float* c0 = C + i * ldc;
+        float* c1 = c0 + ldc;
+        float* c2 = c1 + ldc;
+        float* c3 = c2 + ldc;
+
+        int j = 0;
+#if __SSE2__
+#if __AVX__
+        for (; j + 15 < N; j += 16)
+        {
+            const float* pB0 = B + j / 8 * panel_stride;
+            const float* pB1 = pB0 + panel_stride;
+            const float* bias0 = bias ? bias + j : 0;
+            const float* bias1 = bias ? bias + j + 8 : 0;
+
+            __m256 _sum00 = gemm_x86_load_sum_avx(c0 + j, bias0, accumulate);
+            __m256 _sum01 = gemm_x86_load_sum_avx(c0 + j + 8, bias1, accumulate);
+            __m256 _sum10 = gemm_x86_load_sum_avx(c1 + j, bias0, accumulate);
+            __m256 _sum11 = gemm_x86_load_sum_avx(c1 + j + 8, bias1, accumulate);
+            __m256 _sum20 = gemm_x86_load_sum_avx(c2 + j, bias0, accumulate);
+            __m256 _sum21 = gemm_x86_load_sum_avx(c2 + j + 8, bias1, accumulate);
+            __m256 _sum30 = gemm_x86_load_sum_avx(c3 + j, bias0, accumulate);
+            __m256 _sum31 = gemm_x86_load_sum_avx(c3 + j + 8, bias1, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m256 _b0 = _mm256_loadu_ps(pB0);
+                __m256 _b1 = _mm256_loadu_ps(pB1);
+
+                __m256 _a0 = _mm256_set1_ps(a0[k]);
+                _sum00 = _mm256_comp_fmadd_ps(_a0, _b0, _sum00);
+                _sum01 = _mm256_comp_fmadd_ps(_a0, _b1, _sum01);
+                __m256 _a1 = _mm256_set1_ps(a1[k]);
+                _sum10 = _mm256_comp_fmadd_ps(_a1, _b0, _sum10);
+                _sum11 = _mm256_comp_fmadd_ps(_a1, _b1, _sum11);
+                __m256 _a2 = _mm256_set1_ps(a2[k]);
+                _sum20 = _mm256_comp_fmadd_ps(_a2, _b0, _sum20);
+                _sum21 = _mm256_comp_fmadd_ps(_a2, _b1, _sum21);
+                __m256 _a3 = _mm256_set1_ps(a3[k]);
+                _sum30 = _mm256_comp_fmadd_ps(_a3, _b0, _sum30);
+                _sum31 = _mm256_comp_fmadd_ps(_a3, _b1, _sum31);
+
+                pB0 += ldb;
+                pB1 += ldb;
+            }
+
+            _mm256_storeu_ps(c0 + j, _sum00);
+            _mm256_storeu_ps(c0 + j + 8, _sum01);
+            _mm256_storeu_ps(c1 + j, _sum10);
+            _mm256_storeu_ps(c1 + j + 8, _sum11);
+            _mm256_storeu_ps(c2 + j, _sum20);
+            _mm256_storeu_ps(c2 + j + 8, _sum21);
+            _mm256_storeu_ps(c3 + j, _sum30);
+            _mm256_storeu_ps(c3 + j + 8, _sum31);
+        }
+        for (; j + 7 < N; j += 8)
+        {
+            const float* pB = B + j / 8 * panel_stride;
+            const float* bias0 = bias ? bias + j : 0;
+
+            __m256 _sum0 = gemm_x86_load_sum_avx(c0 + j, bias0, accumulate);
+            __m256 _sum1 = gemm_x86_load_sum_avx(c1 + j, bias0, accumulate);
+            __m256 _sum2 = gemm_x86_load_sum_avx(c2 + j, bias0, accumulate);
+            __m256 _sum3 = gemm_x86_load_sum_avx(c3 + j, bias0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m256 _b = _mm256_loadu_ps(pB);
+                _sum0 = _mm256_comp_fmadd_ps(_mm256_set1_ps(a0[k]), _b, _sum0);
+                _sum1 = _mm256_comp_fmadd_ps(_mm256_set1_ps(a1[k]), _b, _sum1);
+                _sum2 = _mm256_comp_fmadd_ps(_mm256_set1_ps(a2[k]), _b, _sum2);
+                _sum3 = _mm256_comp_fmadd_ps(_mm256_set1_ps(a3[k]), _b, _sum3);
+                pB += ldb;
+            }
+
+            _mm256_storeu_ps(c0 + j, _sum0);
+            _mm256_storeu_ps(c1 + j, _sum1);
+            _mm256_storeu_ps(c2 + j, _sum2);
+            _mm256_storeu_ps(c3 + j, _sum3);
+        }
+#else  // __AVX__
+        for (; j + 7 < N; j += 8)
+        {
+            const float* pB0 = B + j / 4 * panel_stride;
+            const float* pB1 = pB0 + panel_stride;
+            const float* bias0 = bias ? bias + j : 0;
+            const float* bias1 = bias ? bias + j + 4 : 0;
+
+            __m128 _sum00 = gemm_x86_load_sum_sse(c0 + j, bias0, accumulate);
+            __m128 _sum01 = gemm_x86_load_sum_sse(c0 + j + 4, bias1, accumulate);
+            __m128 _sum10 = gemm_x86_load_sum_sse(c1 + j, bias0, accumulate);
+            __m128 _sum11 = gemm_x86_load_sum_sse(c1 + j + 4, bias1, accumulate);
+            __m128 _sum20 = gemm_x86_load_sum_sse(c2 + j, bias0, accumulate);
+            __m128 _sum21 = gemm_x86_load_sum_sse(c2 + j + 4, bias1, accumulate);
+            __m128 _sum30 = gemm_x86_load_sum_sse(c3 + j, bias0, accumulate);
+            __m128 _sum31 = gemm_x86_load_sum_sse(c3 + j + 4, bias1, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m128 _b0 = _mm_loadu_ps(pB0);
+                __m128 _b1 = _mm_loadu_ps(pB1);
+
+                __m128 _a0 = _mm_set1_ps(a0[k]);
+                _sum00 = _mm_comp_fmadd_ps(_a0, _b0, _sum00);
+                _sum01 = _mm_comp_fmadd_ps(_a0, _b1, _sum01);
+                __m128 _a1 = _mm_set1_ps(a1[k]);
+                _sum10 = _mm_comp_fmadd_ps(_a1, _b0, _sum10);
+                _sum11 = _mm_comp_fmadd_ps(_a1, _b1, _sum11);
+                __m128 _a2 = _mm_set1_ps(a2[k]);
+                _sum20 = _mm_comp_fmadd_ps(_a2, _b0, _sum20);
+                _sum21 = _mm_comp_fmadd_ps(_a2, _b1, _sum21);
+                __m128 _a3 = _mm_set1_ps(a3[k]);
+                _sum30 = _mm_comp_fmadd_ps(_a3, _b0, _sum30);
+                _sum31 = _mm_comp_fmadd_ps(_a3, _b1, _sum31);
+
+                pB0 += ldb;
+                pB1 += ldb;
+            }
+
+            _mm_storeu_ps(c0 + j, _sum00);
+            _mm_storeu_ps(c0 + j + 4, _sum01);
+            _mm_storeu_ps(c1 + j, _sum10);
+            _mm_storeu_ps(c1 + j + 4, _sum11);
+            _mm_storeu_ps(c2 + j, _sum20);
+            _mm_storeu_ps(c2 + j + 4, _sum21);
+            _mm_storeu_ps(c3 + j, _sum30);
+            _mm_storeu_ps(c3 + j + 4, _sum31);
+        }
+        for (; j + 3 < N; j += 4)
+        {
+            const float* pB = B + j / 4 * panel_stride;
+            const float* bias0 = bias ? bias + j : 0;
+
+            __m128 _sum0 = gemm_x86_load_sum_sse(c0 + j, bias0, accumulate);
+            __m128 _sum1 = gemm_x86_load_sum_sse(c1 + j, bias0, accumulate);
+            __m128 _sum2 = gemm_x86_load_sum_sse(c2 + j, bias0, accumulate);
+            __m128 _sum3 = gemm_x86_load_sum_sse(c3 + j, bias0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m128 _b = _mm_loadu_ps(pB);
+                _sum0 = _mm_comp_fmadd_ps(_mm_set1_ps(a0[k]), _b, _sum0);
+                _sum1 = _mm_comp_fmadd_ps(_mm_set1_ps(a1[k]), _b, _sum1);
+                _sum2 = _mm_comp_fmadd_ps(_mm_set1_ps(a2[k]), _b, _sum2);
+                _sum3 = _mm_comp_fmadd_ps(_mm_set1_ps(a3[k]), _b, _sum3);
+                pB += ldb;
+            }
+
+            _mm_storeu_ps(c0 + j, _sum0);
+            _mm_storeu_ps(c1 + j, _sum1);
+            _mm_storeu_ps(c2 + j, _sum2);
+            _mm_storeu_ps(c3 + j, _sum3);
+        }
+#endif // __AVX__
+#endif // __SSE2__
+        for (; j < N; j++)
+        {
+            const float* pB = B + j / pw * panel_stride + j % pw;
+
+            float sum0 = accumulate ? c0[j] : bias ? bias[j] : 0.f;
+            float sum1 = accumulate ? c1[j] : sum0;
+            float sum2 = accumulate ? c2[j] : sum0;
+            float sum3 = accumulate ? c3[j] : sum0;
+
+            for (int k = 0; k < K; k++)
+            {
+                const float b = pB[0];
+                sum0 += a0[k] * b;
+                sum1 += a1[k] * b;
+                sum2 += a2[k] * b;
+                sum3 += a3[k] * b;
+                pB += ldb;
+            }
+
+            c0[j] = sum0;
+            c1[j] = sum1;
+            c2[j] = sum2;
+            c3[j] = sum3;
+        }
+    }
+    for (; i < M; i++)
+    {
+        const float* a0 = A + i * lda;
+        float* c0 = C + i * ldc;
+
+        int j = 0;
+#if __SSE2__
+#if __AVX__
+        for (; j + 15 < N; j += 16)
+        {
+            const float* pB0 = B + j / 8 * panel_stride;
+            const float* pB1 = pB0 + panel_stride;
+
+            __m256 _sum0 = gemm_x86_load_sum_avx(c0 + j, bias ? bias + j : 0, accumulate);
+            __m256 _sum1 = gemm_x86_load_sum_avx(c0 + j + 8, bias ? bias + j + 8 : 0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m256 _a0 = _mm256_set1_ps(a0[k]);
+                _sum0 = _mm256_comp_fmadd_ps(_a0, _mm256_loadu_ps(pB0), _sum0);
+                _sum1 = _mm256_comp_fmadd_ps(_a0, _mm256_loadu_ps(pB1), _sum1);
+                pB0 += ldb;
+                pB1 += ldb;
+            }
+
+            _mm256_storeu_ps(c0 + j, _sum0);
+            _mm256_storeu_ps(c0 + j + 8, _sum1);
+        }
+        for (; j + 7 < N; j += 8)
+        {
+            const float* pB = B + j / 8 * panel_stride;
+
+            __m256 _sum0 = gemm_x86_load_sum_avx(c0 + j, bias ? bias + j : 0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                _sum0 = _mm256_comp_fmadd_ps(_mm256_set1_ps(a0[k]), _mm256_loadu_ps(pB), _sum0);
+                pB += ldb;
+            }
+
+            _mm256_storeu_ps(c0 + j, _sum0);
+        }
+#else  // __AVX__
+        for (; j + 7 < N; j += 8)
+        {
+            const float* pB0 = B + j / 4 * panel_stride;
+            const float* pB1 = pB0 + panel_stride;
+
+            __m128 _sum0 = gemm_x86_load_sum_sse(c0 + j, bias ? bias + j : 0, accumulate);
+            __m128 _sum1 = gemm_x86_load_sum_sse(c0 + j + 4, bias ? bias + j + 4 : 0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                __m128 _a0 = _mm_set1_ps(a0[k]);
+                _sum0 = _mm_comp_fmadd_ps(_a0, _mm_loadu_ps(pB0), _sum0);
+                _sum1 = _mm_comp_fmadd_ps(_a0, _mm_loadu_ps(pB1), _sum1);
+                pB0 += ldb;
+                pB1 += ldb;
+            }
+
+            _mm_storeu_ps(c0 + j, _sum0);
+            _mm_storeu_ps(c0 + j + 4, _sum1);
+        }
+        for (; j + 3 < N; j += 4)
+        {
+            const float* pB = B + j / 4 * panel_stride;
+
+            __m128 _sum0 = gemm_x86_load_sum_sse(c0 + j, bias ? bias + j : 0, accumulate);
+
+            for (int k = 0; k < K; k++)
+            {
+                _sum0 = _mm_comp_fmadd_ps(_mm_set1_ps(a0[k]), _mm_loadu_ps(pB), _sum0);
+                pB += ldb;
+            }
+
+            _mm_storeu_ps(c0 + j, _sum0);
+        }
+#endif // __AVX__
+#endif // __SSE2__
+        for (; j < N; j++)
+        {
+            const float* pB = B + j / pw * panel_stride + j % pw;
+
+            float sum0 = accumulate ? c0[j] : bias ? bias[j] : 0.f;
+
+            for (int k = 0; k < K; k++)
+            {
+                sum0 += a0[k] * pB[0];
+                pB += ldb;
+            }
+
+            c0[j] = sum0;
+        }
+    }
+}
+
+// B is K x N with row stride ldb, or N x K if transB
+// dst = pw-K-N/pw
+static int gemm_x86_transform_b(const float* B, int ldb, int transB, int K, int N, ncnn::Mat& B_packed, ncnn::Allocator* allocator)
+{
+    const int pw = gemm_x86_panel_width;
+    const int nn_N = (N + pw - 1) / pw;
+
+    B_packed.create(K * pw, nn_N, 4u, allocator);
+    if (B_packed.empty())
+        return -100;
+
+    for (int q = 0; q < nn_N; q++)
+    {
+        float* g0 = B_packed.row(q);
+
+        for (int k = 0; k < K; k++)
+        {
+            for (int j = 0; j < pw; j++)
+            {
+                const int jj = q * pw + j;
+                if (jj >= N)
+                    *g0++ = 0.f;
+                else
+                    *g0++ = transB ? B[jj * ldb + k] : B[k * ldb + jj];
+            }
+        }
+    }
+
+    return 0;
+}
+
+// C(M, N) = A(M, K) * B(K, N) + bias(N), bias may be null
+// B_packed comes from gemm_x86_transform_b
+// the output is computed in blocks of rows and panels, with the k loop cut into chunks
+// so that a chunk of the panels stays in cache while all the rows of a block run over it
+static void gemm_x86(const float* A, int lda, const ncnn::Mat& B_packed, float* C, int ldc, int M, int N, int K, const float* bias, const ncnn::Option& opt)
+{
+    const int pw = gemm_x86_panel_width;
+
+    const int TILE_M = 16;
+    const int TILE_N = 128;
+    const int TILE_K = 256;
+
+    const int nn_M = (M + TILE_M - 1) / TILE_M;
+    const int nn_N = (N + TILE_N - 1) / TILE_N;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int ij = 0; ij < nn_M * nn_N; ij++)
+    {
+        const int i = ij / nn_N * TILE_M;
+        const int j = ij % nn_N * TILE_N;
+
+        const int max_ii = std::min(TILE_M, M - i);
+        const int max_jj = std::min(TILE_N, N - j);
+
+        // k == 0 runs once for empty K to write the bias
+        for (int k = 0; k == 0 || k < K; k += TILE_K)
+        {
+            const int max_kk = std::min(TILE_K, K - k);
+
+            const float* pB = (const float*)B_packed.row(j / pw) + k * pw;
+
+            gemm_x86_kernel(A + i * lda + k, lda, pB, pw, K * pw, C + i * ldc + j, ldc, max_ii, max_jj, max_kk, k == 0 && bias ? bias + j : 0, k > 0);
+        }
+    }
+}
+
+#endif // X86_GEMM_H
@@ -182,21 +182,9 @@ int Yolov3DetectionOutput_x86::forward(const std::vector<Mat>& bottom_blobs, std
         }
     }
 
-    // global sort inplace
-    qsort_descent_inplace(all_bbox_rects);
-
-    // apply nms
-    std::vector<size_t> picked;
-    nms_sorted_bboxes(all_bbox_rects, picked, nms_threshold);
-
-    // select
+    // global sort and apply nms
     std::vector<BBoxRect> bbox_rects;
-
-    for (size_t i = 0; i < picked.size(); i++)
-    {
-        size_t z = picked[i];
-        bbox_rects.push_back(all_bbox_rects[z]);
-    }
+    select_nms_bboxes(all_bbox_rects, bbox_rects);
 
     // fill result
     int num_detected = static_cast<int>(bbox_rects.size());
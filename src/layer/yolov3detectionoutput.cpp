@@ -15,6 +15,7 @@
 #include "yolov3detectionoutput.h"
 
 #include "layer_type.h"
+#include "nms.h"
 
 #include <float.h>
 #include <math.h>
@@ -52,87 +53,31 @@ int Yolov3DetectionOutput::load_param(const ParamDict& pd)
     return 0;
 }
 
-static inline float intersection_area(const Yolov3DetectionOutput::BBoxRect& a, const Yolov3DetectionOutput::BBoxRect& b)
+void Yolov3DetectionOutput::select_nms_bboxes(const std::vector<BBoxRect>& bboxes, std::vector<BBoxRect>& picked_bboxes) const
 {
-    if (a.xmin > b.xmax || a.xmax < b.xmin || a.ymin > b.ymax || a.ymax < b.ymin)
-    {
-        // no intersection
-        return 0.f;
-    }
+    picked_bboxes.clear();
 
-    float inter_width = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
-    float inter_height = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+    if (bboxes.empty())
+        return;
 
-    return inter_width * inter_height;
-}
+    const int stride = sizeof(BBoxRect) / sizeof(float);
 
-void Yolov3DetectionOutput::qsort_descent_inplace(std::vector<BBoxRect>& datas, int left, int right) const
-{
-    int i = left;
-    int j = right;
-    float p = datas[(left + right) / 2].score;
+    std::vector<int> order;
+    sort_descent_topk(&bboxes.data()->score, (int)bboxes.size(), stride, 0, order);
 
-    while (i <= j)
+    std::vector<BBoxRect> sorted_bboxes(order.size());
+    for (size_t i = 0; i < order.size(); i++)
     {
-        while (datas[i].score > p)
-            i++;
-
-        while (datas[j].score < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(datas[i], datas[j]);
-
-            i++;
-            j--;
-        }
+        sorted_bboxes[i] = bboxes[order[i]];
     }
 
-    if (left < j)
-        qsort_descent_inplace(datas, left, j);
-
-    if (i < right)
-        qsort_descent_inplace(datas, i, right);
-}
-
-void Yolov3DetectionOutput::qsort_descent_inplace(std::vector<BBoxRect>& datas) const
-{
-    if (datas.empty())
-        return;
-
-    qsort_descent_inplace(datas, 0, static_cast<int>(datas.size() - 1));
-}
-
-void Yolov3DetectionOutput::nms_sorted_bboxes(std::vector<BBoxRect>& bboxes, std::vector<size_t>& picked, float nms_threshold) const
-{
-    picked.clear();
-
-    const size_t n = bboxes.size();
+    std::vector<int> picked;
+    nms_sorted_bboxes(&sorted_bboxes.data()->xmin, (int)sorted_bboxes.size(), stride, &sorted_bboxes.data()->area, 0, nms_threshold, picked);
 
-    for (size_t i = 0; i < n; i++)
+    picked_bboxes.resize(picked.size());
+    for (size_t i = 0; i < picked.size(); i++)
     {
-        const BBoxRect& a = bboxes[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const BBoxRect& b = bboxes[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = a.area + b.area - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area > nms_threshold * union_area)
-            {
-                keep = 0;
-                break;
-            }
-        }
-
-        if (keep)
-            picked.push_back(i);
+        picked_bboxes[i] = sorted_bboxes[picked[i]];
     }
 }
 
@@ -243,21 +188,9 @@ int Yolov3DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::ve
         }
     }
 
-    // global sort inplace
-    qsort_descent_inplace(all_bbox_rects);
-
-    // apply nms
-    std::vector<size_t> picked;
-    nms_sorted_bboxes(all_bbox_rects, picked, nms_threshold);
-
-    // select
+    // global sort and apply nms
     std::vector<BBoxRect> bbox_rects;
-
-    for (size_t i = 0; i < picked.size(); i++)
-    {
-        size_t z = picked[i];
-        bbox_rects.push_back(all_bbox_rects[z]);
-    }
+    select_nms_bboxes(all_bbox_rects, bbox_rects);
 
     // fill result
     int num_detected = static_cast<int>(bbox_rects.size());
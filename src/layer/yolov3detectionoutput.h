@@ -52,9 +52,8 @@ public:
         int label;
     };
 
-    void qsort_descent_inplace(std::vector<BBoxRect>& datas, int left, int right) const;
-    void qsort_descent_inplace(std::vector<BBoxRect>& datas) const;
-    void nms_sorted_bboxes(std::vector<BBoxRect>& bboxes, std::vector<size_t>& picked, float nms_threshold) const;
+    // sort by score descending and keep the boxes surviving nms
+    void select_nms_bboxes(const std::vector<BBoxRect>& bboxes, std::vector<BBoxRect>& picked_bboxes) const;
 };
 
 } // namespace ncnn
@@ -270,6 +270,17 @@ public:
     // convenient construct from pixel data roi and resize to specific size with stride(bytes-per-row) parameter
     static Mat from_pixels_roi_resize(const unsigned char* pixels, int type, int w, int h, int stride, int roix, int roiy, int roiw, int roih, int target_width, int target_height, Allocator* allocator = 0);
 
+    enum YUVType
+    {
+        YUV420SP_NV21 = 1,
+        YUV420SP_NV12 = 2,
+        YUV420P_I420 = 3
+    };
+    // convenient construct from yuv420 data roi, converted to PIXEL_RGB PIXEL_BGR or PIXEL_GRAY,
+    // resized to specific size and mean substracted and normalized in one pass, pass 0 to skip mean or norm
+    // w and h must be even, the rows are processed by opt.num_threads
+    static Mat from_yuv420_roi_resize_normalize(const unsigned char* yuv, int yuv_type, int w, int h, int roix, int roiy, int roiw, int roih, int type_to, int target_width, int target_height, const float* mean_vals, const float* norm_vals, const Option& opt);
+
     // convenient export to pixel data
     void to_pixels(unsigned char* pixels, int type) const;
     // convenient export to pixel data with stride(bytes-per-row) parameter
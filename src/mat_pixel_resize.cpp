@@ -19,6 +19,7 @@
 #if __ARM_NEON
 #include <arm_neon.h>
 #endif // __ARM_NEON
+#include "cpu.h"
 #include "platform.h"
 
 namespace ncnn {
@@ -1242,6 +1243,234 @@ void resize_bilinear_yuv420sp(const unsigned char* src, int srcw, int srch, unsi
     unsigned char* dstUV = dst + w * h;
     resize_bilinear_c2(srcUV, srcw / 2, srch / 2, dstUV, w / 2, h / 2);
 }
+
+// source offset and weight of the bilinear sample for every destination position
+// the coordinates map into [start, start + len) of a plane with size positions
+static void yuv420_sample_table(int dstlen, int start, int len, int size, bool chroma, int* ofs, float* alpha)
+{
+    const double scale = (double)len / dstlen;
+
+    for (int i = 0; i < dstlen; i++)
+    {
+        float f = (float)((i + 0.5) * scale - 0.5);
+
+        int lo = start;
+        int hi = start + len - 1;
+        if (chroma)
+        {
+            // chroma samples sit at the center of each 2x2 luma block
+            f = (f + start + 0.5f) * 0.5f - 0.5f;
+            lo = start / 2;
+            hi = std::min((start + len + 1) / 2, size) - 1;
+        }
+        else
+        {
+            f += start;
+        }
+
+        int s = static_cast<int>(floor(f));
+        f -= s;
+
+        if (s < lo)
+        {
+            s = lo;
+            f = 0.f;
+        }
+        if (s >= hi)
+        {
+            s = hi;
+            f = 0.f;
+        }
+
+        ofs[i] = s;
+        alpha[i] = f;
+    }
+}
+
+Mat Mat::from_yuv420_roi_resize_normalize(const unsigned char* yuv, int yuv_type, int w, int h, int roix, int roiy, int roiw, int roih, int type_to, int target_width, int target_height, const float* mean_vals, const float* norm_vals, const Option& opt)
+{
+    if (w % 2 != 0 || h % 2 != 0)
+    {
+        NCNN_LOGE("yuv420 image %d %d must be even", w, h);
+        return Mat();
+    }
+
+    if (roix < 0 || roiy < 0 || roiw <= 0 || roih <= 0 || roix + roiw > w || roiy + roih > h)
+    {
+        NCNN_LOGE("roi %d %d %d %d out of image %d %d", roix, roiy, roiw, roih, w, h);
+        return Mat();
+    }
+
+    if (type_to != PIXEL_RGB && type_to != PIXEL_BGR && type_to != PIXEL_GRAY)
+    {
+        NCNN_LOGE("unknown convert type %d", type_to);
+        return Mat();
+    }
+
+    // chroma plane layout
+    const unsigned char* uplane = yuv + w * h;
+    const unsigned char* vplane = yuv + w * h;
+    int cstride = w;
+    int cpix = 2;
+    if (yuv_type == YUV420SP_NV12)
+    {
+        vplane += 1;
+    }
+    else if (yuv_type == YUV420SP_NV21)
+    {
+        uplane += 1;
+    }
+    else if (yuv_type == YUV420P_I420)
+    {
+        vplane += (w / 2) * (h / 2);
+        cstride = w / 2;
+        cpix = 1;
+    }
+    else
+    {
+        NCNN_LOGE("unknown yuv type %d", yuv_type);
+        return Mat();
+    }
+
+    const int channels = type_to == PIXEL_GRAY ? 1 : 3;
+
+    Mat m(target_width, target_height, channels, 4u, opt.blob_allocator);
+    if (m.empty())
+        return m;
+
+    std::vector<int> xofs(target_width * 2);
+    std::vector<float> xalpha(target_width * 2);
+    std::vector<int> yofs(target_height * 2);
+    std::vector<float> yalpha(target_height * 2);
+
+    yuv420_sample_table(target_width, roix, roiw, w / 2, false, xofs.data(), xalpha.data());
+    yuv420_sample_table(target_width, roix, roiw, w / 2, true, xofs.data() + target_width, xalpha.data() + target_width);
+    yuv420_sample_table(target_height, roiy, roih, h / 2, false, yofs.data(), yalpha.data());
+    yuv420_sample_table(target_height, roiy, roih, h / 2, true, yofs.data() + target_height, yalpha.data() + target_height);
+
+    // out = (value - mean) * norm = value * norm + bias
+    float scale[3] = {1.f, 1.f, 1.f};
+    float bias[3] = {0.f, 0.f, 0.f};
+    for (int q = 0; q < channels; q++)
+    {
+        if (norm_vals)
+            scale[q] = norm_vals[q];
+        if (mean_vals)
+            bias[q] = -mean_vals[q] * scale[q];
+    }
+
+    // output channel of r g b
+    const int rq = type_to == PIXEL_BGR ? 2 : 0;
+    const int bq = type_to == PIXEL_BGR ? 0 : 2;
+
+    // the resampled y u v rows of each thread
+    Mat rowbuf(target_width, channels, opt.num_threads, 4u, opt.workspace_allocator);
+    if (rowbuf.empty())
+        return Mat();
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int dy = 0; dy < target_height; dy++)
+    {
+        Mat buf = rowbuf.channel(get_omp_thread_num());
+
+        // luma
+        {
+            const int sy = yofs[dy];
+            const float fy = yalpha[dy];
+            const unsigned char* y0 = yuv + sy * w;
+            const unsigned char* y1 = fy == 0.f ? y0 : y0 + w;
+
+            float* yptr = buf.row(0);
+            for (int dx = 0; dx < target_width; dx++)
+            {
+                const int sx = xofs[dx];
+                const float fx = xalpha[dx];
+                const int sx1 = fx == 0.f ? sx : sx + 1;
+
+                float a = y0[sx] + (y0[sx1] - y0[sx]) * fx;
+                float b = y1[sx] + (y1[sx1] - y1[sx]) * fx;
+                yptr[dx] = a + (b - a) * fy;
+            }
+        }
+
+        if (channels == 1)
+        {
+            const float* yptr = buf.row(0);
+            float* outptr = m.channel(0).row(dy);
+            for (int dx = 0; dx < target_width; dx++)
+            {
+                outptr[dx] = yptr[dx] * scale[0] + bias[0];
+            }
+            continue;
+        }
+
+        // chroma
+        {
+            const int* cxofs = xofs.data() + target_width;
+            const float* cxalpha = xalpha.data() + target_width;
+
+            const int cy = yofs[target_height + dy];
+            const float fcy = yalpha[target_height + dy];
+            const unsigned char* u0 = uplane + cy * cstride;
+            const unsigned char* u1 = fcy == 0.f ? u0 : u0 + cstride;
+            const unsigned char* v0 = vplane + cy * cstride;
+            const unsigned char* v1 = fcy == 0.f ? v0 : v0 + cstride;
+
+            float* uptr = buf.row(1);
+            float* vptr = buf.row(2);
+            for (int dx = 0; dx < target_width; dx++)
+            {
+                const int cx = cxofs[dx] * cpix;
+                const float fcx = cxalpha[dx];
+                const int cx1 = fcx == 0.f ? cx : cx + cpix;
+
+                float ua = u0[cx] + (u0[cx1] - u0[cx]) * fcx;
+                float ub = u1[cx] + (u1[cx1] - u1[cx]) * fcx;
+                uptr[dx] = ua + (ub - ua) * fcy - 128.f;
+
+                float va = v0[cx] + (v0[cx1] - v0[cx]) * fcx;
+                float vb = v1[cx] + (v1[cx1] - v1[cx]) * fcx;
+                vptr[dx] = va + (vb - va) * fcy - 128.f;
+            }
+        }
+
+        // colour conversion and normalization, straight line code for the compiler to vectorize
+        {
+            const float* yptr = buf.row(0);
+            const float* uptr = buf.row(1);
+            const float* vptr = buf.row(2);
+
+            float* rptr = m.channel(rq).row(dy);
+            float* gptr = m.channel(1).row(dy);
+            float* bptr = m.channel(bq).row(dy);
+
+            const float rscale = scale[rq];
+            const float gscale = scale[1];
+            const float bscale = scale[bq];
+            const float rbias = bias[rq];
+            const float gbias = bias[1];
+            const float bbias = bias[bq];
+
+            for (int dx = 0; dx < target_width; dx++)
+            {
+                const float Y = yptr[dx];
+                const float U = uptr[dx];
+                const float V = vptr[dx];
+
+                // the coefficients of yuv420sp2rgb
+                float R = std::min(std::max(Y + 1.40625f * V, 0.f), 255.f);
+                float G = std::min(std::max(Y - 0.71875f * V - 0.34375f * U, 0.f), 255.f);
+                float B = std::min(std::max(Y + 1.765625f * U, 0.f), 255.f);
+
+                rptr[dx] = R * rscale + rbias;
+                gptr[dx] = G * gscale + gbias;
+                bptr[dx] = B * bscale + bbias;
+            }
+        }
+    }
+
+    return m;
+}
 #endif // NCNN_PIXEL
 
 } // namespace ncnn
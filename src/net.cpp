@@ -14,20 +14,22 @@
 
 #include "net.h"
 
+#include "benchmark.h"
 #include "cpu.h"
 #include "datareader.h"
 #include "layer_type.h"
 #include "modelbin.h"
 #include "paramdict.h"
 
+#include <list>
 #include <stdarg.h>
 #include <stdint.h>
 #include <string.h>
 #include <convolution.h>
-
-#if NCNN_BENCHMARK
-#include "benchmark.h"
-#endif // NCNN_BENCHMARK
+#include <convolutiondepthwise.h>
+#include <concat.h>
+#include <interp.h>
+#include <pooling.h>
 
 #if NCNN_VULKAN
 #include "command.h"
@@ -70,6 +72,24 @@ public:
     void update_input_output_names();
 #endif // NCNN_STRING
 
+    // level every layer by its longest path from the inputs
+    // layers on the same level never depend on each other
+    void update_layer_levels();
+
+    // run the layers producing blob_index, independent branches concurrently
+    // on inter_op_threads workers, each with num_threads / inter_op_threads omp threads
+    int forward_branches(int blob_index, std::vector<Mat>& blob_mats, const Option& opt, int inter_op_threads);
+
+    // compare the input against the previous frame fed into the same blob
+    // drop the memoized outputs and start a new generation if anything changed
+    // return the memo generation the input belongs to
+    int update_frame_memo(int blob_index, const Mat& in);
+
+    // mark the input tiles changed since the previous frame
+    void update_input_dirty_mask(int blob_index, const Mat& in);
+    // derive top blob masks from bottom blob masks and the layer receptive field
+    void propagate_dirty_masks(const Layer* layer, const std::vector<Mat>& blob_mats);
+
     std::vector<Blob> blobs;
     std::vector<Layer*> layers;
 
@@ -85,6 +105,29 @@ public:
     PoolAllocator* local_blob_allocator;
     PoolAllocator* local_workspace_allocator;
 
+#if NCNN_STDIO
+    // weights referenced from the mapped model files
+    std::vector<DataReaderFromMmap*> model_mmaps;
+
+    // persistent create_pipeline weight transforms
+    std::string weight_cache_path;
+#endif // NCNN_STDIO
+
+    // frame memoization, shared by the extractors of the net
+    // an extractor only touches the memo of the generation it fed
+    Mutex memo_lock;
+    int memo_generation;
+    std::vector<Mat> memo_input_mats;
+    std::vector<Mat> memo_output_mats;
+
+    // dirty region
+    std::vector<Mat> blob_dirty_masks;
+    std::vector<Mat> last_blob_mats;
+
+    // branch parallel
+    std::vector<int> layer_levels;
+    int max_level_width;
+
 #if NCNN_VULKAN
     const VulkanDevice* vkdev;
 
@@ -101,6 +144,10 @@ NetPrivate::NetPrivate(Option& _opt)
     local_blob_allocator = 0;
     local_workspace_allocator = 0;
 
+    max_level_width = 0;
+
+    memo_generation = 0;
+
 #if NCNN_VULKAN
     vkdev = 0;
     weight_vkallocator = 0;
@@ -198,33 +245,105 @@ int NetPrivate::forward_layer(int layer_index, std::vector<Mat>& blob_mats, Opti
 #endif
     opt.use_reserved_0 = false;
     opt.use_reserved_4 = false;
-    int next_index = layer_index + 1;
-    if (layer->type == "Convolution"
-        && ((Convolution*)layer)->activation_type == 1       // Faster R-CNN / mobilenet
-//        && layers[next_index]->typeindex == LayerType::ReLU     // Squeezenet/ vgg
-    ){
-//        fprintf(stderr, "%d\t", layer_index);
-        // squeezenet 1	4	7	9	12	15	17	21	24	26	29	32	34	38	41	43	46	49	51	54	57	59	62	65	67	71
-        // vgg 3 5	8	10	13	15	17	20	22	24	27	29 31
-        // mobile net  2	4	6	8	10	12	14	16	18	20	22	24	27	29	31	32	34	35	37	38	40	41
-        // video infer
-//        if (layer_index<=8)
-//            opt.use_reserved_4 = true;  // spatial + temp
-//        else if (layer_index <= 8)
-//            opt.use_reserved_0 = true; // only tmep
+    if (layer->type == "Convolution" && ((Convolution*)layer)->activation_type == 1)
+    {
+        // per layer policy from the sparsity table, otherwise the options decide
+        const int sparse_mode = ((Convolution*)layer)->sparse_mode;
+        if (sparse_mode == 1 || (sparse_mode < 0 && !opt.use_spatial_sparsity && opt.use_temporal_sparsity))
+            opt.use_reserved_0 = true;
+    }
+
+    Allocator* frame_blob_allocator = opt.blob_allocator;
+    if (opt.use_dirty_region)
+    {
+        // the tops are kept as the previous output of the next frame,
+        // they come from the net allocator rather than the one of this frame
+        opt.blob_allocator = this->opt.blob_allocator ? this->opt.blob_allocator : local_blob_allocator;
+
+        propagate_dirty_masks(layer, blob_mats);
+
+        bool all_clean = true;
+        for (size_t i = 0; i < layer->tops.size() && all_clean; i++)
+        {
+            const Mat& mask = blob_dirty_masks[layer->tops[i]];
+            if (mask.empty())
+            {
+                all_clean = false;
+                break;
+            }
+
+            const unsigned char* mptr = mask;
+            for (int j = 0; j < mask.w * mask.h; j++)
+            {
+                if (mptr[j])
+                {
+                    all_clean = false;
+                    break;
+                }
+            }
+        }
+
+        if (all_clean)
+        {
+            // nothing changed in the receptive field, reuse the previous output
+            for (size_t i = 0; i < layer->tops.size(); i++)
+            {
+                int top_blob_index = layer->tops[i];
+                blob_mats[top_blob_index] = last_blob_mats[top_blob_index];
+
+                const Mat& top_blob = blob_mats[top_blob_index];
+                layer->stats.clean_outputs += (double)top_blob.w * top_blob.h * top_blob.d * top_blob.c * top_blob.elempack;
+            }
 
-//         video: only temporal
-//        if (layer_index<=8)
-            opt.use_reserved_0 = true; // only tmep
+            if (opt.lightmode)
+            {
+                for (size_t i = 0; i < layer->bottoms.size(); i++)
+                {
+                    blob_mats[layer->bottoms[i]].release();
+                }
+            }
 
+            opt.blob_allocator = frame_blob_allocator;
+            return 0;
+        }
 
-        // single image infer
-//        if (layer_index<=11)
-//            opt.use_reserved_0 = true; // only spatial
+        if (layer->support_dirty_region && layer->one_blob_only)
+        {
+            int top_blob_index = layer->tops[0];
+            if (!blob_dirty_masks[top_blob_index].empty())
+            {
+                // start from the previous output, the layer overwrites the dirty tiles
+                blob_mats[top_blob_index] = last_blob_mats[top_blob_index].clone(opt.blob_allocator);
+                layer->top_dirty_mask = blob_dirty_masks[top_blob_index];
+            }
+        }
     }
 
+    double forward_start = opt.use_layer_stats ? get_current_time() : 0.0;
 
     int ret = do_forward_layer(layer, blob_mats, opt);
+
+    opt.blob_allocator = frame_blob_allocator;
+
+    layer->stats.forward_count++;
+    if (opt.use_layer_stats)
+    {
+        layer->stats.forward_time += get_current_time() - forward_start;
+    }
+
+    if (opt.use_dirty_region)
+    {
+        layer->top_dirty_mask.release();
+
+        for (size_t i = 0; i < layer->tops.size(); i++)
+        {
+            int top_blob_index = layer->tops[i];
+            if (blob_mats[top_blob_index].dims == 3)
+                last_blob_mats[top_blob_index] = blob_mats[top_blob_index];
+            else
+                last_blob_mats[top_blob_index].release();
+        }
+    }
 //#if NCNN_BENCHMARK
 //    double end = get_current_time();
 //    if (layer->one_blob_only)
@@ -955,6 +1074,12 @@ int NetPrivate::do_forward_layer(Layer* layer, std::vector<Mat>& blob_mats, cons
         else
         {
             Mat top_blob;
+            if (!layer->top_dirty_mask.empty())
+            {
+                // previous output prepared for dirty region forward
+                top_blob = blob_mats[top_blob_index];
+            }
+
             int ret = layer->forward(bottom_blob, top_blob, opt);
             if (ret != 0)
                 return ret;
@@ -1318,199 +1443,747 @@ void NetPrivate::update_input_output_indexes()
     }
 }
 
-#if NCNN_STRING
-void NetPrivate::update_input_output_names()
+void NetPrivate::update_layer_levels()
 {
-    input_blob_names.clear();
-    output_blob_names.clear();
+    layer_levels.assign(layers.size(), 0);
 
-    for (size_t i = 0; i < input_blob_indexes.size(); i++)
+    // layers come in topological order, producers first
+    int level_count = 0;
+    for (size_t i = 0; i < layers.size(); i++)
     {
-        int blob_index = input_blob_indexes[i];
-        input_blob_names.push_back(blobs[blob_index].name.c_str());
+        const Layer* layer = layers[i];
+
+        int level = 0;
+        for (size_t j = 0; j < layer->bottoms.size(); j++)
+        {
+            const int producer = blobs[layer->bottoms[j]].producer;
+            if (producer >= 0 && producer < (int)i)
+                level = std::max(level, layer_levels[producer] + 1);
+        }
+
+        layer_levels[i] = level;
+        level_count = std::max(level_count, level + 1);
     }
 
-    for (size_t i = 0; i < output_blob_indexes.size(); i++)
+    std::vector<int> level_widths(level_count, 0);
+    max_level_width = 0;
+    for (size_t i = 0; i < layers.size(); i++)
     {
-        int blob_index = output_blob_indexes[i];
-        output_blob_names.push_back(blobs[blob_index].name.c_str());
+        max_level_width = std::max(max_level_width, ++level_widths[layer_levels[i]]);
     }
 }
-#endif // NCNN_STRING
 
-Net::Net()
-    : d(new NetPrivate(opt))
+#if NCNN_THREADS
+class BranchScheduler
 {
-}
+public:
+    NetPrivate* d;
+    std::vector<Mat>* blob_mats;
+    Option opt;
 
-Net::~Net()
-{
-    clear();
+    // layers whose bottoms are all ready, lowest level first
+    std::list<int> ready;
+    // bottoms still to be produced per layer
+    std::vector<int> pending;
+    // required consumers per blob
+    std::vector<std::vector<int> > consumers;
+    int remaining;
+    int ret;
 
-    delete d;
-}
+    Mutex lock;
+    ConditionVariable cond;
 
-Net::Net(const Net&)
-    : d(0)
-{
-}
+    void push_ready(int layer_index)
+    {
+        std::list<int>::iterator it = ready.begin();
+        while (it != ready.end() && d->layer_levels[*it] <= d->layer_levels[layer_index])
+            ++it;
+        ready.insert(it, layer_index);
+    }
 
-Net& Net::operator=(const Net&)
+    void run()
+    {
+        Option worker_opt = opt;
+
+        lock.lock();
+        for (;;)
+        {
+            while (ready.empty() && remaining > 0 && ret == 0)
+            {
+                cond.wait(lock);
+            }
+            if (remaining == 0 || ret != 0)
+                break;
+
+            const int layer_index = ready.front();
+            ready.pop_front();
+            lock.unlock();
+
+            // every bottom is ready, forward_layer does not recurse
+            int lret = d->forward_layer(layer_index, *blob_mats, worker_opt);
+
+            lock.lock();
+            remaining--;
+            if (lret != 0)
+            {
+                ret = lret;
+            }
+            else
+            {
+                const Layer* layer = d->layers[layer_index];
+                for (size_t j = 0; j < layer->tops.size(); j++)
+                {
+                    const std::vector<int>& top_consumers = consumers[layer->tops[j]];
+                    for (size_t k = 0; k < top_consumers.size(); k++)
+                    {
+                        if (--pending[top_consumers[k]] == 0)
+                            push_ready(top_consumers[k]);
+                    }
+                }
+            }
+            cond.broadcast();
+        }
+        lock.unlock();
+    }
+};
+
+static void* branch_worker(void* args)
 {
-    return *this;
+    BranchScheduler* scheduler = (BranchScheduler*)args;
+    scheduler->run();
+    return 0;
 }
+#endif // NCNN_THREADS
 
-#if NCNN_STRING
-int Net::register_custom_layer(const char* type, layer_creator_func creator, layer_destroyer_func destroyer, void* userdata)
+int NetPrivate::forward_branches(int blob_index, std::vector<Mat>& blob_mats, const Option& _opt, int inter_op_threads)
 {
-    int typeindex = layer_to_index(type);
-    if (typeindex != -1)
+    Option opt = _opt;
+
+#if NCNN_THREADS
+    if (inter_op_threads <= 1 || max_level_width <= 1 || opt.use_vulkan_compute)
+#endif
     {
-        NCNN_LOGE("can not register build-in layer type %s", type);
-        return -1;
+        // a chain gains nothing, depth first on the caller thread
+        return forward_layer(blobs[blob_index].producer, blob_mats, opt);
     }
 
-    int custom_index = custom_layer_to_index(type);
-    if (custom_index == -1)
+#if NCNN_THREADS
+    // collect the layers still to run for this blob
+    std::vector<char> required(layers.size(), 0);
+    std::vector<int> required_layers;
+    std::vector<int> pending_blobs(1, blob_index);
+    while (!pending_blobs.empty())
     {
-        struct custom_layer_registry_entry entry = {type, creator, destroyer, userdata};
-        d->custom_layer_registry.push_back(entry);
+        const int b = pending_blobs.back();
+        pending_blobs.pop_back();
+
+        const int producer = blobs[b].producer;
+        if (blob_mats[b].dims != 0 || producer < 0 || required[producer])
+            continue;
+
+        required[producer] = 1;
+        required_layers.push_back(producer);
+
+        const Layer* layer = layers[producer];
+        for (size_t j = 0; j < layer->bottoms.size(); j++)
+        {
+            pending_blobs.push_back(layer->bottoms[j]);
+        }
     }
-    else
+
+    // forward_layer only touches the dirty state of its own tops once it is sized
+    if (opt.use_dirty_region && blob_dirty_masks.size() != blobs.size())
     {
-        NCNN_LOGE("overwrite existing custom layer type %s", type);
-        d->custom_layer_registry[custom_index].name = type;
-        d->custom_layer_registry[custom_index].creator = creator;
-        d->custom_layer_registry[custom_index].destroyer = destroyer;
-        d->custom_layer_registry[custom_index].userdata = userdata;
+        blob_dirty_masks.resize(blobs.size());
+        last_blob_mats.resize(blobs.size());
     }
 
-    return 0;
-}
-#endif // NCNN_STRING
+    BranchScheduler scheduler;
+    scheduler.d = this;
+    scheduler.blob_mats = &blob_mats;
+    scheduler.opt = opt;
+    scheduler.opt.num_threads = std::max(opt.num_threads / inter_op_threads, 1);
+    scheduler.pending.assign(layers.size(), 0);
+    scheduler.consumers.resize(blobs.size());
+    scheduler.remaining = (int)required_layers.size();
+    scheduler.ret = 0;
+
+    for (size_t i = 0; i < required_layers.size(); i++)
+    {
+        const int layer_index = required_layers[i];
+        const Layer* layer = layers[layer_index];
+        for (size_t j = 0; j < layer->bottoms.size(); j++)
+        {
+            const int b = layer->bottoms[j];
+            if (blob_mats[b].dims != 0)
+                continue;
 
-int Net::register_custom_layer(int index, layer_creator_func creator, layer_destroyer_func destroyer, void* userdata)
-{
-    int custom_index = index & ~LayerType::CustomBit;
-    if (index == custom_index)
+            scheduler.pending[layer_index]++;
+            scheduler.consumers[b].push_back(layer_index);
+        }
+    }
+
+    for (size_t i = 0; i < required_layers.size(); i++)
     {
-        NCNN_LOGE("can not register build-in layer index %d", custom_index);
-        return -1;
+        if (scheduler.pending[required_layers[i]] == 0)
+            scheduler.push_ready(required_layers[i]);
     }
 
-    if ((int)d->custom_layer_registry.size() <= custom_index)
+    const int worker_count = std::min(inter_op_threads, max_level_width) - 1;
+    std::vector<Thread*> workers(worker_count);
+    for (int i = 0; i < worker_count; i++)
     {
-#if NCNN_STRING
-        struct custom_layer_registry_entry dummy = {"", 0, 0, 0};
-#else
-        struct custom_layer_registry_entry dummy = {0, 0, 0};
-#endif // NCNN_STRING
-        d->custom_layer_registry.resize(custom_index + 1, dummy);
+        workers[i] = new Thread(branch_worker, (void*)&scheduler);
     }
 
-    if (d->custom_layer_registry[custom_index].creator)
+    // the caller thread works too
+    scheduler.run();
+
+    for (int i = 0; i < worker_count; i++)
     {
-        NCNN_LOGE("overwrite existing custom layer index %d", custom_index);
+        workers[i]->join();
+        delete workers[i];
     }
 
-    d->custom_layer_registry[custom_index].creator = creator;
-    d->custom_layer_registry[custom_index].destroyer = destroyer;
-    d->custom_layer_registry[custom_index].userdata = userdata;
-    return 0;
+    return scheduler.ret;
+#endif // NCNN_THREADS
 }
 
-#if NCNN_STRING
-int Net::load_param(const DataReader& dr)
+static bool is_same_frame(const Mat& a, const Mat& b)
 {
-#define SCAN_VALUE(fmt, v)                \
-    if (dr.scan(fmt, &v) != 1)            \
-    {                                     \
-        NCNN_LOGE("parse " #v " failed"); \
-        return -1;                        \
-    }
+    if (a.dims != b.dims || a.w != b.w || a.h != b.h || a.d != b.d || a.c != b.c || a.elemsize != b.elemsize || a.elempack != b.elempack)
+        return false;
 
-    int magic = 0;
-    SCAN_VALUE("%d", magic)
-    if (magic != 7767517)
+    // early exit on the first changed channel, the channel gap excluded
+    const size_t size = (size_t)a.w * a.h * a.d * a.elemsize;
+    for (int q = 0; q < a.c; q++)
     {
-        NCNN_LOGE("param is too old, please regenerate");
-        return -1;
+        if (memcmp(a.channel(q), b.channel(q), size) != 0)
+            return false;
     }
 
-    // parse
-    int layer_count = 0;
-    int blob_count = 0;
-    SCAN_VALUE("%d", layer_count)
-    SCAN_VALUE("%d", blob_count)
-    if (layer_count <= 0 || blob_count <= 0)
+    return true;
+}
+
+int NetPrivate::update_frame_memo(int blob_index, const Mat& in)
+{
+    MutexLockGuard guard(memo_lock);
+
+    if (memo_input_mats.size() != blobs.size())
     {
-        NCNN_LOGE("invalid layer_count or blob_count");
-        return -1;
+        memo_input_mats.resize(blobs.size());
+        memo_output_mats.resize(blobs.size());
     }
 
-    d->layers.resize((size_t)layer_count);
-    d->blobs.resize((size_t)blob_count);
+    if (is_same_frame(in, memo_input_mats[blob_index]))
+        return memo_generation;
 
-#if NCNN_VULKAN
-    // TODO enable gpu when bf16 conversion implemented
-    if (opt.use_bf16_storage)
-        opt.use_vulkan_compute = false;
+    memo_input_mats[blob_index] = in.clone();
 
-    if (opt.use_vulkan_compute)
+    for (size_t i = 0; i < memo_output_mats.size(); i++)
     {
-        if (!d->vkdev) d->vkdev = get_gpu_device();
-        if (!d->vkdev) opt.use_vulkan_compute = false; // no vulkan device, fallback to cpu
+        memo_output_mats[i].release();
     }
-    if (opt.use_vulkan_compute)
-    {
-        // sanitize use options
-        if (!d->vkdev->info.support_fp16_packed()) opt.use_fp16_packed = false;
-        if (!d->vkdev->info.support_fp16_storage()) opt.use_fp16_storage = false;
-        if (!d->vkdev->info.support_fp16_arithmetic()) opt.use_fp16_arithmetic = false;
-        if (!d->vkdev->info.support_int8_storage()) opt.use_int8_storage = false;
-        if (!d->vkdev->info.support_int8_arithmetic()) opt.use_int8_arithmetic = false;
-        if (!d->vkdev->info.support_cooperative_matrix()) opt.use_cooperative_matrix = false;
 
-        if (d->vkdev->info.bug_buffer_image_load_zero()) opt.use_image_storage = false;
+    return ++memo_generation;
+}
 
-        // enable local memory optimization on discrete gpu only
-        if (d->vkdev->info.type() != 0) opt.use_shader_local_memory = false;
+static void dilate_dirty_mask(const Mat& bottom_mask, int w, int h, int outw, int outh, int kernel_extent_w, int kernel_extent_h, int stride_w, int stride_h, Mat& top_mask)
+{
+    // the left padding never exceeds the total padding implied by the shapes
+    const int pad_w = std::max((outw - 1) * stride_w + kernel_extent_w - w, 0);
+    const int pad_h = std::max((outh - 1) * stride_h + kernel_extent_h - h, 0);
 
-        // fp16a makes no sense when fp16 storage disabled
-        if (!opt.use_fp16_packed && !opt.use_fp16_storage) opt.use_fp16_arithmetic = false;
-    }
-    else
-    {
-        // fp16a makes no sense when fp16 storage disabled
-        if (!opt.use_fp16_storage) opt.use_fp16_arithmetic = false;
-    }
-#endif // NCNN_VULKAN
+    const int tiles_w = (outw + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
+    const int tiles_h = (outh + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
 
-    ParamDict pd;
+    top_mask.create(tiles_w, tiles_h, (size_t)1u);
+    if (top_mask.empty())
+        return;
 
-    int blob_index = 0;
-    for (int i = 0; i < layer_count; i++)
+    const unsigned char* bptr = bottom_mask;
+    unsigned char* tptr = top_mask;
+
+    for (int ty = 0; ty < tiles_h; ty++)
     {
-        char layer_type[256];
-        char layer_name[256];
-        int bottom_count = 0;
-        int top_count = 0;
-        SCAN_VALUE("%255s", layer_type)
-        SCAN_VALUE("%255s", layer_name)
-        SCAN_VALUE("%d", bottom_count)
-        SCAN_VALUE("%d", top_count)
+        const int oy0 = ty * NCNN_DIRTY_TILE_SIZE;
+        const int oy1 = std::min(oy0 + NCNN_DIRTY_TILE_SIZE, outh) - 1;
+        const int by0 = std::max(oy0 * stride_h - pad_h, 0) / NCNN_DIRTY_TILE_SIZE;
+        const int by1 = std::min(oy1 * stride_h + kernel_extent_h - 1, h - 1) / NCNN_DIRTY_TILE_SIZE;
 
-        Layer* layer = create_layer(layer_type);
-        if (!layer)
+        for (int tx = 0; tx < tiles_w; tx++)
         {
-            layer = create_custom_layer(layer_type);
-        }
-        if (!layer)
-        {
-            NCNN_LOGE("layer %s not exists or registered", layer_type);
-            clear();
-            return -1;
-        }
+            const int ox0 = tx * NCNN_DIRTY_TILE_SIZE;
+            const int ox1 = std::min(ox0 + NCNN_DIRTY_TILE_SIZE, outw) - 1;
+            const int bx0 = std::max(ox0 * stride_w - pad_w, 0) / NCNN_DIRTY_TILE_SIZE;
+            const int bx1 = std::min(ox1 * stride_w + kernel_extent_w - 1, w - 1) / NCNN_DIRTY_TILE_SIZE;
+
+            unsigned char dirty = 0;
+            for (int by = by0; by <= by1 && !dirty; by++)
+            {
+                for (int bx = bx0; bx <= bx1; bx++)
+                {
+                    if (bptr[by * bottom_mask.w + bx])
+                    {
+                        dirty = 1;
+                        break;
+                    }
+                }
+            }
+
+            tptr[ty * tiles_w + tx] = dirty;
+        }
+    }
+}
+
+static void resize_dirty_mask(const Mat& bottom_mask, int w, int h, int outw, int outh, Mat& top_mask)
+{
+    const int tiles_w = (outw + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
+    const int tiles_h = (outh + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
+
+    top_mask.create(tiles_w, tiles_h, (size_t)1u);
+    if (top_mask.empty())
+        return;
+
+    const unsigned char* bptr = bottom_mask;
+    unsigned char* tptr = top_mask;
+
+    // scaled source window, widened by the bicubic support
+    for (int ty = 0; ty < tiles_h; ty++)
+    {
+        const int oy0 = ty * NCNN_DIRTY_TILE_SIZE;
+        const int oy1 = std::min(oy0 + NCNN_DIRTY_TILE_SIZE, outh);
+        const int by0 = std::max((int)((long)oy0 * h / outh) - 2, 0) / NCNN_DIRTY_TILE_SIZE;
+        const int by1 = std::min((int)(((long)oy1 * h + outh - 1) / outh) + 2, h - 1) / NCNN_DIRTY_TILE_SIZE;
+
+        for (int tx = 0; tx < tiles_w; tx++)
+        {
+            const int ox0 = tx * NCNN_DIRTY_TILE_SIZE;
+            const int ox1 = std::min(ox0 + NCNN_DIRTY_TILE_SIZE, outw);
+            const int bx0 = std::max((int)((long)ox0 * w / outw) - 2, 0) / NCNN_DIRTY_TILE_SIZE;
+            const int bx1 = std::min((int)(((long)ox1 * w + outw - 1) / outw) + 2, w - 1) / NCNN_DIRTY_TILE_SIZE;
+
+            unsigned char dirty = 0;
+            for (int by = by0; by <= by1 && !dirty; by++)
+            {
+                for (int bx = bx0; bx <= bx1; bx++)
+                {
+                    if (bptr[by * bottom_mask.w + bx])
+                    {
+                        dirty = 1;
+                        break;
+                    }
+                }
+            }
+
+            tptr[ty * tiles_w + tx] = dirty;
+        }
+    }
+}
+
+void NetPrivate::update_input_dirty_mask(int blob_index, const Mat& in)
+{
+    if (blob_dirty_masks.size() != blobs.size())
+    {
+        blob_dirty_masks.resize(blobs.size());
+        last_blob_mats.resize(blobs.size());
+    }
+
+    Mat& mask = blob_dirty_masks[blob_index];
+    const Mat& last = last_blob_mats[blob_index];
+
+    mask.release();
+
+    if (in.dims == 3 && in.elemsize == 4u && in.elempack == 1
+            && last.dims == 3 && last.w == in.w && last.h == in.h && last.c == in.c && last.elemsize == in.elemsize && last.elempack == 1)
+    {
+        const int tiles_w = (in.w + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
+        const int tiles_h = (in.h + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE;
+
+        mask.create(tiles_w, tiles_h, (size_t)1u);
+        memset(mask.data, 0, tiles_w * tiles_h);
+
+        unsigned char* mptr = mask;
+
+        for (int q = 0; q < in.c; q++)
+        {
+            const float* ptr0 = in.channel(q);
+            const float* ptr1 = last.channel(q);
+
+            for (int i = 0; i < in.h; i++)
+            {
+                unsigned char* mrow = mptr + (i / NCNN_DIRTY_TILE_SIZE) * tiles_w;
+                for (int j = 0; j < in.w; j++)
+                {
+                    if (ptr0[j] != ptr1[j])
+                        mrow[j / NCNN_DIRTY_TILE_SIZE] = 1;
+                }
+
+                ptr0 += in.w;
+                ptr1 += in.w;
+            }
+        }
+    }
+
+    last_blob_mats[blob_index] = in.clone();
+}
+
+void NetPrivate::propagate_dirty_masks(const Layer* layer, const std::vector<Mat>& blob_mats)
+{
+    if (blob_dirty_masks.size() != blobs.size())
+    {
+        blob_dirty_masks.resize(blobs.size());
+        last_blob_mats.resize(blobs.size());
+    }
+
+    for (size_t i = 0; i < layer->tops.size(); i++)
+    {
+        blob_dirty_masks[layer->tops[i]].release();
+    }
+
+    // the previous output fixes the top geometry
+    const Mat& last_top = last_blob_mats[layer->tops[0]];
+    if (last_top.dims != 3)
+        return;
+
+    for (size_t i = 0; i < layer->tops.size(); i++)
+    {
+        const Mat& last = last_blob_mats[layer->tops[i]];
+        if (last.dims != 3 || last.w != last_top.w || last.h != last_top.h)
+            return;
+    }
+
+    // every bottom must carry a mask for this frame
+    for (size_t i = 0; i < layer->bottoms.size(); i++)
+    {
+        int bottom_blob_index = layer->bottoms[i];
+        const Mat& bottom_blob = blob_mats[bottom_blob_index];
+        const Mat& bottom_mask = blob_dirty_masks[bottom_blob_index];
+        if (bottom_blob.dims != 3 || bottom_mask.empty())
+            return;
+
+        if (bottom_mask.w != (bottom_blob.w + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE || bottom_mask.h != (bottom_blob.h + NCNN_DIRTY_TILE_SIZE - 1) / NCNN_DIRTY_TILE_SIZE)
+            return;
+    }
+
+    const int w = blob_mats[layer->bottoms[0]].w;
+    const int h = blob_mats[layer->bottoms[0]].h;
+    const int outw = last_top.w;
+    const int outh = last_top.h;
+
+    Mat top_mask;
+
+    switch (layer->typeindex)
+    {
+    case LayerType::Convolution:
+    {
+        const Convolution* op = (const Convolution*)layer;
+        if (!op->one_blob_only)
+            return;
+
+        dilate_dirty_mask(blob_dirty_masks[layer->bottoms[0]], w, h, outw, outh, op->dilation_w * (op->kernel_w - 1) + 1, op->dilation_h * (op->kernel_h - 1) + 1, op->stride_w, op->stride_h, top_mask);
+        break;
+    }
+    case LayerType::ConvolutionDepthWise:
+    {
+        const ConvolutionDepthWise* op = (const ConvolutionDepthWise*)layer;
+        if (!op->one_blob_only)
+            return;
+
+        dilate_dirty_mask(blob_dirty_masks[layer->bottoms[0]], w, h, outw, outh, op->dilation_w * (op->kernel_w - 1) + 1, op->dilation_h * (op->kernel_h - 1) + 1, op->stride_w, op->stride_h, top_mask);
+        break;
+    }
+    case LayerType::Pooling:
+    {
+        const Pooling* op = (const Pooling*)layer;
+        if (op->global_pooling || op->adaptive_pooling)
+            return;
+
+        dilate_dirty_mask(blob_dirty_masks[layer->bottoms[0]], w, h, outw, outh, op->kernel_w, op->kernel_h, op->stride_w, op->stride_h, top_mask);
+        break;
+    }
+    case LayerType::Interp:
+    {
+        if (layer->bottoms.size() != 1)
+            return;
+
+        resize_dirty_mask(blob_dirty_masks[layer->bottoms[0]], w, h, outw, outh, top_mask);
+        break;
+    }
+    case LayerType::Concat:
+    {
+        const Concat* op = (const Concat*)layer;
+        if (op->axis != 0 && op->axis != -3)
+            return;
+    }
+    // fall through
+    case LayerType::Eltwise:
+    case LayerType::BinaryOp:
+    {
+        // union of the bottom masks on the same geometry
+        for (size_t i = 0; i < layer->bottoms.size(); i++)
+        {
+            const Mat& bottom_blob = blob_mats[layer->bottoms[i]];
+            if (bottom_blob.w != outw || bottom_blob.h != outh)
+                return;
+        }
+
+        top_mask = blob_dirty_masks[layer->bottoms[0]].clone();
+
+        unsigned char* tptr = top_mask;
+        for (size_t i = 1; i < layer->bottoms.size(); i++)
+        {
+            const unsigned char* bptr = blob_dirty_masks[layer->bottoms[i]];
+            for (int j = 0; j < top_mask.w * top_mask.h; j++)
+            {
+                tptr[j] |= bptr[j];
+            }
+        }
+        break;
+    }
+    case LayerType::AbsVal:
+    case LayerType::BatchNorm:
+    case LayerType::Bias:
+    case LayerType::BNLL:
+    case LayerType::Cast:
+    case LayerType::Clip:
+    case LayerType::Dequantize:
+    case LayerType::Dropout:
+    case LayerType::ELU:
+    case LayerType::Exp:
+    case LayerType::GELU:
+    case LayerType::HardSigmoid:
+    case LayerType::HardSwish:
+    case LayerType::Log:
+    case LayerType::Mish:
+    case LayerType::Noop:
+    case LayerType::Packing:
+    case LayerType::Power:
+    case LayerType::PReLU:
+    case LayerType::Quantize:
+    case LayerType::ReLU:
+    case LayerType::Requantize:
+    case LayerType::Scale:
+    case LayerType::SELU:
+    case LayerType::Sigmoid:
+    case LayerType::Softplus:
+    case LayerType::Split:
+    case LayerType::Swish:
+    case LayerType::TanH:
+    case LayerType::Threshold:
+    case LayerType::UnaryOp:
+    {
+        // pointwise, the mask passes through
+        if (layer->bottoms.size() != 1 || w != outw || h != outh)
+            return;
+
+        top_mask = blob_dirty_masks[layer->bottoms[0]];
+        break;
+    }
+    default:
+        // unknown spatial dependency, treat everything as dirty
+        return;
+    }
+
+    for (size_t i = 0; i < layer->tops.size(); i++)
+    {
+        blob_dirty_masks[layer->tops[i]] = top_mask;
+    }
+}
+
+#if NCNN_STRING
+void NetPrivate::update_input_output_names()
+{
+    input_blob_names.clear();
+    output_blob_names.clear();
+
+    for (size_t i = 0; i < input_blob_indexes.size(); i++)
+    {
+        int blob_index = input_blob_indexes[i];
+        input_blob_names.push_back(blobs[blob_index].name.c_str());
+    }
+
+    for (size_t i = 0; i < output_blob_indexes.size(); i++)
+    {
+        int blob_index = output_blob_indexes[i];
+        output_blob_names.push_back(blobs[blob_index].name.c_str());
+    }
+}
+#endif // NCNN_STRING
+
+Net::Net()
+    : d(new NetPrivate(opt))
+{
+}
+
+Net::~Net()
+{
+    clear();
+
+    delete d;
+}
+
+Net::Net(const Net&)
+    : d(0)
+{
+}
+
+Net& Net::operator=(const Net&)
+{
+    return *this;
+}
+
+#if NCNN_STRING
+int Net::register_custom_layer(const char* type, layer_creator_func creator, layer_destroyer_func destroyer, void* userdata)
+{
+    int typeindex = layer_to_index(type);
+    if (typeindex != -1)
+    {
+        NCNN_LOGE("can not register build-in layer type %s", type);
+        return -1;
+    }
+
+    int custom_index = custom_layer_to_index(type);
+    if (custom_index == -1)
+    {
+        struct custom_layer_registry_entry entry = {type, creator, destroyer, userdata};
+        d->custom_layer_registry.push_back(entry);
+    }
+    else
+    {
+        NCNN_LOGE("overwrite existing custom layer type %s", type);
+        d->custom_layer_registry[custom_index].name = type;
+        d->custom_layer_registry[custom_index].creator = creator;
+        d->custom_layer_registry[custom_index].destroyer = destroyer;
+        d->custom_layer_registry[custom_index].userdata = userdata;
+    }
+
+    return 0;
+}
+#endif // NCNN_STRING
+
+int Net::register_custom_layer(int index, layer_creator_func creator, layer_destroyer_func destroyer, void* userdata)
+{
+    int custom_index = index & ~LayerType::CustomBit;
+    if (index == custom_index)
+    {
+        NCNN_LOGE("can not register build-in layer index %d", custom_index);
+        return -1;
+    }
+
+    if ((int)d->custom_layer_registry.size() <= custom_index)
+    {
+#if NCNN_STRING
+        struct custom_layer_registry_entry dummy = {"", 0, 0, 0};
+#else
+        struct custom_layer_registry_entry dummy = {0, 0, 0};
+#endif // NCNN_STRING
+        d->custom_layer_registry.resize(custom_index + 1, dummy);
+    }
+
+    if (d->custom_layer_registry[custom_index].creator)
+    {
+        NCNN_LOGE("overwrite existing custom layer index %d", custom_index);
+    }
+
+    d->custom_layer_registry[custom_index].creator = creator;
+    d->custom_layer_registry[custom_index].destroyer = destroyer;
+    d->custom_layer_registry[custom_index].userdata = userdata;
+    return 0;
+}
+
+#if NCNN_STRING
+int Net::load_param(const DataReader& dr)
+{
+#define SCAN_VALUE(fmt, v)                \
+    if (dr.scan(fmt, &v) != 1)            \
+    {                                     \
+        NCNN_LOGE("parse " #v " failed"); \
+        return -1;                        \
+    }
+
+    int magic = 0;
+    SCAN_VALUE("%d", magic)
+    if (magic != 7767517)
+    {
+        NCNN_LOGE("param is too old, please regenerate");
+        return -1;
+    }
+
+    // parse
+    int layer_count = 0;
+    int blob_count = 0;
+    SCAN_VALUE("%d", layer_count)
+    SCAN_VALUE("%d", blob_count)
+    if (layer_count <= 0 || blob_count <= 0)
+    {
+        NCNN_LOGE("invalid layer_count or blob_count");
+        return -1;
+    }
+
+    d->layers.resize((size_t)layer_count);
+    d->blobs.resize((size_t)blob_count);
+
+#if NCNN_VULKAN
+    // TODO enable gpu when bf16 conversion implemented
+    if (opt.use_bf16_storage)
+        opt.use_vulkan_compute = false;
+
+    if (opt.use_vulkan_compute)
+    {
+        if (!d->vkdev) d->vkdev = get_gpu_device();
+        if (!d->vkdev) opt.use_vulkan_compute = false; // no vulkan device, fallback to cpu
+    }
+    if (opt.use_vulkan_compute)
+    {
+        // sanitize use options
+        if (!d->vkdev->info.support_fp16_packed()) opt.use_fp16_packed = false;
+        if (!d->vkdev->info.support_fp16_storage()) opt.use_fp16_storage = false;
+        if (!d->vkdev->info.support_fp16_arithmetic()) opt.use_fp16_arithmetic = false;
+        if (!d->vkdev->info.support_int8_storage()) opt.use_int8_storage = false;
+        if (!d->vkdev->info.support_int8_arithmetic()) opt.use_int8_arithmetic = false;
+        if (!d->vkdev->info.support_cooperative_matrix()) opt.use_cooperative_matrix = false;
+
+        if (d->vkdev->info.bug_buffer_image_load_zero()) opt.use_image_storage = false;
+
+        // enable local memory optimization on discrete gpu only
+        if (d->vkdev->info.type() != 0) opt.use_shader_local_memory = false;
+
+        // fp16a makes no sense when fp16 storage disabled
+        if (!opt.use_fp16_packed && !opt.use_fp16_storage) opt.use_fp16_arithmetic = false;
+    }
+    else
+    {
+        // fp16a makes no sense when fp16 storage disabled
+        if (!opt.use_fp16_storage) opt.use_fp16_arithmetic = false;
+    }
+#endif // NCNN_VULKAN
+
+    ParamDict pd;
+
+    int blob_index = 0;
+    for (int i = 0; i < layer_count; i++)
+    {
+        char layer_type[256];
+        char layer_name[256];
+        int bottom_count = 0;
+        int top_count = 0;
+        SCAN_VALUE("%255s", layer_type)
+        SCAN_VALUE("%255s", layer_name)
+        SCAN_VALUE("%d", bottom_count)
+        SCAN_VALUE("%d", top_count)
+
+        Layer* layer = create_layer(layer_type);
+        if (!layer)
+        {
+            layer = create_custom_layer(layer_type);
+        }
+        if (!layer)
+        {
+            NCNN_LOGE("layer %s not exists or registered", layer_type);
+            clear();
+            return -1;
+        }
 
 #if NCNN_VULKAN
         if (opt.use_vulkan_compute)
@@ -1632,6 +2305,7 @@ int Net::load_param(const DataReader& dr)
 
     d->update_input_output_indexes();
     d->update_input_output_names();
+    d->update_layer_levels();
 
 #undef SCAN_VALUE
     return 0;
@@ -1838,11 +2512,340 @@ int Net::load_param_bin(const DataReader& dr)
     }
 
     d->update_input_output_indexes();
+    d->update_layer_levels();
 
 #undef READ_VALUE
     return 0;
 }
 
+// the weight bytes passing through are hashed to key the weight cache
+class DataReaderHashing : public DataReader
+{
+public:
+    DataReaderHashing(const DataReader& _dr)
+        : dr(_dr), hash(14695981039346656037ULL)
+    {
+    }
+
+    virtual size_t read(void* buf, size_t size) const
+    {
+        size_t nread = dr.read(buf, size);
+        update(buf, nread);
+        return nread;
+    }
+
+    virtual size_t reference(size_t size, const void** buf) const
+    {
+        size_t nread = dr.reference(size, buf);
+        if (nread)
+            update(*buf, nread);
+        return nread;
+    }
+
+    void update(const void* data, size_t size) const
+    {
+        // fnv-1a over 8 byte words, the model data is long
+        const unsigned char* ptr = (const unsigned char*)data;
+        size_t i = 0;
+        for (; i + 7 < size; i += 8)
+        {
+            uint64_t v;
+            memcpy(&v, ptr + i, 8);
+            hash ^= v;
+            hash *= 1099511628211ULL;
+        }
+        for (; i < size; i++)
+        {
+            hash ^= ptr[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    const DataReader& dr;
+    mutable uint64_t hash;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* ptr = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= ptr[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t hash_mat(uint64_t hash, const Mat& m)
+{
+    if (m.empty())
+        return hash_bytes(hash, "", 1);
+
+    return hash_bytes(hash, m.data, m.total() * m.elemsize);
+}
+
+static uint64_t weight_cache_key(int layer_index, const Layer* layer, uint64_t weight_hash, const Option& opt)
+{
+    // everything create_pipeline may depend on besides the layer weights
+    const int values[24] = {
+        2, // format version
+        layer_index,
+        layer->typeindex,
+        opt.use_winograd_convolution,
+        opt.use_sgemm_convolution,
+        opt.use_int8_inference,
+        opt.use_packing_layout,
+        opt.use_fp16_packed,
+        opt.use_fp16_storage,
+        opt.use_fp16_arithmetic,
+        opt.use_bf16_storage,
+        opt.use_temporal_sparsity,
+        opt.use_spatial_sparsity,
+        cpu_support_arm_neon(),
+        cpu_support_arm_vfpv4(),
+        cpu_support_arm_asimdhp(),
+        cpu_support_arm_asimddp(),
+        cpu_support_x86_avx(),
+        cpu_support_x86_fma(),
+        cpu_support_x86_f16c(),
+        cpu_support_x86_avx2(),
+        cpu_support_x86_avx_vnni(),
+        cpu_support_x86_avx512(),
+        cpu_support_x86_avx512_vnni(),
+    };
+
+    uint64_t hash = hash_bytes(weight_hash, values, sizeof(values));
+
+    if (layer->typeindex == LayerType::Convolution)
+    {
+        // the params selecting the fused activation, the sparse kernels and the quantization
+        const Convolution* op = (const Convolution*)layer;
+
+        const int params[6] = {
+            op->activation_type,
+            op->sparse_mode,
+            op->temporal_kernel,
+            op->spatial_kernel,
+            op->int8_scale_term,
+            op->dynamic_weight,
+        };
+
+        hash = hash_bytes(hash, params, sizeof(params));
+        hash = hash_mat(hash, op->activation_params);
+#if NCNN_INT8
+        hash = hash_mat(hash, op->weight_data_int8_scales);
+        hash = hash_mat(hash, op->bottom_blob_int8_scales);
+        hash = hash_mat(hash, op->top_blob_int8_scales);
+#endif // NCNN_INT8
+    }
+
+    return hash;
+}
+
+// transformed layer weights persisted across process starts
+// file = magic, entry count, then per entry the key, mat count and mats
+// each mat = dims w h d c elempack elemsize bytes, the data 64 byte aligned in the file
+class WeightCache
+{
+public:
+    WeightCache()
+        : dirty(false)
+    {
+    }
+
+#if NCNN_STDIO
+    // map the cache file, the mapping joins the model mappings of the net
+    int load(const char* path, std::vector<DataReaderFromMmap*>& mmaps);
+
+    // write the entries to a new file renamed over path
+    int save(const char* path) const;
+#endif // NCNN_STDIO
+
+    int get(uint64_t key, std::vector<Mat>& mats) const;
+    void put(uint64_t key, const std::vector<Mat>& mats);
+
+public:
+    std::vector<uint64_t> keys;
+    std::vector<std::vector<Mat> > entries;
+    bool dirty;
+};
+
+#define NCNN_WEIGHT_CACHE_MAGIC 0x6377636e
+
+int WeightCache::get(uint64_t key, std::vector<Mat>& mats) const
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == key)
+        {
+            mats = entries[i];
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void WeightCache::put(uint64_t key, const std::vector<Mat>& mats)
+{
+    keys.push_back(key);
+    entries.push_back(mats);
+    dirty = true;
+}
+
+#if NCNN_STDIO
+int WeightCache::load(const char* path, std::vector<DataReaderFromMmap*>& mmaps)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        // created after this load
+        return 0;
+    }
+    fclose(fp);
+
+    DataReaderFromMmap* dr = new DataReaderFromMmap(path);
+
+    size_t offset = 0;
+
+    int header[2] = {0, 0};
+    offset += dr->read(header, sizeof(header));
+    if (header[0] != NCNN_WEIGHT_CACHE_MAGIC || header[1] < 0)
+    {
+        NCNN_LOGE("weight cache %s corrupted", path);
+        delete dr;
+        return -1;
+    }
+
+    mmaps.push_back(dr);
+
+    for (int i = 0; i < header[1]; i++)
+    {
+        uint64_t key = 0;
+        int mat_count = 0;
+        offset += dr->read(&key, sizeof(key));
+        offset += dr->read(&mat_count, sizeof(mat_count));
+
+        std::vector<Mat> mats(mat_count > 0 ? mat_count : 0);
+        for (int j = 0; j < mat_count; j++)
+        {
+            int shape[6] = {0, 0, 0, 0, 0, 0};
+            uint64_t elemsize = 0;
+            uint64_t nbytes = 0;
+            offset += dr->read(shape, sizeof(shape));
+            offset += dr->read(&elemsize, sizeof(elemsize));
+            offset += dr->read(&nbytes, sizeof(nbytes));
+
+            if (shape[0] == 0)
+                continue;
+
+            const size_t pad = alignSize(offset, 64) - offset;
+            unsigned char padding[64];
+            offset += dr->read(padding, pad);
+
+            const void* data = 0;
+            if (dr->reference((size_t)nbytes, &data) != (size_t)nbytes)
+            {
+                NCNN_LOGE("weight cache %s truncated", path);
+                keys.clear();
+                entries.clear();
+                return -1;
+            }
+            offset += (size_t)nbytes;
+
+            const int dims = shape[0];
+            const int w = shape[1];
+            const int h = shape[2];
+            const int d = shape[3];
+            const int c = shape[4];
+            const int elempack = shape[5];
+
+            Mat m;
+            if (dims == 1) m = Mat(w, (void*)data, (size_t)elemsize, elempack);
+            if (dims == 2) m = Mat(w, h, (void*)data, (size_t)elemsize, elempack);
+            if (dims == 3) m = Mat(w, h, c, (void*)data, (size_t)elemsize, elempack);
+            if (dims == 4) m = Mat(w, h, d, c, (void*)data, (size_t)elemsize, elempack);
+
+            if (m.cstep * m.c * m.elemsize != nbytes)
+            {
+                NCNN_LOGE("weight cache %s corrupted", path);
+                keys.clear();
+                entries.clear();
+                return -1;
+            }
+
+            mats[j] = m;
+        }
+
+        keys.push_back(key);
+        entries.push_back(mats);
+    }
+
+    return 0;
+}
+
+int WeightCache::save(const char* path) const
+{
+    // the current file may still be mapped, never write into it
+    std::string tmppath = std::string(path) + ".tmp";
+
+    FILE* fp = fopen(tmppath.c_str(), "wb");
+    if (!fp)
+    {
+        NCNN_LOGE("fopen %s failed", tmppath.c_str());
+        return -1;
+    }
+
+    size_t offset = 0;
+
+    const int header[2] = {NCNN_WEIGHT_CACHE_MAGIC, (int)keys.size()};
+    offset += fwrite(header, 1, sizeof(header), fp);
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        const std::vector<Mat>& mats = entries[i];
+
+        const int mat_count = (int)mats.size();
+        offset += fwrite(&keys[i], 1, sizeof(uint64_t), fp);
+        offset += fwrite(&mat_count, 1, sizeof(mat_count), fp);
+
+        for (int j = 0; j < mat_count; j++)
+        {
+            const Mat& m = mats[j];
+
+            const int shape[6] = {m.empty() ? 0 : m.dims, m.w, m.h, m.d, m.c, m.elempack};
+            const uint64_t elemsize = m.elemsize;
+            const uint64_t nbytes = m.empty() ? 0 : (uint64_t)m.cstep * m.c * m.elemsize;
+            offset += fwrite(shape, 1, sizeof(shape), fp);
+            offset += fwrite(&elemsize, 1, sizeof(elemsize), fp);
+            offset += fwrite(&nbytes, 1, sizeof(nbytes), fp);
+
+            if (m.empty())
+                continue;
+
+            const unsigned char padding[64] = {0};
+            offset += fwrite(padding, 1, alignSize(offset, 64) - offset, fp);
+
+            offset += fwrite(m.data, 1, (size_t)nbytes, fp);
+        }
+    }
+
+    fclose(fp);
+
+#if _WIN32
+    remove(path);
+#endif
+    if (rename(tmppath.c_str(), path) != 0)
+    {
+        NCNN_LOGE("rename %s failed", tmppath.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+#endif // NCNN_STDIO
+
 int Net::load_model(const DataReader& dr)
 {
     if (d->layers.empty())
@@ -1856,11 +2859,27 @@ int Net::load_model(const DataReader& dr)
     // load file
     int ret = 0;
 
-    ModelBinFromDataReader mb(dr);
+    WeightCache weight_cache;
+    bool use_weight_cache = false;
+#if NCNN_STDIO
+    if (!d->weight_cache_path.empty() && !opt.use_vulkan_compute)
+    {
+        // a missing or broken cache file is rewritten
+        weight_cache.load(d->weight_cache_path.c_str(), d->model_mmaps);
+        use_weight_cache = true;
+    }
+#endif // NCNN_STDIO
+
+    DataReaderHashing drh(dr);
+    std::vector<uint64_t> weight_hashes(layer_count, 0);
+
+    ModelBinFromDataReader mb(use_weight_cache ? (const DataReader&)drh : dr);
     for (int i = 0; i < layer_count; i++)
     {
         Layer* layer = d->layers[i];
 
+        drh.hash = 14695981039346656037ULL;
+
         //Here we found inconsistent content in the parameter file.
         if (!layer)
         {
@@ -1881,6 +2900,8 @@ int Net::load_model(const DataReader& dr)
             break;
         }
 
+        weight_hashes[i] = drh.hash;
+
         if (layer->support_int8_storage)
         {
             // no int8 gpu support yet
@@ -1888,6 +2909,12 @@ int Net::load_model(const DataReader& dr)
         }
     }
 
+    if (ret != 0)
+    {
+        // a truncated or corrupt model leaves layers without weights, skip their pipelines
+        return ret;
+    }
+
 #if NCNN_VULKAN
     if (opt.use_vulkan_compute)
     {
@@ -1912,7 +2939,33 @@ int Net::load_model(const DataReader& dr)
         }
 #endif // NCNN_VULKAN
 
-        int cret = layer->create_pipeline(opt1);
+        int cret = -1;
+        if (use_weight_cache)
+        {
+            const uint64_t key = weight_cache_key(i, layer, weight_hashes[i], opt1);
+
+            std::vector<Mat> mats;
+            if (weight_cache.get(key, mats) == 0)
+            {
+                cret = layer->load_pipeline(mats, opt1);
+            }
+
+            if (cret != 0)
+            {
+                cret = layer->create_pipeline(opt1);
+
+                mats.clear();
+                if (cret == 0 && layer->save_pipeline(mats) == 0)
+                {
+                    weight_cache.put(key, mats);
+                }
+            }
+        }
+        else
+        {
+            cret = layer->create_pipeline(opt1);
+        }
+
         if (cret != 0)
         {
 #if NCNN_STRING
@@ -1925,6 +2978,13 @@ int Net::load_model(const DataReader& dr)
         }
     }
 
+#if NCNN_STDIO
+    if (use_weight_cache && ret == 0 && weight_cache.dirty)
+    {
+        weight_cache.save(d->weight_cache_path.c_str());
+    }
+#endif // NCNN_STDIO
+
     if (opt.use_local_pool_allocator)
     {
         if (opt.blob_allocator == 0)
@@ -2024,6 +3084,105 @@ int Net::load_model(const char* modelpath)
     fclose(fp);
     return ret;
 }
+
+void Net::set_weight_cache_path(const char* path)
+{
+    d->weight_cache_path = path ? path : "";
+}
+
+int Net::load_model_mmap(const char* modelpath)
+{
+    DataReaderFromMmap* dr = new DataReaderFromMmap(modelpath);
+    if (dr->size() == 0)
+    {
+        delete dr;
+        return -1;
+    }
+
+    // layers may reference the mapping even if loading fails halfway
+    d->model_mmaps.push_back(dr);
+
+    return load_model(*dr);
+}
+
+#if NCNN_STRING
+int Net::load_sparsity_table(const char* tablepath)
+{
+    FILE* fp = fopen(tablepath, "rb");
+    if (!fp)
+    {
+        NCNN_LOGE("fopen %s failed", tablepath);
+        return -1;
+    }
+
+    // one convolution per line
+    // layer_name mode temporal_or_spatial_kernel refresh_interval
+    int ret = 0;
+    char line[1024];
+    while (fgets(line, 1024, fp))
+    {
+        if (line[0] == '#')
+            continue;
+
+        char layer_name[256];
+        char mode[16];
+        int kernel = 0;
+        int refresh_interval = 0;
+        int nscan = sscanf(line, "%255s %15s %d %d", layer_name, mode, &kernel, &refresh_interval);
+        if (nscan <= 0)
+            continue;
+
+        if (nscan != 4)
+        {
+            NCNN_LOGE("malformed sparsity table line %s", line);
+            ret = -1;
+            break;
+        }
+
+        int layer_index = find_layer_index_by_name(layer_name);
+        if (layer_index == -1)
+        {
+            ret = -1;
+            break;
+        }
+
+        Layer* layer = d->layers[layer_index];
+        if (layer->type != "Convolution")
+        {
+            NCNN_LOGE("sparsity table layer %s is not a Convolution", layer_name);
+            ret = -1;
+            break;
+        }
+
+        Convolution* conv = (Convolution*)layer;
+        if (strcmp(mode, "dense") == 0)
+        {
+            conv->sparse_mode = 0;
+        }
+        else if (strcmp(mode, "temporal") == 0)
+        {
+            conv->sparse_mode = 1;
+            conv->temporal_kernel = kernel;
+        }
+        else if (strcmp(mode, "spatial") == 0)
+        {
+            conv->sparse_mode = 2;
+            conv->spatial_kernel = kernel;
+        }
+        else
+        {
+            NCNN_LOGE("unknown sparsity mode %s for layer %s", mode, layer_name);
+            ret = -1;
+            break;
+        }
+        conv->refresh_interval = refresh_interval;
+        conv->reset_state();
+    }
+
+    fclose(fp);
+    return ret;
+}
+#endif // NCNN_STRING
 #endif // NCNN_STDIO
 
 int Net::load_param(const unsigned char* _mem)
@@ -2108,8 +3267,37 @@ int Net::load_model(AAssetManager* mgr, const char* assetpath)
 #endif // __ANDROID_API__ >= 9
 #endif // NCNN_PLATFORM_API
 
+void Net::reset_state()
+{
+    d->memo_lock.lock();
+    d->memo_generation++;
+    d->memo_input_mats.clear();
+    d->memo_output_mats.clear();
+    d->memo_lock.unlock();
+
+    d->blob_dirty_masks.clear();
+    d->last_blob_mats.clear();
+
+    for (size_t i = 0; i < d->layers.size(); i++)
+    {
+        d->layers[i]->reset_state();
+    }
+}
+
 void Net::clear()
 {
+    d->memo_lock.lock();
+    d->memo_generation++;
+    d->memo_input_mats.clear();
+    d->memo_output_mats.clear();
+    d->memo_lock.unlock();
+
+    d->blob_dirty_masks.clear();
+    d->last_blob_mats.clear();
+
+    d->layer_levels.clear();
+    d->max_level_width = 0;
+
     d->blobs.clear();
     for (size_t i = 0; i < d->layers.size(); i++)
     {
@@ -2145,7 +3333,16 @@ void Net::clear()
             delete layer;
         }
     }
-    d->layers.clear();
+    d->layers.clear();
+
+#if NCNN_STDIO
+    // after the layers releasing the referenced weights
+    for (size_t i = 0; i < d->model_mmaps.size(); i++)
+    {
+        delete d->model_mmaps[i];
+    }
+    d->model_mmaps.clear();
+#endif // NCNN_STDIO
 
     if (d->local_blob_allocator)
     {
@@ -2320,6 +3517,11 @@ public:
     Net* net;
     std::vector<Mat> blob_mats;
     Option opt;
+    int inter_op_threads;
+    ArenaAllocator* static_arena;
+
+    // the frame memo generation of the last input, -1 before any input
+    int memo_generation;
 
 #if NCNN_VULKAN
     VkAllocator* local_blob_vkallocator;
@@ -2335,6 +3537,9 @@ Extractor::Extractor(Net* _net, size_t blob_count)
 {
     d->blob_mats.resize(blob_count);
     d->opt = d->net->opt;
+    d->inter_op_threads = 1;
+    d->static_arena = 0;
+    d->memo_generation = -1;
 
 #if NCNN_VULKAN
     if (d->net->opt.use_vulkan_compute)
@@ -2361,6 +3566,8 @@ Extractor::Extractor(const Extractor& rhs)
     d->net = rhs.d->net;
     d->blob_mats = rhs.d->blob_mats;
     d->opt = rhs.d->opt;
+    d->inter_op_threads = rhs.d->inter_op_threads;
+    d->static_arena = rhs.d->static_arena;
 
 #if NCNN_VULKAN
     d->local_blob_vkallocator = 0;
@@ -2379,6 +3586,8 @@ Extractor& Extractor::operator=(const Extractor& rhs)
     d->net = rhs.d->net;
     d->blob_mats = rhs.d->blob_mats;
     d->opt = rhs.d->opt;
+    d->inter_op_threads = rhs.d->inter_op_threads;
+    d->static_arena = rhs.d->static_arena;
 
 #if NCNN_VULKAN
     d->local_blob_vkallocator = 0;
@@ -2423,6 +3632,11 @@ void Extractor::set_num_threads(int num_threads)
     d->opt.num_threads = num_threads;
 }
 
+void Extractor::set_inter_op_threads(int inter_op_threads)
+{
+    d->inter_op_threads = std::max(inter_op_threads, 1);
+}
+
 void Extractor::set_blob_allocator(Allocator* allocator)
 {
     d->opt.blob_allocator = allocator;
@@ -2433,6 +3647,56 @@ void Extractor::set_workspace_allocator(Allocator* allocator)
     d->opt.workspace_allocator = allocator;
 }
 
+void Extractor::set_static_arena(ArenaAllocator* arena)
+{
+    d->static_arena = arena;
+    d->opt.blob_allocator = arena;
+    d->opt.workspace_allocator = arena;
+
+    if (arena)
+    {
+        arena->begin_frame();
+    }
+}
+
+std::vector<LayerStats> Extractor::get_layer_stats()
+{
+    const std::vector<Layer*>& layers = d->net->d->layers;
+    const std::vector<Mat>& last_blob_mats = d->net->d->last_blob_mats;
+
+    std::vector<LayerStats> stats(layers.size());
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        const Layer* layer = layers[i];
+
+        stats[i] = layer->stats;
+
+        for (size_t j = 0; j < layer->tops.size(); j++)
+        {
+            int top_blob_index = layer->tops[j];
+            if (top_blob_index < (int)last_blob_mats.size())
+            {
+                const Mat& m = last_blob_mats[top_blob_index];
+                stats[i].state_bytes += m.cstep * m.c * m.elemsize;
+            }
+        }
+    }
+
+    return stats;
+}
+
+void Extractor::reset_layer_stats()
+{
+    const std::vector<Layer*>& layers = d->net->d->layers;
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        // state bytes describe the current state, not an accumulation
+        size_t state_bytes = layers[i]->stats.state_bytes;
+        layers[i]->stats.reset();
+        layers[i]->stats.state_bytes = state_bytes;
+    }
+}
+
 #if NCNN_VULKAN
 void Extractor::set_vulkan_compute(bool enable)
 {
@@ -2507,6 +3771,16 @@ int Extractor::input(int blob_index, const Mat& in)
 
     d->blob_mats[blob_index] = in;
 
+    if (d->opt.use_frame_memoization)
+    {
+        d->memo_generation = d->net->d->update_frame_memo(blob_index, in);
+    }
+
+    if (d->opt.use_dirty_region)
+    {
+        d->net->d->update_input_dirty_mask(blob_index, in);
+    }
+
     return 0;
 }
 
@@ -2523,10 +3797,19 @@ int Extractor::extract(int blob_index, Mat& feat, int type)
 
     int ret = 0;
 
-    if (d->blob_mats[blob_index].dims == 0)
+    if (d->opt.use_frame_memoization && d->blob_mats[blob_index].dims == 0)
     {
-        int layer_index = d->net->blobs()[blob_index].producer;
+        // all inputs unchanged since this output was extracted
+        NetPrivate* net_d = d->net->d;
+        MutexLockGuard guard(net_d->memo_lock);
+        if (d->memo_generation == net_d->memo_generation && blob_index < (int)net_d->memo_output_mats.size() && net_d->memo_output_mats[blob_index].dims != 0)
+        {
+            d->blob_mats[blob_index] = net_d->memo_output_mats[blob_index];
+        }
+    }
 
+    if (d->blob_mats[blob_index].dims == 0)
+    {
         // use local allocator
         if (d->opt.use_local_pool_allocator)
         {
@@ -2540,6 +3823,10 @@ int Extractor::extract(int blob_index, Mat& feat, int type)
             }
         }
 
+        // the static arena replays the allocation order of the recorded frame
+        // concurrent branches allocate in any order, so they run depth first
+        const int inter_op_threads = d->static_arena ? 1 : d->inter_op_threads;
+
 #if NCNN_VULKAN
         if (d->opt.use_vulkan_compute)
         {
@@ -2622,17 +3909,30 @@ int Extractor::extract(int blob_index, Mat& feat, int type)
         }
         else
         {
-            ret = d->net->d->forward_layer(layer_index, d->blob_mats, d->opt);
+            ret = d->net->d->forward_branches(blob_index, d->blob_mats, d->opt, inter_op_threads);
         }
 #else
-//        fprintf(stderr, "start forward\n");
-        ret = d->net->d->forward_layer(layer_index, d->blob_mats, d->opt);
-//        fprintf(stderr, "end forward\n");
+        ret = d->net->d->forward_branches(blob_index, d->blob_mats, d->opt, inter_op_threads);
 #endif // NCNN_VULKAN
     }
 
     feat = d->blob_mats[blob_index];
 
+    if (d->opt.use_frame_memoization && ret == 0)
+    {
+        // another extractor may have fed a newer frame meanwhile
+        NetPrivate* net_d = d->net->d;
+        MutexLockGuard guard(net_d->memo_lock);
+        if (d->memo_generation == net_d->memo_generation && blob_index < (int)net_d->memo_output_mats.size())
+        {
+            // the memo outlives the frame, keep it out of the replayed arena
+            if (d->static_arena && feat.allocator == d->static_arena)
+                net_d->memo_output_mats[blob_index] = feat.clone();
+            else
+                net_d->memo_output_mats[blob_index] = feat;
+        }
+    }
+
     if (d->opt.use_packing_layout && (type == 0) && feat.elempack != 1)
     {
         Mat bottom_blob_unpacked;
@@ -2682,6 +3982,14 @@ int Extractor::extract(int blob_index, Mat& feat, int type)
         feat = feat.clone();
     }
 
+    if (d->static_arena)
+    {
+        // the arena is replayed by the next frame
+        // the blobs retained for the dirty region never come from it
+        if (feat.allocator == d->static_arena)
+            feat = feat.clone();
+    }
+
     set_kmp_blocktime(old_blocktime);
     set_flush_denormals(old_flush_denormals);
 
@@ -2870,4 +4178,432 @@ int Extractor::extract(int blob_index, VkImageMat& feat, VkCompute& cmd)
 }
 #endif // NCNN_VULKAN
 
+
+class StreamFrame
+{
+public:
+    StreamFrame(Net* net)
+        : ex(net->create_extractor()), blob_mats(0), ret(0)
+    {
+    }
+
+    Extractor ex;
+    // points into ex
+    std::vector<Mat>* blob_mats;
+    int ret;
+};
+
+class StreamFrameQueue
+{
+public:
+    // capacity 0 means unbounded
+    StreamFrameQueue(size_t _capacity)
+        : capacity(_capacity)
+    {
+    }
+
+    ~StreamFrameQueue()
+    {
+        std::list<StreamFrame*>::iterator it = frames.begin();
+        for (; it != frames.end(); it++)
+        {
+            delete *it;
+        }
+    }
+
+    void put(StreamFrame* frame)
+    {
+        lock.lock();
+        while (capacity != 0 && frames.size() >= capacity)
+        {
+            cond.wait(lock);
+        }
+        frames.push_back(frame);
+        cond.broadcast();
+        lock.unlock();
+    }
+
+    StreamFrame* take()
+    {
+        lock.lock();
+        while (frames.empty())
+        {
+            cond.wait(lock);
+        }
+        StreamFrame* frame = frames.front();
+        frames.pop_front();
+        cond.broadcast();
+        lock.unlock();
+        return frame;
+    }
+
+private:
+    size_t capacity;
+    std::list<StreamFrame*> frames;
+    Mutex lock;
+    ConditionVariable cond;
+};
+
+class StreamExecutorPrivate;
+class StreamStage
+{
+public:
+    StreamExecutorPrivate* d;
+    std::vector<int> layer_indexes;
+    StreamFrameQueue* in;
+    StreamFrameQueue* out;
+    Option opt;
+    Thread* thread;
+};
+
+class StreamExecutorPrivate
+{
+public:
+    StreamExecutorPrivate(Net* _net, NetPrivate* _net_d)
+        : net(_net), net_d(_net_d)
+    {
+    }
+
+    int forward_layers(StreamFrame* frame, const std::vector<int>& layer_indexes, const Option& opt, double* layer_times = 0);
+    void split_stages(const std::vector<double>& layer_times);
+
+    Net* net;
+    NetPrivate* net_d;
+    std::vector<int> output_blob_indexes;
+    int stage_count;
+    int queue_size;
+    bool lightmode;
+
+    // layers required by the outputs, in execution order
+    std::vector<int> layer_indexes;
+
+    std::vector<StreamStage> stages;
+    // queues[i] feeds stages[i], queues[stage_count] holds the finished frames
+    std::vector<StreamFrameQueue*> queues;
+    bool started;
+};
+
+static void* stream_stage_worker(void* args)
+{
+    StreamStage* stage = (StreamStage*)args;
+
+    for (;;)
+    {
+        StreamFrame* frame = stage->in->take();
+        if (!frame)
+        {
+            // end of stream, pass it down
+            stage->out->put(0);
+            break;
+        }
+
+        if (frame->ret == 0)
+        {
+            frame->ret = stage->d->forward_layers(frame, stage->layer_indexes, stage->opt);
+        }
+
+        stage->out->put(frame);
+    }
+
+    return 0;
+}
+
+int StreamExecutorPrivate::forward_layers(StreamFrame* frame, const std::vector<int>& _layer_indexes, const Option& _opt, double* layer_times)
+{
+    std::vector<Mat>& blob_mats = *frame->blob_mats;
+    Option opt = _opt;
+
+    for (size_t i = 0; i < _layer_indexes.size(); i++)
+    {
+        const int layer_index = _layer_indexes[i];
+        const Layer* layer = net_d->layers[layer_index];
+
+        // input layers and layers already pulled in by an earlier producer chain
+        bool forwarded = true;
+        for (size_t j = 0; j < layer->tops.size(); j++)
+        {
+            if (blob_mats[layer->tops[j]].dims == 0)
+            {
+                forwarded = false;
+                break;
+            }
+        }
+        if (forwarded)
+        {
+            if (layer_times)
+                layer_times[i] = 0.0;
+            continue;
+        }
+
+        double start = layer_times ? get_current_time() : 0.0;
+
+        int ret = net_d->forward_layer(layer_index, blob_mats, opt);
+        if (ret != 0)
+            return ret;
+
+        if (layer_times)
+            layer_times[i] = get_current_time() - start;
+    }
+
+    return 0;
+}
+
+void StreamExecutorPrivate::split_stages(const std::vector<double>& layer_times)
+{
+    const int layer_count = (int)layer_indexes.size();
+    if (stage_count > layer_count)
+        stage_count = layer_count;
+
+    // cut where the accumulated time crosses each 1/stage_count of the total
+    std::vector<double> time_prefix(layer_count + 1, 0.0);
+    for (int i = 0; i < layer_count; i++)
+    {
+        time_prefix[i + 1] = time_prefix[i] + layer_times[i];
+    }
+
+    std::vector<int> stage_begins(stage_count + 1);
+    stage_begins[0] = 0;
+    stage_begins[stage_count] = layer_count;
+    for (int s = 1; s < stage_count; s++)
+    {
+        const double target = time_prefix[layer_count] * s / stage_count;
+        const int max_begin = layer_count - (stage_count - s);
+
+        int b = stage_begins[s - 1] + 1;
+        while (b < max_begin && time_prefix[b] < target)
+            b++;
+
+        stage_begins[s] = b;
+    }
+
+    stages.resize(stage_count);
+    for (int s = 0; s < stage_count; s++)
+    {
+        StreamStage& stage = stages[s];
+        stage.d = this;
+        stage.layer_indexes.assign(layer_indexes.begin() + stage_begins[s], layer_indexes.begin() + stage_begins[s + 1]);
+        stage.thread = 0;
+    }
+}
+
+StreamExecutor::StreamExecutor(Net* _net, const std::vector<int>& _output_blob_indexes, int _stage_count, int _queue_size)
+    : d(new StreamExecutorPrivate(_net, _net->d))
+{
+    d->output_blob_indexes = _output_blob_indexes;
+    d->stage_count = std::max(_stage_count, 1);
+    d->queue_size = std::max(_queue_size, 1);
+    d->started = false;
+
+    const std::vector<Blob>& blobs = d->net->d->blobs;
+    const std::vector<Layer*>& layers = d->net->d->layers;
+
+    // collect the layers required by the outputs
+    std::vector<char> layer_required(layers.size(), 0);
+    std::vector<int> pending;
+    for (size_t i = 0; i < d->output_blob_indexes.size(); i++)
+    {
+        const int blob_index = d->output_blob_indexes[i];
+        if (blob_index < 0 || blob_index >= (int)blobs.size())
+        {
+            NCNN_LOGE("stream executor invalid output blob %d", blob_index);
+            continue;
+        }
+        pending.push_back(blobs[blob_index].producer);
+    }
+    while (!pending.empty())
+    {
+        const int layer_index = pending.back();
+        pending.pop_back();
+
+        if (layer_index < 0 || layer_required[layer_index])
+            continue;
+
+        layer_required[layer_index] = 1;
+
+        const Layer* layer = layers[layer_index];
+        for (size_t j = 0; j < layer->bottoms.size(); j++)
+        {
+            pending.push_back(blobs[layer->bottoms[j]].producer);
+        }
+    }
+
+    // an output consumed by another required layer must survive light mode
+    d->lightmode = d->net->opt.lightmode;
+    for (size_t i = 0; i < d->output_blob_indexes.size(); i++)
+    {
+        const int blob_index = d->output_blob_indexes[i];
+        if (blob_index < 0 || blob_index >= (int)blobs.size())
+            continue;
+
+        const int consumer = blobs[blob_index].consumer;
+        if (consumer >= 0 && layer_required[consumer])
+            d->lightmode = false;
+    }
+
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        if (layer_required[i])
+            d->layer_indexes.push_back((int)i);
+    }
+}
+
+StreamExecutor::~StreamExecutor()
+{
+    if (d->started)
+    {
+#if NCNN_THREADS
+        // the end of stream mark stops every stage in turn
+        d->queues[0]->put(0);
+
+        for (int s = 0; s < d->stage_count; s++)
+        {
+            d->stages[s].thread->join();
+            delete d->stages[s].thread;
+        }
+#endif // NCNN_THREADS
+
+        // drop the frames never popped
+        for (size_t i = 0; i < d->queues.size(); i++)
+        {
+            delete d->queues[i];
+        }
+    }
+
+    delete d;
+}
+
+StreamExecutor::StreamExecutor(const StreamExecutor&)
+    : d(0)
+{
+}
+
+StreamExecutor& StreamExecutor::operator=(const StreamExecutor&)
+{
+    return *this;
+}
+
+int StreamExecutor::push(const std::vector<Mat>& inputs)
+{
+    const std::vector<int>& input_blob_indexes = d->net->d->input_blob_indexes;
+    if (inputs.size() != input_blob_indexes.size())
+    {
+        NCNN_LOGE("stream executor expects %d inputs but got %d", (int)input_blob_indexes.size(), (int)inputs.size());
+        return -1;
+    }
+
+    if (d->layer_indexes.empty())
+    {
+        NCNN_LOGE("stream executor has nothing to run");
+        return -1;
+    }
+
+    StreamFrame* frame = new StreamFrame(d->net);
+    frame->blob_mats = &frame->ex.d->blob_mats;
+
+    // frames in different stages would keep flipping the memo generation
+    // and race on the shared dirty region state
+    Option& frame_opt = frame->ex.d->opt;
+    frame_opt.lightmode = d->lightmode;
+    frame_opt.use_frame_memoization = false;
+    frame_opt.use_dirty_region = false;
+    frame_opt.use_vulkan_compute = false;
+    if (frame_opt.use_local_pool_allocator)
+    {
+        if (!frame_opt.blob_allocator)
+            frame_opt.blob_allocator = d->net->d->local_blob_allocator;
+        if (!frame_opt.workspace_allocator)
+            frame_opt.workspace_allocator = d->net->d->local_workspace_allocator;
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        frame->ex.input(input_blob_indexes[i], inputs[i]);
+    }
+
+    if (!d->started)
+    {
+        // run the first frame here to time the layers
+        std::vector<double> layer_times(d->layer_indexes.size(), 0.0);
+        frame->ret = d->forward_layers(frame, d->layer_indexes, frame_opt, &layer_times[0]);
+
+        d->split_stages(layer_times);
+
+        d->queues.resize(d->stage_count + 1);
+        for (int s = 0; s < d->stage_count; s++)
+        {
+            d->queues[s] = new StreamFrameQueue(d->queue_size);
+        }
+        // the caller may push several frames before popping any
+        d->queues[d->stage_count] = new StreamFrameQueue(0);
+
+        for (int s = 0; s < d->stage_count; s++)
+        {
+            StreamStage& stage = d->stages[s];
+            stage.in = d->queues[s];
+            stage.out = d->queues[s + 1];
+            stage.opt = frame_opt;
+            stage.opt.num_threads = std::max(frame_opt.num_threads / d->stage_count, 1);
+        }
+
+#if NCNN_THREADS
+        for (int s = 0; s < d->stage_count; s++)
+        {
+            d->stages[s].thread = new Thread(stream_stage_worker, (void*)&d->stages[s]);
+        }
+#endif // NCNN_THREADS
+
+        d->started = true;
+
+        d->queues[d->stage_count]->put(frame);
+
+        return frame->ret;
+    }
+
+#if NCNN_THREADS
+    d->queues[0]->put(frame);
+#else
+    // no thread support, run the stages in order on the caller thread
+    frame->ret = d->forward_layers(frame, d->layer_indexes, frame_opt);
+    d->queues[d->stage_count]->put(frame);
+#endif // NCNN_THREADS
+
+    return 0;
+}
+
+int StreamExecutor::pop(std::vector<Mat>& outputs)
+{
+    if (!d->started)
+    {
+        NCNN_LOGE("stream executor pop before push");
+        return -1;
+    }
+
+    StreamFrame* frame = d->queues[d->stage_count]->take();
+
+    int ret = frame->ret;
+
+    outputs.resize(d->output_blob_indexes.size());
+    for (size_t i = 0; i < d->output_blob_indexes.size() && ret == 0; i++)
+    {
+        // already forwarded, extract only converts the layout
+        ret = frame->ex.extract(d->output_blob_indexes[i], outputs[i]);
+    }
+
+    delete frame;
+
+    return ret;
+}
+
+int StreamExecutor::stage_layer_range(int stage, int& layer_begin, int& layer_end) const
+{
+    if (!d->started || stage < 0 || stage >= d->stage_count)
+        return -1;
+
+    const std::vector<int>& layer_indexes = d->stages[stage].layer_indexes;
+    layer_begin = layer_indexes.front();
+    layer_end = layer_indexes.back() + 1;
+
+    return 0;
+}
+
 } // namespace ncnn
@@ -92,6 +92,23 @@ public:
     // return 0 if success
     int load_model(FILE* fp);
     int load_model(const char* modelpath);
+
+    // map the model file read-only and reference the weight data in place
+    // the mapping is kept until clear, forked processes share the pages
+    // return 0 if success
+    int load_model_mmap(const char* modelpath);
+
+    // keep the create_pipeline weight transforms in a cache file
+    // entries are keyed by the layer weights, layer index, options and cpu isa
+    // the file is mapped by load_model and rewritten if entries were missing
+    // call before load_model, empty path disables the cache
+    void set_weight_cache_path(const char* path);
+
+#if NCNN_STRING
+    // load per layer sparse convolution policy from the ncnn2sparsity table
+    // call after load_param, return 0 if success
+    int load_sparsity_table(const char* tablepath);
+#endif // NCNN_STRING
 #endif // NCNN_STDIO
 
     // load network structure from external memory
@@ -126,6 +143,10 @@ public:
     // unload network structure and weight data
     void clear();
 
+    // drop the state of the stateful layers and the retained previous frame
+    // call when a new stream starts
+    void reset_state();
+
     // construct an Extractor from network
     Extractor create_extractor();
 
@@ -145,6 +166,7 @@ public:
 
 protected:
     friend class Extractor;
+    friend class StreamExecutor;
 #if NCNN_STRING
     int find_blob_index_by_name(const char* name);
     int find_layer_index_by_name(const char* name);
@@ -185,12 +207,33 @@ public:
     // default count is system depended
     void set_num_threads(int num_threads);
 
+    // run independent graph branches concurrently on inter_op_threads workers
+    // the num_threads omp threads are split evenly among the workers
+    // the blob and workspace allocators must be thread safe
+    // 1 = run the layers one by one (default)
+    void set_inter_op_threads(int inter_op_threads);
+
     // set blob memory allocator
     void set_blob_allocator(Allocator* allocator);
 
     // set workspace memory allocator
     void set_workspace_allocator(Allocator* allocator);
 
+    // serve the blob and workspace memory of every frame from one planned arena
+    // the frame allocations are replayed at the offsets planned from the first frame
+    // for fixed input shapes, create one extractor per frame and keep one alive at a time
+    // the extracted mats are copied out of the arena
+    // the layers run one by one while an arena is set, whatever inter_op_threads is
+    void set_static_arena(ArenaAllocator* arena);
+
+    // get the runtime counters of every layer, indexed like net layers
+    // counters accumulate over all frames of the net until reset
+    // state_bytes includes the blobs retained for dirty region
+    std::vector<LayerStats> get_layer_stats();
+
+    // reset the runtime counters of every layer, call when a new stream starts
+    void reset_layer_stats();
+
 #if NCNN_VULKAN
     void set_vulkan_compute(bool enable);
 
@@ -261,12 +304,50 @@ public:
 
 protected:
     friend Extractor Net::create_extractor();
+    friend class StreamExecutor;
     Extractor(Net* net, size_t blob_count);
 
 private:
     ExtractorPrivate* d;
 };
 
+class StreamExecutorPrivate;
+class NCNN_EXPORT StreamExecutor
+{
+public:
+    // run the frames of one stream through net with the layers split into stages
+    // each stage owns a contiguous range of layers and runs on its own thread
+    // frame t+1 enters a stage as soon as frame t leaves it, so stateful layers
+    // still see the frames in order
+    // queue_size is the number of frames waiting between two adjacent stages
+    StreamExecutor(Net* net, const std::vector<int>& output_blob_indexes, int stage_count, int queue_size = 2);
+    ~StreamExecutor();
+
+    // feed one frame, inputs follow net->input_indexes() order
+    // the first frame runs on the caller thread and times every layer,
+    // the stage boundaries are balanced on these timings
+    // blocks while the first stage queue is full
+    // return 0 if success
+    int push(const std::vector<Mat>& inputs);
+
+    // take the outputs of the oldest pushed frame, in output_blob_indexes order
+    // blocks until that frame leaves the last stage
+    // return 0 if success
+    int pop(std::vector<Mat>& outputs);
+
+    // get the layer range [layer_begin, layer_end) of a stage
+    // valid after the first push
+    // return 0 if success
+    int stage_layer_range(int stage, int& layer_begin, int& layer_end) const;
+
+private:
+    StreamExecutor(const StreamExecutor&);
+    StreamExecutor& operator=(const StreamExecutor&);
+
+private:
+    StreamExecutorPrivate* const d;
+};
+
 } // namespace ncnn
 
 #endif // NCNN_NET_H
@@ -0,0 +1,294 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "nms.h"
+
+#include <float.h>
+
+#if __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+namespace ncnn {
+
+// higher score first, then lower index
+static inline bool score_better(const float* scores, int stride, int a, int b)
+{
+    const float sa = scores[a * stride];
+    const float sb = scores[b * stride];
+    return sa > sb || (sa == sb && a < b);
+}
+
+// the heap root is the worst one
+static void sift_down(int* heap, int size, int i, const float* scores, int stride)
+{
+    for (;;)
+    {
+        int worst = i;
+        const int l = i * 2 + 1;
+        const int r = l + 1;
+
+        if (l < size && score_better(scores, stride, heap[worst], heap[l]))
+            worst = l;
+
+        if (r < size && score_better(scores, stride, heap[worst], heap[r]))
+            worst = r;
+
+        if (worst == i)
+            break;
+
+        std::swap(heap[i], heap[worst]);
+        i = worst;
+    }
+}
+
+void sort_descent_topk(const float* scores, int n, int stride, int topk, std::vector<int>& indexes)
+{
+    const int k = topk <= 0 || topk > n ? n : topk;
+
+    indexes.resize(k);
+    if (k == 0)
+        return;
+
+    int* heap = indexes.data();
+    for (int i = 0; i < k; i++)
+    {
+        heap[i] = i;
+    }
+
+    for (int i = k / 2 - 1; i >= 0; i--)
+    {
+        sift_down(heap, k, i, scores, stride);
+    }
+
+    // keep the k best in the heap, O(n log k)
+    for (int i = k; i < n; i++)
+    {
+        if (score_better(scores, stride, i, heap[0]))
+        {
+            heap[0] = i;
+            sift_down(heap, k, 0, scores, stride);
+        }
+    }
+
+    // move the worst to the back one by one
+    for (int size = k - 1; size > 0; size--)
+    {
+        std::swap(heap[0], heap[size]);
+        sift_down(heap, size, 0, scores, stride);
+    }
+}
+
+// picked boxes in structure of arrays, compared by blocks of simd lanes
+struct BBoxArray
+{
+    std::vector<float> xmin;
+    std::vector<float> ymin;
+    std::vector<float> xmax;
+    std::vector<float> ymax;
+    std::vector<float> area;
+    std::vector<int> label;
+
+    void push_back(float x0, float y0, float x1, float y1, float a, int l)
+    {
+        xmin.push_back(x0);
+        ymin.push_back(y0);
+        xmax.push_back(x1);
+        ymax.push_back(y1);
+        area.push_back(a);
+        label.push_back(l);
+    }
+};
+
+// whether any box in the array has iou greater than nms_threshold with the candidate
+static int is_suppressed(const BBoxArray& picked, float x0, float y0, float x1, float y1, float a, int l, bool use_label, float nms_threshold)
+{
+    const int count = (int)picked.xmin.size();
+    const float* px0 = picked.xmin.data();
+    const float* py0 = picked.ymin.data();
+    const float* px1 = picked.xmax.data();
+    const float* py1 = picked.ymax.data();
+    const float* parea = picked.area.data();
+    const int* plabel = picked.label.data();
+
+    int j = 0;
+#if __SSE2__
+    {
+        const __m128 _x0 = _mm_set1_ps(x0);
+        const __m128 _y0 = _mm_set1_ps(y0);
+        const __m128 _x1 = _mm_set1_ps(x1);
+        const __m128 _y1 = _mm_set1_ps(y1);
+        const __m128 _a = _mm_set1_ps(a);
+        const __m128i _l = _mm_set1_epi32(l);
+        const __m128 _thr = _mm_set1_ps(nms_threshold);
+        const __m128 _zero = _mm_setzero_ps();
+        for (; j + 3 < count; j += 4)
+        {
+            __m128 _w = _mm_sub_ps(_mm_min_ps(_x1, _mm_loadu_ps(px1 + j)), _mm_max_ps(_x0, _mm_loadu_ps(px0 + j)));
+            __m128 _h = _mm_sub_ps(_mm_min_ps(_y1, _mm_loadu_ps(py1 + j)), _mm_max_ps(_y0, _mm_loadu_ps(py0 + j)));
+            __m128 _inter = _mm_mul_ps(_mm_max_ps(_w, _zero), _mm_max_ps(_h, _zero));
+            __m128 _union = _mm_sub_ps(_mm_add_ps(_a, _mm_loadu_ps(parea + j)), _inter);
+            __m128 _mask = _mm_cmpgt_ps(_mm_div_ps(_inter, _union), _thr);
+            if (use_label)
+                _mask = _mm_and_ps(_mask, _mm_castsi128_ps(_mm_cmpeq_epi32(_l, _mm_loadu_si128((const __m128i*)(plabel + j)))));
+
+            if (_mm_movemask_ps(_mask))
+                return 1;
+        }
+    }
+#endif // __SSE2__
+#if __ARM_NEON && __aarch64__
+    {
+        const float32x4_t _x0 = vdupq_n_f32(x0);
+        const float32x4_t _y0 = vdupq_n_f32(y0);
+        const float32x4_t _x1 = vdupq_n_f32(x1);
+        const float32x4_t _y1 = vdupq_n_f32(y1);
+        const float32x4_t _a = vdupq_n_f32(a);
+        const int32x4_t _l = vdupq_n_s32(l);
+        const float32x4_t _thr = vdupq_n_f32(nms_threshold);
+        const float32x4_t _zero = vdupq_n_f32(0.f);
+        for (; j + 3 < count; j += 4)
+        {
+            float32x4_t _w = vsubq_f32(vminq_f32(_x1, vld1q_f32(px1 + j)), vmaxq_f32(_x0, vld1q_f32(px0 + j)));
+            float32x4_t _h = vsubq_f32(vminq_f32(_y1, vld1q_f32(py1 + j)), vmaxq_f32(_y0, vld1q_f32(py0 + j)));
+            float32x4_t _inter = vmulq_f32(vmaxq_f32(_w, _zero), vmaxq_f32(_h, _zero));
+            float32x4_t _union = vsubq_f32(vaddq_f32(_a, vld1q_f32(parea + j)), _inter);
+            uint32x4_t _mask = vcgtq_f32(vdivq_f32(_inter, _union), _thr);
+            if (use_label)
+                _mask = vandq_u32(_mask, vceqq_s32(_l, vld1q_s32(plabel + j)));
+
+            if (vmaxvq_u32(_mask))
+                return 1;
+        }
+    }
+#endif // __ARM_NEON && __aarch64__
+    for (; j < count; j++)
+    {
+        if (use_label && plabel[j] != l)
+            continue;
+
+        const float w = std::min(x1, px1[j]) - std::max(x0, px0[j]);
+        const float h = std::min(y1, py1[j]) - std::max(y0, py0[j]);
+        const float inter = std::max(w, 0.f) * std::max(h, 0.f);
+        const float union_area = a + parea[j] - inter;
+        //             float IoU = inter_area / union_area
+        if (inter / union_area > nms_threshold)
+            return 1;
+    }
+
+    return 0;
+}
+
+void nms_sorted_bboxes(const float* bboxes, int n, int stride, const float* areas, const int* labels, float nms_threshold, std::vector<int>& picked, int keep_top_k, int grid_size)
+{
+    picked.clear();
+
+    if (n <= 0)
+        return;
+
+    const int max_picked = keep_top_k <= 0 || keep_top_k > n ? n : keep_top_k;
+
+    // the boxes with zero intersection never suppress each other for non-negative threshold,
+    // only the picked boxes sharing a grid cell with the candidate need to be compared
+    int grid = grid_size;
+    if (grid == 0)
+        grid = n >= 1024 ? 16 : n >= 256 ? 8 : 1;
+
+    if (grid < 1 || nms_threshold < 0.f)
+        grid = 1;
+
+    float gx0 = FLT_MAX;
+    float gy0 = FLT_MAX;
+    float gx1 = -FLT_MAX;
+    float gy1 = -FLT_MAX;
+    if (grid > 1)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            const float* r = bboxes + i * stride;
+            if (r[0] != r[0] || r[1] != r[1] || r[2] != r[2] || r[3] != r[3])
+            {
+                // nan coordinate
+                gx0 = 0.f;
+                gx1 = 0.f;
+                break;
+            }
+
+            gx0 = std::min(gx0, r[0]);
+            gy0 = std::min(gy0, r[1]);
+            gx1 = std::max(gx1, r[2]);
+            gy1 = std::max(gy1, r[3]);
+        }
+
+        // degenerate or infinite extent, compare all
+        if (!(gx1 > gx0 && gy1 > gy0) || !(gx1 - gx0 < FLT_MAX && gy1 - gy0 < FLT_MAX))
+            grid = 1;
+    }
+
+    const float grid_scale_x = grid > 1 ? grid / (gx1 - gx0) : 0.f;
+    const float grid_scale_y = grid > 1 ? grid / (gy1 - gy0) : 0.f;
+
+    std::vector<BBoxArray> cells(grid * grid);
+
+    for (int i = 0; i < n && (int)picked.size() < max_picked; i++)
+    {
+        const float* r = bboxes + i * stride;
+        const float x0 = r[0];
+        const float y0 = r[1];
+        const float x1 = r[2];
+        const float y1 = r[3];
+        const float a = areas ? areas[i * stride] : (x1 - x0) * (y1 - y0);
+        const int l = labels ? labels[i * stride] : 0;
+
+        int cx0 = 0;
+        int cy0 = 0;
+        int cx1 = 0;
+        int cy1 = 0;
+        if (grid > 1)
+        {
+            // the same monotonic mapping for candidates and picked boxes, overlapping extents share a cell
+            cx0 = std::min(std::max((int)((x0 - gx0) * grid_scale_x), 0), grid - 1);
+            cy0 = std::min(std::max((int)((y0 - gy0) * grid_scale_y), 0), grid - 1);
+            cx1 = std::min(std::max((int)((x1 - gx0) * grid_scale_x), cx0), grid - 1);
+            cy1 = std::min(std::max((int)((y1 - gy0) * grid_scale_y), cy0), grid - 1);
+        }
+
+        int suppressed = 0;
+        for (int y = cy0; y <= cy1 && !suppressed; y++)
+        {
+            for (int x = cx0; x <= cx1 && !suppressed; x++)
+            {
+                suppressed = is_suppressed(cells[y * grid + x], x0, y0, x1, y1, a, l, labels != 0, nms_threshold);
+            }
+        }
+
+        if (suppressed)
+            continue;
+
+        picked.push_back(i);
+
+        for (int y = cy0; y <= cy1; y++)
+        {
+            for (int x = cx0; x <= cx1; x++)
+            {
+                cells[y * grid + x].push_back(x0, y0, x1, y1, a, l);
+            }
+        }
+    }
+}
+
+} // namespace ncnn
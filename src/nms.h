@@ -0,0 +1,41 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NCNN_NMS_H
+#define NCNN_NMS_H
+
+#include "platform.h"
+
+namespace ncnn {
+
+// the boxes, areas, labels and scores are fields of an array of structures
+// stride is the structure size in floats, pass 4 for packed xmin ymin xmax ymax
+
+// index of the topk highest scores in descending order, ties keep the input order
+// topk <= 0 keeps all
+NCNN_EXPORT void sort_descent_topk(const float* scores, int n, int stride, int topk, std::vector<int>& indexes);
+
+// greedy non maximum suppression over boxes sorted by descending score
+// box i is xmin ymin xmax ymax at bboxes + i * stride
+// a box is dropped when its iou with a picked box is greater than nms_threshold
+// areas may be null to take them from the box extents
+// labels may be null for class agnostic nms, otherwise only boxes of the same label suppress each other
+// stop after keep_top_k picked boxes, keep_top_k <= 0 keeps all
+// grid_size buckets the picked boxes spatially so that far apart boxes are never compared,
+// the result is the same, 0 picks the bucket count from n, -1 disables
+NCNN_EXPORT void nms_sorted_bboxes(const float* bboxes, int n, int stride, const float* areas, const int* labels, float nms_threshold, std::vector<int>& picked, int keep_top_k = 0, int grid_size = 0);
+
+} // namespace ncnn
+
+#endif // NCNN_NMS_H
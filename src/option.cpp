@@ -68,6 +68,13 @@ Option::Option()
 
     use_shader_local_memory = true;
     use_cooperative_matrix = true;
+
+    use_frame_memoization = false;
+    use_dirty_region = false;
+    use_spatial_sparsity = false;
+    use_approximate_reuse = false;
+    use_layer_stats = false;
+    use_temporal_sparsity = true;
 }
 
 } // namespace ncnn
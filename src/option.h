@@ -137,12 +137,37 @@ public:
 
     bool use_reserved_3;
     bool use_reserved_4;
-    bool use_reserved_5;
-    bool use_reserved_6;
-    bool use_reserved_7;
-    bool use_reserved_8;
-    bool use_reserved_9;
-    bool use_reserved_10;
+
+    // reuse the previously extracted outputs when every input mat
+    // is exactly the same as the one fed in the previous frame
+    // the whole graph is skipped for a static frame
+    bool use_frame_memoization;
+
+    // propagate per-tile change masks from the input through the graph
+    // layers with all tiles clean reuse the previous output
+    // layers supporting dirty region compute the dirty tiles only
+    // previous frame blobs are retained, may consume more memory
+    // the layer outputs come from the net blob allocator, or its local pool
+    bool use_dirty_region;
+
+    // single image inference, skip the relu convolution outputs whose bound
+    // derived from the left and upper neighbours is non-positive
+    // row strips are scanned in parallel, exact result
+    bool use_spatial_sparsity;
+
+    // temporal convolution reuses the last value of a positive output
+    // while its accumulated error bound stays within the layer budget
+    // the budget is set per layer, layers without one stay lossless
+    bool use_approximate_reuse;
+
+    // time every layer forward and the bound and dot product phases
+    // of the sparse convolutions into Layer::stats
+    bool use_layer_stats;
+
+    // relu convolutions skip the outputs bounded non-positive from the previous frame
+    // enabled by default, disable for the plain dense convolution
+    bool use_temporal_sparsity;
+
     bool use_reserved_11;
 };
 
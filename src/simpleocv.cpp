@@ -17,6 +17,7 @@
 #if NCNN_SIMPLEOCV
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_THREAD_LOCALS
@@ -224,6 +225,549 @@ int waitKey(int delay)
     return -1;
 }
 
+class VideoCapturePrivate
+{
+public:
+    VideoCapturePrivate();
+
+    bool open(const std::string& path, int format, int width, int height, bool y4m);
+    void close();
+
+    // read and decode the next frame, return false at the end of stream
+    bool read_frame(Mat& bgr);
+
+    void start_reader();
+    void stop_reader();
+
+    FILE* fp;
+    bool y4m;
+    bool mono;
+    int format;
+    int width;
+    int height;
+    double fps;
+
+    // bytes of one frame in file
+    size_t frame_size;
+    std::vector<uchar> raw;
+    std::vector<uchar> nv21;
+
+    // ring of decoded frames, the reader fills the slots after head + count
+    int buffer_size;
+    std::vector<Mat> ring;
+    int head;
+    int count;
+    bool eof;
+    bool stop;
+    int pos;
+
+    ncnn::Mutex lock;
+    ncnn::ConditionVariable condition_filled;
+    ncnn::ConditionVariable condition_free;
+    ncnn::Thread* reader;
+};
+
+VideoCapturePrivate::VideoCapturePrivate()
+{
+    fp = 0;
+    y4m = false;
+    mono = false;
+    format = 0;
+    width = 0;
+    height = 0;
+    fps = 0.0;
+    frame_size = 0;
+    buffer_size = 4;
+    head = 0;
+    count = 0;
+    eof = false;
+    stop = false;
+    pos = 0;
+    reader = 0;
+}
+
+// read one line without the trailing newline, return false on eof or overlong line
+static bool read_y4m_line(FILE* fp, char* line, int maxlen)
+{
+    int len = 0;
+    for (;;)
+    {
+        int ch = fgetc(fp);
+        if (ch == EOF)
+            return false;
+
+        if (ch == '\n')
+            break;
+
+        if (len == maxlen - 1)
+            return false;
+
+        line[len++] = (char)ch;
+    }
+
+    line[len] = '\0';
+    return true;
+}
+
+bool VideoCapturePrivate::open(const std::string& path, int _format, int _width, int _height, bool _y4m)
+{
+    fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+        NCNN_LOGE("VideoCapture open %s failed", path.c_str());
+        return false;
+    }
+
+    y4m = _y4m;
+    mono = false;
+    format = _format;
+    width = _width;
+    height = _height;
+    fps = 0.0;
+
+    if (y4m)
+    {
+        char header[1024];
+        if (!read_y4m_line(fp, header, 1024) || strncmp(header, "YUV4MPEG2 ", 10) != 0)
+        {
+            NCNN_LOGE("VideoCapture %s is not a y4m file", path.c_str());
+            close();
+            return false;
+        }
+
+        format = CAP_RAW_I420;
+
+        // space separated tags, the first letter is the tag name
+        char* p = header + 10;
+        while (*p)
+        {
+            while (*p == ' ')
+                p++;
+
+            char* tag = p;
+            while (*p && *p != ' ')
+                p++;
+
+            if (*p)
+                *p++ = '\0';
+
+            if (tag[0] == 'W')
+            {
+                width = atoi(tag + 1);
+            }
+            else if (tag[0] == 'H')
+            {
+                height = atoi(tag + 1);
+            }
+            else if (tag[0] == 'F')
+            {
+                int num = 0;
+                int den = 0;
+                if (sscanf(tag + 1, "%d:%d", &num, &den) == 2 && den > 0)
+                    fps = (double)num / den;
+            }
+            else if (tag[0] == 'C')
+            {
+                const char* colorspace = tag + 1;
+                if (strcmp(colorspace, "mono") == 0)
+                {
+                    mono = true;
+                }
+                else if (strcmp(colorspace, "420") != 0 && strcmp(colorspace, "420jpeg") != 0 && strcmp(colorspace, "420paldv") != 0 && strcmp(colorspace, "420mpeg2") != 0)
+                {
+                    NCNN_LOGE("VideoCapture y4m colorspace %s not supported", colorspace);
+                    close();
+                    return false;
+                }
+            }
+        }
+    }
+
+    if (width <= 0 || height <= 0)
+    {
+        NCNN_LOGE("VideoCapture invalid frame size %d x %d", width, height);
+        close();
+        return false;
+    }
+
+    if (mono)
+    {
+        frame_size = (size_t)width * height;
+    }
+    else if (format == CAP_RAW_NV12 || format == CAP_RAW_NV21 || format == CAP_RAW_I420)
+    {
+#if NCNN_PIXEL
+        if (width % 2 != 0 || height % 2 != 0)
+        {
+            NCNN_LOGE("VideoCapture yuv420 frame size %d x %d must be even", width, height);
+            close();
+            return false;
+        }
+
+        frame_size = (size_t)width * height * 3 / 2;
+#else
+        NCNN_LOGE("VideoCapture yuv420 requires NCNN_PIXEL");
+        close();
+        return false;
+#endif
+    }
+    else if (format == CAP_RAW_BGR || format == CAP_RAW_RGB)
+    {
+        frame_size = (size_t)width * height * 3;
+    }
+    else
+    {
+        NCNN_LOGE("VideoCapture unknown raw format %d", format);
+        close();
+        return false;
+    }
+
+    raw.resize(frame_size);
+    if (format == CAP_RAW_I420 && !mono)
+        nv21.resize(frame_size);
+
+    ring.resize(buffer_size);
+    for (int i = 0; i < buffer_size; i++)
+    {
+        ring[i].create(height, width, CV_8UC3);
+    }
+
+    head = 0;
+    count = 0;
+    eof = false;
+    stop = false;
+    pos = 0;
+
+    start_reader();
+
+    return true;
+}
+
+void VideoCapturePrivate::close()
+{
+    stop_reader();
+
+    if (fp)
+    {
+        fclose(fp);
+        fp = 0;
+    }
+
+    raw.clear();
+    nv21.clear();
+    ring.clear();
+
+    width = 0;
+    height = 0;
+    fps = 0.0;
+    frame_size = 0;
+    head = 0;
+    count = 0;
+    pos = 0;
+}
+
+bool VideoCapturePrivate::read_frame(Mat& bgr)
+{
+    if (y4m)
+    {
+        char line[256];
+        if (!read_y4m_line(fp, line, 256) || strncmp(line, "FRAME", 5) != 0)
+            return false;
+    }
+
+    if (fread(raw.data(), 1, frame_size, fp) != frame_size)
+        return false;
+
+    const int size = width * height;
+    const uchar* src = raw.data();
+    uchar* dst = bgr.data;
+
+    if (mono)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            dst[0] = src[i];
+            dst[1] = src[i];
+            dst[2] = src[i];
+            dst += 3;
+        }
+
+        return true;
+    }
+
+    if (format == CAP_RAW_BGR)
+    {
+        memcpy(dst, src, size * 3);
+        return true;
+    }
+
+#if NCNN_PIXEL
+    if (format == CAP_RAW_NV12)
+    {
+        ncnn::yuv420sp2rgb_nv12(src, width, height, dst);
+    }
+    else if (format == CAP_RAW_NV21)
+    {
+        ncnn::yuv420sp2rgb(src, width, height, dst);
+    }
+    else if (format == CAP_RAW_I420)
+    {
+        // interleave the planar chroma as nv21
+        memcpy(nv21.data(), src, size);
+
+        const uchar* u = src + size;
+        const uchar* v = u + size / 4;
+        uchar* vu = nv21.data() + size;
+        for (int i = 0; i < size / 4; i++)
+        {
+            vu[0] = v[i];
+            vu[1] = u[i];
+            vu += 2;
+        }
+
+        ncnn::yuv420sp2rgb(nv21.data(), width, height, dst);
+    }
+    else
+#endif // NCNN_PIXEL
+    {
+        memcpy(dst, src, size * 3);
+    }
+
+    // rgb to bgr
+    for (int i = 0; i < size; i++)
+    {
+        std::swap(dst[0], dst[2]);
+        dst += 3;
+    }
+
+    return true;
+}
+
+#if NCNN_THREADS
+static void* video_capture_reader(void* args)
+{
+    VideoCapturePrivate* d = (VideoCapturePrivate*)args;
+
+    d->lock.lock();
+    while (!d->stop)
+    {
+        while (d->count == d->buffer_size && !d->stop)
+        {
+            d->condition_free.wait(d->lock);
+        }
+
+        if (d->stop)
+            break;
+
+        // the slot is not visible to read until count is increased
+        Mat& slot = d->ring[(d->head + d->count) % d->buffer_size];
+
+        d->lock.unlock();
+
+        bool ok = d->read_frame(slot);
+
+        d->lock.lock();
+
+        if (!ok)
+        {
+            d->eof = true;
+            d->condition_filled.signal();
+            break;
+        }
+
+        d->count++;
+        d->condition_filled.signal();
+    }
+    d->lock.unlock();
+
+    return 0;
+}
+#endif // NCNN_THREADS
+
+void VideoCapturePrivate::start_reader()
+{
+#if NCNN_THREADS
+    reader = new ncnn::Thread(video_capture_reader, (void*)this);
+#endif // NCNN_THREADS
+}
+
+void VideoCapturePrivate::stop_reader()
+{
+    if (!reader)
+        return;
+
+    lock.lock();
+    stop = true;
+    condition_free.signal();
+    lock.unlock();
+
+    reader->join();
+    delete reader;
+    reader = 0;
+}
+
+VideoCapture::VideoCapture()
+    : d(new VideoCapturePrivate)
+{
+}
+
+VideoCapture::VideoCapture(const std::string& path)
+    : d(new VideoCapturePrivate)
+{
+    open(path);
+}
+
+VideoCapture::~VideoCapture()
+{
+    release();
+
+    delete d;
+}
+
+VideoCapture::VideoCapture(const VideoCapture&)
+    : d(0)
+{
+}
+
+VideoCapture& VideoCapture::operator=(const VideoCapture&)
+{
+    return *this;
+}
+
+bool VideoCapture::open(const std::string& path)
+{
+    release();
+
+    return d->open(path, 0, 0, 0, true);
+}
+
+bool VideoCapture::open(const std::string& path, int format, int width, int height)
+{
+    release();
+
+    return d->open(path, format, width, height, false);
+}
+
+bool VideoCapture::isOpened() const
+{
+    return d->fp != 0;
+}
+
+void VideoCapture::release()
+{
+    d->close();
+}
+
+bool VideoCapture::read(Mat& image)
+{
+    if (!d->fp)
+    {
+        image.release();
+        return false;
+    }
+
+    const bool reuse = image.data && image.rows == d->height && image.cols == d->width && image.c == 3 && (!image.refcount || *image.refcount == 1);
+
+#if NCNN_THREADS
+    // the decoded slot is handed out and the image buffer takes its place in the ring
+    Mat spare;
+    if (reuse && image.refcount)
+        spare = image;
+    else
+        spare.create(d->height, d->width, CV_8UC3);
+
+    image.release();
+
+    d->lock.lock();
+    while (d->count == 0 && !d->eof)
+    {
+        d->condition_filled.wait(d->lock);
+    }
+
+    if (d->count == 0)
+    {
+        d->lock.unlock();
+        image.release();
+        return false;
+    }
+
+    // the reader never touches the filled slots
+    Mat& slot = d->ring[d->head];
+
+    d->lock.unlock();
+
+    image = slot;
+    slot = spare;
+
+    d->lock.lock();
+    d->head = (d->head + 1) % d->buffer_size;
+    d->count--;
+    d->pos++;
+    d->condition_free.signal();
+    d->lock.unlock();
+#else
+    if (!reuse)
+        image.create(d->height, d->width, CV_8UC3);
+
+    if (!d->read_frame(image))
+    {
+        image.release();
+        return false;
+    }
+
+    d->pos++;
+#endif // NCNN_THREADS
+
+    return true;
+}
+
+VideoCapture& VideoCapture::operator>>(Mat& image)
+{
+    read(image);
+    return *this;
+}
+
+double VideoCapture::get(int propId) const
+{
+    if (propId == CAP_PROP_POS_FRAMES)
+        return d->pos;
+
+    if (propId == CAP_PROP_FRAME_WIDTH)
+        return d->width;
+
+    if (propId == CAP_PROP_FRAME_HEIGHT)
+        return d->height;
+
+    if (propId == CAP_PROP_FPS)
+        return d->fps;
+
+    if (propId == CAP_PROP_BUFFERSIZE)
+        return d->buffer_size;
+
+    return 0.0;
+}
+
+bool VideoCapture::set(int propId, double value)
+{
+    if (propId == CAP_PROP_FPS)
+    {
+        d->fps = value;
+        return true;
+    }
+
+    if (propId == CAP_PROP_BUFFERSIZE)
+    {
+        // the ring is allocated on open
+        if (d->fp || (int)value < 1)
+            return false;
+
+        d->buffer_size = (int)value;
+        return true;
+    }
+
+    return false;
+}
+
 #if NCNN_PIXEL
 void resize(const Mat& src, Mat& dst, const Size& size, float sw, float sh, int flags)
 {
@@ -459,6 +459,66 @@ NCNN_EXPORT void imshow(const std::string& name, const Mat& m);
 
 NCNN_EXPORT int waitKey(int delay = 0);
 
+enum VideoCaptureProperties
+{
+    CAP_PROP_POS_FRAMES = 1,
+    CAP_PROP_FRAME_WIDTH = 3,
+    CAP_PROP_FRAME_HEIGHT = 4,
+    CAP_PROP_FPS = 5,
+    CAP_PROP_BUFFERSIZE = 38
+};
+
+// headerless raw video layouts, frames are packed back to back
+enum VideoCaptureRawFormats
+{
+    CAP_RAW_NV12 = 1,
+    CAP_RAW_NV21 = 2,
+    CAP_RAW_I420 = 3,
+    CAP_RAW_BGR = 4,
+    CAP_RAW_RGB = 5
+};
+
+class VideoCapturePrivate;
+// streaming reader for y4m and raw video files, frames are decoded to bgr
+// a background thread reads ahead into a bounded ring of preallocated frames
+// set CAP_PROP_BUFFERSIZE before open to change the ring size, default is 4
+class NCNN_EXPORT VideoCapture
+{
+public:
+    VideoCapture();
+    // open y4m file
+    VideoCapture(const std::string& path);
+    ~VideoCapture();
+
+    // open y4m file, 420 and mono colorspaces are supported
+    bool open(const std::string& path);
+
+    // open raw video file of the given layout and frame size
+    bool open(const std::string& path, int format, int width, int height);
+
+    bool isOpened() const;
+
+    void release();
+
+    // the frame is decoded ahead, image takes over its buffer
+    // the buffer of image goes back to the ring when it is not shared and has the frame size
+    // return false and empty image at the end of stream
+    bool read(Mat& image);
+
+    VideoCapture& operator>>(Mat& image);
+
+    double get(int propId) const;
+
+    bool set(int propId, double value);
+
+private:
+    VideoCapture(const VideoCapture&);
+    VideoCapture& operator=(const VideoCapture&);
+
+private:
+    VideoCapturePrivate* const d;
+};
+
 #if NCNN_PIXEL
 NCNN_EXPORT void resize(const Mat& src, Mat& dst, const Size& size, float sw = 0.f, float sh = 0.f, int flags = 0);
 #endif // NCNN_PIXEL
@@ -0,0 +1,409 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "allocator.h"
+#include "net.h"
+#include "testutil.h"
+
+// one frame, every block is filled and freed two allocations later
+// a block overlapping another live block would corrupt its fill
+// the last block is kept alive past the frame when held is given
+static int run_arena_frame(ncnn::ArenaAllocator& arena, const std::vector<int>& sizes, std::vector<void*>& ptrs, void** held = 0)
+{
+    arena.begin_frame();
+
+    ptrs.resize(sizes.size());
+
+    int ret = 0;
+    for (size_t i = 0; i < sizes.size() + 2; i++)
+    {
+        if (i < sizes.size())
+        {
+            ptrs[i] = arena.fastMalloc(sizes[i]);
+            memset(ptrs[i], (int)i + 1, sizes[i]);
+        }
+
+        if (i >= 2 && !(held && i - 2 == sizes.size() - 1))
+        {
+            const unsigned char* p = (const unsigned char*)ptrs[i - 2];
+            for (int j = 0; j < sizes[i - 2]; j++)
+            {
+                if (p[j] != (unsigned char)(i - 1))
+                {
+                    fprintf(stderr, "arena block %d overwritten\n", (int)i - 2);
+                    ret = -1;
+                    break;
+                }
+            }
+
+            arena.fastFree(ptrs[i - 2]);
+        }
+    }
+
+    if (held)
+        *held = ptrs[sizes.size() - 1];
+
+    return ret;
+}
+
+static size_t total_size(const std::vector<int>& sizes)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < sizes.size(); i++)
+        size += sizes[i];
+    return size;
+}
+
+static int test_allocator_0()
+{
+    ncnn::ArenaAllocator arena;
+
+    std::vector<int> sizes_a;
+    sizes_a.push_back(1000);
+    sizes_a.push_back(3000);
+    sizes_a.push_back(200);
+    sizes_a.push_back(4000);
+    sizes_a.push_back(500);
+    sizes_a.push_back(64);
+
+    // the same sequence, the third block grows
+    std::vector<int> sizes_b = sizes_a;
+    sizes_b[2] = 9000;
+
+    std::vector<void*> ptrs0;
+    std::vector<void*> ptrs1;
+
+    // record
+    if (run_arena_frame(arena, sizes_a, ptrs0) != 0 || arena.arena_size() != 0 || arena.heap_bytes() != total_size(sizes_a))
+    {
+        fprintf(stderr, "test_allocator_0 record failed arena_size=%d heap_bytes=%d\n", (int)arena.arena_size(), (int)arena.heap_bytes());
+        return -1;
+    }
+
+    // replay, the same offsets every frame
+    for (int f = 0; f < 3; f++)
+    {
+        if (run_arena_frame(arena, sizes_a, ptrs1) != 0 || arena.arena_size() == 0 || arena.heap_bytes() != 0 || (f > 0 && ptrs1 != ptrs0))
+        {
+            fprintf(stderr, "test_allocator_0 replay failed arena_size=%d heap_bytes=%d\n", (int)arena.arena_size(), (int)arena.heap_bytes());
+            return -1;
+        }
+
+        ptrs0 = ptrs1;
+    }
+
+    // the shape changes, the rest of the frame goes to the heap and the next frame records again
+    if (run_arena_frame(arena, sizes_b, ptrs1) != 0 || arena.heap_bytes() == 0)
+    {
+        fprintf(stderr, "test_allocator_0 diverge failed heap_bytes=%d\n", (int)arena.heap_bytes());
+        return -1;
+    }
+
+    if (run_arena_frame(arena, sizes_b, ptrs1) != 0 || arena.arena_size() != 0 || arena.heap_bytes() != total_size(sizes_b))
+    {
+        fprintf(stderr, "test_allocator_0 record again failed arena_size=%d heap_bytes=%d\n", (int)arena.arena_size(), (int)arena.heap_bytes());
+        return -1;
+    }
+
+    if (run_arena_frame(arena, sizes_b, ptrs1) != 0 || arena.arena_size() < 9000 || arena.heap_bytes() != 0)
+    {
+        fprintf(stderr, "test_allocator_0 replay again failed arena_size=%d heap_bytes=%d\n", (int)arena.arena_size(), (int)arena.heap_bytes());
+        return -1;
+    }
+
+    // a block held across frames keeps the next frame away from the arena
+    void* held = 0;
+    if (run_arena_frame(arena, sizes_b, ptrs1, &held) != 0 || arena.heap_bytes() != 0)
+    {
+        fprintf(stderr, "test_allocator_0 hold failed heap_bytes=%d\n", (int)arena.heap_bytes());
+        return -1;
+    }
+
+    int ret = run_arena_frame(arena, sizes_b, ptrs1);
+    const size_t held_heap_bytes = arena.heap_bytes();
+
+    arena.fastFree(held);
+
+    if (ret != 0 || held_heap_bytes == 0)
+    {
+        fprintf(stderr, "test_allocator_0 held block failed heap_bytes=%d\n", (int)held_heap_bytes);
+        return -1;
+    }
+
+    if (run_arena_frame(arena, sizes_b, ptrs1) != 0 || arena.heap_bytes() != 0)
+    {
+        fprintf(stderr, "test_allocator_0 replay after held block failed heap_bytes=%d\n", (int)arena.heap_bytes());
+        return -1;
+    }
+
+    arena.clear();
+
+    return 0;
+}
+
+static int load_dirty_net(ncnn::Net& net, bool dirty_region, const std::vector<float>& weights, ncnn::Allocator* blob_allocator = 0)
+{
+    static const char param_txt[] = "7767517\n3 3\n"
+                                    "Input data 0 1 data 0=16 1=12 2=2\n"
+                                    "Convolution conv0 1 1 data conv0 0=4 1=3 4=1 5=1 6=72 9=1\n"
+                                    "Convolution conv1 1 1 conv0 out 0=3 1=3 4=1 5=1 6=108\n";
+
+    net.opt.num_threads = 1;
+    net.opt.use_packing_layout = false;
+    net.opt.use_dirty_region = dirty_region;
+    net.opt.blob_allocator = blob_allocator;
+
+    if (net.load_param_mem(param_txt) != 0)
+        return -1;
+
+    const int size = (int)(weights.size() * sizeof(float));
+    if (net.load_model((const unsigned char*)&weights[0]) != size)
+        return -1;
+
+    return 0;
+}
+
+static std::vector<float> dirty_net_weights()
+{
+    // weight tag and data, then bias, for each convolution
+    std::vector<float> weights;
+
+    ncnn::Mat w0 = RandomMat(72);
+    ncnn::Mat b0 = RandomMat(4);
+    ncnn::Mat w1 = RandomMat(108);
+    ncnn::Mat b1 = RandomMat(3);
+
+    weights.push_back(0.f);
+    weights.insert(weights.end(), (const float*)w0, (const float*)w0 + 72);
+    weights.insert(weights.end(), (const float*)b0, (const float*)b0 + 4);
+    weights.push_back(0.f);
+    weights.insert(weights.end(), (const float*)w1, (const float*)w1 + 108);
+    weights.insert(weights.end(), (const float*)b1, (const float*)b1 + 3);
+
+    return weights;
+}
+
+static void change_dirty_frame(ncnn::Mat& frame)
+{
+    // the same small region changes every frame
+    for (int q = 0; q < frame.c; q++)
+    {
+        float* ptr = frame.channel(q).row(3) + 5;
+        ptr[0] = RandomFloat();
+        ptr[1] = RandomFloat();
+    }
+}
+
+// the dirty region retains blobs across frames, the static arena must still replay every frame
+static int test_allocator_1()
+{
+    std::vector<float> weights = dirty_net_weights();
+
+    ncnn::Net net_ref;
+    ncnn::Net net;
+    if (load_dirty_net(net_ref, false, weights) != 0 || load_dirty_net(net, true, weights) != 0)
+    {
+        fprintf(stderr, "test_allocator_1 load failed\n");
+        return -1;
+    }
+
+    ncnn::ArenaAllocator arena;
+
+    ncnn::Mat frame = RandomMat(16, 12, 2);
+
+    int ret = 0;
+    for (int f = 0; f < 8 && ret == 0; f++)
+    {
+        if (f > 0)
+            change_dirty_frame(frame);
+
+        ncnn::Mat a;
+        {
+            ncnn::Extractor ex = net_ref.create_extractor();
+            ex.input("data", frame);
+            ex.extract("out", a);
+        }
+
+        ncnn::Mat b;
+        size_t heap_bytes = 0;
+        {
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_static_arena(&arena);
+            ex.input("data", frame);
+            ex.extract("out", b);
+
+            heap_bytes = arena.heap_bytes();
+        }
+
+        ret = CompareMat(a, b, 0.001);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_allocator_1 frame %d mismatch\n", f);
+            break;
+        }
+
+        // the first frame and the first dirty frame differ, the third one is recorded
+        if (f >= 3 && heap_bytes != 0)
+        {
+            fprintf(stderr, "test_allocator_1 frame %d left the arena heap_bytes=%d\n", f, (int)heap_bytes);
+            ret = -1;
+        }
+    }
+
+    net.clear();
+    arena.clear();
+
+    return ret;
+}
+
+// hands freed blocks back out for the same size, counts the system allocations
+class CountingAllocator : public ncnn::Allocator
+{
+public:
+    CountingAllocator()
+        : system_allocs(0)
+    {
+    }
+
+    ~CountingAllocator()
+    {
+        for (size_t i = 0; i < free_blocks.size(); i++)
+        {
+            ncnn::fastFree(free_blocks[i].second);
+        }
+    }
+
+    virtual void* fastMalloc(size_t size)
+    {
+        void* ptr = 0;
+        for (size_t i = 0; i < free_blocks.size(); i++)
+        {
+            if (free_blocks[i].first == size)
+            {
+                ptr = free_blocks[i].second;
+                free_blocks.erase(free_blocks.begin() + i);
+                break;
+            }
+        }
+
+        if (!ptr)
+        {
+            ptr = ncnn::fastMalloc(size);
+            system_allocs++;
+        }
+
+        used_blocks.push_back(std::make_pair(size, ptr));
+        return ptr;
+    }
+
+    virtual void fastFree(void* ptr)
+    {
+        for (size_t i = 0; i < used_blocks.size(); i++)
+        {
+            if (used_blocks[i].second == ptr)
+            {
+                free_blocks.push_back(used_blocks[i]);
+                used_blocks.erase(used_blocks.begin() + i);
+                return;
+            }
+        }
+    }
+
+public:
+    int system_allocs;
+    std::vector<std::pair<size_t, void*> > free_blocks;
+    std::vector<std::pair<size_t, void*> > used_blocks;
+};
+
+// the retained blobs of the dirty region come from the net allocator, not copied out of the arena every frame
+static int test_allocator_2()
+{
+    std::vector<float> weights = dirty_net_weights();
+
+    CountingAllocator net_allocator;
+    ncnn::ArenaAllocator arena;
+
+    ncnn::Net net_ref;
+    ncnn::Net net;
+    if (load_dirty_net(net_ref, false, weights) != 0 || load_dirty_net(net, true, weights, &net_allocator) != 0)
+    {
+        fprintf(stderr, "test_allocator_2 load failed\n");
+        return -1;
+    }
+
+    ncnn::Mat frame = RandomMat(16, 12, 2);
+
+    int ret = 0;
+    int warm_system_allocs = 0;
+    for (int f = 0; f < 8 && ret == 0; f++)
+    {
+        if (f > 0)
+            change_dirty_frame(frame);
+
+        ncnn::Mat a;
+        {
+            ncnn::Extractor ex = net_ref.create_extractor();
+            ex.input("data", frame);
+            ex.extract("out", a);
+        }
+
+        ncnn::Mat b;
+        size_t heap_bytes = 0;
+        {
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_static_arena(&arena);
+            ex.input("data", frame);
+            ex.extract("out", b);
+
+            heap_bytes = arena.heap_bytes();
+        }
+
+        ret = CompareMat(a, b, 0.001);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_allocator_2 frame %d mismatch\n", f);
+            break;
+        }
+
+        if (f == 3)
+            warm_system_allocs = net_allocator.system_allocs;
+
+        if (f >= 3 && (heap_bytes != 0 || net_allocator.system_allocs != warm_system_allocs))
+        {
+            fprintf(stderr, "test_allocator_2 frame %d allocated heap_bytes=%d system_allocs=%d warm=%d\n", f, (int)heap_bytes, net_allocator.system_allocs, warm_system_allocs);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && warm_system_allocs == 0)
+    {
+        fprintf(stderr, "test_allocator_2 retained blobs bypassed the net allocator\n");
+        ret = -1;
+    }
+
+    net.clear();
+    arena.clear();
+
+    return ret;
+}
+
+int main()
+{
+    SRAND(7767517);
+
+    return 0
+           || test_allocator_0()
+           || test_allocator_1()
+           || test_allocator_2();
+}
@@ -202,9 +202,151 @@ static int test_convolution1d_1()
     return 0;
 }
 
+static int forward_convolution1d(const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights, const std::vector<ncnn::Mat>& chunks, std::vector<ncnn::Mat>& outs)
+{
+    ncnn::Layer* op = ncnn::create_layer("Convolution1D");
+
+    op->load_param(pd);
+
+    ncnn::ModelBinFromMatArray mb(weights.data());
+
+    op->load_model(mb);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+
+    op->create_pipeline(opt);
+
+    int ret = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        // feed the packed layout the net would give this layer
+        const int h = chunks[i].h;
+        const int elempack = op->support_packing ? (h % 8 == 0 ? 8 : h % 4 == 0 ? 4 : 1) : 1;
+
+        ncnn::Mat a;
+        ncnn::convert_packing(chunks[i], a, elempack, opt);
+
+        ncnn::Mat b;
+        ret = op->forward(a, b, opt);
+        if (ret != 0)
+            break;
+
+        ncnn::Mat b1;
+        ncnn::convert_packing(b, b1, 1, opt);
+        outs.push_back(b1.clone());
+    }
+
+    op->destroy_pipeline(opt);
+
+    delete op;
+
+    return ret;
+}
+
+static int test_convolution1d_streaming(int w, int h, int outh, int kernel, int dilation, int stride, int chunk, int bias)
+{
+    ncnn::Mat a = RandomMat(w, h);
+
+    const int kernel_extent = dilation * (kernel - 1) + 1;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outh);
+    pd.set(1, kernel);
+    pd.set(2, dilation);
+    pd.set(3, stride);
+    pd.set(4, kernel_extent - 1);
+    pd.set(15, 0);
+    pd.set(18, 0.5f);
+    pd.set(5, bias);
+    pd.set(6, outh * h * kernel);
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = RandomMat(outh * h * kernel);
+    if (bias)
+        weights[1] = RandomMat(outh);
+
+    std::vector<ncnn::Mat> whole(1, a);
+    std::vector<ncnn::Mat> expect;
+    int ret = forward_convolution1d(pd, weights, whole, expect);
+    if (ret != 0)
+        return ret;
+
+    std::vector<ncnn::Mat> chunks;
+    for (int x = 0; x < w; x += chunk)
+    {
+        const int cw = std::min(chunk, w - x);
+        ncnn::Mat m(cw, h);
+        for (int i = 0; i < h; i++)
+        {
+            memcpy(m.row(i), a.row(i) + x, cw * sizeof(float));
+        }
+        chunks.push_back(m);
+    }
+
+    pd.set(20, 1);
+
+    std::vector<ncnn::Mat> outs;
+    ret = forward_convolution1d(pd, weights, chunks, outs);
+    if (ret == 0)
+    {
+        // the streamed outputs in order cover the whole sequence outputs
+        int outw = 0;
+        for (size_t i = 0; i < outs.size(); i++)
+        {
+            outw += outs[i].w;
+        }
+
+        ncnn::Mat b(outw, outh);
+        int x = 0;
+        for (size_t i = 0; i < outs.size(); i++)
+        {
+            for (int j = 0; j < outh; j++)
+            {
+                memcpy(b.row(j) + x, outs[i].row(j), outs[i].w * sizeof(float));
+            }
+            x += outs[i].w;
+        }
+
+        ret = CompareMat(expect[0], b, 0.001);
+    }
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution1d_streaming failed w=%d h=%d outh=%d kernel=%d dilation=%d stride=%d chunk=%d bias=%d\n", w, h, outh, kernel, dilation, stride, chunk, bias);
+    }
+
+    return ret;
+}
+
+static int test_convolution1d_2()
+{
+    return 0
+           || test_convolution1d_streaming(24, 4, 8, 1, 1, 1, 5, 1)
+           || test_convolution1d_streaming(24, 8, 4, 3, 1, 1, 1, 0)
+           || test_convolution1d_streaming(24, 8, 8, 3, 1, 1, 5, 1)
+           || test_convolution1d_streaming(24, 3, 13, 3, 2, 1, 7, 1)
+           || test_convolution1d_streaming(24, 16, 12, 5, 1, 1, 8, 0)
+           || test_convolution1d_streaming(24, 12, 16, 2, 1, 2, 4, 1)
+           || test_convolution1d_streaming(24, 8, 8, 3, 1, 2, 6, 1)
+           || test_convolution1d_streaming(24, 13, 4, 4, 2, 2, 2, 0);
+}
+
+static int test_convolution1d_3()
+{
+    // chunks shorter than the stride or the kernel extent
+    return 0
+           || test_convolution1d_streaming(8, 4, 4, 3, 1, 2, 1, 1)
+           || test_convolution1d_streaming(24, 8, 8, 3, 1, 2, 1, 0)
+           || test_convolution1d_streaming(24, 4, 8, 5, 1, 3, 2, 1)
+           || test_convolution1d_streaming(24, 8, 4, 3, 2, 2, 1, 0)
+           || test_convolution1d_streaming(25, 16, 8, 4, 1, 4, 3, 1)
+           || test_convolution1d_streaming(24, 12, 16, 2, 3, 5, 2, 0);
+}
+
 int main()
 {
     SRAND(7767517);
 
-    return test_convolution1d_0() || test_convolution1d_1();
+    return test_convolution1d_0() || test_convolution1d_1() || test_convolution1d_2() || test_convolution1d_3();
 }
@@ -87,9 +87,124 @@ static int test_convolution3d_0()
     return 0;
 }
 
+static int run_convolution3d(const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights, const std::vector<ncnn::Mat>& windows, std::vector<ncnn::Mat>& outs)
+{
+    ncnn::Convolution3D* op = new ncnn::Convolution3D;
+
+    op->load_param(pd);
+
+    ncnn::ModelBinFromMatArray mb(weights.data());
+
+    op->load_model(mb);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+
+    int ret = 0;
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        ncnn::Mat out;
+        ret = op->forward(windows[i], out, opt);
+        if (ret != 0)
+            break;
+
+        outs.push_back(out.clone());
+    }
+
+    delete op;
+
+    return ret;
+}
+
+static ncnn::Mat make_window(const std::vector<ncnn::Mat>& frames, int start, int d)
+{
+    const ncnn::Mat& f0 = frames[0];
+
+    ncnn::Mat m(f0.w, f0.h, d, f0.c);
+    for (int q = 0; q < f0.c; q++)
+    {
+        for (int z = 0; z < d; z++)
+        {
+            memcpy(m.channel(q).depth(z), frames[start + z].channel(q), f0.w * f0.h * sizeof(float));
+        }
+    }
+
+    return m;
+}
+
+static int test_convolution3d_sliding(int w, int h, int d, int c, int outch, int kernel, int dilation, int stride, int pad, float pad_value, int bias)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, kernel);
+    pd.set(2, dilation);
+    pd.set(3, stride);
+    pd.set(4, pad);
+    pd.set(5, bias);
+    pd.set(6, outch * c * kernel * kernel * kernel);
+    pd.set(9, 1); // relu
+    pd.set(18, pad_value);
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = RandomMat(outch * c * kernel * kernel * kernel);
+    if (bias)
+        weights[1] = RandomMat(outch);
+
+    std::vector<ncnn::Mat> frames(d + 8);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        frames[i] = RandomMat(w, h, c);
+    }
+
+    // advance by one, stay, advance by two, then a window without shared slices
+    static const int starts[8] = {0, 1, 2, 2, 4, 5, 0, 1};
+
+    std::vector<ncnn::Mat> windows;
+    for (int i = 0; i < 8; i++)
+    {
+        windows.push_back(make_window(frames, starts[i], d));
+    }
+
+    std::vector<ncnn::Mat> a;
+    int ret = run_convolution3d(pd, weights, windows, a);
+    if (ret != 0)
+        return ret;
+
+    pd.set(20, 1);
+
+    std::vector<ncnn::Mat> b;
+    ret = run_convolution3d(pd, weights, windows, b);
+
+    for (size_t i = 0; ret == 0 && i < windows.size(); i++)
+    {
+        ret = CompareMat(a[i], b[i], 0.001);
+    }
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution3d_sliding failed w=%d h=%d d=%d c=%d outch=%d kernel=%d dilation=%d stride=%d pad=%d pad_value=%f bias=%d\n", w, h, d, c, outch, kernel, dilation, stride, pad, pad_value, bias);
+    }
+
+    return ret;
+}
+
+static int test_convolution3d_1()
+{
+    return 0
+           || test_convolution3d_sliding(9, 8, 6, 3, 4, 1, 1, 1, 0, 0.f, 1)
+           || test_convolution3d_sliding(9, 8, 6, 3, 4, 3, 1, 1, 1, 0.f, 0)
+           || test_convolution3d_sliding(9, 8, 6, 4, 5, 3, 1, 1, 1, 0.5f, 1)
+           || test_convolution3d_sliding(9, 8, 7, 4, 5, 3, 1, 2, 1, 0.f, 1)
+           || test_convolution3d_sliding(9, 8, 8, 2, 3, 3, 2, 1, -233, 0.f, 0)
+           || test_convolution3d_sliding(9, 8, 8, 2, 3, 2, 1, 1, -234, -0.5f, 1);
+}
+
 int main()
 {
     SRAND(7767517);
 
-    return test_convolution3d_0();
+    return 0
+           || test_convolution3d_0()
+           || test_convolution3d_1();
 }
@@ -0,0 +1,510 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+// the sparse convolutions skip relu outputs by an upper bound only
+// every frame must match the dense convolution
+
+// temporally correlated frames, small drift, static frames, local changes and a cut
+static std::vector<ncnn::Mat> RandomSequence(int w, int h, int c, int frames)
+{
+    std::vector<ncnn::Mat> seq;
+    seq.push_back(RandomMat(w, h, c));
+
+    for (int f = 1; f < frames; f++)
+    {
+        ncnn::Mat m = seq.back().clone();
+
+        const int kind = f % 4;
+        if (kind == 1)
+        {
+            // static frame
+        }
+        else if (kind == 2)
+        {
+            // small drift everywhere
+            float* ptr = m;
+            for (int i = 0; i < (int)m.total(); i++)
+            {
+                ptr[i] += RandomFloat(-0.05f, 0.05f);
+            }
+        }
+        else if (kind == 3)
+        {
+            // local change
+            const int x0 = RandomInt(0, w - 1);
+            const int y0 = RandomInt(0, h - 1);
+            for (int q = 0; q < c; q++)
+            {
+                for (int y = y0; y < std::min(y0 + 3, h); y++)
+                {
+                    float* ptr = m.channel(q).row(y);
+                    for (int x = x0; x < std::min(x0 + 3, w); x++)
+                    {
+                        ptr[x] = RandomFloat();
+                    }
+                }
+            }
+        }
+        else
+        {
+            // scene cut
+            Randomize(m);
+        }
+
+        seq.push_back(m);
+    }
+
+    return seq;
+}
+
+// the frames after the first compute only the tiles in dirty_mask when given
+static int run_convolution(const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights, const ncnn::Option& opt, const std::vector<ncnn::Mat>& seq, std::vector<ncnn::Mat>& outs,
+                           ncnn::LayerStats* stats = 0, const ncnn::Mat& dirty_mask = ncnn::Mat())
+{
+    ncnn::Layer* op = ncnn::create_layer("Convolution");
+
+    op->load_param(pd);
+
+    ncnn::ModelBinFromMatArray mb(weights.data());
+
+    op->load_model(mb);
+
+    op->create_pipeline(opt);
+
+    int ret = 0;
+    for (size_t f = 0; f < seq.size(); f++)
+    {
+        if (f > 0)
+            op->top_dirty_mask = dirty_mask;
+
+        ncnn::Mat out;
+        ret = op->forward(seq[f], out, opt);
+        if (ret != 0)
+            break;
+
+        outs.push_back(out.clone());
+    }
+
+    // every output of the sparse paths is skipped, reused, clean or computed, exactly once
+    if (ret == 0 && (opt.use_reserved_0 || opt.use_spatial_sparsity))
+    {
+        double outputs = 0.0;
+        for (size_t f = 0; f < outs.size(); f++)
+        {
+            outputs += (double)outs[f].w * outs[f].h * outs[f].c;
+        }
+
+        const ncnn::LayerStats& stats = op->stats;
+        const double counted = stats.skipped_outputs + stats.reused_outputs + stats.clean_outputs + stats.computed_outputs;
+        if (counted != outputs)
+        {
+            fprintf(stderr, "output stats %.0f != %.0f\n", counted, outputs);
+            ret = -1;
+        }
+    }
+
+    if (stats)
+        *stats = op->stats;
+
+    op->destroy_pipeline(opt);
+
+    delete op;
+
+    return ret;
+}
+
+// mode 0 = temporal kernel, 1 = spatial kernel
+static int test_convolution_sparse_seq(const std::vector<ncnn::Mat>& seq, int outch, int kernel, int dilation, int stride, int pad, int bias, int mode, int sparse_kernel, int num_threads)
+{
+    const int c = seq[0].c;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, kernel);
+    pd.set(2, dilation);
+    pd.set(3, stride);
+    pd.set(4, pad);
+    pd.set(5, bias);
+    pd.set(6, outch * c * kernel * kernel);
+    pd.set(9, 1); // relu
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = RandomMat(outch * c * kernel * kernel);
+    if (bias)
+    {
+        // mostly negative bias, the relu outputs are sparse
+        weights[1].create(outch);
+        Randomize(weights[1], -2.f, 0.5f);
+    }
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+    opt.use_temporal_sparsity = false;
+    opt.use_spatial_sparsity = false;
+    opt.use_reserved_0 = false;
+
+    std::vector<ncnn::Mat> a;
+    int ret = run_convolution(pd, weights, opt, seq, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution_sparse raw forward failed\n");
+        return ret;
+    }
+
+    pd.set(mode == 0 ? 22 : 23, sparse_kernel);
+
+    opt.num_threads = num_threads;
+    opt.use_temporal_sparsity = mode == 0;
+    opt.use_reserved_0 = mode == 0;
+    opt.use_spatial_sparsity = mode == 1;
+
+    std::vector<ncnn::Mat> b;
+    ret = run_convolution(pd, weights, opt, seq, b);
+
+    for (size_t f = 0; ret == 0 && f < seq.size(); f++)
+    {
+        ret = CompareMat(a[f], b[f], 0.001);
+        if (ret != 0)
+            fprintf(stderr, "frame %d mismatch\n", (int)f);
+    }
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution_sparse failed w=%d h=%d c=%d outch=%d kernel=%d dilation=%d stride=%d pad=%d bias=%d mode=%d sparse_kernel=%d num_threads=%d\n", seq[0].w, seq[0].h, c, outch, kernel, dilation, stride, pad, bias, mode, sparse_kernel, num_threads);
+    }
+
+    return ret;
+}
+
+static int test_convolution_sparse(int w, int h, int c, int outch, int kernel, int dilation, int stride, int pad, int bias, int mode, int sparse_kernel, int num_threads)
+{
+    return test_convolution_sparse_seq(RandomSequence(w, h, c, 12), outch, kernel, dilation, stride, pad, bias, mode, sparse_kernel, num_threads);
+}
+
+// the resolution changes mid stream, the state built on the old shape must not leak
+static int test_convolution_sparse_resize(int c, int outch, int kernel, int dilation, int stride, int pad, int mode, int sparse_kernel, int num_threads)
+{
+    static const int sizes[4][2] = {
+        {6, 6},
+        {40, 36},
+        {40, 36},
+        {9, 7},
+    };
+
+    std::vector<ncnn::Mat> seq;
+    for (int i = 0; i < 4; i++)
+    {
+        std::vector<ncnn::Mat> part = RandomSequence(sizes[i][0], sizes[i][1], c, 3);
+        seq.insert(seq.end(), part.begin(), part.end());
+    }
+
+    return test_convolution_sparse_seq(seq, outch, kernel, dilation, stride, pad, 1, mode, sparse_kernel, num_threads);
+}
+
+static int test_convolution_sparse_kernel(int mode, int sparse_kernel, int num_threads)
+{
+    static const int kdsp[8][4] = {
+        {1, 1, 1, 0},
+        {1, 1, 2, 0},
+        {3, 1, 1, 0},
+        {3, 1, 1, 1},
+        {3, 1, 2, 1},
+        {3, 2, 1, 2},
+        {5, 1, 1, 2},
+        {5, 2, 2, -233},
+    };
+
+    for (int i = 0; i < 8; i++)
+    {
+        const int k = kdsp[i][0];
+        const int d = kdsp[i][1];
+        const int s = kdsp[i][2];
+        const int p = kdsp[i][3];
+
+        int ret = 0
+                  || test_convolution_sparse(13, 11, 1, 4, k, d, s, p, 1, mode, sparse_kernel, num_threads)
+                  || test_convolution_sparse(12, 15, 3, 8, k, d, s, p, 0, mode, sparse_kernel, num_threads)
+                  || test_convolution_sparse(16, 14, 8, 7, k, d, s, p, 1, mode, sparse_kernel, num_threads);
+
+        if (ret != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int test_convolution_sparse_0()
+{
+    // temporal kernels, single and multiple threads
+    for (int i = 0; i < 5; i++)
+    {
+        int ret = 0
+                  || test_convolution_sparse_kernel(0, i, 1)
+                  || test_convolution_sparse_kernel(0, i, 4);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int test_convolution_sparse_1()
+{
+    // spatial kernels, single and multiple row strips
+    for (int i = 0; i < 3; i++)
+    {
+        int ret = 0
+                  || test_convolution_sparse_kernel(1, i, 1)
+                  || test_convolution_sparse_kernel(1, i, 4);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int run_maxpool(int pool_kernel, int pool_stride, int pool_pad, int pool_pad_mode, const std::vector<ncnn::Mat>& seq, std::vector<ncnn::Mat>& outs)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, 0); // max
+    pd.set(1, pool_kernel);
+    pd.set(2, pool_stride);
+    pd.set(3, pool_pad);
+    pd.set(5, pool_pad_mode);
+
+    ncnn::Layer* op = ncnn::create_layer("Pooling");
+
+    op->load_param(pd);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+
+    op->create_pipeline(opt);
+
+    int ret = 0;
+    for (size_t f = 0; f < seq.size(); f++)
+    {
+        ncnn::Mat out;
+        ret = op->forward(seq[f], out, opt);
+        if (ret != 0)
+            break;
+
+        outs.push_back(out);
+    }
+
+    op->destroy_pipeline(opt);
+
+    delete op;
+
+    return ret;
+}
+
+// the convolution output is bounded only, the pooled output must match
+// pool_pad_mode 0 = full, 1 = valid, 2 = same upper, 3 = same lower
+static int test_convolution_maxpool(int w, int h, int c, int outch, int kernel, int stride, int pad, int pool_kernel, int pool_stride, int pool_pad, int pool_pad_mode, int num_threads)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, kernel);
+    pd.set(3, stride);
+    pd.set(4, pad);
+    pd.set(5, 1);
+    pd.set(6, outch * c * kernel * kernel);
+    pd.set(9, 1); // relu
+
+    std::vector<ncnn::Mat> weights(2);
+    weights[0] = RandomMat(outch * c * kernel * kernel);
+    weights[1].create(outch);
+    Randomize(weights[1], -2.f, 0.5f);
+
+    std::vector<ncnn::Mat> seq = RandomSequence(w, h, c, 12);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+    opt.use_temporal_sparsity = false;
+    opt.use_spatial_sparsity = false;
+    opt.use_reserved_0 = false;
+
+    std::vector<ncnn::Mat> a;
+    int ret = run_convolution(pd, weights, opt, seq, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution_maxpool raw forward failed\n");
+        return ret;
+    }
+
+    pd.set(26, pool_kernel);
+    pd.set(27, pool_stride);
+    pd.set(28, pool_pad_mode == 2 ? -233 : pool_pad_mode == 3 ? -234 : pool_pad);
+
+    opt.num_threads = num_threads;
+    opt.use_temporal_sparsity = true;
+    opt.use_reserved_0 = true;
+
+    std::vector<ncnn::Mat> b;
+    ret = run_convolution(pd, weights, opt, seq, b);
+
+    std::vector<ncnn::Mat> pa;
+    std::vector<ncnn::Mat> pb;
+    if (ret == 0)
+        ret = run_maxpool(pool_kernel, pool_stride, pool_pad, pool_pad_mode, a, pa) || run_maxpool(pool_kernel, pool_stride, pool_pad, pool_pad_mode, b, pb);
+
+    for (size_t f = 0; ret == 0 && f < seq.size(); f++)
+    {
+        ret = CompareMat(pa[f], pb[f], 0.001);
+        if (ret != 0)
+            fprintf(stderr, "frame %d mismatch\n", (int)f);
+    }
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution_maxpool failed w=%d h=%d c=%d outch=%d kernel=%d stride=%d pad=%d pool_kernel=%d pool_stride=%d pool_pad=%d pool_pad_mode=%d num_threads=%d\n", w, h, c, outch, kernel, stride, pad, pool_kernel, pool_stride, pool_pad, pool_pad_mode, num_threads);
+    }
+
+    return ret;
+}
+
+static int test_convolution_sparse_2()
+{
+    static const int kspm[10][4] = {
+        {2, 2, 0, 1},
+        {3, 2, 0, 1},
+        {3, 2, 1, 1},
+        {3, 1, 1, 1},
+        {2, 2, 0, 0},
+        {3, 2, 0, 0},
+        {3, 2, 1, 0},
+        {3, 3, 1, 0},
+        {3, 2, 0, 2},
+        {3, 2, 0, 3},
+    };
+
+    for (int i = 0; i < 10; i++)
+    {
+        const int k = kspm[i][0];
+        const int s = kspm[i][1];
+        const int p = kspm[i][2];
+        const int m = kspm[i][3];
+
+        int ret = 0
+                  || test_convolution_maxpool(13, 11, 1, 4, 3, 1, 1, k, s, p, m, 1)
+                  || test_convolution_maxpool(12, 15, 3, 8, 1, 1, 0, k, s, p, m, 1)
+                  || test_convolution_maxpool(16, 14, 8, 7, 3, 2, 0, k, s, p, m, 4);
+
+        if (ret != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// the reused and clean outputs are counted apart from the skipped ones
+static int test_convolution_sparse_3()
+{
+    const int outch = 8;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, 3);
+    pd.set(4, 1);
+    pd.set(5, 1);
+    pd.set(6, outch * 4 * 3 * 3);
+    pd.set(9, 1); // relu
+    pd.set(20, 0.5f);
+
+    std::vector<ncnn::Mat> weights(2);
+    weights[0] = RandomMat(outch * 4 * 3 * 3);
+    weights[1] = RandomMat(outch);
+
+    std::vector<ncnn::Mat> seq = RandomSequence(24, 20, 4, 12);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+    opt.use_temporal_sparsity = true;
+    opt.use_spatial_sparsity = false;
+    opt.use_reserved_0 = true;
+    opt.use_approximate_reuse = true;
+
+    ncnn::LayerStats stats;
+
+    std::vector<ncnn::Mat> a;
+    int ret = run_convolution(pd, weights, opt, seq, a, &stats);
+    if (ret != 0 || stats.reused_outputs == 0 || stats.clean_outputs != 0)
+    {
+        fprintf(stderr, "test_convolution_sparse_3 reuse failed reused=%.0f clean=%.0f\n", stats.reused_outputs, stats.clean_outputs);
+        return -1;
+    }
+
+    pd.set(20, 0.f);
+    opt.use_approximate_reuse = false;
+
+    // only the first tile row is dirty
+    ncnn::Mat dirty_mask(3, 3, (size_t)1u);
+    memset(dirty_mask.data, 0, 9);
+    memset(dirty_mask.data, 1, 3);
+
+    std::vector<ncnn::Mat> b;
+    ret = run_convolution(pd, weights, opt, seq, b, &stats, dirty_mask);
+
+    const double clean_count = (double)(seq.size() - 1) * 24 * (20 - NCNN_DIRTY_TILE_SIZE) * outch;
+    if (ret != 0 || stats.reused_outputs != 0 || stats.clean_outputs != clean_count)
+    {
+        fprintf(stderr, "test_convolution_sparse_3 clean failed reused=%.0f clean=%.0f\n", stats.reused_outputs, stats.clean_outputs);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_convolution_sparse_4()
+{
+    // every temporal and spatial kernel across resolution changes
+    for (int i = 0; i < 5; i++)
+    {
+        int ret = 0
+                  || test_convolution_sparse_resize(3, 8, 3, 1, 1, 1, 0, i, 1)
+                  || test_convolution_sparse_resize(4, 6, 3, 1, 2, 0, 0, i, 4);
+        if (ret != 0)
+            return ret;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        int ret = 0
+                  || test_convolution_sparse_resize(3, 8, 3, 1, 1, 1, 1, i, 1)
+                  || test_convolution_sparse_resize(4, 6, 3, 1, 2, 0, 1, i, 4);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    SRAND(7767517);
+
+    return 0
+           || test_convolution_sparse_0()
+           || test_convolution_sparse_1()
+           || test_convolution_sparse_2()
+           || test_convolution_sparse_3()
+           || test_convolution_sparse_4();
+}
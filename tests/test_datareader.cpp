@@ -0,0 +1,318 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "datareader.h"
+#include "net.h"
+#include "testutil.h"
+
+#include <string.h>
+
+#if NCNN_STDIO
+static const char* model_path = "test_datareader_model.bin";
+static const char* empty_path = "test_datareader_empty.bin";
+static const char* truncated_path = "test_datareader_truncated.bin";
+static const char* cache_path = "test_datareader_cache.bin";
+
+static const char param_txt[] = "7767517\n3 3\n"
+                                "Input data 0 1 data 0=13 1=11 2=3\n"
+                                "Convolution conv0 1 1 data conv0 0=8 1=3 4=1 5=1 6=216 9=1\n"
+                                "Convolution conv1 1 1 conv0 out 0=5 1=1 5=1 6=40\n";
+
+// the same weights with another activation
+static const char param_leaky_txt[] = "7767517\n3 3\n"
+                                      "Input data 0 1 data 0=13 1=11 2=3\n"
+                                      "Convolution conv0 1 1 data conv0 0=8 1=3 4=1 5=1 6=216 9=2 -23310=1,1.000000e-01\n"
+                                      "Convolution conv1 1 1 conv0 out 0=5 1=1 5=1 6=40\n";
+
+static int write_file(const char* path, const std::vector<float>& data, size_t size)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    size_t nwrite = size ? fwrite(&data[0], 1, size, fp) : 0;
+    fclose(fp);
+
+    return nwrite == size ? 0 : -1;
+}
+
+static int write_model_files()
+{
+    // weight tag and data, then bias, for each convolution
+    std::vector<float> weights;
+
+    const int sizes[4] = {216, 8, 40, 5};
+    for (int i = 0; i < 4; i++)
+    {
+        if (i % 2 == 0)
+            weights.push_back(0.f);
+
+        ncnn::Mat m = RandomMat(sizes[i]);
+        weights.insert(weights.end(), (const float*)m, (const float*)m + sizes[i]);
+    }
+
+    const size_t size = weights.size() * sizeof(float);
+
+    if (write_file(model_path, weights, size) != 0
+            || write_file(empty_path, weights, 0) != 0
+            || write_file(truncated_path, weights, size / 2 + 2) != 0)
+        return -1;
+
+    return 0;
+}
+
+static void remove_model_files()
+{
+    remove(model_path);
+    remove(empty_path);
+    remove(truncated_path);
+    remove(cache_path);
+}
+
+// whether the file shows up in the mappings of this process
+static bool is_mapped(const char* path)
+{
+#if defined(__linux__)
+    FILE* fp = fopen("/proc/self/maps", "rb");
+    if (!fp)
+        return false;
+
+    bool mapped = false;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strstr(line, path))
+        {
+            mapped = true;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return mapped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+static int forward(ncnn::Net& net, const ncnn::Mat& in, ncnn::Mat& out)
+{
+    ncnn::Extractor ex = net.create_extractor();
+    ex.input("data", in);
+    return ex.extract("out", out);
+}
+
+// bit-identical, the channel gaps aside
+static bool is_same_mat(const ncnn::Mat& a, const ncnn::Mat& b)
+{
+    if (a.dims != b.dims || a.w != b.w || a.h != b.h || a.c != b.c || a.elemsize != b.elemsize || a.elempack != b.elempack)
+        return false;
+
+    for (int q = 0; q < a.c; q++)
+    {
+        if (memcmp(a.channel(q).data, b.channel(q).data, (size_t)a.w * a.h * a.elemsize) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+static int test_datareader_0()
+{
+    // the mapped reader hands out the file bytes in place
+    FILE* fp = fopen(model_path, "rb");
+    if (!fp)
+        return -1;
+
+    std::vector<unsigned char> bytes(64);
+    size_t nread = fread(&bytes[0], 1, 64, fp);
+    fclose(fp);
+
+    ncnn::DataReaderFromMmap dr(model_path);
+
+    unsigned char head[4];
+    const void* ref = 0;
+    if (nread != 64 || dr.size() == 0 || dr.read(head, 4) != 4 || dr.reference(60, &ref) != 60
+            || memcmp(head, &bytes[0], 4) != 0 || memcmp(ref, &bytes[4], 60) != 0)
+    {
+        fprintf(stderr, "test_datareader_0 mapped data mismatch\n");
+        return -1;
+    }
+
+    ncnn::DataReaderFromMmap dr_missing("test_datareader_missing.bin");
+    ncnn::DataReaderFromMmap dr_empty(empty_path);
+    if (dr_missing.size() != 0 || dr_empty.size() != 0 || dr_missing.read(head, 4) != 0 || dr_empty.reference(4, &ref) != 0)
+    {
+        fprintf(stderr, "test_datareader_0 unmappable file accepted\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_datareader_1()
+{
+    ncnn::Mat in = RandomMat(13, 11, 3);
+
+    ncnn::Net net_ref;
+    net_ref.opt.num_threads = 1;
+    ncnn::Mat a;
+    if (net_ref.load_param_mem(param_txt) != 0 || net_ref.load_model(model_path) != 0 || forward(net_ref, in, a) != 0)
+    {
+        fprintf(stderr, "test_datareader_1 load_model failed\n");
+        return -1;
+    }
+
+    ncnn::Net net;
+    net.opt.num_threads = 1;
+    ncnn::Mat b;
+    if (net.load_param_mem(param_txt) != 0 || net.load_model_mmap(model_path) != 0 || forward(net, in, b) != 0)
+    {
+        fprintf(stderr, "test_datareader_1 load_model_mmap failed\n");
+        return -1;
+    }
+
+    // the same weights, the same kernels
+    if (!is_same_mat(a, b))
+    {
+        fprintf(stderr, "test_datareader_1 load_model_mmap output differs\n");
+        return -1;
+    }
+
+#if defined(__linux__)
+    if (!is_mapped(model_path))
+    {
+        fprintf(stderr, "test_datareader_1 model not mapped\n");
+        return -1;
+    }
+#endif
+
+    net.clear();
+
+    if (is_mapped(model_path))
+    {
+        fprintf(stderr, "test_datareader_1 model still mapped after clear\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_datareader_2()
+{
+    // a file that cannot be mapped or holds too few weights fails cleanly
+    const char* paths[3] = {"test_datareader_missing.bin", empty_path, truncated_path};
+    for (int i = 0; i < 3; i++)
+    {
+        ncnn::Net net;
+        if (net.load_param_mem(param_txt) != 0)
+            return -1;
+
+        if (net.load_model_mmap(paths[i]) == 0)
+        {
+            fprintf(stderr, "test_datareader_2 load_model_mmap %s succeeded\n", paths[i]);
+            return -1;
+        }
+
+        net.clear();
+
+        if (is_mapped(paths[i]))
+        {
+            fprintf(stderr, "test_datareader_2 %s still mapped after clear\n", paths[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int forward_cached(const char* param, const ncnn::Option& opt, bool use_cache, const ncnn::Mat& in, ncnn::Mat& out)
+{
+    ncnn::Net net;
+    net.opt = opt;
+
+    if (use_cache)
+        net.set_weight_cache_path(cache_path);
+
+    if (net.load_param_mem(param) != 0 || net.load_model(model_path) != 0)
+        return -1;
+
+    return forward(net, in, out);
+}
+
+static int test_datareader_3(const ncnn::Option& opt)
+{
+    remove(cache_path);
+
+    ncnn::Mat in = RandomMat(13, 11, 3);
+
+    // the first load fills the cache, the second one restores the pipelines from it
+    // the leaky net shares the weights but not the activation
+    const char* params[3] = {param_txt, param_txt, param_leaky_txt};
+    for (int i = 0; i < 3; i++)
+    {
+        ncnn::Mat a;
+        ncnn::Mat b;
+        if (forward_cached(params[i], opt, false, in, a) != 0 || forward_cached(params[i], opt, true, in, b) != 0)
+        {
+            fprintf(stderr, "test_datareader_3 load %d failed\n", i);
+            return -1;
+        }
+
+        if (!is_same_mat(a, b))
+        {
+            fprintf(stderr, "test_datareader_3 cached load %d differs use_packing_layout=%d\n", i, opt.use_packing_layout);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif // NCNN_STDIO
+
+int main()
+{
+    SRAND(7767517);
+
+#if NCNN_STDIO
+    if (write_model_files() != 0)
+    {
+        remove_model_files();
+        return -1;
+    }
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+
+    ncnn::Option opt_pack1 = opt;
+    opt_pack1.use_packing_layout = false;
+
+    int ret = 0
+              || test_datareader_0()
+              || test_datareader_1()
+              || test_datareader_2()
+              || test_datareader_3(opt)
+              || test_datareader_3(opt_pack1);
+
+    remove_model_files();
+
+    return ret;
+#else
+    return 0;
+#endif
+}
@@ -78,7 +78,8 @@ static int test_gemm_0()
            || test_gemm(16, 24, 15, 0.1f, 0, 0)
            || test_gemm(16, 24, 15, 0.3f, 1, 0)
            || test_gemm(16, 24, 15, -0.4f, 0, 1)
-           || test_gemm(16, 24, 15, 1.7f, 1, 1);
+           || test_gemm(16, 24, 15, 1.7f, 1, 1)
+           || test_gemm(40, 150, 300, 0.5f, 0, 1);
 }
 
 static int test_gemm_1()
@@ -143,7 +144,8 @@ static int test_gemm_5()
            || test_gemm_bias(16, 24, 15, RandomMat(1, 14), 0.1f, 0.4f, 0, 0)
            || test_gemm_bias(16, 24, 15, RandomMat(1, 14), 0.4f, -1.f, 1, 0)
            || test_gemm_bias(16, 24, 15, RandomMat(1, 14), -0.3f, -0.21f, 0, 1)
-           || test_gemm_bias(16, 24, 15, RandomMat(1, 14), 1.7f, 1.3f, 1, 1);
+           || test_gemm_bias(16, 24, 15, RandomMat(1, 14), 1.7f, 1.3f, 1, 1)
+           || test_gemm_bias(40, 150, 300, RandomMat(1, 150), 1.f, 1.f, 0, 0);
 }
 
 static int test_gemm_6()
@@ -159,6 +161,20 @@ static int test_gemm_6()
            || test_gemm_bias(16, 24, 15, RandomMat(14), 1.7f, 1.3f, 1, 1);
 }
 
+static int test_gemm_7()
+{
+    // odd M N K tails of the x86 microkernels and of the 16 x 128 x 256 blocks
+    return 0
+           || test_gemm(1, 1, 1, 1.f, 0, 0)
+           || test_gemm(3, 7, 5, 0.6f, 0, 1)
+           || test_gemm(5, 9, 3, -1.1f, 1, 0)
+           || test_gemm(7, 17, 1, 0.3f, 1, 1)
+           || test_gemm(17, 31, 9, 1.f, 0, 0)
+           || test_gemm(19, 131, 257, 0.2f, 0, 1)
+           || test_gemm_bias(5, 23, 259, RandomMat(1, 23), 0.5f, 1.f, 0, 0)
+           || test_gemm_bias(18, 129, 7, RandomMat(129), 1.3f, 0.7f, 1, 1);
+}
+
 int main()
 {
     SRAND(7767517);
@@ -170,5 +186,6 @@ int main()
            || test_gemm_3()
            || test_gemm_4()
            || test_gemm_5()
-           || test_gemm_6();
+           || test_gemm_6()
+           || test_gemm_7();
 }
@@ -84,7 +84,8 @@ static int test_innerproduct_2()
            || test_innerproduct(RandomMat(32), 16, 1)
            || test_innerproduct(RandomMat(12), 16, 0)
            || test_innerproduct(RandomMat(16), 12, 1)
-           || test_innerproduct(RandomMat(24), 32, 1);
+           || test_innerproduct(RandomMat(24), 32, 1)
+           || test_innerproduct(RandomMat(300), 150, 1);
 }
 
 #if NCNN_INT8
@@ -192,7 +193,8 @@ static int test_innerproduct_4()
            || test_innerproduct_gemm(RandomMat(19, 16), 16, 1)
            || test_innerproduct_gemm(RandomMat(14, 15), 8, 1)
            || test_innerproduct_gemm(RandomMat(17, 15), 12, 1)
-           || test_innerproduct_gemm(RandomMat(12, 16), 7, 1);
+           || test_innerproduct_gemm(RandomMat(12, 16), 7, 1)
+           || test_innerproduct_gemm(RandomMat(300, 40), 150, 1);
 }
 
 #if NCNN_INT8
@@ -256,8 +256,138 @@ static int test_lstm_3()
            || test_lstm(RandomMat(2, 5), 17, 1);
 }
 
+static int test_lstm_streaming(const ncnn::Mat& a, int outch, float delta_threshold)
+{
+    int input_size = a.w;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, outch * input_size * 4);
+    pd.set(2, 0);
+    pd.set(20, 1);
+    pd.set(21, delta_threshold);
+
+    std::vector<ncnn::Mat> weights(3);
+    weights[0] = RandomMat(outch * input_size * 4);
+    weights[1] = RandomMat(outch * 4);
+    weights[2] = RandomMat(outch * outch * 4);
+
+    int ret = test_layer<ncnn::LSTM>("LSTM", pd, weights, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_lstm_streaming failed a.dims=%d a=(%d %d %d) outch=%d delta_threshold=%f\n", a.dims, a.w, a.h, a.c, outch, delta_threshold);
+    }
+
+    return ret;
+}
+
+static int test_lstm_streaming_chunks(int size, int T, int outch, int chunk, float delta_threshold)
+{
+    ncnn::Mat a = RandomMat(size, T);
+
+    // every other step repeats the previous input
+    for (int t = 1; t < T; t += 2)
+    {
+        memcpy(a.row(t), a.row(t - 1), size * sizeof(float));
+    }
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);
+    pd.set(1, outch * size * 4);
+    pd.set(2, 0);
+
+    std::vector<ncnn::Mat> weights(3);
+    weights[0] = RandomMat(outch * size * 4);
+    weights[1] = RandomMat(outch * 4);
+    weights[2] = RandomMat(outch * outch * 4);
+
+    // the whole sequence in one call
+    ncnn::Mat b;
+    test_layer_naive<ncnn::LSTM>(ncnn::layer_to_index("LSTM"), pd, weights, a, b, 0, 0);
+
+    pd.set(20, 1);
+    pd.set(21, delta_threshold);
+
+    ncnn::Layer* op = ncnn::create_layer("LSTM");
+
+    op->load_param(pd);
+
+    ncnn::ModelBinFromMatArray mb(weights.data());
+
+    op->load_model(mb);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+
+    op->create_pipeline(opt);
+
+    // the whole sequence in chunks, twice with a reset in between
+    int ret = 0;
+    for (int r = 0; ret == 0 && r < 2; r++)
+    {
+        ncnn::Mat c(outch, T);
+        for (int t = 0; ret == 0 && t < T; t += chunk)
+        {
+            const int n = std::min(chunk, T - t);
+
+            ncnn::Mat x = a.row_range(t, n).clone();
+
+            ncnn::Mat y;
+            ret = op->forward(x, y, opt);
+            if (ret == 0)
+                memcpy(c.row(t), y, outch * n * sizeof(float));
+        }
+
+        if (ret == 0)
+            ret = CompareMat(b, c, 0.001);
+
+        op->reset_state();
+    }
+
+    // the repeated inputs are never propagated in delta mode
+    if (ret == 0 && delta_threshold > 0.f && op->stats.macs_avoided == 0)
+    {
+        fprintf(stderr, "no delta skipped\n");
+        ret = -1;
+    }
+
+    op->destroy_pipeline(opt);
+
+    delete op;
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_lstm_streaming_chunks failed size=%d T=%d outch=%d chunk=%d delta_threshold=%f\n", size, T, outch, chunk, delta_threshold);
+    }
+
+    return ret;
+}
+
+static int test_lstm_4()
+{
+    return 0
+           || test_lstm_streaming(RandomMat(4, 12), 1, 0.f)
+           || test_lstm_streaming(RandomMat(16, 12), 8, 0.f)
+           || test_lstm_streaming(RandomMat(15, 13), 16, 1e-6f)
+           || test_lstm_streaming(RandomMat(8, 16), 17, 1e-6f)
+           || test_lstm_streaming(RandomMat(16, 12), 8, 0.1f)
+           || test_lstm_streaming(RandomMat(15, 13), 16, 0.1f);
+}
+
+static int test_lstm_5()
+{
+    return 0
+           || test_lstm_streaming_chunks(4, 12, 1, 1, 0.f)
+           || test_lstm_streaming_chunks(16, 12, 8, 1, 0.f)
+           || test_lstm_streaming_chunks(15, 13, 16, 3, 0.f)
+           || test_lstm_streaming_chunks(8, 16, 17, 16, 0.f)
+           || test_lstm_streaming_chunks(4, 12, 1, 1, 1e-6f)
+           || test_lstm_streaming_chunks(16, 12, 8, 1, 1e-6f)
+           || test_lstm_streaming_chunks(15, 13, 16, 3, 1e-6f);
+}
+
 int main()
 {
     SRAND(7767517);
-    return 0 || test_lstm_0() || test_lstm_1() || test_lstm_2() || test_lstm_3();
+    return 0 || test_lstm_0() || test_lstm_1() || test_lstm_2() || test_lstm_3() || test_lstm_4() || test_lstm_5();
 }
@@ -332,9 +332,104 @@ static int test_mat_pixel_2()
            || test_mat_pixel_roi_resize_bgra(15, 15, 7, 3, 1, 1, 1, 1);
 }
 
+// random luma, smooth chroma and no saturation
+// the fused conversion then matches the three pass conversion up to rounding
+static ncnn::Mat RandomNV12(int w, int h)
+{
+    ncnn::Mat m(w * h * 3 / 2, (size_t)1u);
+
+    unsigned char* p = m;
+    for (int i = 0; i < w * h; i++)
+    {
+        p[i] = 80 + RAND() % 96;
+    }
+
+    const int du = RAND() % 3 - 1;
+    const int dv = RAND() % 3 - 1;
+    unsigned char* uv = p + w * h;
+    for (int y = 0; y < h / 2; y++)
+    {
+        for (int x = 0; x < w / 2; x++)
+        {
+            uv[0] = 128 + (x * du + y * dv) / 2;
+            uv[1] = 128 - (x * dv + y * du) / 2;
+            uv += 2;
+        }
+    }
+
+    return m;
+}
+
+static int test_mat_pixel_yuv420_roi_resize_normalize(int w, int h, int roix, int roiy, int roiw, int roih, int target_width, int target_height, int num_threads)
+{
+    ncnn::Option opt;
+    opt.num_threads = num_threads;
+
+    ncnn::Mat nv12 = RandomNV12(w, h);
+
+    const float mean_vals[3] = {104.f, 117.f, 123.f};
+    const float norm_vals[3] = {0.017f, 0.018f, 0.019f};
+
+    // three passes
+    ncnn::Mat rgb(w * h * 3, (size_t)1u);
+    ncnn::yuv420sp2rgb_nv12(nv12, w, h, rgb);
+
+    ncnn::Mat a = ncnn::Mat::from_pixels_roi_resize(rgb, ncnn::Mat::PIXEL_RGB, w, h, roix, roiy, roiw, roih, target_width, target_height);
+    a.substract_mean_normalize(mean_vals, norm_vals);
+
+    ncnn::Mat b = ncnn::Mat::from_yuv420_roi_resize_normalize(nv12, ncnn::Mat::YUV420SP_NV12, w, h, roix, roiy, roiw, roih, ncnn::Mat::PIXEL_RGB, target_width, target_height, mean_vals, norm_vals, opt);
+
+    // the same image as nv21 and i420 to bgr
+    ncnn::Mat nv21 = nv12.clone();
+    ncnn::Mat i420 = nv12.clone();
+    {
+        const unsigned char* uv = (const unsigned char*)nv12 + w * h;
+        unsigned char* vu = (unsigned char*)nv21 + w * h;
+        unsigned char* u = (unsigned char*)i420 + w * h;
+        unsigned char* v = u + w * h / 4;
+        for (int i = 0; i < w * h / 4; i++)
+        {
+            vu[i * 2] = uv[i * 2 + 1];
+            vu[i * 2 + 1] = uv[i * 2];
+            u[i] = uv[i * 2];
+            v[i] = uv[i * 2 + 1];
+        }
+    }
+
+    const float mean_vals_bgr[3] = {123.f, 117.f, 104.f};
+    const float norm_vals_bgr[3] = {0.019f, 0.018f, 0.017f};
+
+    ncnn::Mat c = ncnn::Mat::from_yuv420_roi_resize_normalize(nv21, ncnn::Mat::YUV420SP_NV21, w, h, roix, roiy, roiw, roih, ncnn::Mat::PIXEL_BGR, target_width, target_height, mean_vals_bgr, norm_vals_bgr, opt);
+    ncnn::Mat d = ncnn::Mat::from_yuv420_roi_resize_normalize(i420, ncnn::Mat::YUV420P_I420, w, h, roix, roiy, roiw, roih, ncnn::Mat::PIXEL_RGB, target_width, target_height, mean_vals, norm_vals, opt);
+
+    ncnn::Mat c_rgb(target_width, target_height, 3);
+    memcpy(c_rgb.channel(0), c.channel(2), target_width * target_height * sizeof(float));
+    memcpy(c_rgb.channel(1), c.channel(1), target_width * target_height * sizeof(float));
+    memcpy(c_rgb.channel(2), c.channel(0), target_width * target_height * sizeof(float));
+
+    // 3 levels of 255 after normalization
+    if (Compare(a, b, 0.06f) != 0 || Compare(b, c_rgb, 0.0001f) != 0 || Compare(b, d, 0.0001f) != 0)
+    {
+        fprintf(stderr, "test_mat_pixel_yuv420_roi_resize_normalize failed w=%d h=%d roi=[%d %d %d %d] target_width=%d target_height=%d num_threads=%d\n", w, h, roix, roiy, roiw, roih, target_width, target_height, num_threads);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_mat_pixel_3()
+{
+    return 0
+           || test_mat_pixel_yuv420_roi_resize_normalize(16, 16, 0, 0, 16, 16, 16, 16, 1)
+           || test_mat_pixel_yuv420_roi_resize_normalize(32, 24, 0, 0, 32, 24, 13, 11, 1)
+           || test_mat_pixel_yuv420_roi_resize_normalize(32, 24, 4, 2, 20, 16, 27, 21, 2)
+           || test_mat_pixel_yuv420_roi_resize_normalize(64, 48, 8, 6, 32, 32, 24, 24, 4)
+           || test_mat_pixel_yuv420_roi_resize_normalize(6, 4, 0, 0, 6, 4, 9, 7, 1);
+}
+
 int main()
 {
     SRAND(7767517);
 
-    return test_mat_pixel_0() || test_mat_pixel_1() || test_mat_pixel_2();
+    return test_mat_pixel_0() || test_mat_pixel_1() || test_mat_pixel_2() || test_mat_pixel_3();
 }
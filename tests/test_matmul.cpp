@@ -133,7 +133,9 @@ static int test_matmul_7()
 
            || test_matmul_transb(RandomMat(14, 10), RandomMat(14, 5))
            || test_matmul_transb(RandomMat(16, 16), RandomMat(16, 10))
-           || test_matmul_transb(RandomMat(14, 28), RandomMat(14, 9));
+           || test_matmul_transb(RandomMat(14, 28), RandomMat(14, 9))
+           || test_matmul(RandomMat(300, 40), RandomMat(150, 300))
+           || test_matmul_transb(RandomMat(300, 40), RandomMat(300, 150));
 }
 
 static int test_matmul_8()
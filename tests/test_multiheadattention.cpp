@@ -83,14 +83,16 @@ static int test_multiheadattention_0()
 {
     return 0
            || test_multiheadattention(RandomMat(64, 128), 4)
-           || test_multiheadattention(RandomMat(64, 127), 16);
+           || test_multiheadattention(RandomMat(64, 127), 16)
+           || test_multiheadattention(RandomMat(32, 600), 2);
 }
 
 static int test_multiheadattention_1()
 {
     return 0
            || test_multiheadattention_sameqkv(RandomMat(64, 128), 8)
-           || test_multiheadattention_sameqkv(RandomMat(64, 127), 32);
+           || test_multiheadattention_sameqkv(RandomMat(64, 127), 32)
+           || test_multiheadattention_sameqkv(RandomMat(20, 531), 5);
 }
 
 int main()
@@ -0,0 +1,299 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "allocator.h"
+#include "net.h"
+#include "platform.h"
+#include "testutil.h"
+
+static const char param_txt[] = "7767517\n3 3\n"
+                                "Input data 0 1 data 0=12 1=10 2=3\n"
+                                "Convolution conv0 1 1 data conv0 0=8 1=3 4=1 5=1 6=216 9=1\n"
+                                "Convolution conv1 1 1 conv0 out 0=4 1=3 4=1 5=1 6=288\n";
+
+// two branches joined by concat
+static const char branch_param_txt[] = "7767517\n6 7\n"
+                                       "Input data 0 1 data 0=12 1=10 2=3\n"
+                                       "Split split 1 2 data data_0 data_1\n"
+                                       "Convolution conv0 1 1 data_0 conv0 0=4 1=3 4=1 5=1 6=108 9=1\n"
+                                       "Convolution conv1 1 1 data_1 conv1 0=4 1=1 5=1 6=12\n"
+                                       "Concat cat 2 1 conv0 conv1 cat\n"
+                                       "Convolution conv2 1 1 cat out 0=4 1=3 4=1 5=1 6=288\n";
+
+static std::vector<float> g_weights;
+static std::vector<float> g_branch_weights;
+
+static int load_net(ncnn::Net& net, const ncnn::Option& opt, const char* param, std::vector<float>& weights, const int* sizes, int size_count)
+{
+    if (weights.empty())
+    {
+        // weight tag and data, then bias, for each convolution
+        for (int i = 0; i < size_count; i++)
+        {
+            if (i % 2 == 0)
+                weights.push_back(0.f);
+
+            ncnn::Mat m = RandomMat(sizes[i]);
+            weights.insert(weights.end(), (const float*)m, (const float*)m + sizes[i]);
+        }
+    }
+
+    net.opt = opt;
+
+    if (net.load_param_mem(param) != 0)
+        return -1;
+
+    if (net.load_model((const unsigned char*)&weights[0]) != (int)(weights.size() * sizeof(float)))
+        return -1;
+
+    return 0;
+}
+
+static int load_net(ncnn::Net& net, const ncnn::Option& opt)
+{
+    const int sizes[4] = {216, 8, 288, 4};
+    return load_net(net, opt, param_txt, g_weights, sizes, 4);
+}
+
+static int load_branch_net(ncnn::Net& net, const ncnn::Option& opt)
+{
+    const int sizes[6] = {108, 4, 12, 4, 288, 4};
+    return load_net(net, opt, branch_param_txt, g_branch_weights, sizes, 6);
+}
+
+static int forward(ncnn::Net& net, const ncnn::Mat& in, ncnn::Mat& out)
+{
+    ncnn::Extractor ex = net.create_extractor();
+    ex.input("data", in);
+    return ex.extract("out", out);
+}
+
+// frames fed by interleaved extractors never pick up the memo of another frame
+static int test_net_0()
+{
+    ncnn::Option opt;
+    opt.num_threads = 1;
+
+    ncnn::Net net_ref;
+    ncnn::Net net;
+    if (load_net(net_ref, opt) != 0)
+        return -1;
+
+    opt.use_frame_memoization = true;
+    if (load_net(net, opt) != 0)
+        return -1;
+
+    ncnn::Mat x = RandomMat(12, 10, 3);
+    ncnn::Mat y = RandomMat(12, 10, 3);
+
+    ncnn::Mat x_ref;
+    ncnn::Mat y_ref;
+    forward(net_ref, x, x_ref);
+    forward(net_ref, y, y_ref);
+
+    ncnn::Mat a;
+    ncnn::Mat b;
+    ncnn::Mat c;
+    ncnn::Mat e;
+    {
+        ncnn::Extractor ex0 = net.create_extractor();
+        ncnn::Extractor ex1 = net.create_extractor();
+        ex0.input("data", x);
+        ex1.input("data", y);
+        ex0.extract("out", a);
+        ex1.extract("out", b);
+    }
+    {
+        // the same frame again, served from the memo
+        ncnn::Extractor ex0 = net.create_extractor();
+        ncnn::Extractor ex1 = net.create_extractor();
+        ex0.input("data", y);
+        ex1.input("data", x);
+        ex0.extract("out", c);
+        ex1.extract("out", e);
+    }
+
+    if (CompareMat(a, x_ref, 0.001) != 0 || CompareMat(b, y_ref, 0.001) != 0 || CompareMat(c, y_ref, 0.001) != 0 || CompareMat(e, x_ref, 0.001) != 0)
+    {
+        fprintf(stderr, "test_net_0 interleaved extractors failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+#if NCNN_THREADS
+struct memo_worker_args
+{
+    ncnn::Net* net;
+    const ncnn::Mat* frames;
+    const ncnn::Mat* refs;
+    int offset;
+    int ret;
+};
+
+static void* memo_worker(void* args)
+{
+    memo_worker_args* wa = (memo_worker_args*)args;
+
+    for (int i = 0; i < 40 && wa->ret == 0; i++)
+    {
+        // runs of repeated frames, shifted per worker
+        const int k = (i / 3 + wa->offset) % 2;
+
+        ncnn::Mat out;
+        if (forward(*wa->net, wa->frames[k], out) != 0 || CompareMat(out, wa->refs[k], 0.001) != 0)
+            wa->ret = -1;
+    }
+
+    return 0;
+}
+
+// concurrent extractors of one net with frame memoization
+static int test_net_1()
+{
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    // the temporal convolution keeps per layer state across frames, which one net cannot share between threads
+    opt.use_temporal_sparsity = false;
+
+    ncnn::Net net_ref;
+    ncnn::Net net;
+    if (load_net(net_ref, opt) != 0)
+        return -1;
+
+    opt.use_frame_memoization = true;
+    if (load_net(net, opt) != 0)
+        return -1;
+
+    ncnn::Mat frames[2];
+    ncnn::Mat refs[2];
+    for (int k = 0; k < 2; k++)
+    {
+        frames[k] = RandomMat(12, 10, 3);
+        forward(net_ref, frames[k], refs[k]);
+    }
+
+    memo_worker_args args[4];
+    ncnn::Thread* workers[4];
+    for (int i = 0; i < 4; i++)
+    {
+        args[i].net = &net;
+        args[i].frames = frames;
+        args[i].refs = refs;
+        args[i].offset = i;
+        args[i].ret = 0;
+        workers[i] = new ncnn::Thread(memo_worker, (void*)&args[i]);
+    }
+
+    int ret = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+
+        if (args[i].ret != 0)
+            ret = -1;
+    }
+
+    if (ret != 0)
+        fprintf(stderr, "test_net_1 concurrent extractors failed\n");
+
+    return ret;
+}
+
+// concurrent branches with dirty region, with and without a static arena
+static int test_net_2(bool use_arena)
+{
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+
+    ncnn::Net net_ref;
+    ncnn::Net net;
+    if (load_branch_net(net_ref, opt) != 0)
+        return -1;
+
+    opt.use_dirty_region = true;
+    if (load_branch_net(net, opt) != 0)
+        return -1;
+
+    ncnn::ArenaAllocator arena;
+
+    ncnn::Mat frame = RandomMat(12, 10, 3);
+
+    int ret = 0;
+    for (int f = 0; f < 8 && ret == 0; f++)
+    {
+        if (f > 0)
+        {
+            // the same small region changes every frame
+            for (int q = 0; q < frame.c; q++)
+            {
+                float* ptr = frame.channel(q).row(4) + 6;
+                ptr[0] = RandomFloat();
+                ptr[1] = RandomFloat();
+            }
+        }
+
+        ncnn::Mat a;
+        forward(net_ref, frame, a);
+
+        ncnn::Mat b;
+        size_t heap_bytes = 0;
+        {
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_inter_op_threads(4);
+            if (use_arena)
+                ex.set_static_arena(&arena);
+            ex.input("data", frame);
+            ex.extract("out", b);
+
+            heap_bytes = arena.heap_bytes();
+        }
+
+        if (CompareMat(a, b, 0.001) != 0)
+        {
+            fprintf(stderr, "test_net_2 frame %d mismatch use_arena=%d\n", f, use_arena);
+            ret = -1;
+        }
+
+        // the allocation order of the recorded frame is replayed
+        if (use_arena && f >= 3 && heap_bytes != 0)
+        {
+            fprintf(stderr, "test_net_2 frame %d left the arena heap_bytes=%d\n", f, (int)heap_bytes);
+            ret = -1;
+        }
+    }
+
+    net.clear();
+    arena.clear();
+
+    return ret;
+}
+#endif // NCNN_THREADS
+
+int main()
+{
+    SRAND(7767517);
+
+    return 0
+           || test_net_0()
+#if NCNN_THREADS
+           || test_net_1()
+           || test_net_2(false)
+           || test_net_2(true)
+#endif
+           ;
+}
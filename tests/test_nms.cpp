@@ -0,0 +1,215 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "nms.h"
+#include "testutil.h"
+
+struct BBox
+{
+    float xmin;
+    float ymin;
+    float xmax;
+    float ymax;
+    float score;
+    int label;
+};
+
+// clustered boxes over a large canvas, scores with ties
+static std::vector<BBox> RandomBBoxes(int n, int num_class)
+{
+    std::vector<BBox> bboxes(n);
+    for (int i = 0; i < n; i++)
+    {
+        const float cx = RandomInt(0, 19) * 50.f + RandomFloat(-20.f, 20.f);
+        const float cy = RandomInt(0, 19) * 50.f + RandomFloat(-20.f, 20.f);
+        const float w = RandomFloat(1.f, 60.f);
+        const float h = RandomFloat(1.f, 60.f);
+
+        BBox& b = bboxes[i];
+        b.xmin = cx - w * 0.5f;
+        b.ymin = cy - h * 0.5f;
+        b.xmax = cx + w * 0.5f;
+        b.ymax = cy + h * 0.5f;
+        b.score = RandomInt(0, 99) / 100.f;
+        b.label = RandomInt(0, num_class - 1);
+    }
+
+    return bboxes;
+}
+
+static int test_sort_descent_topk(int n, int topk)
+{
+    std::vector<BBox> bboxes = RandomBBoxes(n, 1);
+
+    std::vector<int> order;
+    ncnn::sort_descent_topk(&bboxes.data()->score, n, sizeof(BBox) / sizeof(float), topk, order);
+
+    // selection sort reference, ties keep the input order
+    std::vector<int> ref(n);
+    for (int i = 0; i < n; i++)
+    {
+        ref[i] = i;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int best = i;
+        for (int j = i + 1; j < n; j++)
+        {
+            if (bboxes[ref[j]].score > bboxes[ref[best]].score)
+                best = j;
+        }
+
+        int t = ref[best];
+        for (int j = best; j > i; j--)
+        {
+            ref[j] = ref[j - 1];
+        }
+        ref[i] = t;
+    }
+
+    const int k = topk <= 0 || topk > n ? n : topk;
+    if ((int)order.size() != k)
+    {
+        fprintf(stderr, "test_sort_descent_topk failed n=%d topk=%d size=%d\n", n, topk, (int)order.size());
+        return -1;
+    }
+
+    for (int i = 0; i < k; i++)
+    {
+        if (order[i] != ref[i])
+        {
+            fprintf(stderr, "test_sort_descent_topk failed n=%d topk=%d at %d\n", n, topk, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void nms_reference(const std::vector<BBox>& bboxes, bool use_label, float nms_threshold, int keep_top_k, std::vector<int>& picked)
+{
+    picked.clear();
+
+    for (int i = 0; i < (int)bboxes.size(); i++)
+    {
+        if (keep_top_k > 0 && (int)picked.size() == keep_top_k)
+            break;
+
+        const BBox& a = bboxes[i];
+
+        int keep = 1;
+        for (size_t j = 0; j < picked.size(); j++)
+        {
+            const BBox& b = bboxes[picked[j]];
+            if (use_label && a.label != b.label)
+                continue;
+
+            float inter_width = std::max(std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin), 0.f);
+            float inter_height = std::max(std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin), 0.f);
+            float inter_area = inter_width * inter_height;
+            float union_area = (a.xmax - a.xmin) * (a.ymax - a.ymin) + (b.xmax - b.xmin) * (b.ymax - b.ymin) - inter_area;
+            if (inter_area / union_area > nms_threshold)
+                keep = 0;
+        }
+
+        if (keep)
+            picked.push_back(i);
+    }
+}
+
+static int test_nms_sorted_bboxes(int n, int num_class, float nms_threshold, int keep_top_k, int grid_size)
+{
+    std::vector<BBox> unsorted = RandomBBoxes(n, num_class);
+
+    std::vector<int> order;
+    ncnn::sort_descent_topk(&unsorted.data()->score, n, sizeof(BBox) / sizeof(float), 0, order);
+
+    std::vector<BBox> bboxes(n);
+    for (int i = 0; i < n; i++)
+    {
+        bboxes[i] = unsorted[order[i]];
+    }
+
+    const bool use_label = num_class > 1;
+
+    std::vector<int> picked;
+    ncnn::nms_sorted_bboxes(&bboxes.data()->xmin, n, sizeof(BBox) / sizeof(float), 0, use_label ? &bboxes.data()->label : 0, nms_threshold, picked, keep_top_k, grid_size);
+
+    std::vector<int> ref;
+    nms_reference(bboxes, use_label, nms_threshold, keep_top_k, ref);
+
+    if (picked.size() != ref.size())
+    {
+        fprintf(stderr, "test_nms_sorted_bboxes failed n=%d num_class=%d nms_threshold=%f keep_top_k=%d grid_size=%d picked %d vs %d\n", n, num_class, nms_threshold, keep_top_k, grid_size, (int)picked.size(), (int)ref.size());
+        return -1;
+    }
+
+    for (size_t i = 0; i < ref.size(); i++)
+    {
+        if (picked[i] != ref[i])
+        {
+            fprintf(stderr, "test_nms_sorted_bboxes failed n=%d num_class=%d nms_threshold=%f keep_top_k=%d grid_size=%d at %d\n", n, num_class, nms_threshold, keep_top_k, grid_size, (int)i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_nms_0()
+{
+    return 0
+           || test_sort_descent_topk(0, 0)
+           || test_sort_descent_topk(1, 0)
+           || test_sort_descent_topk(17, 0)
+           || test_sort_descent_topk(17, 5)
+           || test_sort_descent_topk(300, 1)
+           || test_sort_descent_topk(300, 100)
+           || test_sort_descent_topk(300, 400);
+}
+
+static int test_nms_1()
+{
+    static const int grid_sizes[4] = {-1, 0, 4, 16};
+
+    for (int i = 0; i < 4; i++)
+    {
+        const int g = grid_sizes[i];
+
+        int ret = 0
+                  || test_nms_sorted_bboxes(0, 1, 0.45f, 0, g)
+                  || test_nms_sorted_bboxes(1, 1, 0.45f, 0, g)
+                  || test_nms_sorted_bboxes(7, 1, 0.45f, 0, g)
+                  || test_nms_sorted_bboxes(100, 1, 0.3f, 0, g)
+                  || test_nms_sorted_bboxes(100, 5, 0.3f, 0, g)
+                  || test_nms_sorted_bboxes(2000, 1, 0.45f, 0, g)
+                  || test_nms_sorted_bboxes(2000, 80, 0.5f, 0, g)
+                  || test_nms_sorted_bboxes(2000, 1, 0.7f, 50, g)
+                  || test_nms_sorted_bboxes(2000, 3, 0.f, 0, g);
+
+        if (ret != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    SRAND(7767517);
+
+    return 0
+           || test_nms_0()
+           || test_nms_1();
+}
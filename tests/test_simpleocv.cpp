@@ -0,0 +1,188 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2024 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mat.h"
+#include "prng.h"
+#include "simpleocv.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static struct prng_rand_t g_prng_rand_state;
+#define SRAND(seed) prng_srand(seed, &g_prng_rand_state)
+#define RAND()      prng_rand(&g_prng_rand_state)
+
+static const char* y4m_path = "test_simpleocv.y4m";
+static const char* raw_path = "test_simpleocv.raw";
+
+static const int frame_w = 10;
+static const int frame_h = 6;
+
+// more frames than the default ring of 4
+static const int frame_count = 7;
+
+static std::vector<unsigned char> random_bytes(int size)
+{
+    std::vector<unsigned char> v(size);
+    for (int i = 0; i < size; i++)
+    {
+        v[i] = (unsigned char)(RAND() % 256);
+    }
+    return v;
+}
+
+static bool is_frame(const cv::Mat& image, const unsigned char* bgr)
+{
+    return image.rows == frame_h && image.cols == frame_w && image.c == 3 && memcmp(image.data, bgr, frame_w * frame_h * 3) == 0;
+}
+
+// read every frame back, a copy held across read must keep its frame
+static int read_frames(cv::VideoCapture& cap, const std::vector<std::vector<unsigned char> >& expected, const char* name)
+{
+    if (!cap.isOpened() || cap.get(cv::CAP_PROP_FRAME_WIDTH) != frame_w || cap.get(cv::CAP_PROP_FRAME_HEIGHT) != frame_h)
+    {
+        fprintf(stderr, "test_simpleocv %s open failed\n", name);
+        return -1;
+    }
+
+    cv::Mat image;
+    cv::Mat kept;
+    for (int i = 0; i < frame_count; i++)
+    {
+        if (!cap.read(image) || !is_frame(image, &expected[i][0]))
+        {
+            fprintf(stderr, "test_simpleocv %s frame %d mismatch\n", name, i);
+            return -1;
+        }
+
+        if (i > 0 && !is_frame(kept, &expected[i - 1][0]))
+        {
+            fprintf(stderr, "test_simpleocv %s frame %d overwritten\n", name, i - 1);
+            return -1;
+        }
+
+        if (i % 2 == 0)
+            kept = image;
+        else
+            kept = image.clone();
+
+        if (cap.get(cv::CAP_PROP_POS_FRAMES) != i + 1)
+        {
+            fprintf(stderr, "test_simpleocv %s position %d wrong\n", name, i);
+            return -1;
+        }
+    }
+
+    if (cap.read(image) || !image.empty())
+    {
+        fprintf(stderr, "test_simpleocv %s read past the end\n", name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int test_simpleocv_0()
+{
+    // y4m 420, decoded the same way as the nv21 of its planes
+    std::vector<std::vector<unsigned char> > yuv(frame_count);
+    std::vector<std::vector<unsigned char> > expected(frame_count);
+
+    FILE* fp = fopen(y4m_path, "wb");
+    if (!fp)
+        return -1;
+
+    fprintf(fp, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C420jpeg\n", frame_w, frame_h);
+
+    const int size = frame_w * frame_h;
+    for (int i = 0; i < frame_count; i++)
+    {
+        yuv[i] = random_bytes(size * 3 / 2);
+
+        fprintf(fp, "FRAME\n");
+        fwrite(&yuv[i][0], 1, size * 3 / 2, fp);
+
+        std::vector<unsigned char> nv21(yuv[i].begin(), yuv[i].begin() + size);
+        for (int j = 0; j < size / 4; j++)
+        {
+            nv21.push_back(yuv[i][size + size / 4 + j]);
+            nv21.push_back(yuv[i][size + j]);
+        }
+
+        expected[i].resize(size * 3);
+        ncnn::yuv420sp2rgb(&nv21[0], frame_w, frame_h, &expected[i][0]);
+        for (int j = 0; j < size; j++)
+        {
+            std::swap(expected[i][j * 3], expected[i][j * 3 + 2]);
+        }
+    }
+
+    fclose(fp);
+
+    cv::VideoCapture cap(y4m_path);
+    if (cap.get(cv::CAP_PROP_FPS) != 30.0)
+    {
+        fprintf(stderr, "test_simpleocv y4m fps wrong\n");
+        return -1;
+    }
+
+    return read_frames(cap, expected, "y4m");
+}
+
+static int test_simpleocv_1()
+{
+    // raw rgb, swapped to bgr
+    std::vector<std::vector<unsigned char> > expected(frame_count);
+
+    FILE* fp = fopen(raw_path, "wb");
+    if (!fp)
+        return -1;
+
+    const int size = frame_w * frame_h;
+    for (int i = 0; i < frame_count; i++)
+    {
+        std::vector<unsigned char> rgb = random_bytes(size * 3);
+        fwrite(&rgb[0], 1, size * 3, fp);
+
+        expected[i] = rgb;
+        for (int j = 0; j < size; j++)
+        {
+            std::swap(expected[i][j * 3], expected[i][j * 3 + 2]);
+        }
+    }
+
+    fclose(fp);
+
+    // a ring shorter than the frames held by the caller
+    cv::VideoCapture cap;
+    cap.set(cv::CAP_PROP_BUFFERSIZE, 2);
+    cap.open(raw_path, cv::CAP_RAW_RGB, frame_w, frame_h);
+
+    return read_frames(cap, expected, "raw");
+}
+
+int main()
+{
+    SRAND(7767517);
+
+    int ret = 0
+              || test_simpleocv_0()
+              || test_simpleocv_1();
+
+    remove(y4m_path);
+    remove(raw_path);
+
+    return ret;
+}
@@ -158,7 +158,7 @@ static ncnn::Mat read_file_content(const char* filepath)
     return m;
 }
 
-static int test_squeezenet(const ncnn::Option& opt, int load_model_type, float epsilon = 0.001)
+static int test_squeezenet(const ncnn::Option& opt, int load_model_type, float epsilon = 0.001, int inter_op_threads = 1)
 {
     ncnn::Net squeezenet;
 
@@ -208,6 +208,7 @@ static int test_squeezenet(const ncnn::Option& opt, int load_model_type, float e
     in.substract_mean_normalize(mean_vals, 0);
 
     ncnn::Extractor ex = squeezenet.create_extractor();
+    ex.set_inter_op_threads(inter_op_threads);
 
     ncnn::Mat out;
     if (load_model_type == 0 || load_model_type == 1)
@@ -312,6 +313,17 @@ int main()
             return ret;
         }
 
+        if (opt.blob_allocator == 0 && opt.workspace_allocator == 0)
+        {
+            // the fire module expand branches run concurrently
+            ret = test_squeezenet(opt_cpu, load_model_types[i], epsilon, 2);
+            if (ret != 0)
+            {
+                fprintf(stderr, "test_squeezenet cpu inter op failed use_packing_layout=%d\n", opt.use_packing_layout);
+                return ret;
+            }
+        }
+
 #if NCNN_VULKAN
         ncnn::Option opt_gpu = opt;
         opt_gpu.use_vulkan_compute = true;
@@ -876,6 +876,17 @@ int ModelWriter::save(const char* parampath, const char* binpath)
             {
                 if (!op->activation_params.empty()) fprintf_param_float_array(10, op->activation_params, pp);
             }
+            fprintf_param_value(" 20=%e", reuse_error_abs)
+            fprintf_param_value(" 21=%e", reuse_error_rel)
+            fprintf_param_value(" 22=%d", temporal_kernel)
+            fprintf_param_value(" 23=%d", spatial_kernel)
+            fprintf_param_value(" 24=%d", sparse_mode)
+            fprintf_param_value(" 25=%d", refresh_interval)
+            fprintf_param_value(" 26=%d", pool_kernel)
+            {
+                if (op->pool_stride != op->pool_kernel) fprintf(pp, " 27=%d", op->pool_stride);
+            }
+            fprintf_param_value(" 28=%d", pool_pad)
 
             fwrite_weight_tag_data(op->weight_data, bp);
             fwrite_weight_data(op->bias_data, bp);
@@ -914,6 +925,7 @@ int ModelWriter::save(const char* parampath, const char* binpath)
                 if (op->pad_right != op->pad_left) fprintf(pp, " 15=%d", op->pad_right);
             }
             fprintf_param_value(" 18=%e", pad_value)
+            fprintf_param_value(" 20=%d", streaming)
             fprintf_param_value(" 5=%d", bias_term)
             fprintf_param_value(" 6=%d", weight_data_size)
             fprintf_param_value(" 9=%d", activation_type)
@@ -969,6 +981,7 @@ int ModelWriter::save(const char* parampath, const char* binpath)
                 if (op->pad_behind != op->pad_front) fprintf(pp, " 17=%d", op->pad_behind);
             }
             fprintf_param_value(" 18=%e", pad_value)
+            fprintf_param_value(" 20=%d", sliding_window)
             fprintf_param_value(" 5=%d", bias_term)
             fprintf_param_value(" 6=%d", weight_data_size)
             fprintf_param_value(" 9=%d", activation_type)
@@ -1607,6 +1620,8 @@ int ModelWriter::save(const char* parampath, const char* binpath)
             fprintf_param_value(" 0=%d", num_output)
             fprintf_param_value(" 1=%d", weight_data_size)
             fprintf_param_value(" 2=%d", direction)
+            fprintf_param_value(" 20=%d", streaming)
+            fprintf_param_value(" 21=%e", delta_threshold)
 
             fwrite_weight_tag_data(op->weight_xc_data, bp);
             fwrite_weight_tag_data(op->bias_c_data, bp);
@@ -1738,6 +1753,8 @@ int ModelWriter::save(const char* parampath, const char* binpath)
             fprintf_param_value(" 0=%d", num_output)
             fprintf_param_value(" 1=%d", weight_data_size)
             fprintf_param_value(" 2=%d", direction)
+            fprintf_param_value(" 20=%d", streaming)
+            fprintf_param_value(" 21=%e", delta_threshold)
 
             fwrite_weight_tag_data(op->weight_xc_data, bp);
             fwrite_weight_tag_data(op->bias_c_data, bp);
@@ -71,6 +71,7 @@ public:
     int fuse_innerproduct_activation();
     int fuse_memorydata_binaryop();
     int fuse_binaryop_eltwise();
+    int fuse_convolution_maxpool();
 
     int eliminate_dropout();
     int eliminate_pooling1x1();
@@ -2047,6 +2048,71 @@ int NetOptimize::fuse_binaryop_eltwise()
     return 0;
 }
 
+int NetOptimize::fuse_convolution_maxpool()
+{
+    const size_t layer_count = layers.size();
+    for (size_t i = 0; i < layer_count; i++)
+    {
+        if (layers[i]->type != "Convolution")
+            continue;
+
+        ncnn::Convolution* convolution = (ncnn::Convolution*)layers[i];
+        if (convolution->activation_type != 1)
+            continue;
+
+        // Convolution - Pooling, the pooling consumes the only reference
+        // the convolution output only holds the pooled windows after fusion,
+        // so it must not be read by any other layer nor be left as a net output
+        int top_blob_index = convolution->tops[0];
+        if (blobs[top_blob_index].consumer == -1)
+            continue;
+
+        size_t j = layer_count;
+        int consumer_count = 0;
+        for (size_t k = 0; k < layer_count; k++)
+        {
+            if (layers[k]->type == "ncnnfused")
+                continue;
+
+            for (size_t b = 0; b < layers[k]->bottoms.size(); b++)
+            {
+                if (layers[k]->bottoms[b] == top_blob_index)
+                {
+                    consumer_count++;
+                    j = k;
+                }
+            }
+        }
+
+        if (consumer_count != 1 || layers[j]->type != "Pooling")
+            continue;
+
+        if (blobs[top_blob_index].consumer != (int)j)
+            continue;
+
+        ncnn::Pooling* pooling = (ncnn::Pooling*)layers[j];
+        if (pooling->pooling_type != 0 || pooling->global_pooling || pooling->adaptive_pooling)
+            continue;
+
+        if (pooling->kernel_w != pooling->kernel_h || pooling->stride_w != pooling->stride_h || pooling->pad_left != pooling->pad_top)
+            continue;
+
+        // the pooling stays, the convolution learns its windows
+        fprintf(stderr, "fuse_convolution_maxpool %s %s\n", convolution->name.c_str(), pooling->name.c_str());
+
+        convolution->pool_kernel = pooling->kernel_w;
+        convolution->pool_stride = pooling->stride_w;
+        if (pooling->pad_mode == 2)
+            convolution->pool_pad = -233;
+        else if (pooling->pad_mode == 3)
+            convolution->pool_pad = -234;
+        else
+            convolution->pool_pad = pooling->pad_left;
+    }
+
+    return 0;
+}
+
 int NetOptimize::eliminate_dropout()
 {
     const size_t layer_count = layers.size();
@@ -2840,6 +2906,8 @@ int main(int argc, char** argv)
     optimizer.eliminate_reshape_after_global_pooling();
     optimizer.eliminate_reshape_before_binaryop();
 
+    optimizer.fuse_convolution_maxpool();
+
     optimizer.replace_convolution_with_innerproduct_after_global_pooling();
     optimizer.replace_convolution_with_innerproduct_after_innerproduct();
 
@@ -0,0 +1,718 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_DEPRECATE
+#endif
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(USE_NCNN_SIMPLEOCV)
+#include "simpleocv.h"
+#elif defined(USE_LOCAL_IMREADWRITE)
+#include "imreadwrite.h"
+#else
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#endif
+#include <string>
+#include <vector>
+
+// ncnn public header
+#include "cpu.h"
+#include "net.h"
+
+// ncnn private header
+#include "layer/convolution.h"
+
+// one candidate sparse algorithm, applied to every relu convolution in a pass
+class SparsePolicy
+{
+public:
+    SparsePolicy(int _mode, int _kernel, int _refresh_interval)
+        : mode(_mode), kernel(_kernel), refresh_interval(_refresh_interval)
+    {
+    }
+
+    const char* mode_name() const
+    {
+        if (mode == 1)
+            return "temporal";
+        if (mode == 2)
+            return "spatial";
+        return "dense";
+    }
+
+public:
+    // 0=dense 1=temporal 2=spatial
+    int mode;
+    int kernel;
+    int refresh_interval;
+};
+
+class SparseLayerStat
+{
+public:
+    SparseLayerStat()
+    {
+        best = 0;
+    }
+
+public:
+    // per candidate, average forward time in ms and skip ratio
+    std::vector<double> times;
+    std::vector<double> skip_ratios;
+
+    int best;
+};
+
+class SparsityNet : public ncnn::Net
+{
+public:
+    SparsityNet();
+
+    std::vector<ncnn::Blob>& blobs;
+    std::vector<ncnn::Layer*>& layers;
+
+public:
+    std::vector<std::vector<std::string> > listspaths;
+    std::vector<std::vector<float> > means;
+    std::vector<std::vector<float> > norms;
+    std::vector<std::vector<int> > shapes;
+    std::vector<int> type_to_pixels;
+    std::vector<int> refresh_intervals;
+    int sparsity_num_threads;
+    int max_frames;
+
+public:
+    int init();
+    int load_frames();
+    int calibrate();
+    void print_sparsity_info() const;
+    int save_table(const char* tablepath) const;
+
+protected:
+    void apply_policy(const SparsePolicy& policy);
+    int run_frames();
+
+public:
+    std::vector<int> input_blobs;
+    std::vector<int> output_blobs;
+    std::vector<int> conv_layers;
+
+    std::vector<SparsePolicy> policies;
+
+    // frames of all input blobs, in playback order
+    std::vector<std::vector<ncnn::Mat> > frames;
+
+    // result
+    std::vector<SparseLayerStat> sparse_layer_stats;
+};
+
+SparsityNet::SparsityNet()
+    : blobs(mutable_blobs()), layers(mutable_layers())
+{
+    sparsity_num_threads = ncnn::get_cpu_count();
+    max_frames = 0;
+}
+
+int SparsityNet::init()
+{
+    // find all input layers
+    for (int i = 0; i < (int)layers.size(); i++)
+    {
+        const ncnn::Layer* layer = layers[i];
+        if (layer->type == "Input")
+        {
+            input_blobs.push_back(layer->tops[0]);
+        }
+    }
+
+    // extract the graph outputs so that every layer runs
+    for (int i = 0; i < (int)blobs.size(); i++)
+    {
+        if (blobs[i].producer != -1 && blobs[i].consumer == -1)
+        {
+            output_blobs.push_back(i);
+        }
+    }
+
+    // find all relu conv layers, the sparse algorithms skip relu outputs only
+    for (int i = 0; i < (int)layers.size(); i++)
+    {
+        const ncnn::Layer* layer = layers[i];
+        if (layer->type == "Convolution" && ((const ncnn::Convolution*)layer)->activation_type == 1)
+        {
+            conv_layers.push_back(i);
+        }
+    }
+
+    if (refresh_intervals.empty())
+    {
+        refresh_intervals.push_back(0);
+    }
+
+    // dense first, a sparse algorithm has to beat it
+    policies.push_back(SparsePolicy(0, 0, 0));
+    for (int k = 0; k < 5; k++)
+    {
+        for (size_t r = 0; r < refresh_intervals.size(); r++)
+        {
+            policies.push_back(SparsePolicy(1, k, refresh_intervals[r]));
+        }
+    }
+    for (int k = 0; k < 2; k++)
+    {
+        policies.push_back(SparsePolicy(2, k, 0));
+    }
+
+    sparse_layer_stats.resize(conv_layers.size());
+
+    return 0;
+}
+
+/**
+ * Read and resize image
+ * shape is input as [w,h,...]
+ * if w and h both are given, image will be resized to exactly size.
+ * if w and h both are zero or negative, image will not be resized.
+ * if only h is zero or negative, image's width will scaled resize to w, keeping aspect ratio.
+ * if only w is zero or negative, image's height will scaled resize to h
+ * @return ncnn::Mat
+ */
+
+inline ncnn::Mat read_and_resize_image(const std::vector<int>& shape, const std::string& imagepath, int pixel_convert_type)
+{
+    int target_w = shape[0];
+    int target_h = shape[1];
+    cv::Mat bgr = cv::imread(imagepath, 1);
+    if (target_h <= 0 && target_w <= 0)
+    {
+        return ncnn::Mat::from_pixels(bgr.data, pixel_convert_type, bgr.cols, bgr.rows);
+    }
+    if (target_h <= 0 || target_w <= 0)
+    {
+        float scale = 1.0;
+        if (target_h <= 0)
+        {
+            scale = 1.0 * bgr.cols / target_w;
+            target_h = int(1.0 * bgr.rows / scale);
+        }
+        if (target_w <= 0)
+        {
+            scale = 1.0 * bgr.rows / target_h;
+            target_w = int(1.0 * bgr.cols / scale);
+        }
+    }
+    return ncnn::Mat::from_pixels_resize(bgr.data, pixel_convert_type, bgr.cols, bgr.rows, target_w, target_h);
+}
+
+int SparsityNet::load_frames()
+{
+    const int input_blob_count = (int)input_blobs.size();
+
+    int frame_count = (int)listspaths[0].size();
+    for (int j = 1; j < input_blob_count; j++)
+    {
+        frame_count = std::min(frame_count, (int)listspaths[j].size());
+    }
+    if (max_frames > 0)
+    {
+        frame_count = std::min(frame_count, max_frames);
+    }
+
+    // every candidate replays the same frames, decode them once
+    frames.resize(frame_count);
+    for (int i = 0; i < frame_count; i++)
+    {
+        for (int j = 0; j < input_blob_count; j++)
+        {
+            const int type_to_pixel = type_to_pixels[j];
+            const std::vector<float>& mean_vals = means[j];
+            const std::vector<float>& norm_vals = norms[j];
+
+            int pixel_convert_type = ncnn::Mat::PIXEL_BGR;
+            if (type_to_pixel != pixel_convert_type)
+            {
+                pixel_convert_type = pixel_convert_type | (type_to_pixel << ncnn::Mat::PIXEL_CONVERT_SHIFT);
+            }
+
+            ncnn::Mat in = read_and_resize_image(shapes[j], listspaths[j][i], pixel_convert_type);
+            if (in.empty())
+            {
+                fprintf(stderr, "read %s failed\n", listspaths[j][i].c_str());
+                return -1;
+            }
+
+            in.substract_mean_normalize(mean_vals.data(), norm_vals.data());
+
+            frames[i].push_back(in);
+        }
+    }
+
+    return 0;
+}
+
+void SparsityNet::apply_policy(const SparsePolicy& policy)
+{
+    for (size_t i = 0; i < conv_layers.size(); i++)
+    {
+        ncnn::Convolution* convolution = (ncnn::Convolution*)layers[conv_layers[i]];
+
+        convolution->sparse_mode = policy.mode;
+        convolution->temporal_kernel = policy.mode == 1 ? policy.kernel : 0;
+        convolution->spatial_kernel = policy.mode == 2 ? policy.kernel : 0;
+        convolution->refresh_interval = policy.refresh_interval;
+        convolution->reset_state();
+    }
+
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        layers[i]->stats.reset();
+    }
+}
+
+int SparsityNet::run_frames()
+{
+    const int input_blob_count = (int)input_blobs.size();
+    const int frame_count = (int)frames.size();
+
+    // the sparse state lives in the layers, frames must run in order on one extractor at a time
+    for (int i = 0; i < frame_count; i++)
+    {
+        ncnn::Extractor ex = create_extractor();
+
+        for (int j = 0; j < input_blob_count; j++)
+        {
+            ex.input(input_blobs[j], frames[i][j]);
+        }
+
+        for (size_t j = 0; j < output_blobs.size(); j++)
+        {
+            ncnn::Mat out;
+            int ret = ex.extract(output_blobs[j], out);
+            if (ret != 0)
+            {
+                fprintf(stderr, "extract failed at frame %d\n", i);
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int SparsityNet::calibrate()
+{
+    const int conv_layer_count = (int)conv_layers.size();
+    const int policy_count = (int)policies.size();
+
+    opt.num_threads = sparsity_num_threads;
+    opt.use_layer_stats = true;
+    opt.use_frame_memoization = false;
+    opt.use_dirty_region = false;
+
+    // warm up caches and allocators before the first measured candidate
+    apply_policy(policies[0]);
+    int ret = run_frames();
+    if (ret != 0)
+        return ret;
+
+    // the sparse algorithms are lossless, every layer sees the same input whatever
+    // the others run, so each layer picks its best candidate independently
+    for (int p = 0; p < policy_count; p++)
+    {
+        const SparsePolicy& policy = policies[p];
+
+        fprintf(stderr, "measure %s kernel=%d refresh=%d [ %d / %d ]\n", policy.mode_name(), policy.kernel, policy.refresh_interval, p + 1, policy_count);
+
+        apply_policy(policy);
+
+        ret = run_frames();
+        if (ret != 0)
+            return ret;
+
+        for (int i = 0; i < conv_layer_count; i++)
+        {
+            const ncnn::LayerStats& stats = layers[conv_layers[i]]->stats;
+
+            const double outputs = stats.skipped_outputs + stats.computed_outputs;
+
+            SparseLayerStat& stat = sparse_layer_stats[i];
+            stat.times.push_back(stats.forward_count > 0 ? stats.forward_time / stats.forward_count : 0.0);
+            stat.skip_ratios.push_back(outputs > 0 ? stats.skipped_outputs / outputs : 0.0);
+        }
+    }
+
+    for (int i = 0; i < conv_layer_count; i++)
+    {
+        SparseLayerStat& stat = sparse_layer_stats[i];
+
+        stat.best = 0;
+        for (int p = 1; p < policy_count; p++)
+        {
+            if (stat.times[p] < stat.times[stat.best])
+                stat.best = p;
+        }
+    }
+
+    return 0;
+}
+
+void SparsityNet::print_sparsity_info() const
+{
+    for (int i = 0; i < (int)conv_layers.size(); i++)
+    {
+        const SparseLayerStat& stat = sparse_layer_stats[i];
+        const SparsePolicy& policy = policies[stat.best];
+
+        fprintf(stderr, "%-40s : %-8s kernel = %d  refresh = %-4d  skip = %-6.2f  time = %-8.3f  dense = %-8.3f\n", layers[conv_layers[i]]->name.c_str(), policy.mode_name(), policy.kernel, policy.refresh_interval, stat.skip_ratios[stat.best], stat.times[stat.best], stat.times[0]);
+    }
+}
+
+int SparsityNet::save_table(const char* tablepath) const
+{
+    FILE* fp = fopen(tablepath, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", tablepath);
+        return -1;
+    }
+
+    fprintf(fp, "# layer mode kernel refresh_interval\n");
+
+    for (int i = 0; i < (int)conv_layers.size(); i++)
+    {
+        const SparseLayerStat& stat = sparse_layer_stats[i];
+        const SparsePolicy& policy = policies[stat.best];
+
+        fprintf(fp, "%s %s %d %d # skip=%.4f time=%.4f dense=%.4f\n", layers[conv_layers[i]]->name.c_str(), policy.mode_name(), policy.kernel, policy.refresh_interval, stat.skip_ratios[stat.best], stat.times[stat.best], stat.times[0]);
+    }
+
+    fclose(fp);
+
+    fprintf(stderr, "ncnn sparsity table create success\n");
+
+    return 0;
+}
+
+static std::vector<std::vector<std::string> > parse_comma_path_list(char* s)
+{
+    std::vector<std::vector<std::string> > aps;
+
+    char* pch = strtok(s, ",");
+    while (pch != NULL)
+    {
+        FILE* fp = fopen(pch, "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "fopen %s failed\n", pch);
+            break;
+        }
+
+        std::vector<std::string> paths;
+
+        // one frame path per line, in playback order
+        char line[1024];
+        while (!feof(fp))
+        {
+            char* ss = fgets(line, 1024, fp);
+            if (!ss)
+                break;
+
+            char filepath[256];
+            int nscan = sscanf(line, "%255s", filepath);
+            if (nscan != 1)
+                continue;
+
+            paths.push_back(std::string(filepath));
+        }
+
+        fclose(fp);
+
+        aps.push_back(paths);
+
+        pch = strtok(NULL, ",");
+    }
+
+    return aps;
+}
+
+static std::vector<std::vector<float> > parse_comma_float_array_list(char* s)
+{
+    std::vector<std::vector<float> > aaf;
+
+    char* pch = strtok(s, "[]");
+    while (pch != NULL)
+    {
+        // parse a,b,c
+        float v;
+        int nconsumed = 0;
+        int nscan = sscanf(pch, "%f%n", &v, &nconsumed);
+        if (nscan == 1)
+        {
+            // ok we get array
+            pch += nconsumed;
+
+            std::vector<float> af;
+            af.push_back(v);
+
+            nscan = sscanf(pch, ",%f%n", &v, &nconsumed);
+            while (nscan == 1)
+            {
+                pch += nconsumed;
+
+                af.push_back(v);
+
+                nscan = sscanf(pch, ",%f%n", &v, &nconsumed);
+            }
+
+            // array end
+            aaf.push_back(af);
+        }
+
+        pch = strtok(NULL, "[]");
+    }
+
+    return aaf;
+}
+
+static std::vector<std::vector<int> > parse_comma_int_array_list(char* s)
+{
+    std::vector<std::vector<int> > aai;
+
+    char* pch = strtok(s, "[]");
+    while (pch != NULL)
+    {
+        // parse a,b,c
+        int v;
+        int nconsumed = 0;
+        int nscan = sscanf(pch, "%d%n", &v, &nconsumed);
+        if (nscan == 1)
+        {
+            // ok we get array
+            pch += nconsumed;
+
+            std::vector<int> ai;
+            ai.push_back(v);
+
+            nscan = sscanf(pch, ",%d%n", &v, &nconsumed);
+            while (nscan == 1)
+            {
+                pch += nconsumed;
+
+                ai.push_back(v);
+
+                nscan = sscanf(pch, ",%d%n", &v, &nconsumed);
+            }
+
+            // array end
+            aai.push_back(ai);
+        }
+
+        pch = strtok(NULL, "[]");
+    }
+
+    return aai;
+}
+
+static std::vector<int> parse_comma_pixel_type_list(char* s)
+{
+    std::vector<int> aps;
+
+    char* pch = strtok(s, ",");
+    while (pch != NULL)
+    {
+        // RAW/RGB/BGR/GRAY/RGBA/BGRA
+        if (strcmp(pch, "RAW") == 0)
+            aps.push_back(-233);
+        if (strcmp(pch, "RGB") == 0)
+            aps.push_back(ncnn::Mat::PIXEL_RGB);
+        if (strcmp(pch, "BGR") == 0)
+            aps.push_back(ncnn::Mat::PIXEL_BGR);
+        if (strcmp(pch, "GRAY") == 0)
+            aps.push_back(ncnn::Mat::PIXEL_GRAY);
+        if (strcmp(pch, "RGBA") == 0)
+            aps.push_back(ncnn::Mat::PIXEL_RGBA);
+        if (strcmp(pch, "BGRA") == 0)
+            aps.push_back(ncnn::Mat::PIXEL_BGRA);
+
+        pch = strtok(NULL, ",");
+    }
+
+    return aps;
+}
+
+static void show_usage()
+{
+    fprintf(stderr, "Usage: ncnn2sparsity [ncnnparam] [ncnnbin] [list,...] [ncnntable] [(key=value)...]\n");
+    fprintf(stderr, "  mean=[104.0,117.0,123.0],...\n");
+    fprintf(stderr, "  norm=[1.0,1.0,1.0],...\n");
+    fprintf(stderr, "  shape=[224,224,3],...[w,h,c] or [w,h] **[0,0] will not resize\n");
+    fprintf(stderr, "  pixel=RAW/RGB/BGR/GRAY/RGBA/BGRA,...\n");
+    fprintf(stderr, "  refresh=[0,16,64] temporal refresh intervals to try\n");
+    fprintf(stderr, "  frames=0 **0 uses all frames\n");
+    fprintf(stderr, "  thread=8\n");
+    fprintf(stderr, "Sample usage: ncnn2sparsity vgg16.param vgg16.bin framelist.txt vgg16.sparsity mean=[104.0,117.0,123.0] norm=[1.0,1.0,1.0] shape=[224,224,3] pixel=BGR refresh=[0,16,64]\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        show_usage();
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            show_usage();
+            return -1;
+        }
+    }
+
+    const char* inparam = argv[1];
+    const char* inbin = argv[2];
+    char* lists = argv[3];
+    const char* outtable = argv[4];
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_fp16_packed = false;
+    opt.use_fp16_storage = false;
+    opt.use_fp16_arithmetic = false;
+
+    SparsityNet net;
+    net.opt = opt;
+    if (net.load_param(inparam) != 0 || net.load_model(inbin) != 0)
+    {
+        fprintf(stderr, "load %s %s failed\n", inparam, inbin);
+        return -1;
+    }
+
+    // load lists
+    net.listspaths = parse_comma_path_list(lists);
+
+    for (int i = 5; i < argc; i++)
+    {
+        // key=value
+        char* kv = argv[i];
+
+        char* eqs = strchr(kv, '=');
+        if (eqs == NULL)
+        {
+            fprintf(stderr, "unrecognized arg %s\n", kv);
+            continue;
+        }
+
+        // split k v
+        eqs[0] = '\0';
+        const char* key = kv;
+        char* value = eqs + 1;
+
+        // load mean norm shape
+        if (memcmp(key, "mean", 4) == 0)
+            net.means = parse_comma_float_array_list(value);
+        if (memcmp(key, "norm", 4) == 0)
+            net.norms = parse_comma_float_array_list(value);
+        if (memcmp(key, "shape", 5) == 0)
+            net.shapes = parse_comma_int_array_list(value);
+        if (memcmp(key, "pixel", 5) == 0)
+            net.type_to_pixels = parse_comma_pixel_type_list(value);
+        if (memcmp(key, "refresh", 7) == 0)
+        {
+            std::vector<std::vector<int> > refresh = parse_comma_int_array_list(value);
+            if (!refresh.empty())
+                net.refresh_intervals = refresh[0];
+        }
+        if (memcmp(key, "frames", 6) == 0)
+            net.max_frames = atoi(value);
+        if (memcmp(key, "thread", 6) == 0)
+            net.sparsity_num_threads = atoi(value);
+    }
+
+    net.init();
+
+    // sanity check
+    const size_t input_blob_count = net.input_blobs.size();
+    if (net.listspaths.size() != input_blob_count)
+    {
+        fprintf(stderr, "expect %d lists, but got %d\n", (int)input_blob_count, (int)net.listspaths.size());
+        return -1;
+    }
+    if (net.means.size() != input_blob_count)
+    {
+        fprintf(stderr, "expect %d means, but got %d\n", (int)input_blob_count, (int)net.means.size());
+        return -1;
+    }
+    if (net.norms.size() != input_blob_count)
+    {
+        fprintf(stderr, "expect %d norms, but got %d\n", (int)input_blob_count, (int)net.norms.size());
+        return -1;
+    }
+    if (net.shapes.size() != input_blob_count)
+    {
+        fprintf(stderr, "expect %d shapes, but got %d\n", (int)input_blob_count, (int)net.shapes.size());
+        return -1;
+    }
+    if (net.type_to_pixels.size() != input_blob_count)
+    {
+        fprintf(stderr, "expect %d pixels, but got %d\n", (int)input_blob_count, (int)net.type_to_pixels.size());
+        return -1;
+    }
+    if (net.sparsity_num_threads < 0)
+    {
+        fprintf(stderr, "malformed thread %d\n", net.sparsity_num_threads);
+        return -1;
+    }
+    for (size_t i = 0; i < net.refresh_intervals.size(); i++)
+    {
+        if (net.refresh_intervals[i] < 0)
+        {
+            fprintf(stderr, "malformed refresh %d\n", net.refresh_intervals[i]);
+            return -1;
+        }
+    }
+    if (net.conv_layers.empty())
+    {
+        fprintf(stderr, "no relu convolution found\n");
+        return -1;
+    }
+
+    if (net.load_frames() != 0)
+        return -1;
+
+    if (net.frames.empty())
+    {
+        fprintf(stderr, "no frame found\n");
+        return -1;
+    }
+
+    fprintf(stderr, "frames = %d\n", (int)net.frames.size());
+    fprintf(stderr, "candidates = %d\n", (int)net.policies.size());
+    fprintf(stderr, "thread = %d\n", net.sparsity_num_threads);
+    fprintf(stderr, "---------------------------------------\n");
+
+    if (net.calibrate() != 0)
+        return -1;
+
+    net.print_sparsity_info();
+
+    return net.save_table(outtable);
+}